@@ -9,5 +9,21 @@
 #include "core/bench_map.h"
 #undef BENCH_MAP_INLINE
 
+#include "core/bench_map_filter.h"
+#include "core/bench_frozen_map.h"
+#include "core/bench_map_geometry.h"
+#include "core/bench_map_fixed.h"
+#include "core/bench_str_map.h"
+#include "core/bench_intern.h"
 #include "core/bench_std_map.h"
+#include "core/bench_btree.h"
+#include "core/bench_slotmap.h"
+#include "core/bench_cache.h"
+#include "core/bench_hash.h"
 
+
+#include "core/bench_sync_map.h"
+#include "core/bench_cow_map.h"
+#include "core/bench_map_parallel.h"
+#include "core/bench_agg.h"
+#include "core/bench_join.h"
@@ -56,6 +56,9 @@ int main(int argc, char **argv)
 			double cy = benchmark->avg_cycles / (double)count;
 			double ghz = cy / ns;
 			printf("  %12u: %10.2fns %10.2fcy %10u runs\n", count, ns, cy, benchmark->num_runs);
+			boa_for (boa_benchmark_metric, metric, &benchmark->metrics) {
+				printf("  %12s  %s: %.2f\n", "", metric->name, metric->value);
+			}
 		}
 	}
 
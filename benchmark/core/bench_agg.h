@@ -0,0 +1,118 @@
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_agg_groups;
+uint32_t g_agg_method;
+
+static uint32_t agg_sizes[] = {
+	1000000,
+};
+
+static uint32_t agg_group_values[] = {
+	100, 100000, 1000000,
+};
+
+// 0: Hand-rolled blit map insert loop, 1: boa_agg_add(), 2: boa_agg_add_batch()
+static uint32_t agg_method_values[] = {
+	0, 1, 2,
+};
+
+typedef struct agg_bench_row { uint64_t key; double value; } agg_bench_row;
+typedef struct agg_bench_group { uint64_t key; uint64_t count; double sum, min, max; } agg_bench_group;
+
+agg_bench_row *make_agg_rows(uint32_t count, uint32_t num_groups)
+{
+	agg_bench_row *rows = boa_make_n(agg_bench_row, count);
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < count; i++) {
+		x = x * 1664525u + 1013904223u;
+		rows[i].key = (uint64_t)(x % num_groups) * 0x9e3779b97f4a7c15u;
+		rows[i].value = (double)(i & 0xff);
+	}
+	return rows;
+}
+
+void init_bench_agg(boa_agg *agg)
+{
+	boa_agg_opts opts = { 0 };
+	opts.key_size = sizeof(uint64_t);
+	opts.row_size = sizeof(agg_bench_row);
+	opts.value_offset = offsetof(agg_bench_row, value);
+	boa_agg_init(agg, &opts, NULL);
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(agg_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_agg_groups, agg_group_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_agg_method, agg_method_values);
+
+BOA_BENCHMARK(agg_rows, "Aggregate the count, sum, min and max of rows grouped by a 64-bit key")
+{
+	uint32_t count = boa_benchmark_count();
+	agg_bench_row *rows = make_agg_rows(count, g_agg_groups);
+
+	boa_agg agg;
+	init_bench_agg(&agg);
+
+	boa_benchmark_for() {
+		boa_map_clear(&agg.map);
+
+		if (g_agg_method == 0) {
+			for (uint32_t i = 0; i < count; i++) {
+				boa_map_insert_result ires = boa_blit_map_insert(&agg.map, &rows[i].key, sizeof(uint64_t));
+				agg_bench_group *group = (agg_bench_group*)ires.entry;
+				double value = rows[i].value;
+				if (ires.inserted) {
+					group->key = rows[i].key;
+					group->count = 0;
+					group->sum = 0.0;
+					group->min = group->max = value;
+				}
+				group->count++;
+				group->sum += value;
+				if (value < group->min) group->min = value;
+				if (value > group->max) group->max = value;
+			}
+		} else if (g_agg_method == 1) {
+			for (uint32_t i = 0; i < count; i++) {
+				boa_agg_add(&agg, &rows[i]);
+			}
+		} else {
+			boa_agg_add_batch(&agg, rows, count);
+		}
+	}
+
+	boa_agg_reset(&agg);
+	boa_free(rows);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_agg_method);
+
+BOA_BENCHMARK(agg_merge_partials, "Merge 4 partial aggregates of a quarter of the rows each")
+{
+	uint32_t count = boa_benchmark_count();
+	agg_bench_row *rows = make_agg_rows(count, g_agg_groups);
+
+	boa_agg partials[4], total;
+	for (uint32_t i = 0; i < 4; i++) {
+		init_bench_agg(&partials[i]);
+		boa_agg_add_batch(&partials[i], rows + count / 4 * i, count / 4);
+	}
+	init_bench_agg(&total);
+
+	boa_benchmark_for() {
+		boa_map_clear(&total.map);
+		for (uint32_t i = 0; i < 4; i++) {
+			boa_agg_merge(&total, &partials[i]);
+		}
+	}
+
+	for (uint32_t i = 0; i < 4; i++) {
+		boa_agg_reset(&partials[i]);
+	}
+	boa_agg_reset(&total);
+	boa_free(rows);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_agg_groups);
+BOA_BENCHMARK_END_COUNT();
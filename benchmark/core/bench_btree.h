@@ -0,0 +1,171 @@
+#if BOA_BENCHMARK_IMPL
+#include <map>
+
+uint32_t g_btree_node_size;
+
+typedef struct { uint32_t key, val; } btree_bench_kv;
+
+static uint32_t btree_sizes[] = {
+	1000, 100000, 1000000,
+};
+
+// 0: std::map, otherwise `boa_btree` node size in bytes
+static uint32_t btree_node_size_values[] = {
+	0, 256, 512, 4096,
+};
+
+// Shuffled keys with gaps so that lower bounds don't always hit
+uint32_t *btree_bench_keys(uint32_t count)
+{
+	uint32_t *keys = boa_make_n(uint32_t, count);
+	for (uint32_t i = 0; i < count; i++) keys[i] = i * 2;
+	uint32_t x = 1;
+	for (uint32_t i = count - 1; i > 0; i--) {
+		x = x * 1664525u + 1013904223u;
+		uint32_t j = x % (i + 1);
+		uint32_t t = keys[i]; keys[i] = keys[j]; keys[j] = t;
+	}
+	return keys;
+}
+
+void btree_bench_fill(boa_btree *tree, std::map<uint32_t, uint32_t> &map, uint32_t count)
+{
+	if (g_btree_node_size) {
+		boa_btree_init(tree, sizeof(btree_bench_kv), BOA_BTREE_KEY_U32, g_btree_node_size, NULL);
+		btree_bench_kv *entries = boa_make_n(btree_bench_kv, count);
+		for (uint32_t i = 0; i < count; i++) {
+			entries[i].key = i * 2;
+			entries[i].val = i;
+		}
+		boa_benchmark_assert(boa_btree_build(tree, entries, count));
+		boa_free(entries);
+	} else {
+		for (uint32_t i = 0; i < count; i++) {
+			map[i * 2] = i;
+		}
+	}
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(btree_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_btree_node_size, btree_node_size_values);
+
+BOA_BENCHMARK(btree_insert_random, "Insert shuffled integers into an ordered map")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t *keys = btree_bench_keys(count);
+
+	boa_benchmark_for() {
+		if (g_btree_node_size) {
+			boa_btree tree;
+			boa_btree_init(&tree, sizeof(btree_bench_kv), BOA_BTREE_KEY_U32, g_btree_node_size, NULL);
+			for (uint32_t i = 0; i < count; i++) {
+				btree_bench_kv *kv = (btree_bench_kv*)boa_u32_btree_insert(&tree, keys[i]).entry;
+				kv->val = i;
+			}
+			boa_benchmark_assert(tree.count == count);
+			boa_btree_reset(&tree);
+		} else {
+			std::map<uint32_t, uint32_t> map;
+			for (uint32_t i = 0; i < count; i++) {
+				map[keys[i]] = i;
+			}
+			boa_benchmark_assert(map.size() == count);
+		}
+	}
+
+	boa_free(keys);
+}
+
+BOA_BENCHMARK(btree_build_sorted, "Build an ordered map from sorted integers")
+{
+	uint32_t count = boa_benchmark_count();
+	btree_bench_kv *entries = boa_make_n(btree_bench_kv, count);
+	for (uint32_t i = 0; i < count; i++) {
+		entries[i].key = i * 2;
+		entries[i].val = i;
+	}
+
+	boa_benchmark_for() {
+		if (g_btree_node_size) {
+			boa_btree tree;
+			boa_btree_init(&tree, sizeof(btree_bench_kv), BOA_BTREE_KEY_U32, g_btree_node_size, NULL);
+			boa_benchmark_assert(boa_btree_build(&tree, entries, count));
+			boa_btree_reset(&tree);
+		} else {
+			// Hinted insert at the end is the closest std::map has to a bulk load
+			std::map<uint32_t, uint32_t> map;
+			for (uint32_t i = 0; i < count; i++) {
+				map.emplace_hint(map.end(), entries[i].key, entries[i].val);
+			}
+			boa_benchmark_assert(map.size() == count);
+		}
+	}
+
+	boa_free(entries);
+}
+
+BOA_BENCHMARK(btree_find_random, "Find shuffled integers from an ordered map")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t *keys = btree_bench_keys(count);
+	boa_btree tree;
+	std::map<uint32_t, uint32_t> map;
+	btree_bench_fill(&tree, map, count);
+
+	boa_benchmark_for() {
+		if (g_btree_node_size) {
+			for (uint32_t i = 0; i < count; i++) {
+				btree_bench_kv *kv = (btree_bench_kv*)boa_u32_btree_find(&tree, keys[i]);
+				boa_benchmark_assert(kv->key == keys[i]);
+			}
+		} else {
+			for (uint32_t i = 0; i < count; i++) {
+				auto it = map.find(keys[i]);
+				boa_benchmark_assert(it->first == keys[i]);
+			}
+		}
+	}
+
+	if (g_btree_node_size) boa_btree_reset(&tree);
+	boa_free(keys);
+}
+
+BOA_BENCHMARK(btree_range_scan, "Sum the values of 64 consecutive keys from random lower bounds")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t *keys = btree_bench_keys(count);
+	boa_btree tree;
+	std::map<uint32_t, uint32_t> map;
+	btree_bench_fill(&tree, map, count);
+	uint32_t num_ranges = count / 64 + 1;
+
+	boa_benchmark_for() {
+		uint32_t sum = 0;
+		if (g_btree_node_size) {
+			for (uint32_t i = 0; i < num_ranges; i++) {
+				boa_btree_iterator it = boa_u32_btree_lower_bound(&tree, keys[i] + 1);
+				for (uint32_t n = 0; n < 64 && it.entry; n++) {
+					sum += ((btree_bench_kv*)it.entry)->val;
+					boa_btree_advance(&tree, &it);
+				}
+			}
+		} else {
+			for (uint32_t i = 0; i < num_ranges; i++) {
+				auto it = map.lower_bound(keys[i] + 1);
+				for (uint32_t n = 0; n < 64 && it != map.end(); n++) {
+					sum += it->second;
+					++it;
+				}
+			}
+		}
+		boa_benchmark_assert(sum != 1);
+	}
+
+	if (g_btree_node_size) boa_btree_reset(&tree);
+	boa_free(keys);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_btree_node_size);
+BOA_BENCHMARK_END_COUNT();
@@ -0,0 +1,63 @@
+#if BOA_BENCHMARK_IMPL
+uint32_t g_cache_policy;
+
+static uint32_t cache_sizes[] = {
+	1000, 100000,
+};
+
+static uint32_t cache_policy_values[] = {
+	BOA_CACHE_LRU, BOA_CACHE_CLOCK,
+};
+
+// Skewed keys from a key space of `4 * count` where low keys are accessed more
+uint32_t *cache_bench_keys(uint32_t count, uint32_t num_accesses)
+{
+	uint32_t *keys = boa_make_n(uint32_t, num_accesses);
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < num_accesses; i++) {
+		x = x * 1664525u + 1013904223u;
+		double r = (double)(x >> 8) / (double)(1u << 24);
+		keys[i] = (uint32_t)(r * r * r * 4.0 * count);
+	}
+	return keys;
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(cache_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_cache_policy, cache_policy_values);
+
+BOA_BENCHMARK(cache_skewed_lookup, "Look up skewed keys in a cache of count entries, inserting on misses")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t num_accesses = count * 8;
+	uint32_t *keys = cache_bench_keys(count, num_accesses);
+
+	boa_benchmark_for() {
+		boa_cache cache;
+		boa_cache_opts opts = { 0 };
+		opts.entry_size = sizeof(kv_int);
+		opts.budget = (uint64_t)count * sizeof(kv_int);
+		opts.policy = g_cache_policy;
+		boa_cache_init(&cache, &opts);
+
+		for (uint32_t i = 0; i < num_accesses; i++) {
+			int key = (int)keys[i];
+			kv_int *kv = (kv_int*)boa_cache_find_inline(&cache, &key, int_hash(key), &int_cmp, NULL);
+			if (!kv) {
+				kv = (kv_int*)boa_cache_insert(&cache, &key, int_hash(key), &int_cmp, NULL, sizeof(kv_int)).entry;
+				kv->key = key;
+				kv->val = 0;
+			}
+			kv->val++;
+		}
+		boa_benchmark_assert(cache.map.count <= count);
+		boa_benchmark_assert(cache.hits + cache.misses == num_accesses);
+		boa_cache_reset(&cache);
+	}
+
+	boa_free(keys);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_cache_policy);
+BOA_BENCHMARK_END_COUNT();
@@ -0,0 +1,140 @@
+#include <boa_os.h>
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_cow_threads;
+uint32_t g_cow_method;
+
+static uint32_t cow_map_sizes[] = {
+	100000, 1000000,
+};
+
+static uint32_t cow_thread_values[] = {
+	1, 2, 4,
+};
+
+// 0: boa_sync_map_find(), 1: boa_cow_version_find() on a pinned version
+static uint32_t cow_method_values[] = {
+	0, 1,
+};
+
+typedef struct cow_bench_reader {
+	boa_sync_map *sync_map;
+	boa_cow_map *cow_map;
+	uint32_t index;
+	volatile uint32_t done;
+} cow_bench_reader;
+
+void cow_bench_increment(void *entry, int inserted, void *user)
+{
+	((kv_int*)entry)->val++;
+}
+
+// Find every key once, pinning a new version every 256 finds
+void cow_bench_reader_entry(void *user)
+{
+	cow_bench_reader *r = (cow_bench_reader*)user;
+	uint32_t count = boa_benchmark_count();
+	uint32_t x = r->index + 1;
+
+	if (r->cow_map) {
+		const boa_cow_version *ver = NULL;
+		for (uint32_t i = 0; i < count; i++) {
+			if (i % 256 == 0) {
+				if (ver) boa_cow_map_unpin(r->cow_map, r->index);
+				ver = boa_cow_map_pin(r->cow_map, r->index);
+			}
+			x = x * 1664525u + 1013904223u;
+			int key = (int)(x % count);
+			kv_int *kv = (kv_int*)boa_cow_version_find(ver, &key, int_hash(key), &int_cmp, NULL);
+			boa_benchmark_assert(kv && kv->key == key);
+		}
+		boa_cow_map_unpin(r->cow_map, r->index);
+	} else {
+		for (uint32_t i = 0; i < count; i++) {
+			x = x * 1664525u + 1013904223u;
+			int key = (int)(x % count);
+			kv_int kv;
+			int found = boa_sync_map_find(r->sync_map, &key, int_hash(key), &int_cmp, NULL, &kv);
+			boa_benchmark_assert(found && kv.key == key);
+		}
+	}
+
+	boa_atomic_store_u32(&r->done, 1);
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(cow_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_cow_method, cow_method_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_cow_threads, cow_thread_values);
+
+BOA_BENCHMARK(cow_map_read_while_writing, "Find integers from reader threads while a writer updates values")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t num = g_cow_threads;
+	boa_sync_map sync_map;
+	boa_cow_map cow_map;
+	cow_bench_reader readers[4];
+	boa_thread *threads[4];
+
+	boa_benchmark_assert(boa_sync_map_init(&sync_map, sizeof(kv_int), 0, NULL));
+	boa_benchmark_assert(boa_cow_map_init(&cow_map, sizeof(kv_int), num, NULL));
+	for (int i = 0; i < (int)count; i++) {
+		kv_int kv = { i, 0 };
+		if (g_cow_method) {
+			kv_int *entry = (kv_int*)boa_cow_map_insert(&cow_map, &i, int_hash(i), &int_cmp, NULL).entry;
+			boa_benchmark_assert(entry != NULL);
+			*entry = kv;
+		} else {
+			boa_benchmark_assert(boa_sync_map_insert(&sync_map, &i, int_hash(i), &int_cmp, NULL, &kv) == 1);
+		}
+	}
+	boa_cow_map_publish(&cow_map);
+
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < num; i++) {
+			boa_thread_opts opts = { 0 };
+			readers[i].sync_map = g_cow_method ? NULL : &sync_map;
+			readers[i].cow_map = g_cow_method ? &cow_map : NULL;
+			readers[i].index = i;
+			readers[i].done = 0;
+			opts.entry = &cow_bench_reader_entry;
+			opts.user = &readers[i];
+			threads[i] = boa_create_thread(&opts);
+			boa_benchmark_assert(threads[i] != NULL);
+		}
+
+		// Update a batch of values between publishes until the readers are done
+		uint32_t x = 1, num_done = 0;
+		while (num_done < num) {
+			for (uint32_t i = 0; i < 64; i++) {
+				x = x * 1664525u + 1013904223u;
+				int key = (int)(x % count);
+				if (g_cow_method) {
+					kv_int *kv = (kv_int*)boa_cow_map_insert(&cow_map, &key, int_hash(key), &int_cmp, NULL).entry;
+					kv->val++;
+				} else {
+					boa_sync_map_update(&sync_map, &key, int_hash(key), &int_cmp, NULL, &cow_bench_increment, NULL);
+				}
+			}
+			if (g_cow_method) boa_cow_map_publish(&cow_map);
+
+			num_done = 0;
+			for (uint32_t i = 0; i < num; i++) {
+				num_done += boa_atomic_load_u32(&readers[i].done);
+			}
+		}
+
+		for (uint32_t i = 0; i < num; i++) {
+			boa_join_thread(threads[i]);
+		}
+	}
+
+	boa_cow_map_reset(&cow_map);
+	boa_sync_map_reset(&sync_map);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_cow_threads);
+BOA_BENCHMARK_END_PERMUTATION(g_cow_method);
+BOA_BENCHMARK_END_COUNT();
+
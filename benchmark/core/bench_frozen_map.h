@@ -0,0 +1,81 @@
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_frozen;
+
+static uint32_t frozen_map_sizes[] = {
+	1000, 100000, 1000000,
+};
+
+// 0: boa_u32_map_find(), 1: boa_u32_frozen_map_find()
+static uint32_t frozen_values[] = {
+	0, 1,
+};
+
+void init_frozen_bench_map(boa_map *map, uint32_t count)
+{
+	boa_map_init(map, sizeof(kv_int));
+	for (uint32_t i = 0; i < count; i++) {
+		kv_int *kv = (kv_int*)boa_u32_map_insert(map, i * 7).entry;
+		kv->key = (int)(i * 7);
+		kv->val = (int)i;
+	}
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(frozen_map_sizes);
+
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_frozen, frozen_values);
+
+BOA_BENCHMARK(u32_map_find_frozen, "Find shuffled integer keys from a map or a frozen map")
+{
+	uint32_t count = boa_benchmark_count();
+	boa_map map;
+	boa_frozen_map frozen;
+	init_frozen_bench_map(&map, count);
+	boa_benchmark_assert(boa_map_freeze(&frozen, &map, NULL));
+
+	uint32_t *keys = boa_make_n(uint32_t, count);
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < count; i++) {
+		x = x * 1664525u + 1013904223u;
+		keys[i] = x % count * 7;
+	}
+
+	boa_benchmark_for() {
+		if (g_frozen) {
+			for (uint32_t i = 0; i < count; i++) {
+				kv_int *kv = (kv_int*)boa_u32_frozen_map_find(&frozen, keys[i]);
+				boa_benchmark_assert(kv->key == (int)keys[i]);
+			}
+		} else {
+			for (uint32_t i = 0; i < count; i++) {
+				kv_int *kv = (kv_int*)boa_u32_map_find(&map, keys[i]);
+				boa_benchmark_assert(kv->key == (int)keys[i]);
+			}
+		}
+	}
+
+	boa_free(keys);
+	boa_frozen_map_reset(&frozen);
+	boa_map_reset(&map);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_frozen);
+
+BOA_BENCHMARK(u32_map_freeze, "Freeze a map of integers")
+{
+	uint32_t count = boa_benchmark_count();
+	boa_map map;
+	boa_frozen_map frozen;
+	init_frozen_bench_map(&map, count);
+
+	boa_benchmark_for() {
+		boa_benchmark_assert(boa_map_freeze(&frozen, &map, NULL));
+		boa_frozen_map_reset(&frozen);
+	}
+
+	boa_map_reset(&map);
+}
+
+BOA_BENCHMARK_END_COUNT();
@@ -0,0 +1,194 @@
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_hash_key_size;
+uint32_t g_legacy_hash;
+
+static uint32_t hash_sizes[] = {
+	1000, 100000,
+};
+
+// Key sizes used by the maps in bench_map.h and some composite keys
+static uint32_t hash_key_sizes[] = {
+	4, 8, 12, 16, 32, 64,
+};
+
+static uint32_t legacy_hash_values[] = {
+	0, 1,
+};
+
+// Previous `boa_blit_map` hash: Fold 4 bytes at a time with `boa_hash_combine()`
+boa_noinline uint32_t legacy_blit_hash(const void *key, uint32_t size)
+{
+	uint32_t x = 1;
+	const char *pa = (const char*)key;
+
+	if ((size & 3) == 0) {
+		while (size >= 4) {
+			uint32_t word;
+			memcpy(&word, pa, 4);
+			x = boa_hash_combine(x, word);
+			size -= 4;
+			pa += 4;
+		}
+	}
+
+	while (size > 0) {
+		x = boa_hash_combine(x, (uint32_t)*pa);
+		size -= 1;
+		pa += 1;
+	}
+
+	return boa_u32_hash(x);
+}
+
+boa_forceinline uint32_t bench_blit_hash(const void *key, uint32_t size)
+{
+	if (g_legacy_hash) {
+		return legacy_blit_hash(key, size);
+	} else {
+		uint64_t hash = boa_hash_bytes(key, size, 0);
+		return (uint32_t)(hash ^ (hash >> 32));
+	}
+}
+
+typedef struct flood_key { uint32_t a, b; } flood_key;
+typedef struct kv_flood { flood_key key; uint32_t val; } kv_flood;
+
+boa_inline int flood_cmp(const void *a, const void *b, void *user) { return !memcmp(a, b, sizeof(flood_key)); }
+
+// Attacker chosen key whose legacy hash is always the same: Solve the second
+// word so that the folded value before the finalizer is a constant.
+boa_inline flood_key make_flood_key(uint32_t i)
+{
+	flood_key key;
+	uint32_t h = boa_hash_combine(1, i);
+	key.a = i;
+	key.b = (0x1234u ^ h) - 0x9e3779b9 - (h << 6) - (h >> 2);
+	return key;
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(hash_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_legacy_hash, legacy_hash_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_hash_key_size, hash_key_sizes);
+
+BOA_BENCHMARK(blit_hash_keys, "Hash keys of various sizes that share most of their bytes")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t key_size = g_hash_key_size;
+	char *keys = (char*)boa_alloc((size_t)count * key_size);
+	for (uint32_t i = 0; i < count; i++) {
+		memset(keys + i * key_size, 0x5a, key_size);
+		memcpy(keys + i * key_size + key_size - 4, &i, 4);
+	}
+
+	uint32_t result = 0;
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < count; i++) {
+			result += bench_blit_hash(keys + i * key_size, key_size);
+		}
+	}
+	boa_benchmark_assert(result != 1);
+
+	boa_free(keys);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_hash_key_size);
+
+BOA_BENCHMARK(blit_hash_flood, "Insert keys crafted to collide with the legacy blit hash")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_flood));
+
+	boa_benchmark_for() {
+		boa_map_clear(map);
+
+		uint32_t count = boa_benchmark_count();
+		for (uint32_t i = 0; i < count; i++) {
+			flood_key key = make_flood_key(i);
+			uint32_t hash = bench_blit_hash(&key, sizeof(key));
+			boa_map_insert_result ires = boa_map_insert(map, &key, hash, &flood_cmp, NULL);
+			boa_benchmark_assert(ires.inserted);
+			((kv_flood*)ires.entry)->val = i;
+		}
+	}
+
+	boa_benchmark_report_map_stats(map);
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_legacy_hash);
+BOA_BENCHMARK_END_COUNT();
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_blit_fixed;
+
+static uint32_t blit_map_sizes[] = {
+	1000, 1000000,
+};
+
+static uint32_t blit_fixed_values[] = {
+	0, 1,
+};
+
+typedef struct id16 { uint64_t lo, hi; } id16;
+typedef struct kv_id16 { id16 key; uint32_t val; } kv_id16;
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(blit_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_blit_fixed, blit_fixed_values);
+
+BOA_BENCHMARK(blit8_map_find, "Find 8-byte IDs from a blit map with generic or fixed size functions")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int));
+	uint32_t count = boa_benchmark_count();
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t key = (uint64_t)i * 0x9e3779b97f4a7c15u;
+		boa_map_insert_result ires = boa_blit8_map_insert(map, &key);
+		memcpy(ires.entry, &key, sizeof(key));
+	}
+
+	uint32_t found = 0;
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < count; i++) {
+			uint64_t key = (uint64_t)i * 0x9e3779b97f4a7c15u;
+			void *entry = g_blit_fixed ? boa_blit8_map_find(map, &key) : boa_blit_map_find(map, &key, sizeof(key));
+			found += entry != NULL;
+		}
+	}
+	boa_benchmark_assert(found > 0);
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK(blit16_map_find, "Find 16-byte IDs from a blit map with generic or fixed size functions")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_id16));
+	uint32_t count = boa_benchmark_count();
+
+	for (uint32_t i = 0; i < count; i++) {
+		id16 key = { (uint64_t)i * 0x9e3779b97f4a7c15u, 0x1234 };
+		boa_map_insert_result ires = boa_blit16_map_insert(map, &key);
+		memcpy(ires.entry, &key, sizeof(key));
+	}
+
+	uint32_t found = 0;
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < count; i++) {
+			id16 key = { (uint64_t)i * 0x9e3779b97f4a7c15u, 0x1234 };
+			void *entry = g_blit_fixed ? boa_blit16_map_find(map, &key) : boa_blit_map_find(map, &key, sizeof(key));
+			found += entry != NULL;
+		}
+	}
+	boa_benchmark_assert(found > 0);
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_blit_fixed);
+BOA_BENCHMARK_END_COUNT();
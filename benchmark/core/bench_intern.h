@@ -0,0 +1,85 @@
+#if BOA_BENCHMARK_IMPL
+uint32_t g_intern;
+
+static uint32_t intern_event_counts[] = {
+	10000, 1000000,
+};
+
+// 0: boa_str_map in every stage, 1: boa_intern_bulk() once and boa_u32_map in every stage
+static uint32_t intern_values[] = {
+	0, 1,
+};
+
+#define intern_num_tags 1000
+#define intern_num_stages 4
+
+typedef struct intern_tag_count { boa_str_key key; uint32_t count; } intern_tag_count;
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(intern_event_counts);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_intern, intern_values);
+
+BOA_BENCHMARK(intern_tag_stages, "Count string tags of events in multiple aggregation stages")
+{
+	uint32_t count = boa_benchmark_count();
+	char **tags = boa_make_n(char*, intern_num_tags);
+	for (uint32_t i = 0; i < intern_num_tags; i++) {
+		tags[i] = boa_format(NULL, "service/region-%u/endpoint/%u", i % 7, i);
+	}
+
+	const char **events = boa_make_n(const char*, count);
+	uint32_t *lengths = boa_make_n(uint32_t, count);
+	uint32_t *ids = boa_make_n(uint32_t, count);
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < count; i++) {
+		x = x * 1664525u + 1013904223u;
+		events[i] = tags[(x >> 8) % intern_num_tags];
+		lengths[i] = (uint32_t)strlen(events[i]);
+	}
+
+	boa_benchmark_for() {
+		if (g_intern) {
+			boa_intern intern;
+			boa_intern_init(&intern, 0, NULL);
+			boa_benchmark_assert(boa_intern_bulk(&intern, ids, events, lengths, count));
+			for (uint32_t stage = 0; stage < intern_num_stages; stage++) {
+				boa_map map;
+				boa_map_init(&map, sizeof(kv_int));
+				for (uint32_t i = 0; i < count; i++) {
+					boa_map_insert_result res = boa_u32_map_insert(&map, ids[i]);
+					kv_int *kv = (kv_int*)res.entry;
+					if (res.inserted) {
+						kv->key = (int)ids[i];
+						kv->val = 0;
+					}
+					kv->val++;
+				}
+				boa_benchmark_assert(map.count <= intern_num_tags);
+				boa_map_reset(&map);
+			}
+			boa_intern_reset(&intern);
+		} else {
+			for (uint32_t stage = 0; stage < intern_num_stages; stage++) {
+				boa_str_map map;
+				boa_str_map_init(&map, sizeof(intern_tag_count), NULL);
+				for (uint32_t i = 0; i < count; i++) {
+					boa_map_insert_result res = boa_str_map_insert(&map, events[i], lengths[i]);
+					intern_tag_count *tc = (intern_tag_count*)res.entry;
+					if (res.inserted) tc->count = 0;
+					tc->count++;
+				}
+				boa_benchmark_assert(map.map.count <= intern_num_tags);
+				boa_str_map_reset(&map);
+			}
+		}
+	}
+
+	boa_free(ids);
+	boa_free(lengths);
+	boa_free((void*)events);
+	free_str_keys(tags, intern_num_tags);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_intern);
+BOA_BENCHMARK_END_COUNT();
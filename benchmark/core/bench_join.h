@@ -0,0 +1,93 @@
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_join_build_size;
+uint32_t g_join_method;
+
+static uint32_t join_probe_sizes[] = {
+	1000000, 10000000,
+};
+
+static uint32_t join_build_size_values[] = {
+	10000, 1000000, 10000000,
+};
+
+// 0: Per-row blit map find loop, 1: boa_hash_join() unpartitioned, 2: boa_hash_join() auto partitioned
+static uint32_t join_method_values[] = {
+	0, 1, 2,
+};
+
+typedef struct join_bench_row { uint64_t key; uint64_t payload; } join_bench_row;
+typedef struct join_bench_entry { uint64_t key; uint32_t index; } join_bench_entry;
+
+join_bench_row *make_join_rows(uint32_t count, uint32_t num_keys, uint32_t seed)
+{
+	join_bench_row *rows = boa_make_n(join_bench_row, count);
+	uint32_t x = seed;
+	for (uint32_t i = 0; i < count; i++) {
+		x = x * 1664525u + 1013904223u;
+		rows[i].key = (uint64_t)(x % num_keys) * 0x9e3779b97f4a7c15u;
+		rows[i].payload = i;
+	}
+	return rows;
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(join_probe_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_join_build_size, join_build_size_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_join_method, join_method_values);
+
+BOA_BENCHMARK(hash_join, "Join probe rows against unique build rows by a 64-bit key")
+{
+	uint32_t probe_count = boa_benchmark_count();
+	uint32_t build_count = g_join_build_size;
+
+	// Unique build keys, probe keys hit the build side about half of the time
+	join_bench_row *build = boa_make_n(join_bench_row, build_count);
+	for (uint32_t i = 0; i < build_count; i++) {
+		build[i].key = (uint64_t)i * 0x9e3779b97f4a7c15u;
+		build[i].payload = i;
+	}
+	join_bench_row *probe = make_join_rows(probe_count, build_count * 2, 1);
+
+	boa_buf out = boa_empty_buf();
+	boa_map map = { 0 };
+	boa_map_init(&map, sizeof(join_bench_entry));
+
+	boa_benchmark_for() {
+		boa_clear(&out);
+
+		if (g_join_method == 0) {
+			boa_map_clear(&map);
+			for (uint32_t i = 0; i < build_count; i++) {
+				boa_map_insert_result ires = boa_blit_map_insert(&map, &build[i].key, sizeof(uint64_t));
+				join_bench_entry *entry = (join_bench_entry*)ires.entry;
+				entry->key = build[i].key;
+				entry->index = i;
+			}
+			for (uint32_t i = 0; i < probe_count; i++) {
+				join_bench_entry *entry = (join_bench_entry*)boa_blit_map_find(&map, &probe[i].key, sizeof(uint64_t));
+				if (entry) {
+					boa_join_pair pair = { entry->index, i };
+					boa_push_data(&out, &pair);
+				}
+			}
+		} else {
+			boa_join_opts opts = { 0 };
+			opts.key_size = sizeof(uint64_t);
+			opts.build_stride = sizeof(join_bench_row);
+			opts.probe_stride = sizeof(join_bench_row);
+			opts.radix_bits = g_join_method == 1 ? BOA_JOIN_NO_PARTITIONS : BOA_JOIN_AUTO_RADIX;
+			boa_hash_join(&out, build, build_count, probe, probe_count, &opts);
+		}
+	}
+
+	boa_map_reset(&map);
+	boa_reset(&out);
+	boa_free(build);
+	boa_free(probe);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_join_method);
+BOA_BENCHMARK_END_PERMUTATION(g_join_build_size);
+BOA_BENCHMARK_END_COUNT();
@@ -1,6 +1,9 @@
 
 #undef bench_map_insert
 #undef bench_map_find
+#undef bench_map_insert_fullhash
+#undef bench_map_find_fullhash
+#undef bench_map_find_batch
 #undef P
 
 #if !defined(BENCH_MAP_INLINE)
@@ -8,17 +11,24 @@
 #elif BENCH_MAP_INLINE
 	#define bench_map_insert boa_map_insert_inline
 	#define bench_map_find boa_map_find_inline
+	#define bench_map_insert_fullhash boa_map_insert_fullhash_inline
+	#define bench_map_find_fullhash boa_map_find_fullhash_inline
+	#define bench_map_find_batch boa_map_find_batch_inline
 	#define P(x) x##_inline
 #else
 	#define bench_map_insert boa_map_insert
 	#define bench_map_find boa_map_find
+	#define bench_map_insert_fullhash boa_map_insert_fullhash
+	#define bench_map_find_fullhash boa_map_find_fullhash
+	#define bench_map_find_batch boa_map_find_batch
 	#define P(x) x##_generic
 #endif
 
 #if BENCH_MAP_INLINE == 0
 #if BOA_BENCHMARK_IMPL
-uint32_t g_map_size;
 uint32_t g_do_reserve;
+uint32_t g_full_hash;
+uint32_t g_incremental;
 
 boa_inline uint32_t int_hash(int i)
 {
@@ -28,7 +38,7 @@ boa_inline uint32_t int_hash(int i)
 	x = (x >> 16) ^ x;
 	return x;
 }
-boa_inline int int_cmp(const void *a, const void *b, boa_map *m) { return *(int*)a == *(int*)b; }
+boa_inline int int_cmp(const void *a, const void *b, void *user) { return *(int*)a == *(int*)b; }
 
 typedef struct int_pair { int x, y; } int_pair;
 
@@ -38,26 +48,109 @@ boa_inline uint32_t pair_hash(int_pair pair)
 	uint32_t y = int_hash(pair.y);
 	return boa_hash_combine(x, y);
 }
-boa_inline int pair_cmp(const void *a, const void *b, boa_map *m) {
+boa_inline int pair_cmp(const void *a, const void *b, void *user) {
 	const int_pair *pa = (const int_pair*)a, *pb = (const int_pair*)b;
 	if (pa->x != pb->x) return 0;
 	if (pa->y != pb->y) return 0;
 	return 1;
 }
 
+typedef struct kv_int { int key, val; } kv_int;
+typedef struct kv_pair { int_pair key; int val; } kv_pair;
+
+// Long keys that share most of their bytes, expensive to compare
+typedef struct long_key { uint32_t data[16]; } long_key;
+typedef struct kv_long { long_key key; int val; } kv_long;
+
+boa_inline long_key make_long_key(uint32_t i)
+{
+	long_key key;
+	for (uint32_t n = 0; n < 16; n++) key.data[n] = 0x12345678u;
+	key.data[15] = i;
+	return key;
+}
+
+boa_inline uint32_t long_hash(const long_key *key)
+{
+	uint32_t x = 1;
+	for (uint32_t n = 0; n < 16; n++) x = boa_hash_combine(x, key->data[n]);
+	return boa_u32_hash(x);
+}
+boa_inline int long_cmp(const void *a, const void *b, void *user) {
+	return !memcmp(a, b, sizeof(long_key));
+}
+
+// Strings with a long common prefix, expensive to compare
+typedef struct kv_str { char *key; int val; } kv_str;
+
+uint32_t str_hash(const char *str)
+{
+	uint32_t hash = 2166136261u;
+	for (; *str != 0; str++) {
+		hash = (hash ^ (uint32_t)*str) * 16777619u;
+	}
+	return hash;
+}
+int str_cmp(const void *a, const void *b, void *user) {
+	return !strcmp((const char*)a, ((const kv_str*)b)->key);
+}
+
+char **make_str_keys(uint32_t count)
+{
+	char **keys = boa_make_n(char*, count);
+	boa_benchmark_assert(keys != NULL);
+	for (uint32_t i = 0; i < count; i++) {
+		keys[i] = boa_format(NULL, "some/long/common/prefix/for/the/keys/%u", i);
+		boa_benchmark_assert(keys[i] != NULL);
+	}
+	return keys;
+}
+
+void free_str_keys(char **keys, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) boa_free(keys[i]);
+	boa_free(keys);
+}
+
+int u64_sort_cmp(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t*)a, vb = *(const uint64_t*)b;
+	return va < vb ? -1 : va > vb ? 1 : 0;
+}
+
+// Report percentiles of `count` latency samples in cycles, sorts `values` in place
+void report_latency_percentiles(uint64_t *values, uint32_t count)
+{
+	qsort(values, count, sizeof(uint64_t), &u64_sort_cmp);
+	boa_benchmark_report("p50 cycles", (double)values[count / 2]);
+	boa_benchmark_report("p99 cycles", (double)values[(uint64_t)count * 99 / 100]);
+	boa_benchmark_report("p99.9 cycles", (double)values[(uint64_t)count * 999 / 1000]);
+	boa_benchmark_report("max cycles", (double)values[count - 1]);
+}
+
 #else
 
-extern uint32_t g_map_size;
 extern uint32_t g_do_reserve;
+extern uint32_t g_full_hash;
+extern uint32_t g_incremental;
 
 static uint32_t map_sizes[] = {
 	10, 100, 1000, 10000, 100000, 1000000,
 };
 
-static int reserve_values[] = {
+static uint32_t reserve_values[] = {
 	1, 0,
 };
 
+static uint32_t full_hash_values[] = {
+	0, 1,
+};
+
+// Old blocks to migrate per insert, 0 rehashes all at once
+static uint32_t incremental_values[] = {
+	0, 1, 4,
+};
+
 #endif
 #endif // BENCH_MAP_INLINE == 0
 
@@ -65,17 +158,18 @@ static int reserve_values[] = {
 
 boa_noinline void P(insert_int_p)(boa_map *map, int k, int v)
 {
-	boa_map_insert_result ires = bench_map_insert(map, &k, int_hash(k), &int_cmp);
-	boa_benchmark_assert(ires.value);
-	boa_key(int, map, ires.value) = k;
-	boa_val(int, map, ires.value) = v;
+	boa_map_insert_result ires = bench_map_insert(map, &k, int_hash(k), &int_cmp, NULL);
+	boa_benchmark_assert(ires.entry);
+	kv_int *kv = (kv_int*)ires.entry;
+	kv->key = k;
+	kv->val = v;
 }
 
 boa_noinline int P(find_int_p)(boa_map *map, int k)
 {
-	void *value = bench_map_find(map, &k, int_hash(k), &int_cmp);
-	if (value != NULL) {
-		return boa_val(int, map, value);
+	kv_int *kv = (kv_int*)bench_map_find(map, &k, int_hash(k), &int_cmp, NULL);
+	if (kv != NULL) {
+		return kv->val;
 	} else {
 		return -1;
 	}
@@ -83,22 +177,84 @@ boa_noinline int P(find_int_p)(boa_map *map, int k)
 
 boa_noinline void P(insert_pair_p)(boa_map *map, int_pair k, int v)
 {
-	boa_map_insert_result ires = bench_map_insert(map, &k, pair_hash(k), &pair_cmp);
-	boa_benchmark_assert(ires.value);
-	boa_key(int_pair, map, ires.value) = k;
-	boa_val(int, map, ires.value) = v;
+	boa_map_insert_result ires = bench_map_insert(map, &k, pair_hash(k), &pair_cmp, NULL);
+	boa_benchmark_assert(ires.entry);
+	kv_pair *kv = (kv_pair*)ires.entry;
+	kv->key = k;
+	kv->val = v;
 }
 
 boa_noinline int P(find_pair_p)(boa_map *map, int_pair k)
 {
-	void *value = bench_map_find(map, &k, pair_hash(k), &pair_cmp);
-	if (value != NULL) {
-		return boa_val(int, map, value);
+	kv_pair *kv = (kv_pair*)bench_map_find(map, &k, pair_hash(k), &pair_cmp, NULL);
+	if (kv != NULL) {
+		return kv->val;
 	} else {
 		return -1;
 	}
 }
 
+boa_noinline void P(insert_long_p)(boa_map *map, const long_key *k, int v)
+{
+	uint32_t hash = long_hash(k);
+	boa_map_insert_result ires;
+	if (g_full_hash) {
+		ires = bench_map_insert_fullhash(map, k, hash, &long_cmp, NULL);
+	} else {
+		ires = bench_map_insert(map, k, hash, &long_cmp, NULL);
+	}
+	boa_benchmark_assert(ires.entry);
+	kv_long *kv = (kv_long*)ires.entry;
+	kv->key = *k;
+	kv->val = v;
+}
+
+boa_noinline int P(find_long_p)(boa_map *map, const long_key *k)
+{
+	uint32_t hash = long_hash(k);
+	kv_long *kv;
+	if (g_full_hash) {
+		kv = (kv_long*)bench_map_find_fullhash(map, k, hash, &long_cmp, NULL);
+	} else {
+		kv = (kv_long*)bench_map_find(map, k, hash, &long_cmp, NULL);
+	}
+	if (kv != NULL) {
+		return kv->val;
+	} else {
+		return -1;
+	}
+}
+
+boa_noinline void P(insert_str_p)(boa_map *map, char *k, int v)
+{
+	uint32_t hash = str_hash(k);
+	boa_map_insert_result ires;
+	if (g_full_hash) {
+		ires = bench_map_insert_fullhash(map, k, hash, &str_cmp, NULL);
+	} else {
+		ires = bench_map_insert(map, k, hash, &str_cmp, NULL);
+	}
+	boa_benchmark_assert(ires.entry);
+	kv_str *kv = (kv_str*)ires.entry;
+	kv->key = k;
+	kv->val = v;
+}
+
+boa_noinline int P(find_str_p)(boa_map *map, const char *k)
+{
+	uint32_t hash = str_hash(k);
+	kv_str *kv;
+	if (g_full_hash) {
+		kv = (kv_str*)bench_map_find_fullhash(map, k, hash, &str_cmp, NULL);
+	} else {
+		kv = (kv_str*)bench_map_find(map, k, hash, &str_cmp, NULL);
+	}
+	if (kv != NULL) {
+		return kv->val;
+	} else {
+		return -1;
+	}
+}
 
 #endif
 
@@ -106,6 +262,10 @@ boa_noinline int P(find_pair_p)(boa_map *map, int_pair k)
 #define find_int P(find_int_p)
 #define insert_pair P(insert_pair_p)
 #define find_pair P(find_pair_p)
+#define insert_long P(insert_long_p)
+#define find_long P(find_long_p)
+#define insert_str P(insert_str_p)
+#define find_str P(find_str_p)
 
 BOA_BENCHMARK_BEGIN_COUNT(map_sizes);
 BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_do_reserve, reserve_values);
@@ -114,11 +274,10 @@ BOA_BENCHMARK_BEGIN_COMPILE_PERMUTATION(BENCH_MAP_INLINE);
 BOA_BENCHMARK_P(int_map_insert_consecutive, "Insert consecutive integers into a map")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
-	map->key_size = sizeof(int);
-	map->val_size = sizeof(int);
+	boa_map_init(map, sizeof(kv_int));
 
 	if (g_do_reserve)
-		boa_map_reserve(map, g_map_size);
+		boa_map_reserve(map, boa_benchmark_count());
 
 	boa_benchmark_for() {
 		if (g_do_reserve) {
@@ -132,16 +291,17 @@ BOA_BENCHMARK_P(int_map_insert_consecutive, "Insert consecutive integers into a
 			insert_int(map, i, i);
 		}
 	}
+
+	boa_map_reset(map);
 }
 
-BOA_BENCHMARK_P(int_bmap_insert_consecutive, "Insert consecutive integers into a bmap")
+BOA_BENCHMARK_P(int_blit_map_insert_consecutive, "Insert consecutive integers into a blit map")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
-	map->key_size = sizeof(int);
-	map->val_size = sizeof(int);
+	boa_map_init(map, sizeof(kv_int));
 
 	if (g_do_reserve)
-		boa_map_reserve(map, g_map_size);
+		boa_map_reserve(map, boa_benchmark_count());
 
 	boa_benchmark_for() {
 		if (g_do_reserve) {
@@ -153,19 +313,20 @@ BOA_BENCHMARK_P(int_bmap_insert_consecutive, "Insert consecutive integers into a
 		uint32_t size = boa_benchmark_count();
 		for (uint32_t i = 0; i < size; i++) {
 			uint32_t key = i;
-			boa_bmap_insert(map, &key);
+			boa_blit_map_insert(map, &key, sizeof(key));
 		}
 	}
+
+	boa_map_reset(map);
 }
 
 BOA_BENCHMARK_P(pair_map_insert_consecutive, "Insert consecutive pairs into a map")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
-	map->key_size = sizeof(int_pair);
-	map->val_size = sizeof(int);
+	boa_map_init(map, sizeof(kv_pair));
 
 	if (g_do_reserve)
-		boa_map_reserve(map, g_map_size);
+		boa_map_reserve(map, boa_benchmark_count());
 
 	boa_benchmark_for() {
 		if (g_do_reserve) {
@@ -182,16 +343,17 @@ BOA_BENCHMARK_P(pair_map_insert_consecutive, "Insert consecutive pairs into a ma
 			insert_pair(map, pair, i);
 		}
 	}
+
+	boa_map_reset(map);
 }
 
-BOA_BENCHMARK_P(pair_bmap_insert_consecutive, "Insert consecutive pairs into a bmap")
+BOA_BENCHMARK_P(pair_blit_map_insert_consecutive, "Insert consecutive pairs into a blit map")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
-	map->key_size = sizeof(int_pair);
-	map->val_size = sizeof(int);
+	boa_map_init(map, sizeof(kv_pair));
 
 	if (g_do_reserve)
-		boa_map_reserve(map, g_map_size);
+		boa_map_reserve(map, boa_benchmark_count());
 
 	boa_benchmark_for() {
 		if (g_do_reserve) {
@@ -205,23 +367,23 @@ BOA_BENCHMARK_P(pair_bmap_insert_consecutive, "Insert consecutive pairs into a b
 			int_pair pair;
 			pair.x = i;
 			pair.y = i;
-			boa_bmap_insert(map, &pair);
+			boa_blit_map_insert(map, &pair, sizeof(pair));
 		}
 	}
+
+	boa_map_reset(map);
 }
 
 BOA_BENCHMARK_P(int_pair_map_insert_interleaved, "Insert interleaved consecutive integers and pairs into maps")
 {
 	boa_map mapiv = { 0 }, *mapi = &mapiv;
-	mapi->key_size = sizeof(int);
-	mapi->val_size = sizeof(int);
+	boa_map_init(mapi, sizeof(kv_int));
 	boa_map mappv = { 0 }, *mapp = &mappv;
-	mapp->key_size = sizeof(int_pair);
-	mapp->val_size = sizeof(int);
+	boa_map_init(mapp, sizeof(kv_pair));
 
 	if (g_do_reserve) {
-		boa_map_reserve(mapi, g_map_size);
-		boa_map_reserve(mapp, g_map_size);
+		boa_map_reserve(mapi, boa_benchmark_count());
+		boa_map_reserve(mapp, boa_benchmark_count());
 	}
 
 	boa_benchmark_for() {
@@ -242,18 +404,44 @@ BOA_BENCHMARK_P(int_pair_map_insert_interleaved, "Insert interleaved consecutive
 			insert_pair(mapp, pair, i);
 		}
 	}
+
+	boa_map_reset(mapi);
+	boa_map_reset(mapp);
 }
 
 BOA_BENCHMARK_END_PERMUTATION(g_do_reserve);
 
-BOA_BENCHMARK_P(int_map_find_consecutive, "Find consecutive integers from an int_map")
+BOA_BENCHMARK_P(int_map_build_consecutive, "Build a map of consecutive integers from an array")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
-	map->key_size = sizeof(int);
-	map->val_size = sizeof(int);
+	boa_map_init(map, sizeof(kv_int));
 
-	if (g_do_reserve)
-		boa_map_reserve(map, g_map_size);
+	uint32_t size = boa_benchmark_count();
+	kv_int *entries = boa_make_n(kv_int, size);
+	uint32_t *hashes = boa_make_n(uint32_t, size);
+	boa_benchmark_assert(entries != NULL && hashes != NULL);
+
+	for (uint32_t i = 0; i < size; i++) {
+		entries[i].key = (int)i;
+		entries[i].val = (int)i;
+		hashes[i] = int_hash(i);
+	}
+
+	boa_benchmark_for() {
+		boa_map_reset(map);
+		int ok = boa_map_build(map, entries, hashes, size);
+		boa_benchmark_assert(ok);
+	}
+
+	boa_free(entries);
+	boa_free(hashes);
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_P(int_map_find_consecutive, "Find consecutive integers from an int_map")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int));
 
 	uint32_t size = boa_benchmark_count();
 
@@ -267,16 +455,15 @@ BOA_BENCHMARK_P(int_map_find_consecutive, "Find consecutive integers from an int
 			boa_benchmark_assert(val == i);
 		}
 	}
+
+	boa_benchmark_report_map_stats(map);
+	boa_map_reset(map);
 }
 
 BOA_BENCHMARK_P(int_map_find_consecutive_missing, "Find consecutive missing integers from an int_map")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
-	map->key_size = sizeof(int);
-	map->val_size = sizeof(int);
-
-	if (g_do_reserve)
-		boa_map_reserve(map, g_map_size);
+	boa_map_init(map, sizeof(kv_int));
 
 	uint32_t size = boa_benchmark_count();
 
@@ -290,11 +477,132 @@ BOA_BENCHMARK_P(int_map_find_consecutive_missing, "Find consecutive missing inte
 			boa_benchmark_assert(val == -1);
 		}
 	}
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_P(int_map_find_batch, "Find consecutive integers from an int_map in batches")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int));
+
+	uint32_t size = boa_benchmark_count();
+
+	for (uint32_t i = 0; i < size; i++) {
+		insert_int(map, i, i);
+	}
+
+	int keys[256];
+	uint32_t hashes[256];
+	void *entries[256];
+
+	boa_benchmark_for() {
+		for (uint32_t base = 0; base < size; base += 256) {
+			uint32_t num = size - base < 256 ? size - base : 256;
+			for (uint32_t i = 0; i < num; i++) {
+				keys[i] = (int)(base + i);
+				hashes[i] = int_hash(keys[i]);
+			}
+
+			bench_map_find_batch(map, entries, keys, sizeof(int), hashes, num, &int_cmp, NULL);
+
+			for (uint32_t i = 0; i < num; i++) {
+				boa_benchmark_assert(entries[i] && ((kv_int*)entries[i])->val == keys[i]);
+			}
+		}
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_full_hash, full_hash_values);
+
+BOA_BENCHMARK_P(long_key_map_find, "Find long keys with a common prefix from a map")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_long));
+
+	uint32_t size = boa_benchmark_count();
+
+	for (uint32_t i = 0; i < size; i++) {
+		long_key key = make_long_key(i);
+		insert_long(map, &key, i);
+	}
+
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < size * 2; i++) {
+			long_key key = make_long_key(i);
+			int val = find_long(map, &key);
+			boa_benchmark_assert(val == (i < size ? (int)i : -1));
+		}
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_P(str_map_find, "Find strings with a common prefix from a map")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_str));
+
+	uint32_t size = boa_benchmark_count();
+	char **keys = make_str_keys(size * 2);
+
+	for (uint32_t i = 0; i < size; i++) {
+		insert_str(map, keys[i], i);
+	}
+
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < size * 2; i++) {
+			int val = find_str(map, keys[i]);
+			boa_benchmark_assert(val == (i < size ? (int)i : -1));
+		}
+	}
+
+	boa_map_reset(map);
+	free_str_keys(keys, size * 2);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_full_hash);
+
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_incremental, incremental_values);
+
+BOA_BENCHMARK_P(int_map_insert_latency, "Latency of single inserts of consecutive integers into a growing map")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int));
+	boa_map_set_incremental(map, g_incremental);
+
+	uint32_t size = boa_benchmark_count();
+	uint64_t *latency = boa_make_n(uint64_t, size);
+	boa_benchmark_assert(latency != NULL);
+
+	boa_benchmark_for() {
+		boa_map_reset(map);
+
+		for (uint32_t i = 0; i < size; i++) {
+			uint64_t begin = boa_cycle_timestamp();
+			insert_int(map, i, i);
+			latency[i] = boa_cycle_timestamp() - begin;
+		}
+	}
+
+	report_latency_percentiles(latency, size);
+
+	boa_free(latency);
+	boa_map_reset(map);
 }
 
+BOA_BENCHMARK_END_PERMUTATION(g_incremental);
+
 BOA_BENCHMARK_END_COUNT();
 BOA_BENCHMARK_END_COMPILE_PERMUTATION(BENCH_MAP_INLINE);
 
 #undef insert_int
 #undef find_int
-
+#undef insert_pair
+#undef find_pair
+#undef insert_long
+#undef find_long
+#undef insert_str
+#undef find_str
@@ -0,0 +1,96 @@
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_filter_hit_percent;
+uint32_t g_use_filter;
+
+static uint32_t filter_map_sizes[] = {
+	10000, 1000000,
+};
+
+static uint32_t filter_hit_percent_values[] = {
+	0, 25, 50, 75, 100,
+};
+
+static uint32_t use_filter_values[] = {
+	0, 1,
+};
+
+// Map of keys `[0, count)` with a filter attached if `g_use_filter` is set
+void init_filter_bench_map(boa_map *map, boa_filter *filter, uint32_t count)
+{
+	boa_map_init(map, sizeof(uint32_t) * 2);
+	boa_map_reserve(map, count);
+	if (g_use_filter) boa_map_set_filter(map, filter);
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t *entry = (uint32_t*)boa_u32_map_insert(map, i).entry;
+		entry[0] = i;
+		entry[1] = i;
+	}
+}
+
+// Shuffled keys of which `g_filter_hit_percent` are in the map
+uint32_t *make_filter_bench_keys(uint32_t count)
+{
+	uint32_t *keys = boa_make_n(uint32_t, count);
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < count; i++) {
+		x = x * 1664525u + 1013904223u;
+		uint32_t key = x % count;
+		keys[i] = (x >> 8) % 100 < g_filter_hit_percent ? key : key + count;
+	}
+	return keys;
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(filter_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_filter_hit_percent, filter_hit_percent_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_use_filter, use_filter_values);
+
+BOA_BENCHMARK(map_filter_find, "Find keys from a map with a varying hit ratio")
+{
+	uint32_t count = boa_benchmark_count();
+	boa_map map;
+	boa_filter filter = { 0 };
+	init_filter_bench_map(&map, &filter, count);
+	uint32_t *keys = make_filter_bench_keys(count);
+	uint32_t num_hits = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		if (keys[i] < count) num_hits++;
+	}
+
+	boa_benchmark_for() {
+		uint32_t num_found = 0;
+		for (uint32_t i = 0; i < count; i++) {
+			if (boa_u32_map_find(&map, keys[i])) num_found++;
+		}
+		boa_benchmark_assert(num_found == num_hits);
+	}
+
+	boa_free(keys);
+	boa_map_reset(&map);
+	boa_filter_reset(&filter);
+}
+
+BOA_BENCHMARK(map_filter_find_batch, "Find keys in batches from a map with a varying hit ratio")
+{
+	uint32_t count = boa_benchmark_count();
+	boa_map map;
+	boa_filter filter = { 0 };
+	init_filter_bench_map(&map, &filter, count);
+	uint32_t *keys = make_filter_bench_keys(count);
+	void **entries = boa_make_n(void*, count);
+
+	boa_benchmark_for() {
+		boa_u32_map_find_batch(&map, entries, keys, count);
+	}
+
+	boa_free(entries);
+	boa_free(keys);
+	boa_map_reset(&map);
+	boa_filter_reset(&filter);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_use_filter);
+BOA_BENCHMARK_END_PERMUTATION(g_filter_hit_percent);
+BOA_BENCHMARK_END_COUNT();
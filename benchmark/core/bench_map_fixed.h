@@ -0,0 +1,58 @@
+#if BOA_BENCHMARK_IMPL
+uint32_t g_map_fixed;
+uint32_t g_request_entries;
+
+static uint32_t request_counts[] = {
+	1000, 100000,
+};
+
+// 0: boa_map_init(), 1: boa_map_init_fixed() on stack storage
+static uint32_t map_fixed_values[] = {
+	0, 1,
+};
+
+static uint32_t request_entries_values[] = {
+	8, 48,
+};
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(request_counts);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_map_fixed, map_fixed_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_request_entries, request_entries_values);
+
+BOA_BENCHMARK(u32_map_per_request, "Build and drop a small map per request")
+{
+	uint32_t count = boa_benchmark_count();
+	uint32_t num_entries = g_request_entries;
+	uint64_t storage[BOA_MAP_FIXED_STORAGE_SIZE(sizeof(kv_int), 64) / 8];
+
+	boa_benchmark_for() {
+		for (uint32_t req = 0; req < count; req++) {
+			boa_map map;
+			if (g_map_fixed) {
+				boa_map_init_fixed(&map, sizeof(kv_int), storage, sizeof(storage), NULL);
+			} else {
+				boa_map_init(&map, sizeof(kv_int));
+			}
+
+			for (uint32_t i = 0; i < num_entries; i++) {
+				uint32_t key = req * 31 + i * 7;
+				kv_int *kv = (kv_int*)boa_u32_map_insert(&map, key).entry;
+				kv->key = (int)key;
+				kv->val = (int)i;
+			}
+			for (uint32_t i = 0; i < num_entries; i++) {
+				uint32_t key = req * 31 + i * 7;
+				kv_int *kv = (kv_int*)boa_u32_map_find(&map, key);
+				boa_benchmark_assert(kv->val == (int)i);
+			}
+
+			boa_map_reset(&map);
+		}
+	}
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_request_entries);
+BOA_BENCHMARK_END_PERMUTATION(g_map_fixed);
+BOA_BENCHMARK_END_COUNT();
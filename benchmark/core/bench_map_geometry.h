@@ -0,0 +1,80 @@
+#if BOA_BENCHMARK_IMPL
+#include <boa_core_cpp.h>
+
+uint32_t g_block_entries;
+
+static uint32_t geometry_map_sizes[] = {
+	1000, 100000, 1000000,
+};
+
+// 0: Block size picked at runtime, otherwise fixed at compile time
+static uint32_t block_entries_values[] = {
+	0, 16, 32, 64,
+};
+
+template <uint32_t BlockEntries>
+void geometry_bench_insert(uint32_t count)
+{
+	boa_benchmark_for() {
+		boa::u32_map<uint32_t, uint32_t, BlockEntries> map;
+		for (uint32_t i = 0; i < count; i++) {
+			map.insert(i * 7, i);
+		}
+		boa_benchmark_assert(map.count == count);
+	}
+}
+
+template <uint32_t BlockEntries>
+void geometry_bench_find(uint32_t count)
+{
+	boa::u32_map<uint32_t, uint32_t, BlockEntries> map;
+	for (uint32_t i = 0; i < count; i++) {
+		map.insert(i * 7, i);
+	}
+
+	uint32_t *keys = boa_make_n(uint32_t, count);
+	uint32_t x = 1;
+	for (uint32_t i = 0; i < count; i++) {
+		x = x * 1664525u + 1013904223u;
+		keys[i] = x % count * 7;
+	}
+
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < count; i++) {
+			auto kv = map.find(keys[i]);
+			boa_benchmark_assert(kv->key == keys[i]);
+		}
+	}
+
+	boa_free(keys);
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(geometry_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_block_entries, block_entries_values);
+
+BOA_BENCHMARK(u32_map_geometry_insert, "Insert integers into a C++ map with a fixed block size")
+{
+	uint32_t count = boa_benchmark_count();
+	switch (g_block_entries) {
+	case 0: geometry_bench_insert<0>(count); break;
+	case 16: geometry_bench_insert<16>(count); break;
+	case 32: geometry_bench_insert<32>(count); break;
+	case 64: geometry_bench_insert<64>(count); break;
+	}
+}
+
+BOA_BENCHMARK(u32_map_geometry_find, "Find shuffled integers from a C++ map with a fixed block size")
+{
+	uint32_t count = boa_benchmark_count();
+	switch (g_block_entries) {
+	case 0: geometry_bench_find<0>(count); break;
+	case 16: geometry_bench_find<16>(count); break;
+	case 32: geometry_bench_find<32>(count); break;
+	case 64: geometry_bench_find<64>(count); break;
+	}
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_block_entries);
+BOA_BENCHMARK_END_COUNT();
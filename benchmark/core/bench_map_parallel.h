@@ -0,0 +1,102 @@
+
+#include <boa_os.h>
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_rehash_threads;
+
+static uint32_t parallel_map_sizes[] = {
+	1000000, 4000000,
+};
+
+static uint32_t rehash_thread_values[] = {
+	1, 2, 4, 8,
+};
+
+typedef struct map_scan_job {
+	const boa_map *map;
+	uint32_t num_parts;
+	uint64_t part_sums[64];
+} map_scan_job;
+
+void map_scan_part(void *user, uint32_t index)
+{
+	map_scan_job *job = (map_scan_job*)user;
+	boa_map_part part = boa_map_get_part(job->map, index, job->num_parts);
+	uint64_t sum = 0;
+	boa_map_part_for (kv_int, kv, job->map, &part) {
+		sum += (uint32_t)kv->val;
+	}
+	job->part_sums[index] = sum;
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(parallel_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_rehash_threads, rehash_thread_values);
+
+BOA_BENCHMARK(int_map_reserve_parallel, "Re-hash a map of consecutive integers into a larger one using threads")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_thread_job_runner runner;
+	uint32_t count = boa_benchmark_count();
+
+	boa_map_init(map, sizeof(kv_int));
+	boa_map_set_job_runner(map, boa_thread_job_runner_init(&runner, g_rehash_threads, NULL));
+
+	// Only the re-hash is interesting so time it separately from building the map
+	uint64_t rehash_time = 0;
+	uint32_t num_runs = 0;
+
+	boa_benchmark_for() {
+		boa_map_reset(map);
+		boa_map_reserve(map, count);
+		for (int i = 0; i < (int)count; i++) {
+			boa_map_insert_result ires = boa_map_insert(map, &i, int_hash(i), &int_cmp, NULL);
+			kv_int *kv = (kv_int*)ires.entry;
+			kv->key = i;
+			kv->val = i;
+		}
+
+		uint64_t begin = boa_perf_timer();
+		boa_map_reserve(map, count * 2);
+		rehash_time += boa_perf_timer() - begin;
+		num_runs++;
+	}
+
+	boa_benchmark_report("rehash ns/entry", boa_perf_sec(rehash_time) * 1e9 / ((double)num_runs * count));
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK(int_map_scan_parallel, "Sum the values of a map of consecutive integers in parts using threads")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_thread_job_runner runner;
+	uint32_t count = boa_benchmark_count();
+
+	boa_map_init(map, sizeof(kv_int));
+	boa_job_runner *jobs = boa_thread_job_runner_init(&runner, g_rehash_threads, NULL);
+	for (int i = 0; i < (int)count; i++) {
+		boa_map_insert_result ires = boa_map_insert(map, &i, int_hash(i), &int_cmp, NULL);
+		kv_int *kv = (kv_int*)ires.entry;
+		kv->key = i;
+		kv->val = i;
+	}
+
+	// A few parts per thread to balance uneven blocks
+	map_scan_job job;
+	job.map = map;
+	job.num_parts = g_rehash_threads * 4;
+
+	boa_benchmark_for() {
+		boa_run_jobs(jobs, &map_scan_part, &job, job.num_parts);
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < job.num_parts; i++) sum += job.part_sums[i];
+		boa_benchmark_assert(sum == (uint64_t)count * (count - 1) / 2);
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_rehash_threads);
+BOA_BENCHMARK_END_COUNT();
@@ -0,0 +1,144 @@
+#if BOA_BENCHMARK_IMPL
+uint32_t g_slotmap_method;
+
+static uint32_t slotmap_sizes[] = {
+	1000, 100000, 1000000,
+};
+
+// 0: Entities keyed by pointer in `boa_ptr_map`, 1: `boa_slotmap` handles
+static uint32_t slotmap_method_values[] = {
+	0, 1,
+};
+
+typedef struct {
+	const void *key;
+	float pos[3], vel[3];
+	uint32_t flags;
+} slot_entity;
+
+// Entity tables with `count` entities and references to them in shuffled order
+typedef struct {
+	boa_map ptr_map;
+	boa_slotmap slotmap;
+	char *ptr_keys;
+	const void **ptrs;
+	uint32_t *handles;
+} slot_bench_table;
+
+void slot_bench_table_init(slot_bench_table *t, uint32_t count)
+{
+	t->ptr_keys = (char*)boa_alloc(count);
+	t->ptrs = boa_make_n(const void*, count);
+	t->handles = boa_make_n(uint32_t, count);
+	boa_map_init(&t->ptr_map, sizeof(slot_entity));
+	boa_slotmap_init(&t->slotmap, sizeof(slot_entity), NULL);
+
+	for (uint32_t i = 0; i < count; i++) {
+		const void *key = t->ptr_keys + i;
+		slot_entity *a = (slot_entity*)boa_ptr_map_insert(&t->ptr_map, key).entry;
+		slot_entity *b = (slot_entity*)boa_slotmap_insert(&t->slotmap, &t->handles[i]);
+		boa_benchmark_assert(a && b);
+		memset(a, 0, sizeof(slot_entity));
+		memset(b, 0, sizeof(slot_entity));
+		a->key = b->key = key;
+		a->flags = b->flags = i;
+		t->ptrs[i] = key;
+	}
+
+	uint32_t x = 1;
+	for (uint32_t i = count - 1; i > 0; i--) {
+		x = x * 1664525u + 1013904223u;
+		uint32_t j = x % (i + 1);
+		const void *p = t->ptrs[i]; t->ptrs[i] = t->ptrs[j]; t->ptrs[j] = p;
+		uint32_t h = t->handles[i]; t->handles[i] = t->handles[j]; t->handles[j] = h;
+	}
+}
+
+void slot_bench_table_reset(slot_bench_table *t)
+{
+	boa_map_reset(&t->ptr_map);
+	boa_slotmap_reset(&t->slotmap);
+	boa_free(t->ptr_keys);
+	boa_free(t->ptrs);
+	boa_free(t->handles);
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(slotmap_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_slotmap_method, slotmap_method_values);
+
+BOA_BENCHMARK(entity_lookup, "Look up entities in shuffled order and update them")
+{
+	uint32_t count = boa_benchmark_count();
+	slot_bench_table t;
+	slot_bench_table_init(&t, count);
+
+	boa_benchmark_for() {
+		if (g_slotmap_method) {
+			for (uint32_t i = 0; i < count; i++) {
+				slot_entity *e = (slot_entity*)boa_slotmap_get(&t.slotmap, t.handles[i]);
+				e->pos[0] += e->vel[0] + 1.0f;
+			}
+		} else {
+			for (uint32_t i = 0; i < count; i++) {
+				slot_entity *e = (slot_entity*)boa_ptr_map_find(&t.ptr_map, t.ptrs[i]);
+				e->pos[0] += e->vel[0] + 1.0f;
+			}
+		}
+	}
+
+	slot_bench_table_reset(&t);
+}
+
+BOA_BENCHMARK(entity_churn, "Remove and re-add a tenth of the entities")
+{
+	uint32_t count = boa_benchmark_count();
+	slot_bench_table t;
+	slot_bench_table_init(&t, count);
+	uint32_t num_churn = count / 10;
+
+	boa_benchmark_for() {
+		for (uint32_t i = 0; i < num_churn; i++) {
+			if (g_slotmap_method) {
+				boa_benchmark_assert(boa_slotmap_remove(&t.slotmap, t.handles[i]));
+				slot_entity *e = (slot_entity*)boa_slotmap_insert(&t.slotmap, &t.handles[i]);
+				e->key = t.ptrs[i];
+				e->flags = i;
+			} else {
+				slot_entity *old = (slot_entity*)boa_ptr_map_find(&t.ptr_map, t.ptrs[i]);
+				boa_benchmark_assert(old != NULL);
+				boa_map_remove(&t.ptr_map, old);
+				slot_entity *e = (slot_entity*)boa_ptr_map_insert(&t.ptr_map, t.ptrs[i]).entry;
+				e->key = t.ptrs[i];
+				e->flags = i;
+			}
+		}
+	}
+
+	slot_bench_table_reset(&t);
+}
+
+BOA_BENCHMARK(entity_scan, "Update every entity in storage order")
+{
+	uint32_t count = boa_benchmark_count();
+	slot_bench_table t;
+	slot_bench_table_init(&t, count);
+
+	boa_benchmark_for() {
+		if (g_slotmap_method) {
+			boa_slotmap_for(slot_entity, e, &t.slotmap) {
+				e->pos[0] += e->vel[0] + 1.0f;
+			}
+		} else {
+			boa_map_for(slot_entity, e, &t.ptr_map) {
+				e->pos[0] += e->vel[0] + 1.0f;
+			}
+		}
+	}
+
+	slot_bench_table_reset(&t);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_slotmap_method);
+BOA_BENCHMARK_END_COUNT();
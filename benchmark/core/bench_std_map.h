@@ -31,7 +31,7 @@ BOA_BENCHMARK(std_int_map_insert_consecutive, "Insert consecutive integers into
 	std::unordered_map<int, int> map;
 
 	if (g_do_reserve)
-		map.reserve(g_map_size);
+		map.reserve(boa_benchmark_count());
 
 	boa_benchmark_for() {
 		if (g_do_reserve) {
@@ -52,7 +52,7 @@ BOA_BENCHMARK(std_pair_map_insert_consecutive, "Insert consecutive pairs into a
 	std::unordered_map<int_pair, int> map;
 
 	if (g_do_reserve)
-		map.reserve(g_map_size);
+		map.reserve(boa_benchmark_count());
 
 	boa_benchmark_for() {
 		if (g_do_reserve) {
@@ -77,8 +77,8 @@ BOA_BENCHMARK_P(std_int_pair_map_insert_interleaved, "Insert interleaved consecu
 	std::unordered_map<int_pair, int> mapp;
 
 	if (g_do_reserve) {
-		mapi.reserve(g_map_size);
-		mapp.reserve(g_map_size);
+		mapi.reserve(boa_benchmark_count());
+		mapp.reserve(boa_benchmark_count());
 	}
 
 	boa_benchmark_for() {
@@ -108,7 +108,7 @@ BOA_BENCHMARK(std_int_map_find_consecutive, "Find consecutive integers from an i
 	std::unordered_map<int, int> map;
 
 	if (g_do_reserve)
-		map.reserve(g_map_size);
+		map.reserve(boa_benchmark_count());
 
 	uint32_t size = boa_benchmark_count();
 
@@ -129,7 +129,7 @@ BOA_BENCHMARK(std_int_map_find_consecutive_missing, "Find consecutive missing in
 	std::unordered_map<int, int> map;
 
 	if (g_do_reserve)
-		map.reserve(g_map_size);
+		map.reserve(boa_benchmark_count());
 
 	uint32_t size = boa_benchmark_count();
 
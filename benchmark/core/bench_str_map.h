@@ -0,0 +1,67 @@
+#if BOA_BENCHMARK_IMPL
+uint32_t g_str_map;
+
+static uint32_t str_map_sizes[] = {
+	1000, 100000, 1000000,
+};
+
+// 0: boa_map with a copied key per entry and a callback compare, 1: boa_str_map
+static uint32_t str_map_values[] = {
+	0, 1,
+};
+
+typedef struct str_map_kv { boa_str_key key; int val; } str_map_kv;
+
+int str_copy_cmp(const void *a, const void *b, void *user) {
+	return !strcmp((const char*)a, ((const kv_str*)b)->key);
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(str_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_str_map, str_map_values);
+
+BOA_BENCHMARK(str_map_insert_find, "Insert strings with a common prefix and find them and missing ones")
+{
+	uint32_t size = boa_benchmark_count();
+	char **keys = make_str_keys(size * 2);
+	uint32_t *lengths = boa_make_n(uint32_t, size * 2);
+	for (uint32_t i = 0; i < size * 2; i++) lengths[i] = (uint32_t)strlen(keys[i]);
+
+	boa_benchmark_for() {
+		if (g_str_map) {
+			boa_str_map map;
+			boa_str_map_init(&map, sizeof(str_map_kv), NULL);
+			for (uint32_t i = 0; i < size; i++) {
+				str_map_kv *kv = (str_map_kv*)boa_str_map_insert(&map, keys[i], lengths[i]).entry;
+				kv->val = (int)i;
+			}
+			for (uint32_t i = 0; i < size * 2; i++) {
+				str_map_kv *kv = (str_map_kv*)boa_str_map_find(&map, keys[i], lengths[i]);
+				boa_benchmark_assert(i < size ? kv && kv->val == (int)i : !kv);
+			}
+			boa_str_map_reset(&map);
+		} else {
+			boa_map map;
+			boa_map_init(&map, sizeof(kv_str));
+			for (uint32_t i = 0; i < size; i++) {
+				kv_str *kv = (kv_str*)boa_map_insert(&map, keys[i], str_hash(keys[i]), &str_copy_cmp, NULL).entry;
+				kv->key = (char*)boa_alloc(lengths[i] + 1);
+				memcpy(kv->key, keys[i], lengths[i] + 1);
+				kv->val = (int)i;
+			}
+			for (uint32_t i = 0; i < size * 2; i++) {
+				kv_str *kv = (kv_str*)boa_map_find(&map, keys[i], str_hash(keys[i]), &str_copy_cmp, NULL);
+				boa_benchmark_assert(i < size ? kv && kv->val == (int)i : !kv);
+			}
+			boa_map_for (kv_str, kv, &map) boa_free(kv->key);
+			boa_map_reset(&map);
+		}
+	}
+
+	boa_free(lengths);
+	free_str_keys(keys, size * 2);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_str_map);
+BOA_BENCHMARK_END_COUNT();
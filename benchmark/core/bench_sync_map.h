@@ -0,0 +1,85 @@
+
+#include <boa_os.h>
+
+#if BOA_BENCHMARK_IMPL
+uint32_t g_sync_threads;
+uint32_t g_sync_shards;
+
+static uint32_t sync_map_sizes[] = {
+	100000, 1000000,
+};
+
+static uint32_t sync_thread_values[] = {
+	1, 2, 4, 8,
+};
+
+// 1 shard is equivalent to a single global lock
+static uint32_t sync_shard_values[] = {
+	1, 64,
+};
+
+typedef struct sync_bench_worker {
+	boa_sync_map *map;
+	uint32_t begin, end;
+} sync_bench_worker;
+
+void sync_bench_insert_find_entry(void *user)
+{
+	sync_bench_worker *w = (sync_bench_worker*)user;
+	for (int i = (int)w->begin; i < (int)w->end; i++) {
+		kv_int kv = { i, i };
+		boa_sync_map_insert(w->map, &i, int_hash(i), &int_cmp, NULL, &kv);
+	}
+	for (int i = (int)w->begin; i < (int)w->end; i++) {
+		kv_int kv;
+		int found = boa_sync_map_find(w->map, &i, int_hash(i), &int_cmp, NULL, &kv);
+		boa_benchmark_assert(found && kv.val == i);
+	}
+}
+
+void sync_bench_run_threads(boa_sync_map *map, boa_thread_entry entry)
+{
+	sync_bench_worker workers[8];
+	boa_thread *threads[8];
+	uint32_t count = boa_benchmark_count();
+	uint32_t num = g_sync_threads;
+
+	for (uint32_t i = 0; i < num; i++) {
+		boa_thread_opts opts = { 0 };
+		workers[i].map = map;
+		workers[i].begin = (uint32_t)((uint64_t)count * i / num);
+		workers[i].end = (uint32_t)((uint64_t)count * (i + 1) / num);
+		opts.entry = entry;
+		opts.user = &workers[i];
+		threads[i] = boa_create_thread(&opts);
+		boa_benchmark_assert(threads[i] != NULL);
+	}
+	for (uint32_t i = 0; i < num; i++) {
+		boa_join_thread(threads[i]);
+	}
+}
+
+#endif
+
+BOA_BENCHMARK_BEGIN_COUNT(sync_map_sizes);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_sync_shards, sync_shard_values);
+BOA_BENCHMARK_BEGIN_PERMUTATION_U32(g_sync_threads, sync_thread_values);
+
+BOA_BENCHMARK(sync_map_insert_find, "Insert and find consecutive integers from multiple threads")
+{
+	boa_sync_map map;
+	boa_benchmark_assert(boa_sync_map_init(&map, sizeof(kv_int), g_sync_shards, NULL));
+
+	boa_benchmark_for() {
+		boa_sync_map_reset(&map);
+		boa_benchmark_assert(boa_sync_map_init(&map, sizeof(kv_int), g_sync_shards, NULL));
+		sync_bench_run_threads(&map, &sync_bench_insert_find_entry);
+	}
+
+	boa_benchmark_assert(boa_sync_map_count(&map) == boa_benchmark_count());
+	boa_sync_map_reset(&map);
+}
+
+BOA_BENCHMARK_END_PERMUTATION(g_sync_threads);
+BOA_BENCHMARK_END_PERMUTATION(g_sync_shards);
+BOA_BENCHMARK_END_COUNT();
@@ -76,10 +76,12 @@ bool pathfind(boa::buf<point> &path, const map &map, point begin, point end, boa
 		return path.try_push(begin);
 	}
 
+	typedef boa::blit_map<point, float> closed_map;
 	state stack_states[64];
 	work_item stack_work[64];
+	alignas(8) char stack_closed[closed_map::fixed_storage_size(64)];
 
-	boa::blit_map<point, float> closed{ ator };
+	closed_map closed{ stack_closed, sizeof(stack_closed), ator };
 	boa::buf<state> states{ boa::array_buf_ator(stack_states, ator) };
 	boa::pqueue<work_item> work{ boa::array_buf_ator(stack_work, ator) };
 
@@ -50,7 +50,11 @@
 extern uint32_t boa__benchmark_count;
 #define boa_benchmark_count() (boa__benchmark_count)
 
-#define boa_benchmark_assert(x) do { if (!(x)) __debugbreak(); } while (0)
+#if BOA_MSVC
+	#define boa_benchmark_assert(x) do { if (!(x)) __debugbreak(); } while (0)
+#else
+	#define boa_benchmark_assert(x) do { if (!(x)) __builtin_trap(); } while (0)
+#endif
 
 typedef struct boa_benchmark {
 	void (*benchmark_fn)();
@@ -64,8 +68,15 @@ typedef struct boa_benchmark {
 	uint32_t num_runs;
 	double avg_time;
 	double avg_cycles;
+
+	boa_buf metrics; // < boa_benchmark_metric reported during the last permutation
 } boa_benchmark;
 
+typedef struct boa_benchmark_metric {
+	const char *name;
+	double value;
+} boa_benchmark_metric;
+
 typedef struct boa_benchmark_permutation {
 	void *ptr;
 	const char *name;
@@ -88,6 +99,12 @@ int boa_benchmark_run(boa_benchmark *benchmark, int permutation_filter);
 uint32_t boa_benchmark_begin();
 uint32_t boa_benchmark_end();
 
+// Report an additional named result of the running benchmark, eg. a latency percentile
+void boa_benchmark_report(const char *name, double value);
+
+// Report the most relevant `boa_map_get_stats()` values of `map`
+void boa_benchmark_report_map_stats(const boa_map *map);
+
 #define boa_benchmark_for() for ( \
 	uint32_t boa__benchmark_state = boa_benchmark_begin(); \
 	boa__benchmark_state > 0 || (boa__benchmark_state = boa_benchmark_end()); \
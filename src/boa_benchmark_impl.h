@@ -34,6 +34,7 @@ typedef struct boa__benchmark_compile_permutation {
 } boa__benchmark_compile_permutation;
 
 boa__benchmark_state boa__current_state;
+static boa_benchmark *boa__current_benchmark;
 
 static boa_buf boa__all_benchmarks;
 boa_buf boa__benchmark_active_permutations;
@@ -51,6 +52,7 @@ void boa_benchmark_add(void (*benchmark_fn)(), const char *name, const char *des
 
 		benchmark->permutations = boa_empty_buf();
 		boa_buf_push_buf(&benchmark->permutations, &boa__benchmark_active_permutations);
+		benchmark->metrics = boa_empty_buf();
 	}
 }
 
@@ -140,7 +142,10 @@ boa_benchmark *boa_benchmark_get_all(size_t *count)
 
 static void boa__benchmark_run_permutation(boa_benchmark *benchmark)
 {
+	boa_clear(&benchmark->metrics);
+	boa__current_benchmark = benchmark;
 	benchmark->benchmark_fn();
+	boa__current_benchmark = NULL;
 
 	boa__benchmark_state *state = &boa__current_state;
 	benchmark->avg_time = state->avg_time;
@@ -223,5 +228,29 @@ uint32_t boa_benchmark_end()
 	return runs;
 }
 
+void boa_benchmark_report(const char *name, double value)
+{
+	boa_benchmark *benchmark = boa__current_benchmark;
+	boa_assert(benchmark != NULL);
+	boa_benchmark_metric *metric = boa_push(boa_benchmark_metric, &benchmark->metrics);
+	if (metric) {
+		metric->name = name;
+		metric->value = value;
+	}
+}
+
+void boa_benchmark_report_map_stats(const boa_map *map)
+{
+	boa_map_stats stats;
+	boa_map_get_stats(map, &stats);
+	boa_benchmark_report("map avg scan", stats.avg_scan);
+	boa_benchmark_report("map max scan", (double)stats.max_scan);
+	boa_benchmark_report("map avg block fill", stats.avg_block_fill);
+	boa_benchmark_report("map max aux chain", (double)stats.max_aux_chain);
+	boa_benchmark_report("map aux blocks used", (double)stats.num_aux_used);
+	boa_benchmark_report("map aux blocks allocated", (double)stats.num_aux_allocated);
+	boa_benchmark_report("map bytes per entry", stats.bytes_per_entry);
+}
+
 #endif
 
@@ -20,6 +20,11 @@
 #define BOA_WINDOWS 0 // < Windows
 #define BOA_LINUX 0   // < Linux (or Linux like)
 
+// Instruction sets
+#define BOA_SSE2 0 // < SSE2 intrinsics are available
+#define BOA_AVX2 0 // < AVX2 intrinsics are available
+#define BOA_AESNI 0 // < AES-NI intrinsics are available (64-bit only)
+
 #if !defined(BOA_SINGLETHREADED)
 	#define BOA_SINGLETHREADED 0
 #else
@@ -34,6 +39,14 @@
 	#define BOA_RELEASE 1
 #endif
 
+// Use only portable code paths, don't use any instruction set extensions
+#if !defined(BOA_GENERIC)
+	#define BOA_GENERIC 0
+#else
+	#undef BOA_GENERIC
+	#define BOA_GENERIC 1
+#endif
+
 #if defined(_MSC_VER)
 	#undef BOA_MSVC
 	#define BOA_MSVC 1
@@ -71,10 +84,35 @@
 	#error "Unsupported OS"
 #endif
 
+#if BOA_X86 && !BOA_GENERIC
+	#if defined(__SSE2__) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#undef BOA_SSE2
+		#define BOA_SSE2 1
+	#endif
+	#if defined(__AVX2__)
+		#undef BOA_AVX2
+		#define BOA_AVX2 1
+	#endif
+	#if defined(__AES__) && BOA_SSE2 && BOA_64BIT
+		#undef BOA_AESNI
+		#define BOA_AESNI 1
+	#endif
+#endif
+
 #if BOA_MSVC
 	#include <intrin.h>
 #endif
 
+#if BOA_AVX2
+	#include <immintrin.h>
+#elif BOA_SSE2
+	#include <emmintrin.h>
+#endif
+
+#if BOA_AESNI && BOA_GNUC
+	#include <wmmintrin.h>
+#endif
+
 // -- Language
 
 #include <stddef.h>
@@ -82,6 +120,8 @@
 
 #define boa_arraycount(arr) (sizeof(arr) / sizeof(*(arr)))
 #define boa_arrayend(arr) (arr + (sizeof(arr) / sizeof(*(arr))))
+#define boa_min(a, b) ((a) < (b) ? (a) : (b))
+#define boa_max(a, b) ((a) < (b) ? (b) : (a))
 
 #if defined(__cplusplus)
 	#define boa_inline inline
@@ -206,6 +246,21 @@ boa_forceinline uint32_t boa_highest_bit(uint32_t value)
 #endif
 }
 
+boa_forceinline uint32_t boa_lowest_bit(uint32_t value)
+{
+	boa_assert(value != 0);
+
+#if BOA_MSVC
+	unsigned long result;
+	_BitScanForward(&result, value);
+	return result;
+#elif BOA_GNUC
+	return __builtin_ctz(value);
+#else
+	#error "Unimplemented"
+#endif
+}
+
 boa_forceinline void boa_swap_inline(void *a, void *b, uint32_t size)
 {
 	char *pa = (char*)a, *pb = (char*)b;
@@ -249,6 +304,98 @@ boa_forceinline void boa_swap_inline(void *a, void *b, uint32_t size)
 
 void boa_swap(void *a, void *b, uint32_t size);
 
+// Hint the CPU to start loading the cache line containing `ptr`
+#if BOA_MSVC
+	#define boa_prefetch(ptr) _mm_prefetch((const char*)(ptr), _MM_HINT_T0)
+#elif BOA_GNUC
+	#define boa_prefetch(ptr) __builtin_prefetch((ptr))
+#else
+	#define boa_prefetch(ptr) (void)0
+#endif
+
+// -- boa_atomic: Sequentially consistent 32-bit and pointer atomics
+
+#if BOA_SINGLETHREADED
+	boa_forceinline uint32_t boa_atomic_load_u32(const volatile uint32_t *p) { return *p; }
+	boa_forceinline void boa_atomic_store_u32(volatile uint32_t *p, uint32_t v) { *p = v; }
+	boa_forceinline uint32_t boa_atomic_exchange_u32(volatile uint32_t *p, uint32_t v) { uint32_t r = *p; *p = v; return r; }
+	boa_forceinline uint32_t boa_atomic_fetch_add_u32(volatile uint32_t *p, uint32_t v) { uint32_t r = *p; *p = r + v; return r; }
+	boa_forceinline void *boa_atomic_load_ptr(void *const volatile *p) { return *p; }
+	boa_forceinline void boa_atomic_store_ptr(void *volatile *p, void *v) { *p = v; }
+#elif BOA_MSVC
+	boa_forceinline uint32_t boa_atomic_load_u32(const volatile uint32_t *p) { uint32_t v = *p; _ReadWriteBarrier(); return v; }
+	boa_forceinline void boa_atomic_store_u32(volatile uint32_t *p, uint32_t v) { _InterlockedExchange((volatile long*)p, (long)v); }
+	boa_forceinline uint32_t boa_atomic_exchange_u32(volatile uint32_t *p, uint32_t v) { return (uint32_t)_InterlockedExchange((volatile long*)p, (long)v); }
+	boa_forceinline uint32_t boa_atomic_fetch_add_u32(volatile uint32_t *p, uint32_t v) { return (uint32_t)_InterlockedExchangeAdd((volatile long*)p, (long)v); }
+	boa_forceinline void *boa_atomic_load_ptr(void *const volatile *p) { void *v = *p; _ReadWriteBarrier(); return v; }
+	boa_forceinline void boa_atomic_store_ptr(void *volatile *p, void *v) { _InterlockedExchangePointer(p, v); }
+#elif BOA_GNUC
+	boa_forceinline uint32_t boa_atomic_load_u32(const volatile uint32_t *p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+	boa_forceinline void boa_atomic_store_u32(volatile uint32_t *p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+	boa_forceinline uint32_t boa_atomic_exchange_u32(volatile uint32_t *p, uint32_t v) { return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+	boa_forceinline uint32_t boa_atomic_fetch_add_u32(volatile uint32_t *p, uint32_t v) { return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST); }
+	boa_forceinline void *boa_atomic_load_ptr(void *const volatile *p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+	boa_forceinline void boa_atomic_store_ptr(void *volatile *p, void *v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+#else
+	#error "No atomics for compiler"
+#endif
+
+// Hint the CPU that we are busy-waiting
+#if BOA_MSVC
+	#define boa_spin_pause() _mm_pause()
+#elif BOA_GNUC
+	#define boa_spin_pause() __builtin_ia32_pause()
+#endif
+
+// Spinlock for short critical sections, zero initialized is unlocked
+typedef struct boa_spinlock {
+	volatile uint32_t locked;
+} boa_spinlock;
+
+boa_forceinline int boa_spinlock_try_lock(boa_spinlock *lock)
+{
+	return boa_atomic_exchange_u32(&lock->locked, 1) == 0;
+}
+
+boa_forceinline void boa_spinlock_lock(boa_spinlock *lock)
+{
+	while (boa_atomic_exchange_u32(&lock->locked, 1) != 0) {
+		// Wait with plain loads so the cache line is not bounced between cores
+		while (boa_atomic_load_u32(&lock->locked) != 0) {
+			boa_spin_pause();
+		}
+	}
+}
+
+boa_forceinline void boa_spinlock_unlock(boa_spinlock *lock)
+{
+	boa_atomic_store_u32(&lock->locked, 0);
+}
+
+// -- boa_job_runner: Interface for running data-parallel work
+
+typedef void (*boa_job_fn)(void *user, uint32_t index);
+
+typedef struct boa_job_runner boa_job_runner;
+struct boa_job_runner {
+	// Call `fn(user, index)` for every index in [0, count) potentially in parallel,
+	// must return only after all the calls have finished
+	void (*run_fn)(boa_job_runner *runner, boa_job_fn fn, void *user, uint32_t count);
+
+	// Number of jobs that can run in parallel, used to decide how to split the work
+	uint32_t num_workers;
+};
+
+// Run `fn` for `count` indices using `runner`, serially on the calling thread if NULL
+boa_inline void boa_run_jobs(boa_job_runner *runner, boa_job_fn fn, void *user, uint32_t count) {
+	if (runner) {
+		runner->run_fn(runner, fn, user, count);
+	} else {
+		uint32_t i;
+		for (i = 0; i < count; i++) fn(user, i);
+	}
+}
+
 // -- boa_allocator
 
 typedef struct boa_allocator boa_allocator;
@@ -488,6 +635,85 @@ typedef int (*boa_format_fn)(boa_buf *buf, const void *data, size_t size);
 int boa_format_null(boa_buf *buf, const void *data, size_t size);
 int boa_format_u32(boa_buf *buf, const void *data, size_t size);
 
+/*
+	-- boa_filter: Blocked Bloom filter for 32-bit hashes.
+	Each hash is mapped to a single 32-byte block where it sets one bit in each of the
+	eight words, so testing a hash touches only one cache line. The filter never has
+	false negatives and has a false positive rate of a fraction of a percent when filled
+	up to its capacity. Hashes can't be removed: A `boa_map` with an attached filter
+	rebuilds it from its entries instead once enough entries have been removed.
+*/
+
+#define BOA__FILTER_BLOCK_WORDS 8
+#define BOA__FILTER_BITS_PER_ENTRY 16
+
+typedef struct boa_filter {
+	boa_allocator *ator; // < Allocator to use
+	void *data;          // < Allocation root, `words` is aligned to a cache line within it
+	uint32_t *words;     // < `num_blocks * BOA__FILTER_BLOCK_WORDS` bits
+	uint32_t num_blocks; // < Number of 32-byte blocks
+	uint32_t capacity;   // < Number of hashes the filter is sized for
+	uint32_t count;      // < Number of hashes added since the last clear
+	uint32_t num_stale;  // < Entries removed from the attached map since the last rebuild
+} boa_filter;
+
+// Initialize an empty `filter` sized for `capacity` hashes. Returns 0 if out of memory.
+int boa_filter_init(boa_filter *filter, uint32_t capacity, boa_allocator *ator);
+
+// Remove all the hashes from the filter. Doesn't free memory.
+void boa_filter_clear(boa_filter *filter);
+
+// Free the memory of the filter, it needs to be initialized again before use.
+void boa_filter_reset(boa_filter *filter);
+
+// Mix the hash so that even poor map hashes spread over the blocks
+boa_forceinline uint32_t boa__filter_mix(uint32_t hash)
+{
+	hash ^= hash >> 16;
+	hash *= 0x7feb352du;
+	hash ^= hash >> 15;
+	hash *= 0x846ca68bu;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+// Select the block using the high bits of the mixed hash
+#define boa__filter_block(filter, mixed) ((filter)->words + \
+	(uint32_t)(((uint64_t)(mixed) * (filter)->num_blocks) >> 32) * BOA__FILTER_BLOCK_WORDS)
+
+// Bits of the block: Top bits of the mixed hash multiplied by an odd constant per word
+#define BOA__FILTER_SALTS { 0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, \
+	0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u }
+
+// Add `hash` to the filter
+boa_forceinline void boa_filter_add(boa_filter *filter, uint32_t hash)
+{
+	const uint32_t salts[BOA__FILTER_BLOCK_WORDS] = BOA__FILTER_SALTS;
+	uint32_t mixed = boa__filter_mix(hash);
+	uint32_t *block = boa__filter_block(filter, mixed);
+	uint32_t i;
+	for (i = 0; i < BOA__FILTER_BLOCK_WORDS; i++) {
+		block[i] |= 1u << ((mixed * salts[i]) >> 27);
+	}
+	filter->count++;
+}
+
+// Returns zero if `hash` has definitely not been added to the filter
+boa_forceinline int boa_filter_test(const boa_filter *filter, uint32_t hash)
+{
+	const uint32_t salts[BOA__FILTER_BLOCK_WORDS] = BOA__FILTER_SALTS;
+	uint32_t mixed = boa__filter_mix(hash);
+	const uint32_t *block = boa__filter_block(filter, mixed);
+	uint32_t missing = 0, i;
+	for (i = 0; i < BOA__FILTER_BLOCK_WORDS; i++) {
+		missing |= ~block[i] & 1u << ((mixed * salts[i]) >> 27);
+	}
+	return missing == 0;
+}
+
+// Start loading the block of `hash`
+#define boa__filter_prefetch(filter, hash) boa_prefetch(boa__filter_block((filter), boa__filter_mix(hash)))
+
 /*
 	-- boa_map: General purpose hash container.
 	A boa_map consists of multiple entries: values in a set or key-value pairs in
@@ -517,6 +743,7 @@ typedef struct boa__map_impl {
 
 	uint8_t block_num_entries; // < Number of user visible entries in a block
 	uint8_t entry_block_shift; // < How much to shift by to get from an entry to its block
+	uint8_t fixed_block_entries; // < `block_num_entries` for all table sizes, 0 to pick by capacity
 
 	// Block metadata, also the root of the allocation to be freed
 	struct boa__map_block *blocks;
@@ -535,6 +762,25 @@ typedef struct boa__map_impl {
 	// Entries within the block are in contiguous memory.
 	void *entries;
 
+	// Old table being migrated by an incremental rehash, NULL if none in progress
+	struct boa__map_rehash *rehash;
+
+	// Number of old blocks to migrate per insert, 0 to rehash all at once
+	uint32_t incremental_blocks;
+
+	// Optional runner used to rehash large tables in parallel
+	boa_job_runner *job_runner;
+
+	// Seed for hashing the keys in `boa_blit_map_*()` functions
+	uint32_t hash_seed;
+
+	// Optional filter of the hashes of the entries to reject finds that would miss
+	boa_filter *filter;
+
+	// Caller storage from `boa_map_init_fixed()` used for tables that fit in it
+	void *fixed_data;
+	uint32_t fixed_size;
+
 } boa__map_impl;
 
 typedef struct boa_map {
@@ -552,6 +798,12 @@ typedef struct boa__map_block {
 	uint32_t count;    // < Number of elements in this block
 } boa__map_block;
 
+typedef struct boa__map_rehash {
+	boa__map_impl impl;  // < Old table, blocks before `next_block` have been emptied
+	uint32_t count;      // < Number of entries still in the old table
+	uint32_t next_block; // < Next old block to migrate
+} boa__map_rehash;
+
 // Return non-zero if `key` is equal to `entry`
 typedef int (*boa_map_cmp_fn)(const void *key, const void *entry, void *user);
 
@@ -570,8 +822,13 @@ typedef struct boa_map_iterator {
 
 uint32_t boa__map_find_fallback(boa_map *map, uint32_t block_ix);
 boa_map_iterator boa__map_find_block_start(const boa_map *map, uint32_t block_ix);
+boa_map_iterator boa__map_find_block_range(const boa_map *map, uint32_t block_ix, uint32_t end_block);
+boa_map_iterator boa__map_find_next_in(const boa_map *map, const void *entry, uint32_t end_block);
 void *boa__map_remove_non_iter(boa_map *map, void *value);
 boa_map_iterator boa__map_find_next(const boa_map *map, const void *value);
+int boa__map_grow(boa_map *map);
+boa_noinline void *boa__map_rehash_find(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash);
+boa_noinline void *boa__map_rehash_insert_step(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash);
 
 #define boa__map_block_num_slots(map) ((map)->impl.block_num_entries << 1)
 
@@ -586,6 +843,7 @@ boa_map_iterator boa__map_find_next(const boa_map *map, const void *value);
 
 #define boa__map_entry_index_from_block(map, block, offset) ((block) * (map)->impl.block_num_entries + (offset))
 #define boa__map_entry_from_index(map, entry_index) ((void*)((char*)(map)->impl.entries + (entry_index) * (map)->entry_size))
+#define boa__map_geometry_entry(map, entry_index, entry_size) ((void*)((char*)(map)->impl.entries + (entry_index) * (entry_size)))
 
 // Set the lowest bit of the hash to 1 if bits 1:LOWBITS are 0
 #define boa__map_hash_canonicalize(hash) ((hash) | ((uint32_t)((hash) & BOA__MAP_LOWMASK) - 1) >> 31)
@@ -596,7 +854,7 @@ boa_inline void boa_map_init_ator(boa_map *map, size_t entry_size, boa_allocator
 	map->count = 0;
 	map->capacity = 0;
 	map->entry_size = (uint32_t)entry_size;
-	map->impl.blocks = NULL;
+	memset(&map->impl, 0, sizeof(map->impl));
 }
 
 // Initialize `map` to hold entries of size `entry_size`
@@ -605,13 +863,90 @@ boa_inline void boa_map_init(boa_map *map, size_t entry_size) {
 	map->count = 0;
 	map->capacity = 0;
 	map->entry_size = (uint32_t)entry_size;
-	map->impl.blocks = NULL;
+	memset(&map->impl, 0, sizeof(map->impl));
+}
+
+// Bytes of storage needed by `boa_map_init_fixed()` to hold `capacity` entries without
+// allocating, `capacity` must be a power of two between 16 and `BOA_MAP_MAX_BLOCK_ENTRIES`.
+#define BOA_MAP_FIXED_STORAGE_SIZE(entry_size, capacity) (8 + (capacity) * 8 + ((capacity) * (entry_size) + 7) / 8 * 8)
+
+// Initialize `map` to use `size` bytes at `data` (8-byte aligned) as storage for the table
+// while it fits, see `BOA_MAP_FIXED_STORAGE_SIZE()`. Small tables are sized to fill the
+// storage. Larger tables are allocated using `ator` and the map moves back to `data` if
+// it shrinks. `data` must outlive the map and is not freed by `boa_map_reset()`.
+boa_inline void boa_map_init_fixed(boa_map *map, size_t entry_size, void *data, uint32_t size, boa_allocator *ator) {
+	boa_assert(((uintptr_t)data & 7) == 0);
+	boa_map_init_ator(map, entry_size, ator);
+	map->impl.fixed_data = data;
+	map->impl.fixed_size = size;
 }
 
 // Reserve `capacity` entries to insert into. Note: Does not guarantee that the map doesn't
 // reallocate in pathological cases.
 int boa_map_reserve(boa_map *map, uint32_t capacity);
 
+// Re-hash the map to the smallest geometry that fits the current entries without any extra
+// auxilary blocks. Frees all memory if the map is empty. Returns 0 if out of memory.
+int boa_map_shrink(boa_map *map);
+
+// Re-hash the map with the current capacity folding entries in auxilary blocks back into
+// the primary blocks and freeing unnecessary auxilary blocks. Returns 0 if out of memory.
+int boa_map_compact(boa_map *map);
+
+// Grow the map incrementally: Instead of rehashing all the entries at once when the map
+// is full the old entries are migrated `blocks_per_insert` blocks at a time during the
+// following inserts. Bounds the worst case insert latency of large maps, but finds that
+// miss need to check both tables while the migration is in progress. 0 disables (default).
+boa_inline void boa_map_set_incremental(boa_map *map, uint32_t blocks_per_insert) {
+	map->impl.incremental_blocks = blocks_per_insert;
+}
+
+// Re-hash large tables in parallel using `runner` when the map is resized, NULL to
+// always re-hash on the calling thread. Ignored for incremental rehashing.
+boa_inline void boa_map_set_job_runner(boa_map *map, boa_job_runner *runner) {
+	map->impl.job_runner = runner;
+}
+
+#define BOA_MAP_MIN_BLOCK_ENTRIES 16
+#define BOA_MAP_MAX_BLOCK_ENTRIES BOA__MAP_BLOCK_MAX_ENTRIES
+
+// Use blocks of `block_entries` entries (a power of two between `BOA_MAP_MIN_BLOCK_ENTRIES`
+// and `BOA_MAP_MAX_BLOCK_ENTRIES`) for all table sizes, 0 to size small tables to fit (default).
+// Smaller blocks keep the slot arrays of tiny entries dense in the cache, larger blocks
+// waste less memory on the load factor of large entries. Enables the fixed geometry
+// `boa_map_*_geometry_inline()` functions. Must be set before the map is allocated.
+boa_inline void boa_map_set_block_entries(boa_map *map, uint32_t block_entries) {
+	boa_assert(map->capacity == 0);
+	boa_assert(block_entries == 0 || (block_entries >= BOA_MAP_MIN_BLOCK_ENTRIES
+		&& block_entries <= BOA_MAP_MAX_BLOCK_ENTRIES && (block_entries & (block_entries - 1)) == 0));
+	map->impl.fixed_block_entries = (uint8_t)block_entries;
+}
+
+// Set the seed used to hash the keys of `boa_blit_map_*()` functions, use a random
+// value for maps with untrusted keys. Must be set while the map is empty.
+boa_inline void boa_map_set_hash_seed(boa_map *map, uint32_t seed) {
+	boa_assert(map->count == 0);
+	map->impl.hash_seed = seed;
+}
+
+// Attach `filter` to the map, NULL to detach. Finds of keys whose hashes are not in the
+// filter return without touching the blocks of the map, useful for maps that mostly miss.
+// The filter is kept in sync by the map: It's filled from the current entries, grown with
+// the map and rebuilt after removals. A zero-initialized filter is allocated using the
+// allocator of the map. `filter` must outlive the map or be detached before, note that
+// `boa_map_snapshot_open()` detaches the filter. Returns 0 if out of memory.
+int boa_map_set_filter(boa_map *map, boa_filter *filter);
+
+// Migrate up to `num_blocks` blocks of an incremental rehash, eg. when idle.
+// Returns non-zero if the rehash is still in progress.
+int boa_map_rehash_step(boa_map *map, uint32_t num_blocks);
+
+// Replace the contents of the map with `count` entries from the array `entries` where
+// `hashes[i]` is the hash of the key of entry `i`. The map is sized for exactly `count`
+// entries which are placed block by block, a lot faster than inserting them one by one.
+// Important: The keys must be unique as they are never compared!
+int boa_map_build(boa_map *map, const void *entries, const uint32_t *hashes, uint32_t count);
+
 // Insert a value into the map.
 // Important: This function is a low-level primitive and doesn't copy any data to the
 // resulting entry, but it needs to be done by the calling code.
@@ -671,12 +1006,116 @@ boa_forceinline void *boa__map_advance_for_block(const boa_map *map, void *entry
 	return it.entry;
 }
 
+// Partitioned iteration: The blocks of the map are split into disjoint parts that can be
+// iterated independently, eg. to scan a large map on multiple threads. Entries of a block
+// are contiguous in memory from `entry` to `impl_block_end` of the iterator, so a part can
+// also be streamed a block at a time. The map must not be modified while iterating.
+typedef struct boa_map_part {
+	uint32_t begin_block; // < First block of the part
+	uint32_t end_block;   // < One past the last block of the part
+} boa_map_part;
+
+// Get part `index` of `num_parts` parts of `map`, the parts have an equal number of blocks
+// give or take one. Blocks of an incremental rehash in progress are included.
+boa_map_part boa_map_get_part(const boa_map *map, uint32_t index, uint32_t num_parts);
+
+// Get the iterator to the first entry in `part`, the entry is NULL if the part is empty.
+boa_forceinline boa_map_iterator boa_map_part_begin(const boa_map *map, const boa_map_part *part) {
+	return boa__map_find_block_range(map, part->begin_block, part->end_block);
+}
+
+// Advance the iterator to the next entry in `part`.
+boa_forceinline void boa_map_part_advance(const boa_map *map, const boa_map_part *part, boa_map_iterator *it)
+{
+	boa_assert(it->entry != NULL);
+	void *next = (char*)it->entry + map->entry_size;
+	if (next == it->impl_block_end) {
+		*it = boa__map_find_next_in(map, it->entry, part->end_block);
+	} else {
+		it->entry = next;
+	}
+}
+
+// Advance the iterator to the first entry of the next non-empty block in `part`.
+boa_forceinline void boa_map_part_next_block(const boa_map *map, const boa_map_part *part, boa_map_iterator *it) {
+	boa_assert(it->entry != NULL);
+	*it = boa__map_find_next_in(map, it->entry, part->end_block);
+}
+
+boa_forceinline void *boa__map_part_begin_for(const boa_map *map, const boa_map_part *part, void **impl_end) {
+	boa_map_iterator it = boa__map_find_block_range(map, part->begin_block, part->end_block);
+	*impl_end = it.impl_block_end;
+	return it.entry;
+}
+
+boa_forceinline void *boa__map_part_advance_for_block(const boa_map *map, const boa_map_part *part, void *entry, void **impl_end) {
+	boa_assert(entry != NULL);
+	boa_map_iterator it = boa__map_find_next_in(map, entry, part->end_block);
+	*impl_end = it.impl_block_end;
+	return it.entry;
+}
+
+#define boa_map_part_for(type, name, map, part) for ( \
+	type *name##__end, *name = (type*)boa__map_part_begin_for(map, part, (void**)&name##__end); name; \
+	name = (name + 1 != name##__end ? name + 1 : (type*)boa__map_part_advance_for_block(map, part, name, (void**)&name##__end)))
+
 // Remove all elements from the map. Doesn't free memory.
 void boa_map_clear(boa_map *map);
 
 // Reset the map to its initial state. Frees any allocated memory.
 void boa_map_reset(boa_map *map);
 
+#define BOA_MAP_STATS_FILL_BUCKETS 8
+
+typedef struct boa_map_stats {
+	uint32_t count;             // < Number of entries
+	uint32_t capacity;          // < Entries that fit before growing
+	uint32_t block_num_entries; // < Entries per block
+
+	uint32_t num_hash_blocks;   // < Number of primary blocks
+	uint32_t num_aux_used;      // < Auxilary blocks linked to primary blocks
+	uint32_t num_aux_allocated; // < Auxilary blocks allocated including the used ones
+
+	// Blocks with fill ratio in [N/BUCKETS, (N+1)/BUCKETS), full blocks are in the last bucket
+	uint32_t fill_histogram[BOA_MAP_STATS_FILL_BUCKETS];
+	uint32_t num_full_blocks;   // < Blocks with no free entries
+	double avg_block_fill;      // < Average fill ratio of the used blocks
+
+	uint32_t max_aux_chain;     // < Longest chain of auxilary blocks of a primary block
+	double avg_aux_chain;       // < Average auxilary chain length of a primary block
+
+	uint32_t max_scan;          // < Longest scan distance from an entry's original slot
+	double avg_scan;            // < Average scan distance, 0 means every entry is in its original slot
+
+	uint32_t rehash_count;      // < Entries not yet migrated by an incremental rehash
+
+	size_t memory_bytes;        // < Bytes allocated by the map
+	double bytes_per_entry;     // < `memory_bytes / count`
+} boa_map_stats;
+
+// Gather statistics about the internal layout of `map`, useful for diagnosing bad hash
+// functions or wasted memory. Walks the whole map so it's not free.
+void boa_map_get_stats(const boa_map *map, boa_map_stats *stats);
+
+// Snapshots: A position independent image of a map that can be opened without parsing,
+// eg. from a memory mapped file. The entries are copied bitwise so they must not contain
+// pointers and the keys must be hashed with the same function on both ends. Snapshots
+// are only compatible between builds with the same BOA_AESNI as `boa_hash_bytes()` and
+// blit map hashes depend on it.
+
+// Size of the snapshot of `map` in bytes.
+uint32_t boa_map_snapshot_size(const boa_map *map);
+
+// Write a snapshot of `map` to `dst`. Returns the number of bytes written or 0 if
+// `dst_size` is too small or an incremental rehash is in progress.
+uint32_t boa_map_snapshot_write(const boa_map *map, void *dst, uint32_t dst_size);
+
+// Reset `map` and point it to the snapshot at `data` (8-byte aligned) that must outlive
+// it. The entry size of the map must match the snapshot. The map is read-only: finds and
+// iteration work as usual, inserts fail as the map uses the null allocator and removes
+// or clears are not allowed. Returns 0 if the snapshot is invalid or incompatible.
+int boa_map_snapshot_open(boa_map *map, const void *data, uint32_t size);
+
 // Combine two hash values
 boa_forceinline uint32_t boa_hash_combine(uint32_t hash, uint32_t value)
 {
@@ -693,9 +1132,100 @@ boa_forceinline uint32_t boa_u32_hash(uint32_t value)
 	return x;
 }
 
-// Inline implementation of `boa_map_insert()`, wrap in a specialized function for better map performance
+// Hash a pointer value, used by `boa_ptr_map_*()`
+boa_forceinline uint32_t boa_ptr_hash(const void *ptr)
+{
+	uintptr_t up = (uintptr_t)ptr;
+#if BOA_64BIT
+	uint32_t x = boa_hash_combine((uint32_t)up, (uint32_t)(up >> 32));
+#else
+	uint32_t x = (uint32_t)up;
+#endif
+	return boa_u32_hash(x);
+}
+
+// Hash `size` bytes of `data` using `seed`. Note: Keys longer than 16 bytes hash
+// differently depending on BOA_AESNI so don't persist them across builds, map
+// snapshots record the variant and refuse to open in a mismatching build.
+uint64_t boa_hash_bytes(const void *data, size_t size, uint64_t seed);
+
+#if BOA_AVX2
+	#define BOA__MAP_GROUP_SLOTS 16
+#elif BOA_SSE2
+	#define BOA__MAP_GROUP_SLOTS 8
+#else
+	#define BOA__MAP_GROUP_SLOTS 1
+#endif
+
+#if BOA__MAP_GROUP_SLOTS > 1
+
+// Scan a group of up to `BOA__MAP_GROUP_SLOTS` slots starting from `slot_ix` without
+// wrapping around the end of the block. Returns non-zero if the probe sequence ends
+// in the group (empty slot or one with lower scan distance). `*p_num` is set to the
+// number of slots scanned before the end and `*p_match` to a mask of slots matching
+// the `LOWMASK` bits of the hash, where slot `slot_ix + N` is the bit `2 * N`.
+boa_forceinline int
+boa__map_scan_group(const uint16_t *entry_slot, uint32_t slot_ix, uint32_t scan, uint32_t hash,
+	uint32_t block_num_slots, uint32_t *p_num, uint32_t *p_match)
+{
+	// Load a full group ending at the block boundary and ignore the leading slots
+	uint32_t base = slot_ix;
+	if (base > block_num_slots - BOA__MAP_GROUP_SLOTS) base = block_num_slots - BOA__MAP_GROUP_SLOTS;
+	uint32_t skip = (slot_ix - base) * 2;
+	short low = (short)(hash & BOA__MAP_LOWMASK);
+
+#if BOA_AVX2
+	__m256i lane = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	__m256i es = _mm256_loadu_si256((const __m256i*)(entry_slot + base));
+	__m256i slot = _mm256_add_epi16(_mm256_set1_epi16((short)base), lane);
+	__m256i scans = _mm256_add_epi16(_mm256_set1_epi16((short)(scan + base - slot_ix)), lane);
+	__m256i dist = _mm256_and_si256(_mm256_sub_epi16(slot, es), _mm256_set1_epi16((short)(block_num_slots - 1)));
+	__m256i empty = _mm256_cmpeq_epi16(es, _mm256_setzero_si256());
+	__m256i term = _mm256_or_si256(empty, _mm256_cmpgt_epi16(scans, dist));
+	__m256i match = _mm256_cmpeq_epi16(_mm256_and_si256(es, _mm256_set1_epi16(BOA__MAP_LOWMASK)), _mm256_set1_epi16(low));
+	uint32_t term_bits = (uint32_t)_mm256_movemask_epi8(term);
+	uint32_t match_bits = (uint32_t)_mm256_movemask_epi8(match);
+#else
+	__m128i lane = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+	__m128i es = _mm_loadu_si128((const __m128i*)(entry_slot + base));
+	__m128i slot = _mm_add_epi16(_mm_set1_epi16((short)base), lane);
+	__m128i scans = _mm_add_epi16(_mm_set1_epi16((short)(scan + base - slot_ix)), lane);
+	__m128i dist = _mm_and_si128(_mm_sub_epi16(slot, es), _mm_set1_epi16((short)(block_num_slots - 1)));
+	__m128i empty = _mm_cmpeq_epi16(es, _mm_setzero_si128());
+	__m128i term = _mm_or_si128(empty, _mm_cmplt_epi16(dist, scans));
+	__m128i match = _mm_cmpeq_epi16(_mm_and_si128(es, _mm_set1_epi16(BOA__MAP_LOWMASK)), _mm_set1_epi16(low));
+	uint32_t term_bits = (uint32_t)_mm_movemask_epi8(term);
+	uint32_t match_bits = (uint32_t)_mm_movemask_epi8(match);
+#endif
+
+	// Movemask produces two bits per slot, keep only the lower one
+	term_bits = (term_bits >> skip) & 0x55555555u;
+	match_bits = (match_bits >> skip) & 0x55555555u;
+
+	if (term_bits) {
+		uint32_t end = boa_lowest_bit(term_bits);
+		*p_num = end >> 1;
+		*p_match = match_bits & ((1u << end) - 1);
+		return 1;
+	} else {
+		*p_num = BOA__MAP_GROUP_SLOTS - (skip >> 1);
+		*p_match = match_bits;
+		return 0;
+	}
+}
+
+#endif
+
+// Returns non-zero if `hash` may match the entry at `entry_index`: If `full_hash` is set
+// the high bits of the hash are compared to the ones stored in `hash_cur_slot`.
+#define boa__map_hcs_match(map, entry_index, hash, full_hash) \
+	(!(full_hash) || (((map)->impl.hash_cur_slot[entry_index] ^ (hash)) & BOA__MAP_HIGHMASK) == 0)
+
+// `block_entries` and `entry_size` are the geometry of the map if known at compile time or
+// zero to read them from the map, constants let the compiler fold the index arithmetic.
 boa_forceinline boa_map_insert_result
-boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+boa__map_insert_geometry_impl(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash,
+	uint32_t block_entries, uint32_t entry_size)
 {
 	boa_map_insert_result result;
 	result.entry = NULL;
@@ -703,16 +1233,29 @@ boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_
 
 	// Rehash before insert for simplicity, also handles edge case of empty map
 	if (map->count >= map->capacity) {
-		if (!boa_map_reserve(map, map->capacity * 2)) return result;
+		if (!boa__map_grow(map)) return result;
+	}
+
+	// Incremental rehash in progress: Migrate some entries and check the old table
+	if (map->impl.rehash) {
+		void *old_entry = boa__map_rehash_insert_step(map, key_ptr, hash, cmp, user, full_hash);
+		if (old_entry) {
+			result.entry = old_entry;
+			return result;
+		}
 	}
 
 	hash = boa__map_hash_canonicalize(hash);
 
+	boa_assert(!block_entries || block_entries == map->impl.block_num_entries);
+	uint32_t block_num_entries = block_entries ? block_entries : map->impl.block_num_entries;
+	uint32_t entry_stride = entry_size ? entry_size : map->entry_size;
+
 	// Calculate block and slot indices from the hash
 	uint32_t block_mask = map->impl.num_hash_blocks - 1;
 	uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
 	uint32_t count;
-	uint32_t block_num_slots = boa__map_block_num_slots(map);
+	uint32_t block_num_slots = block_num_entries << 1;
 	uint32_t slot_mask = block_num_slots - 1;
 
 	uint16_t *entry_slot;
@@ -724,15 +1267,44 @@ boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_
 		entry_slot = map->impl.entry_slot + block_ix * block_num_slots;
 		scan = 0;  // < Number of slots scanned from insertion point
 
+#if BOA__MAP_GROUP_SLOTS > 1
+		for (;;) {
+			uint32_t num, match;
+			int end = boa__map_scan_group(entry_slot, slot_ix, scan, hash, block_num_slots, &num, &match);
+
+			// Compare only the slots that match `LOWMASK` bits of the hash
+			while (match) {
+				es = entry_slot[slot_ix + (boa_lowest_bit(match) >> 1)];
+				match &= match - 1;
+
+				uint32_t entry_offset = boa__es_entry_offset(es);
+				uint32_t entry_index = block_ix * block_num_entries + entry_offset;
+				void *entry = boa__map_geometry_entry(map, entry_index, entry_stride);
+				if (boa__map_hcs_match(map, entry_index, hash, full_hash) && cmp(key_ptr, entry, user)) {
+					result.entry = entry;
+					return result;
+				}
+			}
+
+			slot_ix = (slot_ix + num) & slot_mask;
+			scan += num;
+
+			// If we find an empty slot or one with lower scan distance insert here
+			if (end) {
+				es = entry_slot[slot_ix];
+				break;
+			}
+		}
+#else
 		for (;;) {
 			es = entry_slot[slot_ix];
 
 			// Match `LOWMASK` bits of the hash to the element-slot value
 			if (((es ^ hash) & BOA__MAP_LOWMASK) == 0) {
 				uint32_t entry_offset = boa__es_entry_offset(es);
-				uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, entry_offset);
-				void *entry = boa__map_entry_from_index(map, entry_index);
-				if (cmp(key_ptr, entry, user)) {
+				uint32_t entry_index = block_ix * block_num_entries + entry_offset;
+				void *entry = boa__map_geometry_entry(map, entry_index, entry_stride);
+				if (boa__map_hcs_match(map, entry_index, hash, full_hash) && cmp(key_ptr, entry, user)) {
 					result.entry = entry;
 					return result;
 				}
@@ -747,10 +1319,11 @@ boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_
 			slot_ix = (slot_ix + 1) & slot_mask;
 			scan++;
 		}
+#endif
 
 		uint32_t next_ix = map->impl.blocks[block_ix].next_aux;
 		if (next_ix == 0) {
-			if (count >= map->impl.block_num_entries) {
+			if (count >= block_num_entries) {
 				next_ix = boa__map_find_fallback(map, block_ix);
 				if (next_ix == ~0u) return result;
 			}
@@ -765,11 +1338,12 @@ boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_
 
 	// Insert as last entry of the block
 	entry_slot[slot_ix] = boa__es_make(count, hash);
-	uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, count);
-	void *entry = boa__map_entry_from_index(map, entry_index);
+	uint32_t entry_index = block_ix * block_num_entries + count;
+	void *entry = boa__map_geometry_entry(map, entry_index, entry_stride);
 	map->impl.hash_cur_slot[entry_index] = boa__hcs_make(hash, slot_ix);
 	map->impl.blocks[block_ix].count = count + 1;
 	map->count++;
+	if (map->impl.filter) boa_filter_add(map->impl.filter, hash);
 
 	result.entry = entry;
 	result.inserted = 1;
@@ -783,7 +1357,7 @@ boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_
 		uint32_t ref_scan = (slot_ix - next_es) & slot_mask;
 		if (next_es == 0 || ref_scan < scan) {
 			uint32_t entry_offset = boa__es_entry_offset(es);
-			uint32_t entry = boa__map_entry_index_from_block(map, block_ix, entry_offset);
+			uint32_t entry = block_ix * block_num_entries + entry_offset;
 			uint32_t hcs = map->impl.hash_cur_slot[entry];
 			map->impl.hash_cur_slot[entry] = boa__hcs_set_slot(hcs, slot_ix);
 
@@ -795,19 +1369,26 @@ boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_
 	return result;
 }
 
-// Inline implementation of `boa_map_find()`, wrap in a specialized function for better map performance
 boa_forceinline void *
-boa_map_find_inline(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+boa__map_find_geometry_impl(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash,
+	uint32_t block_entries, uint32_t entry_size)
 {
 	// Edge case: Rest of the boa_map struct can be invalid when empty
 	if (map->count == 0) return NULL;
 
 	hash = boa__map_hash_canonicalize(hash);
 
+	// Reject most missing keys without touching the blocks
+	if (map->impl.filter && !boa_filter_test(map->impl.filter, hash)) return NULL;
+
+	boa_assert(!block_entries || block_entries == map->impl.block_num_entries);
+	uint32_t block_num_entries = block_entries ? block_entries : map->impl.block_num_entries;
+	uint32_t entry_stride = entry_size ? entry_size : map->entry_size;
+
 	// Calculate block and slot indices from the hash
 	uint32_t block_mask = map->impl.num_hash_blocks - 1;
 	uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
-	uint32_t block_num_slots = boa__map_block_num_slots(map);
+	uint32_t block_num_slots = block_num_entries << 1;
 	uint32_t slot_mask = block_num_slots - 1;
 
 	do {
@@ -815,15 +1396,40 @@ boa_map_find_inline(const boa_map *map, const void *key_ptr, uint32_t hash, boa_
 		uint16_t *entry_slot = map->impl.entry_slot + block_ix * block_num_slots;
 		uint32_t scan = 0;
 
+#if BOA__MAP_GROUP_SLOTS > 1
+		for (;;) {
+			uint32_t num, match;
+			int end = boa__map_scan_group(entry_slot, slot_ix, scan, hash, block_num_slots, &num, &match);
+
+			// Compare only the slots that match `LOWMASK` bits of the hash
+			while (match) {
+				uint32_t es = entry_slot[slot_ix + (boa_lowest_bit(match) >> 1)];
+				match &= match - 1;
+
+				uint32_t entry_offset = boa__es_entry_offset(es);
+				uint32_t entry_index = block_ix * block_num_entries + entry_offset;
+				void *entry = boa__map_geometry_entry(map, entry_index, entry_stride);
+				if (boa__map_hcs_match(map, entry_index, hash, full_hash) && cmp(key_ptr, entry, user)) {
+					return entry;
+				}
+			}
+
+			// If we find an empty slot or one with lower scan fail find
+			if (end) break;
+
+			slot_ix = (slot_ix + num) & slot_mask;
+			scan += num;
+		}
+#else
 		for (;;) {
 			uint32_t es = entry_slot[slot_ix];
 
 			// Match `LOWMASK` bits of the hash to the element-slot value
 			if (((es ^ hash) & BOA__MAP_LOWMASK) == 0) {
 				uint32_t entry_offset = boa__es_entry_offset(es);
-				uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, entry_offset);
-				void *entry = boa__map_entry_from_index(map, entry_index);
-				if (cmp(key_ptr, entry, user)) {
+				uint32_t entry_index = block_ix * block_num_entries + entry_offset;
+				void *entry = boa__map_geometry_entry(map, entry_index, entry_stride);
+				if (boa__map_hcs_match(map, entry_index, hash, full_hash) && cmp(key_ptr, entry, user)) {
 					return entry;
 				}
 			}
@@ -837,45 +1443,565 @@ boa_map_find_inline(const boa_map *map, const void *key_ptr, uint32_t hash, boa_
 			slot_ix = (slot_ix + 1) & slot_mask;
 			scan++;
 		}
+#endif
 
 		block_ix = map->impl.blocks[block_ix].next_aux;
 	} while (block_ix != 0);
 
+	// The entry may not have been migrated yet
+	if (map->impl.rehash) {
+		return boa__map_rehash_find(map, key_ptr, hash, cmp, user, full_hash);
+	}
+
 	return NULL;
 }
 
-#define boa_map_for(type, name, map) for ( \
-	type *name##__end, *name = (type*)boa__map_begin_for(map, (void**)&name##__end); name; \
-	name = (name + 1 != name##__end ? name + 1 : (type*)boa__map_advance_for_block(map, name, (void**)&name##__end)))
-
-// Blit map: Bitwise hash and compare key
-boa_noinline boa_map_insert_result boa_blit_map_insert(boa_map *map, const void *key_ptr, uint32_t key_size);
-boa_noinline void *boa_blit_map_find(const boa_map *map, const void *key_ptr, uint32_t key_size);
+boa_forceinline boa_map_insert_result
+boa__map_insert_impl(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash)
+{
+	return boa__map_insert_geometry_impl(map, key_ptr, hash, cmp, user, full_hash, 0, 0);
+}
 
-// Pointer map
-boa_noinline boa_map_insert_result boa_ptr_map_insert(boa_map *map, const void *key);
-boa_noinline void *boa_ptr_map_find(const boa_map *map, const void *key);
+boa_forceinline void *
+boa__map_find_impl(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash)
+{
+	return boa__map_find_geometry_impl(map, key_ptr, hash, cmp, user, full_hash, 0, 0);
+}
 
-// uint32_t map
-boa_noinline boa_map_insert_result boa_u32_map_insert(boa_map *map, uint32_t key);
-boa_noinline void *boa_u32_map_find(const boa_map *map, uint32_t key);
+// Inline implementation of `boa_map_insert()`, wrap in a specialized function for better map performance
+boa_forceinline boa_map_insert_result
+boa_map_insert_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa__map_insert_impl(map, key_ptr, hash, cmp, user, 0);
+}
 
-// -- boa_heap
+// Inline implementation of `boa_map_find()`, wrap in a specialized function for better map performance
+boa_forceinline void *
+boa_map_find_inline(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa__map_find_impl(map, key_ptr, hash, cmp, user, 0);
+}
 
-typedef int (*boa_before_fn)(const void *a, const void *b, void *user);
+// Full hash variants: Compare the full stored hash of a candidate entry before calling `cmp`.
+// Costs an extra load per candidate, but avoids most false calls to expensive `cmp` functions
+// and touching the entry memory. Mixing with the normal variants on the same map is fine.
+boa_forceinline boa_map_insert_result
+boa_map_insert_fullhash_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa__map_insert_impl(map, key_ptr, hash, cmp, user, 1);
+}
 
-boa_forceinline void boa_upheap_inline(void *values, uint32_t index, uint32_t size, boa_before_fn before, void *user)
+boa_forceinline void *
+boa_map_find_fullhash_inline(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
 {
-	char *data = (char*)values;
-	void *index_v = data + index * size;
-	while (index > 0) {
-		uint32_t parent = (index - 1) >> 1;
-		void *parent_v = data + parent * size;
-		if (before(index_v, parent_v, user)) {
-			boa_swap_inline(parent_v, index_v, size);
+	return boa__map_find_impl(map, key_ptr, hash, cmp, user, 1);
+}
 
-			index_v = parent_v;
-			index = parent;
+boa_noinline boa_map_insert_result boa_map_insert_fullhash(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+boa_noinline void *boa_map_find_fullhash(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+
+// Fixed geometry variants for maps set up with `boa_map_set_block_entries(map, block_entries)`:
+// Pass `block_entries` and the `entry_size` of the map as compile-time constants so that the
+// block and entry index arithmetic is folded to shifts and constant offsets. `full_hash`
+// selects between the normal and full hash variants and should also be a constant.
+boa_forceinline boa_map_insert_result
+boa_map_insert_geometry_inline(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user,
+	int full_hash, uint32_t block_entries, uint32_t entry_size)
+{
+	return boa__map_insert_geometry_impl(map, key_ptr, hash, cmp, user, full_hash, block_entries, entry_size);
+}
+
+boa_forceinline void *
+boa_map_find_geometry_inline(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user,
+	int full_hash, uint32_t block_entries, uint32_t entry_size)
+{
+	return boa__map_find_geometry_impl(map, key_ptr, hash, cmp, user, full_hash, block_entries, entry_size);
+}
+
+// Number of keys to prefetch at a time in batched finds
+#define BOA__MAP_BATCH_SIZE 16
+
+// Start loading the block headers and initial slots of `num` keys with `hashes`
+boa_forceinline void boa__map_prefetch_slots(const boa_map *map, const uint32_t *hashes, uint32_t num)
+{
+	// Edge case: Rest of the boa_map struct can be invalid when empty
+	if (map->count == 0) return;
+
+	uint32_t block_mask = map->impl.num_hash_blocks - 1;
+	uint32_t block_num_slots = boa__map_block_num_slots(map);
+	uint32_t slot_mask = block_num_slots - 1;
+	uint32_t i;
+	for (i = 0; i < num; i++) {
+		uint32_t hash = boa__map_hash_canonicalize(hashes[i]);
+		uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
+		boa_prefetch(&map->impl.blocks[block_ix]);
+		boa_prefetch(map->impl.entry_slot + block_ix * block_num_slots + (hash & slot_mask));
+	}
+}
+
+boa_forceinline void
+boa__map_find_batch_impl(const boa_map *map, void **entries, const void *keys, uint32_t key_stride,
+	const uint32_t *hashes, uint32_t count, boa_map_cmp_fn cmp, void *user, int full_hash)
+{
+	uint32_t base, i;
+
+	// Edge case: Rest of the boa_map struct can be invalid when empty
+	if (map->count == 0) {
+		for (i = 0; i < count; i++) entries[i] = NULL;
+		return;
+	}
+
+	uint32_t block_mask = map->impl.num_hash_blocks - 1;
+	uint32_t block_num_slots = boa__map_block_num_slots(map);
+	uint32_t slot_mask = block_num_slots - 1;
+
+	for (base = 0; base < count; base += BOA__MAP_BATCH_SIZE) {
+		uint32_t num = count - base;
+		if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+		const uint32_t *batch_hashes = hashes + base;
+		const char *batch_keys = (const char*)keys + base * key_stride;
+
+		// Keys rejected by the filter skip loading the blocks, bit `i` is set if key `i` passed
+		uint32_t pass = (1u << num) - 1;
+		if (map->impl.filter) {
+			uint32_t pass_hashes[BOA__MAP_BATCH_SIZE], num_pass = 0;
+			for (i = 0; i < num; i++) {
+				boa__filter_prefetch(map->impl.filter, boa__map_hash_canonicalize(batch_hashes[i]));
+			}
+			for (i = 0; i < num; i++) {
+				if (boa_filter_test(map->impl.filter, boa__map_hash_canonicalize(batch_hashes[i]))) {
+					pass_hashes[num_pass++] = batch_hashes[i];
+				} else {
+					pass &= ~(1u << i);
+				}
+			}
+			boa__map_prefetch_slots(map, pass_hashes, num_pass);
+		} else {
+			boa__map_prefetch_slots(map, batch_hashes, num);
+		}
+
+		// Start loading the entries at the initial slots, usually the ones we're looking for
+		for (i = 0; i < num; i++) {
+			if (!(pass & (1u << i))) continue;
+			uint32_t hash = boa__map_hash_canonicalize(batch_hashes[i]);
+			uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
+			uint32_t es = map->impl.entry_slot[block_ix * block_num_slots + (hash & slot_mask)];
+			if (((es ^ hash) & BOA__MAP_LOWMASK) == 0) {
+				uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, boa__es_entry_offset(es));
+				boa_prefetch(boa__map_entry_from_index(map, entry_index));
+			}
+		}
+
+		for (i = 0; i < num; i++) {
+			const void *key = batch_keys + i * key_stride;
+			if (pass & (1u << i)) {
+				entries[base + i] = boa__map_find_impl(map, key, batch_hashes[i], cmp, user, full_hash);
+			} else {
+				entries[base + i] = NULL;
+			}
+		}
+	}
+}
+
+// Inline implementation of `boa_map_find_batch()`
+boa_forceinline void
+boa_map_find_batch_inline(const boa_map *map, void **entries, const void *keys, uint32_t key_stride,
+	const uint32_t *hashes, uint32_t count, boa_map_cmp_fn cmp, void *user)
+{
+	boa__map_find_batch_impl(map, entries, keys, key_stride, hashes, count, cmp, user, 0);
+}
+
+// Find `count` keys from the map at once. `keys` are read `key_stride` bytes apart with
+// `hashes` containing the hash of each key. The found entry or NULL is written to `entries`.
+// Memory accesses of multiple keys are overlapped, which is faster than calling
+// `boa_map_find()` in a loop especially for maps that don't fit in the cache.
+boa_noinline void boa_map_find_batch(const boa_map *map, void **entries, const void *keys, uint32_t key_stride,
+	const uint32_t *hashes, uint32_t count, boa_map_cmp_fn cmp, void *user);
+
+#define boa_map_for(type, name, map) for ( \
+	type *name##__end, *name = (type*)boa__map_begin_for(map, (void**)&name##__end); name; \
+	name = (name + 1 != name##__end ? name + 1 : (type*)boa__map_advance_for_block(map, name, (void**)&name##__end)))
+
+// Specialized maps: The `_build()` functions take entries that begin with the key
+
+// Blit map: Bitwise hash and compare key
+boa_noinline boa_map_insert_result boa_blit_map_insert(boa_map *map, const void *key_ptr, uint32_t key_size);
+boa_noinline void *boa_blit_map_find(const boa_map *map, const void *key_ptr, uint32_t key_size);
+boa_noinline void boa_blit_map_find_batch(const boa_map *map, void **entries, const void *keys, uint32_t key_size, uint32_t count);
+boa_noinline int boa_blit_map_build(boa_map *map, const void *entries, uint32_t key_size, uint32_t count);
+
+// Fixed size blit maps: Same as `boa_blit_map_*()` with a constant `key_size`
+boa_noinline boa_map_insert_result boa_blit4_map_insert(boa_map *map, const void *key_ptr);
+boa_noinline void *boa_blit4_map_find(const boa_map *map, const void *key_ptr);
+boa_noinline boa_map_insert_result boa_blit8_map_insert(boa_map *map, const void *key_ptr);
+boa_noinline void *boa_blit8_map_find(const boa_map *map, const void *key_ptr);
+boa_noinline boa_map_insert_result boa_blit12_map_insert(boa_map *map, const void *key_ptr);
+boa_noinline void *boa_blit12_map_find(const boa_map *map, const void *key_ptr);
+boa_noinline boa_map_insert_result boa_blit16_map_insert(boa_map *map, const void *key_ptr);
+boa_noinline void *boa_blit16_map_find(const boa_map *map, const void *key_ptr);
+
+// Pointer map
+boa_noinline boa_map_insert_result boa_ptr_map_insert(boa_map *map, const void *key);
+boa_noinline void *boa_ptr_map_find(const boa_map *map, const void *key);
+boa_noinline void boa_ptr_map_find_batch(const boa_map *map, void **entries, const void *const *keys, uint32_t count);
+boa_noinline int boa_ptr_map_build(boa_map *map, const void *entries, uint32_t count);
+
+// uint32_t map
+boa_noinline boa_map_insert_result boa_u32_map_insert(boa_map *map, uint32_t key);
+boa_noinline void *boa_u32_map_find(const boa_map *map, uint32_t key);
+boa_noinline void boa_u32_map_find_batch(const boa_map *map, void **entries, const uint32_t *keys, uint32_t count);
+boa_noinline int boa_u32_map_build(boa_map *map, const void *entries, uint32_t count);
+
+/*
+	-- boa_frozen_map: Read-only map with perfect hashing.
+	Built once from a `boa_map` using the stored hashes of the entries. The distinct hashes
+	are placed into a table without collisions using "hash and displace": hashes are split
+	into small buckets and each bucket has a 16-bit pilot value that offsets the slots of its
+	hashes so that they don't collide with the other buckets. A find reads the pilot of the
+	bucket, the slot and compares only the entries with the exact same hash, which are
+	stored densely in slot order. Keys with colliding 32-bit hashes are still supported as
+	all the entries with the same hash share a slot.
+*/
+
+typedef struct boa__frozen_slot {
+	uint32_t hash;  // < Canonicalized hash of the entries of the slot, 0 if empty
+	uint32_t begin; // < Index of the first entry, the entries end at the next slot's `begin`
+} boa__frozen_slot;
+
+typedef struct boa_frozen_map {
+	boa_allocator *ator;     // < Allocator to use
+	uint32_t entry_size;     // < Size of an entry in bytes
+	uint32_t count;          // < Number of entries in the map
+
+	uint32_t num_buckets;    // < Number of pilot values
+	uint32_t num_slots;      // < Number of slots, `slots` has an extra one at the end
+	uint32_t seed;           // < Seed that allowed placing all the buckets
+	uint32_t hash_seed;      // < Copy of the seed of `boa_blit_map_*()` functions
+
+	uint16_t *pilots;        // < Slot offset for each bucket
+	boa__frozen_slot *slots; // < Entry ranges of each slot
+	void *entries;           // < `count` entries densely packed in slot order
+	void *data;              // < Allocation root
+} boa_frozen_map;
+
+// Build `frozen` with copies of all the entries of `map` using `ator` for allocations.
+// `map` is not modified. Returns 0 if out of memory or if placement failed, which is
+// practically impossible for reasonable hashes.
+int boa_map_freeze(boa_frozen_map *frozen, const boa_map *map, boa_allocator *ator);
+
+// Free the memory of the map.
+void boa_frozen_map_reset(boa_frozen_map *map);
+
+#define boa__frozen_bucket_hash(hash, seed) boa__filter_mix((hash) ^ (seed))
+#define boa__frozen_slot_hash(hash, seed) boa__filter_mix((hash) * 0x9e3779b1u + (seed))
+#define boa__frozen_pilot_hash(pilot) boa__filter_mix((pilot) * 0x85ebca6bu + 0xc2b2ae35u)
+#define boa__frozen_range(hash, num) (uint32_t)(((uint64_t)(hash) * (num)) >> 32)
+
+// Slot of a hash with `slot_hash` displaced by `pilot`
+#define boa__frozen_slot_index(slot_hash, pilot, num_slots) \
+	boa__frozen_range((slot_hash) ^ boa__frozen_pilot_hash(pilot), num_slots)
+
+// Inline implementation of `boa_frozen_map_find()`
+boa_forceinline void *
+boa_frozen_map_find_inline(const boa_frozen_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	if (map->count == 0) return NULL;
+
+	hash = boa__map_hash_canonicalize(hash);
+	uint32_t bucket = boa__frozen_range(boa__frozen_bucket_hash(hash, map->seed), map->num_buckets);
+	uint32_t slot_hash = boa__frozen_slot_hash(hash, map->seed);
+	const boa__frozen_slot *slot = map->slots + boa__frozen_slot_index(slot_hash, map->pilots[bucket], map->num_slots);
+	if (slot->hash != hash) return NULL;
+
+	uint32_t ix, end = slot[1].begin;
+	for (ix = slot->begin; ix < end; ix++) {
+		void *entry = (char*)map->entries + (size_t)ix * map->entry_size;
+		if (cmp(key_ptr, entry, user)) return entry;
+	}
+	return NULL;
+}
+
+// Find a value from the map, `hash` and `cmp` must be the same as used with the `boa_map`.
+boa_noinline void *boa_frozen_map_find(const boa_frozen_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+
+// Specialized finds for maps built with the matching `boa_*_map_insert()` functions
+boa_noinline void *boa_blit_frozen_map_find(const boa_frozen_map *map, const void *key_ptr, uint32_t key_size);
+boa_noinline void *boa_ptr_frozen_map_find(const boa_frozen_map *map, const void *key);
+boa_noinline void *boa_u32_frozen_map_find(const boa_frozen_map *map, uint32_t key);
+
+/*
+	-- boa_sync_map: Thread-safe hash container.
+	The entries are split into shards that are independent boa_maps each protected by its
+	own spinlock. Threads working on different keys rarely contend for the same shard and
+	a full shard grows without blocking the other ones. The entries are copied in and out
+	of the map as pointers to them are not stable after the shard is unlocked. If the map
+	uses a custom allocator it needs to be thread-safe.
+*/
+
+#define BOA_SYNC_MAP_DEFAULT_SHARDS 64
+
+typedef struct boa__sync_map_shard {
+	boa_spinlock lock;
+	boa_map map;
+	char pad[64]; // < Keep the locks of adjacent shards on separate cache lines
+} boa__sync_map_shard;
+
+typedef struct boa_sync_map {
+	boa_allocator *ator;   // < Allocator to use
+	uint32_t entry_size;   // < Size of an entry in bytes
+	uint32_t num_shards;   // < Number of shards, power of two
+	boa__sync_map_shard *shards;
+} boa_sync_map;
+
+// Called with the shard locked, `entry` is uninitialized if `inserted` is set
+typedef void (*boa_sync_map_update_fn)(void *entry, int inserted, void *user);
+
+// Initialize `map` with `num_shards` (rounded to a power of two, 0 for the default).
+// Returns 0 if out of memory.
+int boa_sync_map_init(boa_sync_map *map, size_t entry_size, uint32_t num_shards, boa_allocator *ator);
+
+// Free all the memory of the map, must not be used concurrently.
+void boa_sync_map_reset(boa_sync_map *map);
+
+// Reserve `capacity` entries in total spread evenly over the shards.
+int boa_sync_map_reserve(boa_sync_map *map, uint32_t capacity);
+
+// Insert a copy of `entry` if `key_ptr` doesn't exist in the map.
+// Returns 1 if inserted, 0 if the key exists and -1 if out of memory.
+int boa_sync_map_insert(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, const void *entry);
+
+// Find or insert `key_ptr` and call `fn` on the entry while the shard is locked.
+// Returns 0 if out of memory.
+int boa_sync_map_update(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user,
+	boa_sync_map_update_fn fn, void *fn_user);
+
+// Copy the entry matching `key_ptr` to `entry_out` (optional). Returns 1 if found.
+int boa_sync_map_find(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, void *entry_out);
+
+// Remove the entry matching `key_ptr` copying it to `entry_out` (optional). Returns 1 if found.
+int boa_sync_map_remove(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, void *entry_out);
+
+// Number of entries in the map, only a snapshot if the map is modified concurrently.
+uint32_t boa_sync_map_count(boa_sync_map *map);
+
+/*
+	-- boa_cow_map: Versioned hash container for lock-free readers.
+	A single writer modifies the map while any number of readers look up entries from
+	a consistent version without locking. The blocks of the map are allocated separately
+	and shared between versions: The first write to a block after a publish copies the
+	block metadata, `entry_slot` row and entries and the writer publishes a new root of
+	block pointers atomically. Readers pin the latest version with an epoch counter in a
+	reader slot and memory of old versions is reclaimed once no reader can still see it.
+	The blocks never overflow to auxilary blocks, a full block grows the whole table.
+	Because of this inserting fails if more than `BOA_COW_MAP_BLOCK_ENTRIES` keys have
+	hashes that only differ in the low `BOA__MAP_BLOCK_SHIFT` bits.
+*/
+
+#define BOA_COW_MAP_BLOCK_ENTRIES BOA__MAP_BLOCK_MAX_ENTRIES
+
+typedef struct boa__cow_block {
+	boa_map map;      // < Single block map over the rest of the allocation
+	uint32_t version; // < Version that allocated the block, writable if it's the working version
+} boa__cow_block;
+
+typedef struct boa_cow_version {
+	uint32_t version;         // < Epoch number, incremented by one for each publish
+	uint32_t count;           // < Number of entries in the version
+	uint32_t num_blocks;      // < Number of blocks, power of two or zero if empty
+	boa__cow_block **blocks;  // < Blocks indexed by the high bits of the hash
+} boa_cow_version;
+
+typedef struct boa_cow_reader {
+	volatile uint32_t pinned; // < Pinned epoch, zero if the reader is not pinned
+	char pad[60];             // < Keep the slots of different readers on separate cache lines
+} boa_cow_reader;
+
+typedef struct boa__cow_retired {
+	void *ptr;        // < Block or version allocation
+	uint32_t version; // < Last version that can refer to `ptr`
+} boa__cow_retired;
+
+typedef struct boa_cow_map {
+	boa_allocator *ator;  // < Allocator to use
+	uint32_t entry_size;  // < Size of an entry in bytes
+	uint32_t num_readers; // < Number of reader slots
+	uint32_t block_size;  // < Size of a block allocation in bytes
+
+	boa_cow_reader *readers;              // < Reader slots indexed by the user
+	boa_cow_version *volatile published;  // < Latest published version
+	volatile uint32_t published_version;  // < Epoch of `published`, stored after it
+	boa_cow_version *working;             // < Unpublished version of the writer, NULL if unmodified
+	boa_buf retired;                      // < Array of `boa__cow_retired` waiting for readers
+} boa_cow_map;
+
+// Initialize `map` for `num_readers` (at least one) concurrent readers. Returns 0 if out of memory.
+int boa_cow_map_init(boa_cow_map *map, size_t entry_size, uint32_t num_readers, boa_allocator *ator);
+
+// Free all the memory of the map, must not be used concurrently.
+void boa_cow_map_reset(boa_cow_map *map);
+
+// Writer: Find or insert `key_ptr` to the working version. The entry is writable until
+// the next publish, inserted entries need to be initialized by the caller.
+// Returns a NULL entry if out of memory or the block of `hash` is full of colliding hashes.
+boa_noinline boa_map_insert_result boa_cow_map_insert(boa_cow_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+
+// Writer: Remove the entry matching `key_ptr` from the working version.
+// Returns 1 if removed, 0 if not found and -1 if out of memory.
+int boa_cow_map_remove(boa_cow_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+
+// Writer: Make the changes visible to readers that pin after this call and free the
+// memory of versions no reader has pinned anymore.
+void boa_cow_map_publish(boa_cow_map *map);
+
+// Writer: Free the memory of old versions that are not pinned anymore.
+void boa_cow_map_collect(boa_cow_map *map);
+
+// Writer: Version containing the unpublished changes, don't retain over modifications.
+boa_forceinline const boa_cow_version *boa_cow_map_current(const boa_cow_map *map) {
+	return map->working ? map->working : map->published;
+}
+
+// Reader: Pin the latest published version to reader slot `reader`. The version stays
+// valid until `boa_cow_map_unpin()`, each slot must be used by one thread at a time.
+boa_forceinline const boa_cow_version *boa_cow_map_pin(boa_cow_map *map, uint32_t reader)
+{
+	boa_assert(reader < map->num_readers);
+
+	// Everything reachable from versions newer than the pinned epoch is kept alive
+	// so the pointer can be loaded after pinning even if more versions were published
+	uint32_t epoch = boa_atomic_load_u32(&map->published_version);
+	boa_atomic_store_u32(&map->readers[reader].pinned, epoch);
+	return (const boa_cow_version*)boa_atomic_load_ptr((void *const volatile*)&map->published);
+}
+
+// Reader: Release the version pinned to `reader`.
+boa_forceinline void boa_cow_map_unpin(boa_cow_map *map, uint32_t reader) {
+	boa_atomic_store_u32(&map->readers[reader].pinned, 0);
+}
+
+// Find an entry from a pinned or current version.
+boa_forceinline void *
+boa_cow_version_find(const boa_cow_version *version, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	if (version->count == 0) return NULL;
+	uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & (version->num_blocks - 1);
+	return boa__map_find_impl(&version->blocks[block_ix]->map, key_ptr, hash, cmp, user, 0);
+}
+
+/*
+	-- boa_agg: Hash aggregation (group-by).
+	Rows are grouped by a key of `key_size` bytes at the start of the row. Each group keeps
+	the count, sum, min and max of an optional `double` value in the row and an optional user
+	state updated by callbacks. The groups are entries of a blit map `map` laid out as the
+	key, `boa_agg_stats` and the user state. Partial aggregates, eg. one per thread, with the
+	same options can be merged together.
+*/
+
+// Fold `row` into the user `state` of its group, `state` is zeroed for new groups
+typedef void (*boa_agg_update_fn)(void *state, const void *row, void *user);
+
+// Merge the user state `src` of a group in a partial aggregate into `dst`
+typedef void (*boa_agg_merge_fn)(void *dst, const void *src, void *user);
+
+#define BOA_AGG_NO_VALUE (~0u)
+
+typedef struct boa_agg_opts {
+	uint32_t key_size;            // < Size of the key at the start of the row in bytes
+	uint32_t row_size;            // < Stride of the rows in `boa_agg_add_batch()`
+	uint32_t value_offset;        // < Offset of a `double` in the row or BOA_AGG_NO_VALUE
+	uint32_t state_size;          // < Size of the user state of each group
+	boa_agg_update_fn update_fn;  // < Optional
+	boa_agg_merge_fn merge_fn;    // < Required for merging if `state_size > 0`
+	void *user;                   // < Passed to the callbacks
+} boa_agg_opts;
+
+typedef struct boa_agg_stats {
+	uint64_t count; // < Number of rows in the group
+	double sum;     // < Sum of the values, 0 if BOA_AGG_NO_VALUE
+	double min;     // < Smallest value, 0 if BOA_AGG_NO_VALUE
+	double max;     // < Largest value, 0 if BOA_AGG_NO_VALUE
+} boa_agg_stats;
+
+typedef struct boa_agg {
+	boa_map map;           // < Groups, use `boa_blit_map_find()` or iterate directly
+	boa_agg_opts opts;
+	uint32_t stats_offset; // < Offset of `boa_agg_stats` in a group
+	uint32_t state_offset; // < Offset of the user state in a group
+} boa_agg;
+
+void boa_agg_init(boa_agg *agg, const boa_agg_opts *opts, boa_allocator *ator);
+void boa_agg_reset(boa_agg *agg);
+
+// Aggregate a single row. Returns the group or NULL if out of memory.
+boa_noinline void *boa_agg_add(boa_agg *agg, const void *row);
+
+// Aggregate `count` rows `opts.row_size` bytes apart overlapping the memory accesses of
+// multiple rows. Returns 0 if out of memory.
+int boa_agg_add_batch(boa_agg *agg, const void *rows, uint32_t count);
+
+// Merge the groups of the partial aggregate `src` into `agg`. Returns 0 if out of memory.
+int boa_agg_merge(boa_agg *agg, const boa_agg *src);
+
+// Find the group of `key`, NULL if there are no rows with the key
+boa_noinline void *boa_agg_find(const boa_agg *agg, const void *key);
+
+boa_forceinline boa_agg_stats *boa_agg_group_stats(const boa_agg *agg, void *group) {
+	return (boa_agg_stats*)((char*)group + agg->stats_offset);
+}
+
+boa_forceinline void *boa_agg_group_state(const boa_agg *agg, void *group) {
+	return (char*)group + agg->state_offset;
+}
+
+/*
+	-- boa_join: Build/probe hash join.
+	Joins two arrays of rows that begin with a key of `key_size` bytes compared bitwise.
+	The build rows are inserted into a boa_map and the probe rows are looked up in batches
+	prefetching the rows and map blocks ahead. Large inputs are first radix partitioned by
+	hash so that the map of each partition fits in the cache.
+*/
+
+typedef struct boa_join_pair {
+	uint32_t build_index; // < Index of the row in the build input
+	uint32_t probe_index; // < Index of the row in the probe input
+} boa_join_pair;
+
+// Pick the number of partitions based on the size of the build input
+#define BOA_JOIN_AUTO_RADIX 0
+
+// Don't partition the inputs
+#define BOA_JOIN_NO_PARTITIONS (~0u)
+
+typedef struct boa_join_opts {
+	uint32_t key_size;     // < Size of the key at the start of the rows in bytes
+	uint32_t build_stride; // < Distance between the build rows in bytes
+	uint32_t probe_stride; // < Distance between the probe rows in bytes
+	uint32_t radix_bits;   // < Partition to `1 << radix_bits` parts, or one of the above
+	boa_allocator *ator;   // < Allocator for temporary memory
+} boa_join_opts;
+
+// Append a `boa_join_pair` to `out` for every pair of build and probe rows with equal keys.
+// The pairs are grouped by partition instead of being in probe order.
+// Returns 0 if out of memory, `out` may contain some of the pairs in that case.
+int boa_hash_join(boa_buf *out, const void *build, uint32_t build_count,
+	const void *probe, uint32_t probe_count, const boa_join_opts *opts);
+
+// -- boa_heap
+
+typedef int (*boa_before_fn)(const void *a, const void *b, void *user);
+
+boa_forceinline void boa_upheap_inline(void *values, uint32_t index, uint32_t size, boa_before_fn before, void *user)
+{
+	char *data = (char*)values;
+	void *index_v = data + index * size;
+	while (index > 0) {
+		uint32_t parent = (index - 1) >> 1;
+		void *parent_v = data + parent * size;
+		if (before(index_v, parent_v, user)) {
+			boa_swap_inline(parent_v, index_v, size);
+
+			index_v = parent_v;
+			index = parent;
 		} else {
 			break;
 		}
@@ -991,4 +2117,766 @@ void boa_arena_reset(boa_arena *arena);
 #define boa_arena_push(type, arena) (type*)boa_arena_push_size((arena), sizeof(type), boa_alignof(type))
 #define boa_arena_push_n(type, arena, n) (type*)boa_arena_push_size((arena), sizeof(type) * (n), boa_alignof(type))
 
+/*
+	-- boa_str_map: Hash container with string keys.
+	The key bytes are copied to an arena owned by the map and the entries begin with a
+	`boa_str_key` that points to them with the length and full hash of the key inline.
+	The underlying `boa_map` compares the full hashes so only keys with the same hash
+	are compared by length and bytes. Finds take a pointer and length and don't allocate.
+	Removed keys keep their bytes in the arena until the map is cleared or reset.
+*/
+
+typedef struct boa_str_key {
+	const char *data; // < Zero-terminated key bytes in the arena of the map
+	uint32_t length;  // < Length of the key in bytes without the terminator
+	uint32_t hash;    // < Full hash of the key
+} boa_str_key;
+
+typedef struct boa_str_map {
+	boa_map map;     // < Entries that begin with a `boa_str_key`
+	boa_arena arena; // < Storage for the key bytes
+} boa_str_map;
+
+// Initialize `map` to hold entries of size `entry_size` that begin with a `boa_str_key`
+// using `ator` for allocations.
+boa_inline void boa_str_map_init(boa_str_map *map, size_t entry_size, boa_allocator *ator) {
+	boa_assert(entry_size >= sizeof(boa_str_key));
+	boa_map_init_ator(&map->map, entry_size, ator);
+	boa_arena_init_ator(&map->arena, ator);
+}
+
+// Free all the memory of the map.
+void boa_str_map_reset(boa_str_map *map);
+
+// Remove all the entries and free the key bytes, keeps the table allocated.
+void boa_str_map_clear(boa_str_map *map);
+
+// Hash of the key of `length` bytes at `data` as stored in `boa_str_key`
+boa_forceinline uint32_t boa_str_map_hash(const boa_str_map *map, const char *data, uint32_t length) {
+	uint64_t hash = boa_hash_bytes(data, length, map->map.impl.hash_seed);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+boa_inline int boa__str_map_cmp(const void *a, const void *b, void *user) {
+	const boa_str_key *ka = (const boa_str_key*)a, *kb = (const boa_str_key*)b;
+	return ka->length == kb->length && ka->hash == kb->hash && !memcmp(ka->data, kb->data, ka->length);
+}
+
+// Inline implementation of `boa_str_map_find()`
+boa_forceinline void *
+boa_str_map_find_inline(const boa_str_map *map, const char *data, uint32_t length)
+{
+	boa_str_key key;
+	key.data = data;
+	key.length = length;
+	key.hash = boa_str_map_hash(map, data, length);
+	return boa_map_find_fullhash_inline(&map->map, &key, key.hash, &boa__str_map_cmp, NULL);
+}
+
+// Find or insert `length` bytes at `data` as a key. Sets the `boa_str_key` of inserted
+// entries to point to a copy of the key, the rest of the entry is uninitialized.
+// Returns a NULL entry if out of memory.
+boa_noinline boa_map_insert_result boa_str_map_insert(boa_str_map *map, const char *data, uint32_t length);
+
+// Find the entry with the key of `length` bytes at `data`, NULL if not found.
+boa_noinline void *boa_str_map_find(const boa_str_map *map, const char *data, uint32_t length);
+
+// Remove `entry` returned by `boa_str_map_insert()` or `boa_str_map_find()`
+boa_inline void boa_str_map_remove(boa_str_map *map, void *entry) {
+	boa_map_remove(&map->map, entry);
+}
+
+#define boa_str_map_insert_cstr(map, str) boa_str_map_insert((map), (str), (uint32_t)strlen(str))
+#define boa_str_map_find_cstr(map, str) boa_str_map_find((map), (str), (uint32_t)strlen(str))
+
+/*
+	-- boa_intern: String interning table.
+	Maps byte strings to dense `uint32_t` IDs assigned in order of first insertion and
+	back. Each string is stored once in a `boa_str_map` and `strings` holds the key of
+	each ID so resolving an ID is a single array lookup. IDs are never reused so they can
+	be used as keys for `boa_u32_map_*()` or indices to arrays instead of the strings.
+	In thread-safe mode all the operations take a spinlock. The returned string pointers
+	stay valid until the table is reset.
+*/
+
+#define BOA_INTERN_INVALID_ID ((uint32_t)~0u)
+
+typedef struct boa__intern_entry {
+	boa_str_key key;
+	uint32_t id;
+} boa__intern_entry;
+
+typedef struct boa_intern {
+	boa_str_map map;    // < Entries of `boa__intern_entry`
+	boa_buf strings;    // < `boa_str_key` of each ID
+	boa_spinlock lock;  // < Taken by all the operations if `thread_safe` is set
+	int thread_safe;    // < Allow using the table from multiple threads
+} boa_intern;
+
+// Initialize `intern` using `ator` for allocations, which needs to be thread-safe if
+// `thread_safe` is set.
+void boa_intern_init(boa_intern *intern, int thread_safe, boa_allocator *ator);
+
+// Free all the memory of the table, must not be used concurrently.
+void boa_intern_reset(boa_intern *intern);
+
+// ID of the string of `length` bytes at `data`, interning it if necessary.
+// Returns `BOA_INTERN_INVALID_ID` if out of memory.
+uint32_t boa_intern_str(boa_intern *intern, const char *data, uint32_t length);
+
+// ID of an already interned string, `BOA_INTERN_INVALID_ID` if the string is not interned.
+uint32_t boa_intern_find(boa_intern *intern, const char *data, uint32_t length);
+
+// Intern `count` strings writing their IDs to `ids` holding the lock only once.
+// `lengths` is optional for zero-terminated `strings`. Returns 0 if out of memory,
+// the IDs of the strings that couldn't be interned are `BOA_INTERN_INVALID_ID`.
+int boa_intern_bulk(boa_intern *intern, uint32_t *ids, const char *const *strings, const uint32_t *lengths, uint32_t count);
+
+#define boa_intern_cstr(intern, str) boa_intern_str((intern), (str), (uint32_t)strlen(str))
+#define boa_intern_find_cstr(intern, str) boa_intern_find((intern), (str), (uint32_t)strlen(str))
+
+// Number of interned strings, IDs are in the range [0, count)
+boa_inline uint32_t boa_intern_count(boa_intern *intern) {
+	if (intern->thread_safe) boa_spinlock_lock(&intern->lock);
+	uint32_t count = (uint32_t)boa_count(boa_str_key, &intern->strings);
+	if (intern->thread_safe) boa_spinlock_unlock(&intern->lock);
+	return count;
+}
+
+// Zero-terminated string of `id` writing its length without the terminator to `length`
+// (optional). `id` must have been returned by this table.
+boa_inline const char *boa_intern_get(boa_intern *intern, uint32_t id, uint32_t *length) {
+	if (intern->thread_safe) boa_spinlock_lock(&intern->lock);
+	boa_assert(id < boa_count(boa_str_key, &intern->strings));
+	boa_str_key key = boa_begin(boa_str_key, &intern->strings)[id];
+	if (intern->thread_safe) boa_spinlock_unlock(&intern->lock);
+	if (length) *length = key.length;
+	return key.data;
+}
+
+/*
+	-- boa_btree: Ordered map.
+	B+tree storing entries of `entry_size` bytes in leaf nodes sorted by key. Nodes are
+	laid out to fit in `node_size` bytes so pick a multiple of the cache line size for
+	in-memory trees or the page size for large ones. Leaves are linked in key order so
+	iterating from `boa_btree_lower_bound()` visits a range of entries sequentially.
+	Trees with a `BOA_BTREE_KEY_U32`/`BOA_BTREE_KEY_U64` key layout keep the keys of
+	each node in a separate column that is searched with SIMD instead of calling
+	`cmp`, in these trees the entries must begin with the key. Removal doesn't merge
+	underfull nodes, only empty ones are freed. Insert and remove move the entries in
+	memory so pointers to entries are invalidated by any modification.
+*/
+
+#define BOA_BTREE_DEFAULT_NODE_SIZE 512
+
+// Key layouts: Keys compared only using `cmp` or unsigned integers at the start of the entry
+#define BOA_BTREE_KEY_ANY 0
+#define BOA_BTREE_KEY_U32 4
+#define BOA_BTREE_KEY_U64 8
+
+#define BOA__BTREE_MAX_HEIGHT 32
+
+// Padding in the key column for reading full vectors past the last key
+#define BOA__BTREE_KEY_PAD 8
+
+// Keys at most this far apart are searched linearly instead of bisecting
+#define BOA__BTREE_SCAN_KEYS 32
+
+// Return negative if `key` is less than the key of `entry`, zero if equal and positive if greater
+typedef int (*boa_btree_cmp_fn)(const void *key, const void *entry, void *user);
+
+typedef struct boa__btree_node {
+	uint32_t count;  // < Number of entries in leaves and separators in inner nodes
+	uint32_t leaf;   // < Non-zero for leaf nodes
+	struct boa__btree_node *prev, *next; // < Neighbor leaves in key order
+} boa__btree_node;
+
+typedef struct boa__btree_impl {
+	boa__btree_node *root;
+	uint32_t height;             // < Number of inner node levels
+	uint32_t key_type;           // < `BOA_BTREE_KEY_*`
+	uint32_t leaf_cap, inner_cap;
+	uint32_t leaf_size, inner_size;
+	uint32_t key_offset;         // < Offset of the key column in both kinds of nodes
+	uint32_t leaf_entry_offset;
+	uint32_t inner_entry_offset; // < Separators are copies of the first entry of the right subtree
+	uint32_t child_offset;
+} boa__btree_impl;
+
+typedef struct boa_btree {
+	boa_allocator *ator;
+	uint32_t entry_size;
+	uint32_t count;
+	boa__btree_impl impl;
+} boa_btree;
+
+typedef struct boa_btree_iterator {
+	void *entry;             // < NULL at the end of the tree
+	boa__btree_node *node;
+	uint32_t index;
+} boa_btree_iterator;
+
+// Path from the root to a leaf: Inner nodes and the index of the child taken from each
+typedef struct boa__btree_path {
+	boa__btree_node *nodes[BOA__BTREE_MAX_HEIGHT];
+	uint32_t indices[BOA__BTREE_MAX_HEIGHT];
+} boa__btree_path;
+
+// Initialize `tree` for entries of `entry_size` bytes compared using `key_type` layout
+// (`BOA_BTREE_KEY_*`) in nodes of about `node_size` bytes (0 for the default). Nodes
+// always fit at least four entries so they may exceed `node_size` for large entries.
+void boa_btree_init(boa_btree *tree, size_t entry_size, uint32_t key_type, uint32_t node_size, boa_allocator *ator);
+
+// Free all the memory of the tree, it can be used again afterwards.
+void boa_btree_reset(boa_btree *tree);
+
+// Replace the contents of the tree with `count` entries at `entries` that must be
+// sorted in strictly increasing key order. Packs the leaves full so following inserts
+// are likely to split nodes. Returns 0 and leaves the tree unchanged if out of memory.
+int boa_btree_build(boa_btree *tree, const void *entries, uint32_t count);
+
+boa_noinline boa_map_insert_result boa__btree_insert_split(boa_btree *tree, boa__btree_path *path,
+	boa__btree_node *leaf, uint32_t pos, const void *key_ptr);
+
+#define boa__btree_keys(tree, node) ((char*)(node) + (tree)->impl.key_offset)
+#define boa__btree_entry(tree, node, ix) ((char*)(node) + (tree)->impl.leaf_entry_offset + (size_t)(ix) * (tree)->entry_size)
+#define boa__btree_sep(tree, node, ix) ((char*)(node) + (tree)->impl.inner_entry_offset + (size_t)(ix) * (tree)->entry_size)
+#define boa__btree_children(tree, node) ((boa__btree_node**)((char*)(node) + (tree)->impl.child_offset))
+
+// Number of keys in the sorted column `keys` of `count` that are less than `key`
+boa_forceinline uint32_t boa__btree_rank_u32(const uint32_t *keys, uint32_t count, uint32_t key)
+{
+	uint32_t lo = 0, hi = count;
+	while (hi - lo > BOA__BTREE_SCAN_KEYS) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (keys[mid] < key) lo = mid + 1; else hi = mid;
+	}
+
+	// The keys less than `key` form a prefix so the first unset bit in the mask is the
+	// answer. Lanes past `hi` may be anything so clamp the result.
+#if BOA_AVX2
+	__m256i bias = _mm256_set1_epi32((int)0x80000000u);
+	__m256i k = _mm256_xor_si256(_mm256_set1_epi32((int)key), bias);
+	for (; lo < hi; lo += 8) {
+		__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + lo)), bias);
+		uint32_t less = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+		if (less != 0xff) return boa_min(lo + boa_lowest_bit(~less), hi);
+	}
+	return hi;
+#elif BOA_SSE2
+	__m128i bias = _mm_set1_epi32((int)0x80000000u);
+	__m128i k = _mm_xor_si128(_mm_set1_epi32((int)key), bias);
+	for (; lo < hi; lo += 4) {
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + lo)), bias);
+		uint32_t less = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k)));
+		if (less != 0xf) return boa_min(lo + boa_lowest_bit(~less), hi);
+	}
+	return hi;
+#else
+	while (lo < hi && keys[lo] < key) lo++;
+	return lo;
+#endif
+}
+
+// Number of keys in the sorted column `keys` of `count` that are less than `key`
+boa_forceinline uint32_t boa__btree_rank_u64(const uint64_t *keys, uint32_t count, uint64_t key)
+{
+	uint32_t lo = 0, hi = count;
+	while (hi - lo > BOA__BTREE_SCAN_KEYS) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (keys[mid] < key) lo = mid + 1; else hi = mid;
+	}
+
+	// SSE2 has no 64-bit compare so only AVX2 gets a vector loop
+#if BOA_AVX2
+	__m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+	__m256i k = _mm256_xor_si256(_mm256_set1_epi64x((long long)key), bias);
+	for (; lo < hi; lo += 4) {
+		__m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + lo)), bias);
+		uint32_t less = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+		if (less != 0xf) return boa_min(lo + boa_lowest_bit(~less), hi);
+	}
+	return hi;
+#else
+	while (lo < hi && keys[lo] < key) lo++;
+	return lo;
+#endif
+}
+
+// Number of the first `count` entries at `base` less than `key`, or less or equal if `upper`.
+// `key_type` selects between the key column of `node` and calling `cmp`.
+boa_forceinline uint32_t
+boa__btree_rank(const boa_btree *tree, const boa__btree_node *node, const char *base, const void *key_ptr,
+	boa_btree_cmp_fn cmp, void *user, uint32_t key_type, int upper)
+{
+	uint32_t count = node->count;
+	if (key_type == BOA_BTREE_KEY_U32) {
+		uint32_t key = *(const uint32_t*)key_ptr;
+		if (upper) {
+			if (key == UINT32_MAX) return count;
+			key++;
+		}
+		return boa__btree_rank_u32((const uint32_t*)boa__btree_keys(tree, node), count, key);
+	} else if (key_type == BOA_BTREE_KEY_U64) {
+		uint64_t key = *(const uint64_t*)key_ptr;
+		if (upper) {
+			if (key == UINT64_MAX) return count;
+			key++;
+		}
+		return boa__btree_rank_u64((const uint64_t*)boa__btree_keys(tree, node), count, key);
+	} else {
+		uint32_t lo = 0, hi = count, entry_size = tree->entry_size;
+		while (lo < hi) {
+			uint32_t mid = lo + (hi - lo) / 2;
+			int c = cmp(key_ptr, base + (size_t)mid * entry_size, user);
+			if (c > 0 || (upper && c == 0)) lo = mid + 1; else hi = mid;
+		}
+		return lo;
+	}
+}
+
+// Descend to the leaf that would contain `key_ptr`, recording the path if `path` is not NULL
+boa_forceinline boa__btree_node *
+boa__btree_descend(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user,
+	uint32_t key_type, boa__btree_path *path)
+{
+	boa__btree_node *node = tree->impl.root;
+	uint32_t level, height = tree->impl.height;
+	for (level = 0; level < height; level++) {
+		uint32_t ix = boa__btree_rank(tree, node, boa__btree_sep(tree, node, 0), key_ptr, cmp, user, key_type, 1);
+		if (path) {
+			path->nodes[level] = node;
+			path->indices[level] = ix;
+		}
+		node = boa__btree_children(tree, node)[ix];
+	}
+	return node;
+}
+
+// Is the key of entry `ix` of `leaf` equal to `key_ptr`
+boa_forceinline int
+boa__btree_leaf_equal(const boa_btree *tree, const boa__btree_node *leaf, uint32_t ix, const void *key_ptr,
+	boa_btree_cmp_fn cmp, void *user, uint32_t key_type)
+{
+	if (key_type == BOA_BTREE_KEY_U32) {
+		return ((const uint32_t*)boa__btree_keys(tree, leaf))[ix] == *(const uint32_t*)key_ptr;
+	} else if (key_type == BOA_BTREE_KEY_U64) {
+		return ((const uint64_t*)boa__btree_keys(tree, leaf))[ix] == *(const uint64_t*)key_ptr;
+	} else {
+		return cmp(key_ptr, boa__btree_entry(tree, leaf, ix), user) == 0;
+	}
+}
+
+// Make room for an entry at `pos` in a non-full `leaf` and set its key column
+boa_forceinline void *
+boa__btree_leaf_insert_at(boa_btree *tree, boa__btree_node *leaf, uint32_t pos, const void *key_ptr)
+{
+	uint32_t num_move = leaf->count - pos, key_size = tree->impl.key_type;
+	char *entry = boa__btree_entry(tree, leaf, pos);
+	if (num_move > 0) memmove(entry + tree->entry_size, entry, (size_t)num_move * tree->entry_size);
+	if (key_size) {
+		char *key = boa__btree_keys(tree, leaf) + (size_t)pos * key_size;
+		if (num_move > 0) memmove(key + key_size, key, (size_t)num_move * key_size);
+		memcpy(key, key_ptr, key_size);
+	}
+	leaf->count++;
+	tree->count++;
+	return entry;
+}
+
+// Inline implementation of `boa_btree_lower_bound()`, `key_type` must be a constant
+// `BOA_BTREE_KEY_*` matching the tree or `BOA_BTREE_KEY_ANY` to compare with `cmp`.
+boa_forceinline boa_btree_iterator
+boa_btree_lower_bound_inline(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user, uint32_t key_type)
+{
+	boa_btree_iterator it;
+	it.entry = NULL;
+	it.node = NULL;
+	it.index = 0;
+	if (!tree->impl.root) return it;
+
+	boa__btree_node *leaf = boa__btree_descend(tree, key_ptr, cmp, user, key_type, NULL);
+	uint32_t ix = boa__btree_rank(tree, leaf, boa__btree_entry(tree, leaf, 0), key_ptr, cmp, user, key_type, 0);
+
+	// Only the root leaf may be empty so the next leaf has an entry if it exists
+	if (ix == leaf->count) {
+		leaf = leaf->next;
+		ix = 0;
+	}
+	if (leaf) {
+		it.entry = boa__btree_entry(tree, leaf, ix);
+		it.node = leaf;
+		it.index = ix;
+	}
+	return it;
+}
+
+// Inline implementation of `boa_btree_find()`, see `boa_btree_lower_bound_inline()` for `key_type`
+boa_forceinline void *
+boa_btree_find_inline(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user, uint32_t key_type)
+{
+	if (!tree->impl.root) return NULL;
+	boa__btree_node *leaf = boa__btree_descend(tree, key_ptr, cmp, user, key_type, NULL);
+	uint32_t ix = boa__btree_rank(tree, leaf, boa__btree_entry(tree, leaf, 0), key_ptr, cmp, user, key_type, 0);
+	if (ix < leaf->count && boa__btree_leaf_equal(tree, leaf, ix, key_ptr, cmp, user, key_type)) {
+		return boa__btree_entry(tree, leaf, ix);
+	}
+	return NULL;
+}
+
+// Inline implementation of `boa_btree_insert()`, see `boa_btree_lower_bound_inline()` for `key_type`
+boa_forceinline boa_map_insert_result
+boa_btree_insert_inline(boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user, uint32_t key_type)
+{
+	boa_map_insert_result result;
+	boa__btree_path path;
+	if (!tree->impl.root) return boa__btree_insert_split(tree, &path, NULL, 0, key_ptr);
+
+	boa__btree_node *leaf = boa__btree_descend(tree, key_ptr, cmp, user, key_type, &path);
+	uint32_t ix = boa__btree_rank(tree, leaf, boa__btree_entry(tree, leaf, 0), key_ptr, cmp, user, key_type, 0);
+	if (ix < leaf->count && boa__btree_leaf_equal(tree, leaf, ix, key_ptr, cmp, user, key_type)) {
+		result.entry = boa__btree_entry(tree, leaf, ix);
+		result.inserted = 0;
+		return result;
+	}
+
+	if (leaf->count == tree->impl.leaf_cap) return boa__btree_insert_split(tree, &path, leaf, ix, key_ptr);
+	result.entry = boa__btree_leaf_insert_at(tree, leaf, ix, key_ptr);
+	result.inserted = 1;
+	return result;
+}
+
+// The non-inline functions take a NULL `cmp` to use the key layout of the tree.
+
+// Find the first entry with a key not less than `key_ptr`. Iterate further with
+// `boa_btree_advance()`, the iterator entry is NULL if all the keys are less than `key_ptr`.
+boa_noinline boa_btree_iterator boa_btree_lower_bound(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user);
+
+// Find the entry with the key `key_ptr`, NULL if not found.
+boa_noinline void *boa_btree_find(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user);
+
+// Find or insert an entry with the key `key_ptr`. Inserted entries are uninitialized
+// so the caller must write the key to them, trees with a key layout read the key from
+// `key_ptr` so it must point to a `uint32_t`/`uint64_t` in them.
+// Returns a NULL entry if out of memory.
+boa_noinline boa_map_insert_result boa_btree_insert(boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user);
+
+// Remove the entry with the key `key_ptr`, returns 1 if it was found.
+boa_noinline int boa_btree_remove(boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user);
+
+// Iterator to the first entry of the tree
+boa_inline boa_btree_iterator boa_btree_begin(const boa_btree *tree)
+{
+	boa_btree_iterator it;
+	uint32_t level;
+	boa__btree_node *node = tree->impl.root;
+	it.entry = NULL;
+	it.node = NULL;
+	it.index = 0;
+	if (!node) return it;
+	for (level = 0; level < tree->impl.height; level++) {
+		node = boa__btree_children(tree, node)[0];
+	}
+	if (node->count > 0) {
+		it.entry = boa__btree_entry(tree, node, 0);
+		it.node = node;
+	}
+	return it;
+}
+
+// Move `it` to the next entry in key order
+boa_forceinline void boa_btree_advance(const boa_btree *tree, boa_btree_iterator *it)
+{
+	if (++it->index == it->node->count) {
+		it->node = it->node->next;
+		it->index = 0;
+		if (!it->node) {
+			it->entry = NULL;
+			return;
+		}
+	}
+	it->entry = boa__btree_entry(tree, it->node, it->index);
+}
+
+boa_inline void *boa__btree_begin_for(const boa_btree *tree, void **p_node, void **p_end) {
+	boa_btree_iterator it = boa_btree_begin(tree);
+	if (!it.entry) return NULL;
+	*p_node = it.node;
+	*p_end = boa__btree_entry(tree, it.node, it.node->count);
+	return it.entry;
+}
+
+boa_inline void *boa__btree_advance_for(const boa_btree *tree, void **p_node, void **p_end) {
+	boa__btree_node *node = ((boa__btree_node*)*p_node)->next;
+	if (!node) return NULL;
+	*p_node = node;
+	*p_end = boa__btree_entry(tree, node, node->count);
+	return boa__btree_entry(tree, node, 0);
+}
+
+// Iterate through all the entries of `tree` in key order
+#define boa_btree_for(type, name, tree) for ( \
+	type *name##__node, *name##__end, *name = (type*)boa__btree_begin_for(tree, (void**)&name##__node, (void**)&name##__end); name; \
+	name = (name + 1 != name##__end ? name + 1 : (type*)boa__btree_advance_for(tree, (void**)&name##__node, (void**)&name##__end)))
+
+// Specialized trees with entries that begin with a `uint32_t` or `uint64_t` key
+
+boa_inline void boa_u32_btree_init(boa_btree *tree, size_t entry_size, boa_allocator *ator) {
+	boa_assert(entry_size >= sizeof(uint32_t));
+	boa_btree_init(tree, entry_size, BOA_BTREE_KEY_U32, 0, ator);
+}
+boa_forceinline void *boa_u32_btree_find(const boa_btree *tree, uint32_t key) {
+	return boa_btree_find_inline(tree, &key, NULL, NULL, BOA_BTREE_KEY_U32);
+}
+boa_forceinline boa_btree_iterator boa_u32_btree_lower_bound(const boa_btree *tree, uint32_t key) {
+	return boa_btree_lower_bound_inline(tree, &key, NULL, NULL, BOA_BTREE_KEY_U32);
+}
+boa_forceinline boa_map_insert_result boa_u32_btree_insert(boa_btree *tree, uint32_t key) {
+	boa_map_insert_result result = boa_btree_insert_inline(tree, &key, NULL, NULL, BOA_BTREE_KEY_U32);
+	if (result.inserted) *(uint32_t*)result.entry = key;
+	return result;
+}
+boa_inline int boa_u32_btree_remove(boa_btree *tree, uint32_t key) {
+	return boa_btree_remove(tree, &key, NULL, NULL);
+}
+
+boa_inline void boa_u64_btree_init(boa_btree *tree, size_t entry_size, boa_allocator *ator) {
+	boa_assert(entry_size >= sizeof(uint64_t));
+	boa_btree_init(tree, entry_size, BOA_BTREE_KEY_U64, 0, ator);
+}
+boa_forceinline void *boa_u64_btree_find(const boa_btree *tree, uint64_t key) {
+	return boa_btree_find_inline(tree, &key, NULL, NULL, BOA_BTREE_KEY_U64);
+}
+boa_forceinline boa_btree_iterator boa_u64_btree_lower_bound(const boa_btree *tree, uint64_t key) {
+	return boa_btree_lower_bound_inline(tree, &key, NULL, NULL, BOA_BTREE_KEY_U64);
+}
+boa_forceinline boa_map_insert_result boa_u64_btree_insert(boa_btree *tree, uint64_t key) {
+	boa_map_insert_result result = boa_btree_insert_inline(tree, &key, NULL, NULL, BOA_BTREE_KEY_U64);
+	if (result.inserted) *(uint64_t*)result.entry = key;
+	return result;
+}
+boa_inline int boa_u64_btree_remove(boa_btree *tree, uint64_t key) {
+	return boa_btree_remove(tree, &key, NULL, NULL);
+}
+
+/*
+	-- boa_slotmap: Dense object storage with generational handles.
+	Objects of `elem_size` bytes are packed in `data` and referred to by 32-bit handles
+	that combine a slot index and a generation. Looking up a handle is two indexed loads
+	instead of hashing like `boa_ptr_map_*()`. Removing an object moves the last one to
+	its place so `data` has no holes and can be scanned directly, handles of moved
+	objects stay valid. Live slots have odd generations and free slots even ones so a
+	removed handle never resolves to a free slot. Removed handles are detected until their
+	slot has been reused `BOA_SLOTMAP_GENERATION_MASK / 2` times, after that they may
+	refer to a newer object in the same slot.
+*/
+
+#ifndef BOA_SLOTMAP_INDEX_BITS
+#define BOA_SLOTMAP_INDEX_BITS 20
+#endif
+
+#define BOA_SLOTMAP_INDEX_MASK ((1u << BOA_SLOTMAP_INDEX_BITS) - 1)
+#define BOA_SLOTMAP_GENERATION_MASK ((uint32_t)~0u >> BOA_SLOTMAP_INDEX_BITS)
+
+// Live generations are odd so zero is never a valid handle
+#define BOA_SLOTMAP_INVALID_HANDLE 0u
+
+typedef struct boa__slot {
+	uint32_t index;       // < Index of the object in `data` if live, next free slot otherwise
+	uint32_t generation;  // < Odd generation of the live handle, even for free slots
+} boa__slot;
+
+typedef struct boa_slotmap {
+	boa_buf data;         // < Objects of `elem_size` bytes packed densely
+	boa_buf slots;        // < `boa__slot` for each handle index
+	boa_buf dense_slots;  // < `uint32_t` slot index of each object
+	uint32_t elem_size;
+	uint32_t count;
+	uint32_t free_slot;   // < First free slot, `BOA_SLOTMAP_INDEX_MASK` if none
+} boa_slotmap;
+
+// Initialize `map` for objects of `elem_size` bytes using `ator` for allocations.
+boa_inline void boa_slotmap_init(boa_slotmap *map, size_t elem_size, boa_allocator *ator) {
+	map->data = boa_empty_buf_ator(ator);
+	map->slots = boa_empty_buf_ator(ator);
+	map->dense_slots = boa_empty_buf_ator(ator);
+	map->elem_size = (uint32_t)elem_size;
+	map->count = 0;
+	map->free_slot = BOA_SLOTMAP_INDEX_MASK;
+}
+
+// Free all the memory of the map, all handles become invalid.
+void boa_slotmap_reset(boa_slotmap *map);
+
+// Remove all the objects keeping the memory allocated, handles become invalid.
+void boa_slotmap_clear(boa_slotmap *map);
+
+// Reserve space for `count` objects in total so that inserting them doesn't allocate.
+// Returns 0 if out of memory.
+int boa_slotmap_reserve(boa_slotmap *map, uint32_t count);
+
+// Insert an uninitialized object writing its handle to `p_handle`.
+// Returns NULL if out of memory or all the `BOA_SLOTMAP_INDEX_MASK` slots are in use.
+boa_noinline void *boa_slotmap_insert(boa_slotmap *map, uint32_t *p_handle);
+
+// Object referred to by `handle`, NULL if it has been removed.
+boa_forceinline void *boa_slotmap_get(const boa_slotmap *map, uint32_t handle)
+{
+	// Even generations belong to free slots, including the invalid handle
+	uint32_t ix = handle & BOA_SLOTMAP_INDEX_MASK, generation = handle >> BOA_SLOTMAP_INDEX_BITS;
+	if ((generation & 1) == 0 || ix >= boa_count(boa__slot, &map->slots)) return NULL;
+	boa__slot slot = boa_begin(boa__slot, &map->slots)[ix];
+	if (slot.generation != generation) return NULL;
+	return (char*)map->data.data + (size_t)slot.index * map->elem_size;
+}
+
+// Remove the object referred to by `handle` moving the last object to its place.
+// Returns 1 if the object was removed, 0 if the handle was already invalid.
+boa_forceinline int boa_slotmap_remove(boa_slotmap *map, uint32_t handle)
+{
+	uint32_t ix = handle & BOA_SLOTMAP_INDEX_MASK, generation = handle >> BOA_SLOTMAP_INDEX_BITS;
+	if ((generation & 1) == 0 || ix >= boa_count(boa__slot, &map->slots)) return 0;
+	boa__slot *slot = boa_begin(boa__slot, &map->slots) + ix;
+	if (slot->generation != generation) return 0;
+
+	uint32_t dense_ix = slot->index, last = --map->count;
+	uint32_t *dense_slots = boa_begin(uint32_t, &map->dense_slots);
+	if (dense_ix != last) {
+		size_t size = map->elem_size;
+		memcpy((char*)map->data.data + dense_ix * size, (char*)map->data.data + last * size, size);
+		dense_slots[dense_ix] = dense_slots[last];
+		boa_begin(boa__slot, &map->slots)[dense_slots[last]].index = dense_ix;
+	}
+	map->data.end_pos -= map->elem_size;
+	map->dense_slots.end_pos -= sizeof(uint32_t);
+
+	slot->index = map->free_slot;
+	slot->generation = (slot->generation + 1) & BOA_SLOTMAP_GENERATION_MASK;
+	map->free_slot = ix;
+	return 1;
+}
+
+// Handle of the object at `index` in `data`
+boa_forceinline uint32_t boa_slotmap_handle_at(const boa_slotmap *map, uint32_t index)
+{
+	boa_assert(index < map->count);
+	uint32_t ix = boa_begin(uint32_t, &map->dense_slots)[index];
+	return boa_begin(boa__slot, &map->slots)[ix].generation << BOA_SLOTMAP_INDEX_BITS | ix;
+}
+
+// Iterate through all the objects of `map` in memory order, the map must not be modified
+// during the iteration. To remove objects iterate by index without advancing past removed ones.
+#define boa_slotmap_for(type, name, map) \
+	for (type *name = boa_begin(type, &(map)->data), *name##__end = boa_end(type, &(map)->data); name != name##__end; name++)
+
+/*
+	-- boa_cache: Bounded key-value cache.
+	Entries of `entry_size` bytes are stored in a `boa_map` and evicted with LRU or CLOCK
+	policy when the total charge of the entries would exceed `budget` bytes. Each entry
+	owns a slot that indexes the recency state in side arrays: LRU links slots by index in
+	`slots`, CLOCK keeps a reference byte per slot in `referenced`. Map entries store their
+	slot index and slots store the hash of their key, so entries moving inside the map
+	don't matter and the entry of an evicted slot is found by a single lookup. Slots of
+	removed entries are reused through a free list. Entry pointers are invalidated by
+	inserting or removing entries like in `boa_map`.
+*/
+
+#define BOA_CACHE_LRU 0
+#define BOA_CACHE_CLOCK 1
+
+#define BOA__CACHE_NONE ((uint32_t)~0u)
+
+// Value of `referenced` for free slots that the CLOCK hand skips
+#define BOA__CACHE_FREE_SLOT 2
+
+// Called for each entry that leaves the cache, `entry` is removed after the call
+typedef void (*boa_cache_evict_fn)(void *entry, void *user);
+
+typedef struct boa_cache_opts {
+	size_t entry_size;
+	uint64_t budget;              // < Maximum total charge of the entries, usually bytes
+	uint32_t policy;              // < `BOA_CACHE_LRU` or `BOA_CACHE_CLOCK`
+	boa_cache_evict_fn evict_fn;  // < Optional callback for entries leaving the cache
+	void *evict_user;             // < Passed to `evict_fn`
+	boa_allocator *ator;
+} boa_cache_opts;
+
+typedef struct boa__cache_slot {
+	uint32_t hash;    // < Hash of the key of the entry owning the slot
+	uint32_t charge;  // < Amount counted against the budget
+	uint32_t older;   // < LRU: Next slot towards the least recently used one, next free slot if free
+	uint32_t newer;   // < LRU: Next slot towards the most recently used one
+} boa__cache_slot;
+
+typedef struct boa_cache {
+	boa_map map;          // < Entries followed by their `uint32_t` slot index
+	boa_buf slots;        // < `boa__cache_slot` for each entry
+	boa_buf referenced;   // < CLOCK: `uint8_t` per slot set when accessed
+	boa_cache_opts opts;
+	uint64_t used;        // < Total charge of the entries
+	uint32_t slot_offset; // < Offset of the slot index in the map entries
+	uint32_t newest, oldest; // < LRU: Ends of the recency order
+	uint32_t clock_hand;  // < CLOCK: Next slot to consider for eviction
+	uint32_t free_slot;   // < First free slot, `BOA__CACHE_NONE` if none
+	uint64_t hits, misses, evictions;
+} boa_cache;
+
+// Initialize `cache` using `opts`, which are copied.
+void boa_cache_init(boa_cache *cache, const boa_cache_opts *opts);
+
+// Remove all the entries calling `evict_fn` for them and free the memory.
+void boa_cache_reset(boa_cache *cache);
+
+// Remove all the entries calling `evict_fn` for them, keeps the memory allocated.
+void boa_cache_clear(boa_cache *cache);
+
+// Mark slot `slot_ix` as accessed
+boa_forceinline void boa__cache_touch(boa_cache *cache, uint32_t slot_ix)
+{
+	if (cache->opts.policy == BOA_CACHE_CLOCK) {
+		boa_begin(uint8_t, &cache->referenced)[slot_ix] = 1;
+		return;
+	}
+
+	if (cache->newest == slot_ix) return;
+	boa__cache_slot *slots = boa_begin(boa__cache_slot, &cache->slots);
+	boa__cache_slot *slot = &slots[slot_ix];
+
+	// Unlink, `slot` is not the newest so it has a newer neighbor
+	slots[slot->newer].older = slot->older;
+	if (slot->older != BOA__CACHE_NONE) slots[slot->older].newer = slot->newer;
+	else cache->oldest = slot->newer;
+
+	slot->older = cache->newest;
+	slot->newer = BOA__CACHE_NONE;
+	slots[cache->newest].newer = slot_ix;
+	cache->newest = slot_ix;
+}
+
+// Inline implementation of `boa_cache_find()`
+boa_forceinline void *
+boa_cache_find_inline(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	void *entry = boa_map_find_inline(&cache->map, key_ptr, hash, cmp, user);
+	if (entry) {
+		cache->hits++;
+		boa__cache_touch(cache, *(uint32_t*)((char*)entry + cache->slot_offset));
+	} else {
+		cache->misses++;
+	}
+	return entry;
+}
+
+// Find an entry marking it as recently used and counting a hit or a miss.
+boa_noinline void *boa_cache_find(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+
+// Find or insert an entry with `charge` counted against the budget, evicting other
+// entries as necessary. Inserted entries are uninitialized, existing entries get
+// `charge` replacing the previous one. Returns a NULL entry if out of memory or if
+// `charge` exceeds the budget alone, in which case nothing is evicted.
+boa_noinline boa_map_insert_result boa_cache_insert(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, uint32_t charge);
+
+// Remove an entry calling `evict_fn` for it, returns 1 if the key was found.
+boa_noinline int boa_cache_remove(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user);
+
 #endif
@@ -187,6 +187,23 @@ T &check_ptr(T *t) { return *(T*)boa_check_ptr(t); }
 
 // -- boa_map
 
+constexpr uint32_t log2_pow2(uint32_t value) { return value > 1 ? 1 + log2_pow2(value >> 1) : 0; }
+
+// Block geometry of a map fixed at compile time, see `boa_map_set_block_entries()`.
+// Hashers fold the block and entry index arithmetic of `*_geometry()` functions using
+// these constants. `BlockEntries` of 0 picks the geometry at runtime by the capacity.
+template <uint32_t BlockEntries, uint32_t EntrySize>
+struct map_geometry {
+	static_assert(BlockEntries == 0 || (BlockEntries >= BOA_MAP_MIN_BLOCK_ENTRIES
+		&& BlockEntries <= BOA_MAP_MAX_BLOCK_ENTRIES && (BlockEntries & (BlockEntries - 1)) == 0),
+		"Block entries must be a power of two between BOA_MAP_MIN_BLOCK_ENTRIES and BOA_MAP_MAX_BLOCK_ENTRIES");
+
+	static constexpr uint32_t block_entries = BlockEntries;  // < Entries per block
+	static constexpr uint32_t block_slots = BlockEntries * 2; // < Hash slots per block
+	static constexpr uint32_t slot_bits = log2_pow2(block_slots); // < Bits of the hash used for the slot
+	static constexpr uint32_t entry_size = EntrySize;         // < Size of an entry in bytes
+};
+
 struct blit_hasher: boa_map {
 	uint32_t blit_key_size;
 
@@ -204,6 +221,65 @@ struct blit_hasher: boa_map {
 	void *hasher_find(const void *key) const {
 		return boa_blit_map_find(this, key, blit_key_size);
 	}
+	void hasher_find_batch(void **entries, const void *keys, uint32_t count) const {
+		boa_blit_map_find_batch(this, entries, keys, blit_key_size, count);
+	}
+	int hasher_build(const void *entries, uint32_t count) {
+		return boa_blit_map_build(this, entries, blit_key_size, count);
+	}
+};
+
+// `blit_hasher` with a constant key size for inlined fixed geometry operations
+template <size_t Size>
+struct sized_blit_geometry: blit_hasher {
+	static int geometry_equal(const void *a, const void *b, void *user) {
+		return memcmp(a, b, Size) == 0;
+	}
+
+	// Same hash as `boa_blit_map_*()`
+	uint32_t geometry_hash(const void *key) const {
+		uint64_t hash = boa_hash_bytes(key, Size, impl.hash_seed);
+		return (uint32_t)(hash ^ (hash >> 32));
+	}
+
+	template <typename Geometry>
+	boa_map_insert_result hasher_insert_geometry(const void *key) {
+		return boa_map_insert_geometry_inline(this, key, geometry_hash(key), &geometry_equal, NULL,
+			Size > 8, Geometry::block_entries, Geometry::entry_size);
+	}
+	template <typename Geometry>
+	void *hasher_find_geometry(const void *key) const {
+		return boa_map_find_geometry_inline(this, key, geometry_hash(key), &geometry_equal, NULL,
+			Size > 8, Geometry::block_entries, Geometry::entry_size);
+	}
+};
+
+// `blit_hasher` that calls the fixed size functions directly for common key sizes
+template <size_t Size>
+struct sized_blit_hasher: sized_blit_geometry<Size> { };
+
+template <>
+struct sized_blit_hasher<4>: sized_blit_geometry<4> {
+	boa_map_insert_result hasher_insert(const void *key) { return boa_blit4_map_insert(this, key); }
+	void *hasher_find(const void *key) const { return boa_blit4_map_find(this, key); }
+};
+
+template <>
+struct sized_blit_hasher<8>: sized_blit_geometry<8> {
+	boa_map_insert_result hasher_insert(const void *key) { return boa_blit8_map_insert(this, key); }
+	void *hasher_find(const void *key) const { return boa_blit8_map_find(this, key); }
+};
+
+template <>
+struct sized_blit_hasher<12>: sized_blit_geometry<12> {
+	boa_map_insert_result hasher_insert(const void *key) { return boa_blit12_map_insert(this, key); }
+	void *hasher_find(const void *key) const { return boa_blit12_map_find(this, key); }
+};
+
+template <>
+struct sized_blit_hasher<16>: sized_blit_geometry<16> {
+	boa_map_insert_result hasher_insert(const void *key) { return boa_blit16_map_insert(this, key); }
+	void *hasher_find(const void *key) const { return boa_blit16_map_find(this, key); }
 };
 
 struct ptr_hasher: boa_map {
@@ -219,6 +295,26 @@ struct ptr_hasher: boa_map {
 	void *hasher_find(const void *key) const {
 		return boa_ptr_map_find(this, *(const void**)key);
 	}
+	void hasher_find_batch(void **entries, const void *keys, uint32_t count) const {
+		boa_ptr_map_find_batch(this, entries, (const void *const*)keys, count);
+	}
+	int hasher_build(const void *entries, uint32_t count) {
+		return boa_ptr_map_build(this, entries, count);
+	}
+
+	static int geometry_equal(const void *a, const void *b, void *user) {
+		return *(const void**)a == *(const void**)b;
+	}
+	template <typename Geometry>
+	boa_map_insert_result hasher_insert_geometry(const void *key) {
+		return boa_map_insert_geometry_inline(this, key, boa_ptr_hash(*(const void**)key), &geometry_equal, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
+	template <typename Geometry>
+	void *hasher_find_geometry(const void *key) const {
+		return boa_map_find_geometry_inline(this, key, boa_ptr_hash(*(const void**)key), &geometry_equal, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
 };
 
 struct u32_hasher: boa_map {
@@ -234,11 +330,32 @@ struct u32_hasher: boa_map {
 	void *hasher_find(const void *key) const {
 		return boa_u32_map_find(this, *(const uint32_t*)key);
 	}
+	void hasher_find_batch(void **entries, const void *keys, uint32_t count) const {
+		boa_u32_map_find_batch(this, entries, (const uint32_t*)keys, count);
+	}
+	int hasher_build(const void *entries, uint32_t count) {
+		return boa_u32_map_build(this, entries, count);
+	}
+
+	static int geometry_equal(const void *a, const void *b, void *user) {
+		return *(const uint32_t*)a == *(const uint32_t*)b;
+	}
+	template <typename Geometry>
+	boa_map_insert_result hasher_insert_geometry(const void *key) {
+		return boa_map_insert_geometry_inline(this, key, boa_u32_hash(*(const uint32_t*)key), &geometry_equal, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
+	template <typename Geometry>
+	void *hasher_find_geometry(const void *key) const {
+		return boa_map_find_geometry_inline(this, key, boa_u32_hash(*(const uint32_t*)key), &geometry_equal, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
 };
 
 struct virtual_hasher: boa_map {
 	boa_map_cmp_fn virtual_cmp_fn;
 	boa_map_hash_fn virtual_hash_fn;
+	uint32_t virtual_key_size;
 
 	template <typename T> static constexpr
 	bool hasher_compatible() { return true; }
@@ -257,6 +374,7 @@ struct virtual_hasher: boa_map {
 	void hasher_init() {
 		virtual_cmp_fn = &virtual_equal<T>;
 		virtual_hash_fn = &virtual_hash<T>;
+		virtual_key_size = sizeof(T);
 	}
 
 	boa_map_insert_result hasher_insert(const void *key) {
@@ -267,6 +385,38 @@ struct virtual_hasher: boa_map {
 		uint32_t hash = virtual_hash_fn(key, NULL);
 		return boa_map_find(this, key, hash, virtual_cmp_fn, NULL);
 	}
+	void hasher_find_batch(void **entries, const void *keys, uint32_t count) const {
+		uint32_t hashes[BOA__MAP_BATCH_SIZE];
+		for (uint32_t base = 0; base < count; base += BOA__MAP_BATCH_SIZE) {
+			uint32_t num = count - base;
+			if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+			const char *batch_keys = (const char*)keys + base * virtual_key_size;
+			for (uint32_t i = 0; i < num; i++) {
+				hashes[i] = virtual_hash_fn(batch_keys + i * virtual_key_size, NULL);
+			}
+			boa_map_find_batch(this, entries + base, batch_keys, virtual_key_size, hashes, num, virtual_cmp_fn, NULL);
+		}
+	}
+	int hasher_build(const void *entries, uint32_t count) {
+		uint32_t *hashes = boa_make_n_ator(uint32_t, count + 1, ator);
+		if (!hashes) return 0;
+		for (uint32_t i = 0; i < count; i++) {
+			hashes[i] = virtual_hash_fn((const char*)entries + i * entry_size, NULL);
+		}
+		int result = boa_map_build(this, entries, hashes, count);
+		boa_free_ator(ator, hashes);
+		return result;
+	}
+	template <typename Geometry>
+	boa_map_insert_result hasher_insert_geometry(const void *key) {
+		return boa_map_insert_geometry_inline(this, key, virtual_hash_fn(key, NULL), virtual_cmp_fn, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
+	template <typename Geometry>
+	void *hasher_find_geometry(const void *key) const {
+		return boa_map_find_geometry_inline(this, key, virtual_hash_fn(key, NULL), virtual_cmp_fn, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
 };
 
 template <typename T>
@@ -293,6 +443,16 @@ struct inline_hasher: boa_map {
 		uint32_t hash = inline_hash(key);
 		return boa_map_find(this, key, hash, &inline_equal);
 	}
+	template <typename Geometry>
+	boa_map_insert_result hasher_insert_geometry(const void *key) {
+		return boa_map_insert_geometry_inline(this, key, inline_hash(key), &inline_equal, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
+	template <typename Geometry>
+	void *hasher_find_geometry(const void *key) const {
+		return boa_map_find_geometry_inline(this, key, inline_hash(key), &inline_equal, NULL,
+			0, Geometry::block_entries, Geometry::entry_size);
+	}
 };
 
 template <typename Key, typename Val>
@@ -351,50 +511,119 @@ struct map_iterator: boa_map_iterator {
 	const T *operator->() const { return (const T*)entry; }
 };
 
-template <typename Hasher, typename T>
+template <typename Hasher, typename T, uint32_t BlockEntries = 0>
 struct set: Hasher {
 	static_assert(Hasher::template hasher_compatible<T>(), "Hasher is incompatible with the type");
 
 	typedef map_iterator<T> iterator;
 	typedef map_iterator<const T> const_iterator;
+	typedef map_geometry<BlockEntries, sizeof(T)> geometry;
 
 	set() {
 		boa_map_init(this, sizeof(T));
 		this->template hasher_init<T>();
+		if (BlockEntries) boa_map_set_block_entries(this, BlockEntries);
 	}
 
 	explicit set(boa_allocator *ator) {
 		boa_map_init_ator(this, sizeof(T), ator);
 		this->template hasher_init<T>();
+		if (BlockEntries) boa_map_set_block_entries(this, BlockEntries);
+	}
+
+	// Use `size` bytes at `storage` for the table while it fits, see `boa_map_init_fixed()`
+	set(void *storage, uint32_t size, boa_allocator *ator = nullptr) {
+		boa_map_init_fixed(this, sizeof(T), storage, size, ator);
+		this->template hasher_init<T>();
+		if (BlockEntries) boa_map_set_block_entries(this, BlockEntries);
+	}
+
+	static constexpr uint32_t fixed_storage_size(uint32_t capacity) {
+		return BOA_MAP_FIXED_STORAGE_SIZE(sizeof(T), capacity);
 	}
 
 	~set() {
 		boa_map_reset(this);
 	}
 
+	// Use the constant geometry if the block size is fixed at compile time
+	boa_map_insert_result geometry_insert(const void *key) {
+		if (BlockEntries) return this->template hasher_insert_geometry<geometry>(key);
+		return this->hasher_insert(key);
+	}
+	void *geometry_find(const void *key) const {
+		if (BlockEntries) return this->template hasher_find_geometry<geometry>(key);
+		return this->hasher_find(key);
+	}
+
 	void reserve(uint32_t capacity) {
 		boa_map_reserve(this, capacity);
 	}
 
+	void set_incremental(uint32_t blocks_per_insert) {
+		boa_map_set_incremental(this, blocks_per_insert);
+	}
+
+	void set_job_runner(boa_job_runner *runner) {
+		boa_map_set_job_runner(this, runner);
+	}
+
+	void set_hash_seed(uint32_t seed) {
+		boa_map_set_hash_seed(this, seed);
+	}
+
+	bool set_filter(boa_filter *filter) {
+		return (bool)boa_map_set_filter(this, filter);
+	}
+
+	void shrink() {
+		boa_map_shrink(this);
+	}
+
+	void compact() {
+		boa_map_compact(this);
+	}
+
 	insert_result<T> insert_uninitialized(const T &t) {
-		return this->hasher_insert(&t);
+		return geometry_insert(&t);
 	}
 
 	insert_result<T> insert(const T &t) {
-		insert_result<T> ires { this->hasher_insert(&t) };
+		insert_result<T> ires { geometry_insert(&t) };
 		boa_assert(ires.entry);
 		if (ires.inserted) *ires.entry = t;
 		return ires;
 	}
 
 	insert_result<T> try_insert(const T &t) {
-		insert_result<T> ires { this->hasher_insert(&t) };
+		insert_result<T> ires { geometry_insert(&t) };
 		if (ires.inserted) *ires.entry = t;
 		return ires;
 	}
 
 	T *find(const T &t) {
-		return (T*)this->hasher_find(&t);
+		return (T*)geometry_find(&t);
+	}
+
+	// Replace the contents with `count` unique `values`, see `boa_map_build()`
+	bool assign_bulk(const T *values, uint32_t count) {
+		return this->hasher_build(values, count) != 0;
+	}
+
+	// Open a read-only snapshot, see `boa_map_snapshot_open()`
+	bool open_snapshot(const void *data, uint32_t size) {
+		return boa_map_snapshot_open(this, data, size) != 0;
+	}
+
+	boa_map_stats get_stats() const {
+		boa_map_stats stats;
+		boa_map_get_stats(this, &stats);
+		return stats;
+	}
+
+	// Find `count` values from `values` writing the found entries or NULL to `entries`
+	void find_batch(T **entries, const T *values, uint32_t count) {
+		this->hasher_find_batch((void**)entries, values, count);
 	}
 
 	iterator begin() { return iterator(this, boa_map_begin(this)); }
@@ -402,7 +631,11 @@ struct set: Hasher {
 	iterator iterate_from(const T *entry) { return iterator(this, boa_map_iterate_from(this, entry)); }
 
 	const T *find(const T &t) const {
-		return (const T*)this->hasher_find(&t);
+		return (const T*)geometry_find(&t);
+	}
+
+	void find_batch(const T **entries, const T *values, uint32_t count) const {
+		this->hasher_find_batch((void**)entries, values, count);
 	}
 
 	const_iterator begin() const { return const_iterator(this, boa_map_begin(this)); }
@@ -410,45 +643,93 @@ struct set: Hasher {
 	const_iterator iterate_from(const T *entry) const { return const_iterator(this, boa_map_iterate_from(this, entry)); }
 };
 
-template <typename Hasher, typename Key, typename Val>
+template <typename Hasher, typename Key, typename Val, uint32_t BlockEntries = 0>
 struct map: Hasher {
 	static_assert(Hasher::template hasher_compatible<Key>(), "Hasher is incompatible with the key type");
 
 	typedef key_val<Key, Val> key_val;
 	typedef map_iterator<key_val> iterator;
 	typedef map_iterator<const key_val> const_iterator;
+	typedef map_geometry<BlockEntries, sizeof(key_val)> geometry;
 
 	map() {
 		boa_map_init(this, sizeof(key_val));
 		this->template hasher_init<Key>();
+		if (BlockEntries) boa_map_set_block_entries(this, BlockEntries);
 	}
 
 	explicit map(boa_allocator *ator) {
 		boa_map_init_ator(this, sizeof(key_val), ator);
 		this->template hasher_init<Key>();
+		if (BlockEntries) boa_map_set_block_entries(this, BlockEntries);
+	}
+
+	// Use `size` bytes at `storage` for the table while it fits, see `boa_map_init_fixed()`
+	map(void *storage, uint32_t size, boa_allocator *ator = nullptr) {
+		boa_map_init_fixed(this, sizeof(key_val), storage, size, ator);
+		this->template hasher_init<Key>();
+		if (BlockEntries) boa_map_set_block_entries(this, BlockEntries);
+	}
+
+	static constexpr uint32_t fixed_storage_size(uint32_t capacity) {
+		return BOA_MAP_FIXED_STORAGE_SIZE(sizeof(key_val), capacity);
 	}
 
 	~map() {
 		boa_map_reset(this);
 	}
 
+	// Use the constant geometry if the block size is fixed at compile time
+	boa_map_insert_result geometry_insert(const void *key) {
+		if (BlockEntries) return this->template hasher_insert_geometry<geometry>(key);
+		return this->hasher_insert(key);
+	}
+	void *geometry_find(const void *key) const {
+		if (BlockEntries) return this->template hasher_find_geometry<geometry>(key);
+		return this->hasher_find(key);
+	}
+
 	void reserve(uint32_t capacity) {
 		boa_map_reserve(this, capacity);
 	}
 
+	void set_incremental(uint32_t blocks_per_insert) {
+		boa_map_set_incremental(this, blocks_per_insert);
+	}
+
+	void set_job_runner(boa_job_runner *runner) {
+		boa_map_set_job_runner(this, runner);
+	}
+
+	void set_hash_seed(uint32_t seed) {
+		boa_map_set_hash_seed(this, seed);
+	}
+
+	bool set_filter(boa_filter *filter) {
+		return (bool)boa_map_set_filter(this, filter);
+	}
+
+	void shrink() {
+		boa_map_shrink(this);
+	}
+
+	void compact() {
+		boa_map_compact(this);
+	}
+
 	insert_result<key_val> insert_uninitialized(const Key &key) {
-		insert_result<key_val> ires { this->hasher_insert(&key) };
+		insert_result<key_val> ires { geometry_insert(&key) };
 		boa_assert(ires.entry);
 		return ires;
 	}
 
 	insert_result<key_val> try_insert_uninitialized(const Key &key) {
-		insert_result<key_val> ires { this->hasher_insert(&key) };
+		insert_result<key_val> ires { geometry_insert(&key) };
 		return ires;
 	}
 
 	insert_result<key_val> insert(const Key &key, const Val &val) {
-		insert_result<key_val> ires { this->hasher_insert(&key) };
+		insert_result<key_val> ires { geometry_insert(&key) };
 		boa_assert(ires.entry);
 		if (ires.inserted) {
 			ires.entry->key = key;
@@ -458,7 +739,7 @@ struct map: Hasher {
 	}
 
 	insert_result<key_val> try_insert(const Key &key, const Val &val) {
-		insert_result<key_val> ires { this->hasher_insert(&key) };
+		insert_result<key_val> ires { geometry_insert(&key) };
 		if (ires.inserted) {
 			ires.entry->key = key;
 			ires.entry->val = val;
@@ -467,7 +748,7 @@ struct map: Hasher {
 	}
 
 	insert_result<key_val> insert_or_assign(const Key &key, const Val &val) {
-		insert_result<key_val> ires { this->hasher_insert(&key) };
+		insert_result<key_val> ires { geometry_insert(&key) };
 		boa_assert(ires.entry);
 		if (ires.inserted) ires.entry->key = key;
 		ires.entry->val = val;
@@ -475,14 +756,35 @@ struct map: Hasher {
 	}
 
 	insert_result<key_val> try_insert_or_assign(const Key &key, const Val &val) {
-		insert_result<key_val> ires { this->hasher_insert(&key) };
+		insert_result<key_val> ires { geometry_insert(&key) };
 		if (ires.inserted) ires.entry->key = key;
 		if (ires.entry) ires.entry->val = val;
 		return ires;
 	}
 
 	key_val *find(const Key &key) {
-		return (key_val*)this->hasher_find(&key);
+		return (key_val*)geometry_find(&key);
+	}
+
+	// Replace the contents with `count` entries with unique keys, see `boa_map_build()`
+	bool assign_bulk(const key_val *entries, uint32_t count) {
+		return this->hasher_build(entries, count) != 0;
+	}
+
+	// Open a read-only snapshot, see `boa_map_snapshot_open()`
+	bool open_snapshot(const void *data, uint32_t size) {
+		return boa_map_snapshot_open(this, data, size) != 0;
+	}
+
+	boa_map_stats get_stats() const {
+		boa_map_stats stats;
+		boa_map_get_stats(this, &stats);
+		return stats;
+	}
+
+	// Find `count` keys from `keys` writing the found entries or NULL to `entries`
+	void find_batch(key_val **entries, const Key *keys, uint32_t count) {
+		this->hasher_find_batch((void**)entries, keys, count);
 	}
 
 	iterator begin() { return iterator(this, boa_map_begin(this)); }
@@ -490,7 +792,11 @@ struct map: Hasher {
 	iterator iterate_from(const key_val *entry) { return iterator(this, boa_map_iterate_from(this, entry)); }
 
 	const key_val *find(const Key &key) const {
-		return (key_val*)this->hasher_find(&key);
+		return (key_val*)geometry_find(&key);
+	}
+
+	void find_batch(const key_val **entries, const Key *keys, uint32_t count) const {
+		this->hasher_find_batch((void**)entries, keys, count);
 	}
 
 	const_iterator begin() const { return const_iterator(this, boa_map_begin(this)); }
@@ -498,16 +804,17 @@ struct map: Hasher {
 	const_iterator iterate_from(const key_val *entry) const { return const_iterator(this, boa_map_iterate_from(this, entry)); }
 };
 
-template <typename T> using blit_set = set<blit_hasher, T>;
-template <typename T> using ptr_set = set<ptr_hasher, T>;
-template <typename T> using u32_set = set<u32_hasher, T>;
-template <typename T> using virtual_set = set<virtual_hasher, T>;
-template <typename T> using inline_set = set<inline_hasher<T>, T>;
-template <typename Key, typename Val> using blit_map = map<blit_hasher, Key, Val>;
-template <typename Key, typename Val> using ptr_map = map<ptr_hasher, Key, Val>;
-template <typename Key, typename Val> using u32_map = map<u32_hasher, Key, Val>;
-template <typename Key, typename Val> using virtual_map = map<virtual_hasher, Key, Val>;
-template <typename Key, typename Val> using inline_map = map<inline_hasher<Key>, Key, Val>;
+// `BlockEntries` fixes the block size at compile time, see `map_geometry`
+template <typename T, uint32_t BlockEntries = 0> using blit_set = set<sized_blit_hasher<sizeof(T)>, T, BlockEntries>;
+template <typename T, uint32_t BlockEntries = 0> using ptr_set = set<ptr_hasher, T, BlockEntries>;
+template <typename T, uint32_t BlockEntries = 0> using u32_set = set<u32_hasher, T, BlockEntries>;
+template <typename T, uint32_t BlockEntries = 0> using virtual_set = set<virtual_hasher, T, BlockEntries>;
+template <typename T, uint32_t BlockEntries = 0> using inline_set = set<inline_hasher<T>, T, BlockEntries>;
+template <typename Key, typename Val, uint32_t BlockEntries = 0> using blit_map = map<sized_blit_hasher<sizeof(Key)>, Key, Val, BlockEntries>;
+template <typename Key, typename Val, uint32_t BlockEntries = 0> using ptr_map = map<ptr_hasher, Key, Val, BlockEntries>;
+template <typename Key, typename Val, uint32_t BlockEntries = 0> using u32_map = map<u32_hasher, Key, Val, BlockEntries>;
+template <typename Key, typename Val, uint32_t BlockEntries = 0> using virtual_map = map<virtual_hasher, Key, Val, BlockEntries>;
+template <typename Key, typename Val, uint32_t BlockEntries = 0> using inline_map = map<inline_hasher<Key>, Key, Val, BlockEntries>;
 
 // -- boa_pqueue
 
@@ -636,6 +943,150 @@ struct arena : boa_arena {
 
 };
 
+// -- boa_str_map
+
+template <typename Val>
+struct str_key_val {
+	boa_str_key key;
+	Val val;
+};
+
+template <typename Val>
+struct str_map: boa_str_map {
+	typedef str_key_val<Val> key_val;
+	typedef map_iterator<key_val> iterator;
+	typedef map_iterator<const key_val> const_iterator;
+
+	str_map() {
+		boa_str_map_init(this, sizeof(key_val), NULL);
+	}
+
+	explicit str_map(boa_allocator *ator) {
+		boa_str_map_init(this, sizeof(key_val), ator);
+	}
+
+	~str_map() {
+		boa_str_map_reset(this);
+	}
+
+	uint32_t count() const {
+		return map.count;
+	}
+
+	void clear() {
+		boa_str_map_clear(this);
+	}
+
+	insert_result<key_val> insert(const char *data, uint32_t length, const Val &val) {
+		insert_result<key_val> ires { boa_str_map_insert(this, data, length) };
+		boa_assert(ires.entry);
+		if (ires.inserted) ires.entry->val = val;
+		return ires;
+	}
+
+	insert_result<key_val> try_insert(const char *data, uint32_t length, const Val &val) {
+		insert_result<key_val> ires { boa_str_map_insert(this, data, length) };
+		if (ires.inserted) ires.entry->val = val;
+		return ires;
+	}
+
+	insert_result<key_val> insert_or_assign(const char *data, uint32_t length, const Val &val) {
+		insert_result<key_val> ires { boa_str_map_insert(this, data, length) };
+		boa_assert(ires.entry);
+		ires.entry->val = val;
+		return ires;
+	}
+
+	insert_result<key_val> insert(const char *str, const Val &val) {
+		return insert(str, (uint32_t)strlen(str), val);
+	}
+
+	key_val *find(const char *data, uint32_t length) {
+		return (key_val*)boa_str_map_find(this, data, length);
+	}
+
+	key_val *find(const char *str) {
+		return (key_val*)boa_str_map_find(this, str, (uint32_t)strlen(str));
+	}
+
+	void remove(key_val *entry) {
+		boa_str_map_remove(this, entry);
+	}
+
+	iterator begin() { return iterator(&map, boa_map_begin(&map)); }
+	iterator end() { return iterator(); }
+
+	const key_val *find(const char *data, uint32_t length) const {
+		return (const key_val*)boa_str_map_find(this, data, length);
+	}
+
+	const key_val *find(const char *str) const {
+		return (const key_val*)boa_str_map_find(this, str, (uint32_t)strlen(str));
+	}
+
+	const_iterator begin() const { return const_iterator(&map, boa_map_begin(&map)); }
+	const_iterator end() const { return const_iterator(); }
+};
+
+// -- boa_cache
+
+template <typename Key, typename Val>
+struct blit_cache: boa_cache {
+	typedef key_val<Key, Val> key_val;
+
+	explicit blit_cache(uint64_t budget, uint32_t policy = BOA_CACHE_CLOCK, boa_allocator *ator = nullptr) {
+		boa_cache_opts opts = { };
+		opts.entry_size = sizeof(key_val);
+		opts.budget = budget;
+		opts.policy = policy;
+		opts.ator = ator;
+		boa_cache_init(this, &opts);
+	}
+
+	~blit_cache() {
+		boa_cache_reset(this);
+	}
+
+	static int key_cmp(const void *a, const void *b, void *user) {
+		return !memcmp(a, b, sizeof(Key));
+	}
+
+	uint32_t hash(const Key &key) const {
+		uint64_t hash = boa_hash_bytes(&key, sizeof(Key), map.impl.hash_seed);
+		return (uint32_t)(hash ^ (hash >> 32));
+	}
+
+	uint32_t count() const {
+		return map.count;
+	}
+
+	// Call `fn` for every entry that leaves the cache
+	void set_evict_fn(boa_cache_evict_fn fn, void *user) {
+		opts.evict_fn = fn;
+		opts.evict_user = user;
+	}
+
+	void clear() {
+		boa_cache_clear(this);
+	}
+
+	key_val *find(const Key &key) {
+		return (key_val*)boa_cache_find_inline(this, &key, hash(key), &key_cmp, NULL);
+	}
+
+	// Insert or update `key` with `charge` counted against the budget, NULL if it doesn't fit
+	key_val *insert_or_assign(const Key &key, const Val &val, uint32_t charge = sizeof(key_val)) {
+		insert_result<key_val> ires { boa_cache_insert(this, &key, hash(key), &key_cmp, NULL, charge) };
+		if (ires.inserted) ires.entry->key = key;
+		if (ires.entry) ires.entry->val = val;
+		return ires.entry;
+	}
+
+	bool remove(const Key &key) {
+		return boa_cache_remove(this, &key, hash(key), &key_cmp, NULL) != 0;
+	}
+};
+
 // -- Pod aliases
 
 template <typename T> using pod_buf = pod<buf<T>>;
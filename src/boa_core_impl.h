@@ -251,32 +251,117 @@ int boa_format_u32(boa_buf *buf, const void *data, size_t size)
 	return boa_format(buf, "%u", *(const uint32_t*)data) ? 1 : 0;
 }
 
-static int boa__map_allocate(boa_map *map, uint32_t prev_blocks)
+// -- boa_filter
+
+int boa_filter_init(boa_filter *filter, uint32_t capacity, boa_allocator *ator)
+{
+	uint32_t num_blocks = (uint32_t)(((uint64_t)capacity * BOA__FILTER_BITS_PER_ENTRY + 255) / 256);
+	if (num_blocks == 0) num_blocks = 1;
+
+	// Over-allocate to align the blocks to cache lines
+	size_t size = (size_t)num_blocks * BOA__FILTER_BLOCK_WORDS * sizeof(uint32_t);
+	void *data = boa_alloc_ator(ator, size + 64);
+	if (!data) return 0;
+
+	filter->ator = ator;
+	filter->data = data;
+	filter->words = (uint32_t*)(((uintptr_t)data + 63) & ~(uintptr_t)63);
+	filter->num_blocks = num_blocks;
+	filter->capacity = capacity;
+	filter->count = 0;
+	filter->num_stale = 0;
+	memset(filter->words, 0, size);
+	return 1;
+}
+
+void boa_filter_clear(boa_filter *filter)
+{
+	if (!filter->words) return;
+	memset(filter->words, 0, (size_t)filter->num_blocks * BOA__FILTER_BLOCK_WORDS * sizeof(uint32_t));
+	filter->count = 0;
+	filter->num_stale = 0;
+}
+
+void boa_filter_reset(boa_filter *filter)
+{
+	if (filter->data) {
+		boa_free_ator(filter->ator, filter->data);
+	}
+	memset(filter, 0, sizeof(boa_filter));
+}
+
+// -- boa_map
+
+typedef struct boa__map_layout {
+	uint32_t block_offset;
+	uint32_t es_offset;
+	uint32_t hcs_offset;
+	uint32_t entry_offset;
+	uint32_t total_size;
+} boa__map_layout;
+
+// Compute the offsets of the arrays of `num_blocks` blocks stored contiguously
+static boa__map_layout boa__map_get_layout(const boa_map *map, uint32_t num_blocks)
 {
-	uint32_t num_total_blocks = map->impl.num_total_blocks;
 	uint32_t block_num_entries = map->impl.block_num_entries;
 	uint32_t block_num_slots = map->impl.block_num_entries << 1;
 
-	uint32_t block_size = boa_align_up(num_total_blocks * sizeof(boa__map_block), 8);
-	uint32_t es_size = boa_align_up(num_total_blocks * block_num_slots * sizeof(uint16_t), 8);
-	uint32_t hcs_size = boa_align_up(num_total_blocks * block_num_entries * sizeof(uint32_t), 8);
-	uint32_t entry_size = boa_align_up(num_total_blocks * block_num_entries * map->entry_size, 8);
+	uint32_t block_size = boa_align_up(num_blocks * sizeof(boa__map_block), 8);
+	uint32_t es_size = boa_align_up(num_blocks * block_num_slots * sizeof(uint16_t), 8);
+	uint32_t hcs_size = boa_align_up(num_blocks * block_num_entries * sizeof(uint32_t), 8);
+	uint32_t entry_size = boa_align_up(num_blocks * block_num_entries * map->entry_size, 8);
+
+	boa__map_layout layout;
+	layout.block_offset = 0;
+	layout.es_offset = layout.block_offset + block_size;
+	layout.hcs_offset = layout.es_offset + es_size;
+	layout.entry_offset = layout.hcs_offset + hcs_size;
+	layout.total_size = layout.entry_offset + entry_size;
+	return layout;
+}
+
+// The storage of `boa_map_init_fixed()` can hold a table of `size` bytes if no table uses it
+static int boa__map_fixed_fits(const boa_map *map, uint32_t size)
+{
+	void *fixed = map->impl.fixed_data;
+	if (!fixed || size > map->impl.fixed_size) return 0;
+	if (map->impl.blocks == fixed) return 0;
+	if (map->impl.rehash && map->impl.rehash->impl.blocks == fixed) return 0;
+	return 1;
+}
+
+// Free a table rooted at `blocks` unless it's in the fixed storage
+static void boa__map_free_table(const boa_map *map, void *blocks)
+{
+	if (blocks && blocks != map->impl.fixed_data) boa_free_ator(map->ator, blocks);
+}
+
+static int boa__map_allocate(boa_map *map, uint32_t prev_blocks)
+{
+	uint32_t block_num_entries = map->impl.block_num_entries;
+	uint32_t block_num_slots = map->impl.block_num_entries << 1;
 
-	uint32_t block_offset = 0;
-	uint32_t es_offset = block_offset + block_size;
-	uint32_t hcs_offset = es_offset + es_size;
-	uint32_t entry_offset = hcs_offset + hcs_size;
-	uint32_t total_size = entry_offset + entry_size;
+	boa__map_layout layout = boa__map_get_layout(map, map->impl.num_total_blocks);
+	uint32_t block_offset = layout.block_offset;
+	uint32_t es_offset = layout.es_offset;
+	uint32_t hcs_offset = layout.hcs_offset;
+	uint32_t entry_offset = layout.entry_offset;
+	uint32_t total_size = layout.total_size;
 
-	char *ptr = (char*)boa_alloc_ator(map->ator, total_size);
-	if (!ptr) return 0;
+	char *ptr;
+	if (boa__map_fixed_fits(map, total_size)) {
+		ptr = (char*)map->impl.fixed_data;
+	} else {
+		ptr = (char*)boa_alloc_ator(map->ator, total_size);
+		if (!ptr) return 0;
+	}
 
 	if (prev_blocks) {
 		memcpy(ptr + block_offset, map->impl.blocks, prev_blocks * sizeof(boa__map_block));
 		memcpy(ptr + es_offset, map->impl.entry_slot, prev_blocks * block_num_slots * sizeof(uint16_t));
 		memcpy(ptr + hcs_offset, map->impl.hash_cur_slot, prev_blocks * block_num_entries * sizeof(uint32_t));
 		memcpy(ptr + entry_offset, map->impl.entries, prev_blocks * block_num_entries * map->entry_size);
-		boa_free_ator(map->ator, map->impl.blocks);
+		boa__map_free_table(map, map->impl.blocks);
 	}
 
 	map->impl.blocks = (boa__map_block*)(ptr + block_offset);
@@ -287,28 +372,13 @@ static int boa__map_allocate(boa_map *map, uint32_t prev_blocks)
 	return 1;
 }
 
-static void boa__map_insert_no_find(boa_map *map, uint32_t hash, const void *data)
+// Insert the slot of entry `entry_offset` with `hash` to the `entry_slot` of a block
+static void boa__map_place_slot(boa_map *map, uint32_t block_ix, uint32_t entry_offset, uint32_t hash)
 {
-	// Inserted hashes should come from the table and be already canonicalized
-	boa_assert(hash == boa__map_hash_canonicalize(hash));
-
-	// Calculate block and slot indices from the hash
-	uint32_t block_mask = map->impl.num_hash_blocks - 1;
-	uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
 	uint32_t block_num_slots = boa__map_block_num_slots(map);
 	uint32_t slot_mask = block_num_slots - 1;
 	uint32_t slot_ix = hash & slot_mask;
 
-	// Retrieve the actual block to insert to, falling back to auxilary blocks when
-	// the blocks get full.
-	// Note: `boa__map_find_fallback()` may invalidate any pointers to the map!
-	uint32_t count = map->impl.blocks[block_ix].count;
-	if (count >= map->impl.block_num_entries) {
-		block_ix = boa__map_find_fallback(map, block_ix);
-		boa_assert(block_ix != ~0u);
-		count = map->impl.blocks[block_ix].count;
-	}
-
 	uint16_t *entry_slot = map->impl.entry_slot + block_ix * block_num_slots;
 	uint32_t scan = 0;  // < Number of slots scanned from insertion point
 	uint16_t displaced; // < Displaced element-slot value that needs to be inserted
@@ -319,15 +389,10 @@ static void boa__map_insert_no_find(boa_map *map, uint32_t hash, const void *dat
 		// If we find an empty slot or one with lower scan distance insert here
 		uint32_t ref_scan = boa__es_scan_distance(es, slot_ix, slot_mask);
 		if (es == 0 || ref_scan < scan) {
-			// Insert as last element of the block
-			entry_slot[slot_ix] = boa__es_make(count, hash);
-			uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, count);
+			entry_slot[slot_ix] = boa__es_make(entry_offset, hash);
+			uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, entry_offset);
 			map->impl.hash_cur_slot[entry_index] = boa__hcs_make(hash, slot_ix);
-			map->impl.blocks[block_ix].count = count + 1;
 			displaced = es;
-
-			void *dst = boa__map_entry_from_index(map, entry_index);
-			memcpy(dst, data, map->entry_size);
 			break;
 		}
 
@@ -354,81 +419,541 @@ static void boa__map_insert_no_find(boa_map *map, uint32_t hash, const void *dat
 	}
 }
 
-int boa_map_reserve(boa_map *map, uint32_t capacity)
+static void boa__map_insert_no_find(boa_map *map, uint32_t hash, const void *data)
 {
-	boa_map new_map = *map;
+	// Inserted hashes should come from the table and be already canonicalized
+	boa_assert(hash == boa__map_hash_canonicalize(hash));
 
-	if (capacity < 16) capacity = 16;
+	// Calculate block index from the hash
+	uint32_t block_mask = map->impl.num_hash_blocks - 1;
+	uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
 
-	uint32_t block_ix, elem_ix;
-	uint32_t num_blocks = map->impl.num_used_blocks;
-	uint32_t num_aux = map->impl.num_total_blocks - map->impl.num_hash_blocks;
+	// Retrieve the actual block to insert to, falling back to auxilary blocks when
+	// the blocks get full.
+	// Note: `boa__map_find_fallback()` may invalidate any pointers to the map!
+	uint32_t count = map->impl.blocks[block_ix].count;
+	if (count >= map->impl.block_num_entries) {
+		block_ix = boa__map_find_fallback(map, block_ix);
+		boa_assert(block_ix != ~0u);
+		count = map->impl.blocks[block_ix].count;
+	}
+
+	// Insert as last element of the block
+	uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, count);
+	void *dst = boa__map_entry_from_index(map, entry_index);
+	memcpy(dst, data, map->entry_size);
+	boa__map_place_slot(map, block_ix, count, hash);
+	map->impl.blocks[block_ix].count = count + 1;
+}
+
+// Setup the geometry of `map` for `capacity` entries and allocate empty blocks.
+// Does not free or rehash the previous blocks.
+static int boa__map_alloc_table(boa_map *map, uint32_t capacity, uint32_t num_aux)
+{
+	uint32_t fixed_entries = map->impl.fixed_block_entries;
+	uint32_t max_entries = fixed_entries ? fixed_entries : BOA__MAP_BLOCK_MAX_ENTRIES;
+	if (capacity < 16) capacity = 16;
 
-	if (capacity <= BOA__MAP_BLOCK_MAX_ENTRIES) {
+	if (capacity <= max_entries) {
 		capacity = boa_round_pow2_up(capacity);
 		num_aux = 0;
-		new_map.impl.num_hash_blocks = 1;
-		new_map.impl.block_num_entries = capacity;
+
+		// Fill the whole fixed storage if the table fits in it
+		if (map->impl.fixed_data && !fixed_entries) {
+			boa_map view = *map;
+			while (capacity < max_entries) {
+				view.impl.block_num_entries = (uint8_t)(capacity * 2);
+				if (!boa__map_fixed_fits(map, boa__map_get_layout(&view, 1).total_size)) break;
+				capacity *= 2;
+			}
+		}
+
+		map->impl.num_hash_blocks = 1;
+		map->impl.block_num_entries = fixed_entries ? fixed_entries : capacity;
 	} else {
-		uint32_t cap = (capacity * 4 / 3 + BOA__MAP_BLOCK_MAX_ENTRIES - 1) / BOA__MAP_BLOCK_MAX_ENTRIES;
-		new_map.impl.num_hash_blocks = boa_round_pow2_up(cap);
-		new_map.impl.block_num_entries = BOA__MAP_BLOCK_MAX_ENTRIES;
+		uint32_t cap = (capacity * 4 / 3 + max_entries - 1) / max_entries;
+		map->impl.num_hash_blocks = boa_round_pow2_up(cap);
+		map->impl.block_num_entries = max_entries;
 	}
 
 	// Alloacte at least 1/4 aux blocks per hash block
-	uint32_t auto_aux = new_map.impl.num_hash_blocks / 4;
+	uint32_t auto_aux = map->impl.num_hash_blocks / 4;
 	if (num_aux < auto_aux) num_aux = auto_aux;
-	if (new_map.impl.num_hash_blocks < 2) num_aux = 0;
+	if (map->impl.num_hash_blocks < 2) num_aux = 0;
 
-	new_map.impl.entry_block_shift = boa_highest_bit(new_map.impl.block_num_entries);
-	new_map.impl.num_total_blocks = new_map.impl.num_hash_blocks + num_aux;
-	new_map.impl.num_used_blocks = new_map.impl.num_hash_blocks;
-	if (new_map.impl.num_hash_blocks > 1) {
-		new_map.capacity = new_map.impl.num_hash_blocks * new_map.impl.block_num_entries * 3 / 4;
+	map->impl.entry_block_shift = boa_highest_bit(map->impl.block_num_entries);
+	map->impl.num_total_blocks = map->impl.num_hash_blocks + num_aux;
+	map->impl.num_used_blocks = map->impl.num_hash_blocks;
+	if (map->impl.num_hash_blocks > 1) {
+		map->capacity = map->impl.num_hash_blocks * map->impl.block_num_entries * 3 / 4;
 	} else {
-		new_map.capacity = new_map.impl.block_num_entries;
+		map->capacity = map->impl.block_num_entries;
 	}
 
-	uint32_t block_num_slots = boa__map_block_num_slots(&new_map);
-	boa_assert(new_map.impl.block_num_entries <= BOA__MAP_BLOCK_MAX_ENTRIES);
+	uint32_t block_num_slots = boa__map_block_num_slots(map);
+	boa_assert(map->impl.block_num_entries <= BOA__MAP_BLOCK_MAX_ENTRIES);
 	boa_assert(block_num_slots <= BOA__MAP_BLOCK_MAX_SLOTS);
 
-	if (!boa__map_allocate(&new_map, 0)) return 0;
+	if (!boa__map_allocate(map, 0)) return 0;
 
-	memset(new_map.impl.entry_slot, 0, sizeof(uint16_t) * block_num_slots * new_map.impl.num_hash_blocks);
-	memset(new_map.impl.blocks, 0, sizeof(boa__map_block) * new_map.impl.num_hash_blocks);
+	memset(map->impl.entry_slot, 0, sizeof(uint16_t) * block_num_slots * map->impl.num_hash_blocks);
+	memset(map->impl.blocks, 0, sizeof(boa__map_block) * map->impl.num_hash_blocks);
 
-	// Re-hash previous entries
-	if (map->count > 0) {
-		uint32_t old_block_num_slots = boa__map_block_num_slots(map);
-		uint32_t *hash_cur_slot = map->impl.hash_cur_slot;
-		uint16_t *element_slot = map->impl.entry_slot;
-		for (block_ix = 0; block_ix < num_blocks; block_ix++)
-		{
-			const char *entry = (const char *)map->impl.entries + block_ix * map->impl.block_num_entries * map->entry_size;
-			uint32_t num_elems = map->impl.blocks[block_ix].count;
-			for (elem_ix = 0; elem_ix < num_elems; elem_ix++)
-			{
-				uint32_t hcs = hash_cur_slot[elem_ix];
-				uint16_t es = element_slot[boa__hcs_current_slot(hcs)];
-				uint32_t hash = (es & BOA__MAP_LOWMASK) | (hcs & BOA__MAP_HIGHMASK);
-				boa__map_insert_no_find(&new_map, hash, entry);
-				entry += map->entry_size;
+	return 1;
+}
+
+// Reconstruct the full hash of entry `entry_index` in block `block_ix`
+boa_forceinline uint32_t boa__map_stored_hash(const boa_map *map, uint32_t block_ix, uint32_t entry_index)
+{
+	uint32_t hcs = map->impl.hash_cur_slot[entry_index];
+	uint16_t es = map->impl.entry_slot[block_ix * boa__map_block_num_slots(map) + boa__hcs_current_slot(hcs)];
+	return (es & BOA__MAP_LOWMASK) | (hcs & BOA__MAP_HIGHMASK);
+}
+
+// Re-hash the entries of `src` block `block_ix` into `dst`
+static void boa__map_migrate_block(boa_map *dst, const boa_map *src, uint32_t block_ix)
+{
+	uint32_t block_num_entries = src->impl.block_num_entries;
+	uint32_t entry_index = block_ix * block_num_entries;
+	const char *entry = (const char *)src->impl.entries + entry_index * src->entry_size;
+	uint32_t elem_ix, num_elems = src->impl.blocks[block_ix].count;
+
+	for (elem_ix = 0; elem_ix < num_elems; elem_ix++)
+	{
+		uint32_t hash = boa__map_stored_hash(src, block_ix, entry_index + elem_ix);
+		boa__map_insert_no_find(dst, hash, entry);
+		entry += src->entry_size;
+	}
+}
+
+// Minimum number of source blocks to bother re-hashing in parallel
+#define BOA__MAP_PARALLEL_MIN_BLOCKS 256
+
+typedef struct boa__map_parallel_rehash {
+	boa_map *dst;
+	const boa_map *src;
+	uint32_t num_chunks;          // < Number of jobs the blocks are split into
+	uint32_t src_chunk_blocks;    // < Number of `src` blocks per job
+	uint32_t dst_chunk_blocks;    // < Number of `dst` hash blocks per job
+	uint32_t *offsets;            // < [chunk][dst block]: Entry counts, then write offsets
+	uint32_t *spill_offsets;      // < [chunk]: Start of the chunk in `spill`
+	uint32_t *spill;              // < `src` entry indices that didn't fit in their primary block
+} boa__map_parallel_rehash;
+
+// First pass: Count the entries each chunk of `src` blocks has for each `dst` block
+static void boa__map_parallel_count(void *user, uint32_t chunk)
+{
+	boa__map_parallel_rehash *pr = (boa__map_parallel_rehash*)user;
+	const boa_map *src = pr->src;
+	uint32_t block_mask = pr->dst->impl.num_hash_blocks - 1;
+	uint32_t *counts = pr->offsets + chunk * pr->dst->impl.num_hash_blocks;
+	uint32_t block_ix = chunk * pr->src_chunk_blocks;
+	uint32_t block_end = boa_min(block_ix + pr->src_chunk_blocks, src->impl.num_used_blocks);
+
+	for (; block_ix < block_end; block_ix++) {
+		uint32_t entry_index = block_ix * src->impl.block_num_entries;
+		uint32_t entry_end = entry_index + src->impl.blocks[block_ix].count;
+		for (; entry_index < entry_end; entry_index++) {
+			uint32_t hash = boa__map_stored_hash(src, block_ix, entry_index);
+			counts[(hash >> BOA__MAP_BLOCK_SHIFT) & block_mask]++;
+		}
+	}
+}
+
+// Second pass: Copy the entries to their reserved places in `dst` storing the full hash
+// to `hash_cur_slot`, entries past the end of the primary block are spilled
+static void boa__map_parallel_scatter(void *user, uint32_t chunk)
+{
+	boa__map_parallel_rehash *pr = (boa__map_parallel_rehash*)user;
+	const boa_map *src = pr->src;
+	boa_map *dst = pr->dst;
+	uint32_t block_mask = dst->impl.num_hash_blocks - 1;
+	uint32_t block_num_entries = dst->impl.block_num_entries;
+	uint32_t *offsets = pr->offsets + chunk * dst->impl.num_hash_blocks;
+	uint32_t *spill = pr->spill + pr->spill_offsets[chunk];
+	uint32_t block_ix = chunk * pr->src_chunk_blocks;
+	uint32_t block_end = boa_min(block_ix + pr->src_chunk_blocks, src->impl.num_used_blocks);
+	size_t entry_size = src->entry_size;
+
+	for (; block_ix < block_end; block_ix++) {
+		uint32_t entry_index = block_ix * src->impl.block_num_entries;
+		uint32_t entry_end = entry_index + src->impl.blocks[block_ix].count;
+		for (; entry_index < entry_end; entry_index++) {
+			uint32_t hash = boa__map_stored_hash(src, block_ix, entry_index);
+			uint32_t dst_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
+			uint32_t offset = offsets[dst_ix]++;
+			if (offset < block_num_entries) {
+				uint32_t dst_index = boa__map_entry_index_from_block(dst, dst_ix, offset);
+				memcpy(boa__map_entry_from_index(dst, dst_index), boa__map_entry_from_index(src, entry_index), entry_size);
+				dst->impl.hash_cur_slot[dst_index] = hash;
+			} else {
+				*spill++ = entry_index;
+			}
+		}
+	}
+}
+
+// Third pass: Fill the slots of a chunk of `dst` blocks, all the data is local to the block
+static void boa__map_parallel_place(void *user, uint32_t chunk)
+{
+	boa__map_parallel_rehash *pr = (boa__map_parallel_rehash*)user;
+	boa_map *dst = pr->dst;
+	uint32_t block_num_entries = dst->impl.block_num_entries;
+	uint32_t block_ix = chunk * pr->dst_chunk_blocks;
+	uint32_t block_end = boa_min(block_ix + pr->dst_chunk_blocks, dst->impl.num_hash_blocks);
+
+	for (; block_ix < block_end; block_ix++) {
+		uint32_t offset, block_count = dst->impl.blocks[block_ix].count;
+		uint32_t *hash_cur_slot = dst->impl.hash_cur_slot + block_ix * block_num_entries;
+		for (offset = 0; offset < block_count; offset++) {
+			boa__map_place_slot(dst, block_ix, offset, hash_cur_slot[offset]);
+		}
+	}
+}
+
+// Re-hash all the entries of `src` to the empty table `dst` using the job runner of `src`.
+// Returns 0 without modifying `dst` if the table is too small or out of memory.
+static int boa__map_rehash_parallel(boa_map *dst, const boa_map *src)
+{
+	boa_job_runner *runner = src->impl.job_runner;
+	if (!runner || runner->num_workers <= 1) return 0;
+	if (src->impl.num_used_blocks < BOA__MAP_PARALLEL_MIN_BLOCKS) return 0;
+
+	boa__map_parallel_rehash pr;
+	uint32_t num_dst = dst->impl.num_hash_blocks;
+	uint32_t block_num_entries = dst->impl.block_num_entries;
+	uint32_t num_chunks = runner->num_workers;
+	uint32_t chunk, block_ix, i;
+
+	pr.dst = dst;
+	pr.src = src;
+	pr.num_chunks = num_chunks;
+	pr.src_chunk_blocks = (src->impl.num_used_blocks + num_chunks - 1) / num_chunks;
+	pr.dst_chunk_blocks = (num_dst + num_chunks - 1) / num_chunks;
+	pr.offsets = boa_make_n_ator(uint32_t, (size_t)num_chunks * num_dst + num_chunks, src->ator);
+	if (!pr.offsets) return 0;
+	pr.spill_offsets = pr.offsets + (size_t)num_chunks * num_dst;
+	memset(pr.offsets, 0, sizeof(uint32_t) * ((size_t)num_chunks * num_dst + num_chunks));
+
+	boa_run_jobs(runner, &boa__map_parallel_count, &pr, num_chunks);
+
+	// Turn the counts into write offsets: Each chunk writes after the entries of the previous
+	// chunks to keep the serial insertion order. Count the entries that will be spilled.
+	uint32_t num_spill = 0;
+	for (block_ix = 0; block_ix < num_dst; block_ix++) {
+		uint32_t base = 0;
+		for (chunk = 0; chunk < num_chunks; chunk++) {
+			uint32_t *offset = &pr.offsets[chunk * num_dst + block_ix];
+			uint32_t count = *offset;
+			*offset = base;
+			if (base + count > block_num_entries) {
+				uint32_t num_over = base + count - boa_max(base, block_num_entries);
+				pr.spill_offsets[chunk] += num_over;
+				num_spill += num_over;
 			}
+			base += count;
+		}
+		dst->impl.blocks[block_ix].count = boa_min(base, block_num_entries);
+	}
+
+	pr.spill = boa_make_n_ator(uint32_t, num_spill + 1, src->ator);
+	if (!pr.spill) {
+		memset(dst->impl.blocks, 0, sizeof(boa__map_block) * num_dst);
+		boa_free_ator(src->ator, pr.offsets);
+		return 0;
+	}
+
+	uint32_t spill_base = 0;
+	for (chunk = 0; chunk < num_chunks; chunk++) {
+		uint32_t num = pr.spill_offsets[chunk];
+		pr.spill_offsets[chunk] = spill_base;
+		spill_base += num;
+	}
+
+	boa_run_jobs(runner, &boa__map_parallel_scatter, &pr, num_chunks);
+	boa_run_jobs(runner, &boa__map_parallel_place, &pr, num_chunks);
+
+	// Insert the overflowing entries into auxilary blocks in order
+	for (i = 0; i < num_spill; i++) {
+		uint32_t entry_index = pr.spill[i];
+		uint32_t block_ix = entry_index / src->impl.block_num_entries;
+		uint32_t hash = boa__map_stored_hash(src, block_ix, entry_index);
+		boa__map_insert_no_find(dst, hash, boa__map_entry_from_index(src, entry_index));
+	}
+
+	boa_free_ator(src->ator, pr.spill);
+	boa_free_ator(src->ator, pr.offsets);
+	return 1;
+}
+
+// View to the old table of an incremental rehash as a map
+static boa_map boa__map_rehash_view(const boa_map *map)
+{
+	boa_map old = *map;
+	old.impl = map->impl.rehash->impl;
+	old.impl.filter = NULL;
+	old.count = map->impl.rehash->count;
+	return old;
+}
+
+static void boa__map_rehash_free(boa_map *map)
+{
+	boa__map_rehash *rehash = map->impl.rehash;
+	if (rehash) {
+		boa__map_free_table(map, rehash->impl.blocks);
+		boa_free_ator(map->ator, rehash);
+		map->impl.rehash = NULL;
+	}
+}
+
+// Add the hashes of the entries of a single table of `map` to `filter`
+static void boa__map_filter_add_table(boa_filter *filter, const boa_map *map)
+{
+	uint32_t block_ix, entry_ix;
+	uint32_t block_num_entries = map->impl.block_num_entries;
+	for (block_ix = 0; block_ix < map->impl.num_used_blocks; block_ix++) {
+		uint32_t entry_index = block_ix * block_num_entries;
+		uint32_t count = map->impl.blocks[block_ix].count;
+		for (entry_ix = 0; entry_ix < count; entry_ix++) {
+			boa_filter_add(filter, boa__map_stored_hash(map, block_ix, entry_index + entry_ix));
+		}
+	}
+}
+
+// Refill the attached filter from the entries, including the ones not migrated yet
+static void boa__map_filter_rebuild(boa_map *map)
+{
+	boa_filter *filter = map->impl.filter;
+	boa_filter_clear(filter);
+	boa__map_filter_add_table(filter, map);
+	if (map->impl.rehash) {
+		boa_map old = boa__map_rehash_view(map);
+		boa__map_filter_add_table(filter, &old);
+	}
+}
+
+// Grow the attached filter to the capacity of the map, refilling it if it was
+// re-allocated or `rebuild` is set. Returns 0 if the filter has no memory.
+static int boa__map_filter_fit(boa_map *map, int rebuild)
+{
+	boa_filter *filter = map->impl.filter;
+	if (!filter) return 1;
+
+	if (!filter->words || filter->capacity < map->capacity) {
+		boa_allocator *ator = filter->words ? filter->ator : map->ator;
+		boa_filter grown;
+
+		// If out of memory keep the previous filter: It's still correct, just less selective
+		if (boa_filter_init(&grown, map->capacity, ator)) {
+			boa_filter_reset(filter);
+			*filter = grown;
+			rebuild = 1;
+		}
+	}
+
+	if (!filter->words) return 0;
+	if (rebuild) boa__map_filter_rebuild(map);
+	return 1;
+}
+
+#define boa__map_owns_entry(map, entry) ((char*)(entry) >= (char*)(map)->impl.entries && \
+	(char*)(entry) < (char*)(map)->impl.entries + (size_t)(map)->impl.num_total_blocks * (map)->impl.block_num_entries * (map)->entry_size)
+
+// Re-hash all the entries of `map` to a new table with at least `num_aux` auxilary blocks
+static int boa__map_rehash_to(boa_map *map, uint32_t capacity, uint32_t num_aux)
+{
+	// Finish any incremental rehash first so there's only one table to re-hash
+	boa_map_rehash_step(map, ~0u);
+
+	boa_map new_map = *map;
+
+	uint32_t block_ix;
+	uint32_t num_blocks = map->impl.num_used_blocks;
+	if (capacity < map->count) capacity = map->count;
+
+	if (!boa__map_alloc_table(&new_map, capacity, num_aux)) return 0;
+
+	// Re-hash previous entries
+	if (map->count > 0 && !boa__map_rehash_parallel(&new_map, map)) {
+		for (block_ix = 0; block_ix < num_blocks; block_ix++) {
+			boa__map_migrate_block(&new_map, map, block_ix);
+		}
+	}
+
+	boa__map_free_table(map, map->impl.blocks);
+
+	*map = new_map;
+	boa__map_filter_fit(map, 0);
+	return 1;
+}
+
+int boa_map_reserve(boa_map *map, uint32_t capacity)
+{
+	// Keep the auxilary blocks as the map has needed them before
+	uint32_t num_aux = map->impl.num_total_blocks - map->impl.num_hash_blocks;
+	return boa__map_rehash_to(map, capacity, num_aux);
+}
+
+int boa_map_shrink(boa_map *map)
+{
+	if (map->count == 0) {
+		boa_map_reset(map);
+		return 1;
+	}
+	return boa__map_rehash_to(map, map->count, 0);
+}
+
+int boa_map_compact(boa_map *map)
+{
+	if (!map->impl.blocks) return 1;
+	return boa__map_rehash_to(map, map->capacity, 0);
+}
+
+int boa_map_build(boa_map *map, const void *entries, const uint32_t *hashes, uint32_t count)
+{
+	boa_map new_map = *map;
+	new_map.impl.rehash = NULL;
+	uint32_t i;
+
+	if (!boa__map_alloc_table(&new_map, count, 0)) return 0;
+
+	uint32_t num_blocks = new_map.impl.num_hash_blocks;
+	uint32_t block_mask = num_blocks - 1;
+	uint32_t block_num_entries = new_map.impl.block_num_entries;
+	uint32_t *spill = boa_make_n_ator(uint32_t, count + 1, map->ator);
+	if (!spill) {
+		boa__map_free_table(map, new_map.impl.blocks);
+		return 0;
+	}
+
+	// Scatter the entries directly to their primary blocks in input order, storing the
+	// full hash in `hash_cur_slot` for now. Entries that don't fit are spilled for later.
+	uint32_t num_spill = 0;
+	size_t entry_size = map->entry_size;
+	for (i = 0; i < count; i++) {
+		uint32_t hash = boa__map_hash_canonicalize(hashes[i]);
+		uint32_t block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & block_mask;
+		uint32_t offset = new_map.impl.blocks[block_ix].count;
+		if (offset < block_num_entries) {
+			uint32_t entry_index = boa__map_entry_index_from_block(&new_map, block_ix, offset);
+			memcpy(boa__map_entry_from_index(&new_map, entry_index), (const char*)entries + i * entry_size, entry_size);
+			new_map.impl.hash_cur_slot[entry_index] = hash;
+			new_map.impl.blocks[block_ix].count = offset + 1;
+		} else {
+			spill[num_spill++] = i;
+		}
+	}
 
-			hash_cur_slot += map->impl.block_num_entries;
-			element_slot += old_block_num_slots;
+	// Fill the slots of each block, all the data is local to the block
+	for (i = 0; i < num_blocks; i++) {
+		uint32_t offset, block_count = new_map.impl.blocks[i].count;
+		uint32_t *hash_cur_slot = new_map.impl.hash_cur_slot + i * block_num_entries;
+		for (offset = 0; offset < block_count; offset++) {
+			boa__map_place_slot(&new_map, i, offset, hash_cur_slot[offset]);
 		}
 	}
 
-	if (map->impl.blocks) {
-		boa_free_ator(map->ator, map->impl.blocks);
+	// Insert the overflowing entries into auxilary blocks
+	for (i = 0; i < num_spill; i++) {
+		uint32_t index = spill[i];
+		uint32_t hash = boa__map_hash_canonicalize(hashes[index]);
+		boa__map_insert_no_find(&new_map, hash, (const char*)entries + index * entry_size);
+	}
+
+	new_map.count = count;
+	boa_free_ator(map->ator, spill);
+
+	boa__map_rehash_free(map);
+	boa__map_free_table(map, map->impl.blocks);
+
+	*map = new_map;
+	boa__map_filter_fit(map, 1);
+	return 1;
+}
+
+int boa_map_rehash_step(boa_map *map, uint32_t num_blocks)
+{
+	boa__map_rehash *rehash = map->impl.rehash;
+	if (!rehash) return 0;
+
+	boa_map old = boa__map_rehash_view(map);
+	uint32_t block_num_slots = boa__map_block_num_slots(&old);
+	uint32_t num_used = old.impl.num_used_blocks;
+	if (num_blocks == 0) num_blocks = 1;
+
+	for (; num_blocks > 0 && rehash->next_block < num_used; num_blocks--) {
+		uint32_t block_ix = rehash->next_block++;
+		boa__map_block *block = &old.impl.blocks[block_ix];
+		if (block->count == 0) continue;
+
+		boa__map_migrate_block(map, &old, block_ix);
+
+		// Empty the block so finds to the old table don't see the migrated entries
+		rehash->count -= block->count;
+		block->count = 0;
+		memset(old.impl.entry_slot + block_ix * block_num_slots, 0, sizeof(uint16_t) * block_num_slots);
+	}
+
+	if (rehash->next_block < num_used) return 1;
+
+	boa_assert(rehash->count == 0);
+	boa__map_rehash_free(map);
+	return 0;
+}
+
+// Called when inserting to a full map
+int boa__map_grow(boa_map *map)
+{
+	uint32_t capacity = map->capacity * 2;
+	if (map->impl.incremental_blocks == 0 || map->count == 0) {
+		return boa_map_reserve(map, capacity);
+	}
+
+	// Edge case: Filled the map before the previous rehash finished
+	boa_map_rehash_step(map, ~0u);
+
+	boa__map_rehash *rehash = boa_make_ator(boa__map_rehash, map->ator);
+	if (!rehash) return 0;
+
+	boa_map new_map = *map;
+	uint32_t num_aux = map->impl.num_total_blocks - map->impl.num_hash_blocks;
+	if (!boa__map_alloc_table(&new_map, capacity, num_aux)) {
+		boa_free_ator(map->ator, rehash);
+		return 0;
 	}
 
+	rehash->impl = map->impl;
+	rehash->count = map->count;
+	rehash->next_block = 0;
+	new_map.impl.rehash = rehash;
+
 	*map = new_map;
+	boa__map_filter_fit(map, 0);
 	return 1;
 }
 
+int boa_map_set_filter(boa_map *map, boa_filter *filter)
+{
+	map->impl.filter = filter;
+	if (!boa__map_filter_fit(map, 1)) {
+		map->impl.filter = NULL;
+		return 0;
+	}
+	return 1;
+}
+
+boa_noinline void *boa__map_rehash_find(const boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash)
+{
+	boa_map old = boa__map_rehash_view(map);
+	return boa__map_find_impl(&old, key_ptr, hash, cmp, user, full_hash);
+}
+
+boa_noinline void *boa__map_rehash_insert_step(boa_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, int full_hash)
+{
+	if (!boa_map_rehash_step(map, map->impl.incremental_blocks)) return NULL;
+	return boa__map_rehash_find(map, key_ptr, hash, cmp, user, full_hash);
+}
+
 uint32_t boa__map_find_fallback(boa_map *map, uint32_t block_ix)
 {
 	boa__map_block *block = &map->impl.blocks[block_ix];
@@ -443,7 +968,10 @@ uint32_t boa__map_find_fallback(boa_map *map, uint32_t block_ix)
 				if (num_aux <= 1) num_aux = 2;
 
 				map->impl.num_total_blocks += num_aux;
-				if (!boa__map_allocate(map, prev_blocks)) return ~0u;
+				if (!boa__map_allocate(map, prev_blocks)) {
+					map->impl.num_total_blocks = prev_blocks;
+					return ~0u;
+				}
 
 				// Reload invalidated the pointer
 				block = &map->impl.blocks[block_ix];
@@ -474,32 +1002,66 @@ boa_noinline void *boa_map_find(const boa_map *map, const void *key, uint32_t ha
 	return boa_map_find_inline(map, key, hash, cmp, user);
 }
 
+boa_noinline void boa_map_find_batch(const boa_map *map, void **entries, const void *keys, uint32_t key_stride,
+	const uint32_t *hashes, uint32_t count, boa_map_cmp_fn cmp, void *user)
+{
+	boa_map_find_batch_inline(map, entries, keys, key_stride, hashes, count, cmp, user);
+}
+
+boa_noinline boa_map_insert_result boa_map_insert_fullhash(boa_map *map, const void *key, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa_map_insert_fullhash_inline(map, key, hash, cmp, user);
+}
+
+boa_noinline void *boa_map_find_fullhash(const boa_map *map, const void *key, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa_map_find_fullhash_inline(map, key, hash, cmp, user);
+}
+
 #define boa__map_index_from_entry(map, entry) (uint32_t)(((char*)(entry) - (char*)(map)->impl.entries) / ((map)->entry_size))
 
 boa_map_iterator boa__map_find_block_start(const boa_map *map, uint32_t block_ix)
 {
-	boa__map_block *block = &map->impl.blocks[block_ix];
+	return boa__map_find_block_range(map, block_ix, ~0u);
+}
+
+boa_map_iterator boa__map_find_block_range(const boa_map *map, uint32_t block_ix, uint32_t end_block)
+{
 	uint32_t count = map->impl.num_used_blocks;
+	uint32_t end = end_block < count ? end_block : count;
 	boa_map_iterator result;
 	result.entry = NULL;
 
-	while (block_ix < count) {
-		uint32_t block_count = block->count;
+	for (; block_ix < end; block_ix++) {
+		uint32_t block_count = map->impl.blocks[block_ix].count;
 		if (block_count != 0) {
 			uint32_t entry_index = boa__map_entry_index_from_block(map, block_ix, 0);
 			result.entry = boa__map_entry_from_index(map, entry_index);
 			result.impl_block_end = (char*)result.entry + map->entry_size * block_count;
-			break;
+			return result;
 		}
-		block_ix++;
-		block++;
+	}
+
+	// Continue iterating to the old table, its blocks are numbered after the current ones
+	if (map->impl.rehash && end_block > count) {
+		boa_map old = boa__map_rehash_view(map);
+		if (block_ix < count) block_ix = count;
+		return boa__map_find_block_range(&old, block_ix - count, end_block - count);
 	}
 
 	return result;
 }
 
-void *boa__map_remove_non_iter(boa_map *map, void *entry)
+static void *boa__map_remove_entry(boa_map *map, void *entry)
 {
+	if (map->impl.rehash && !boa__map_owns_entry(map, entry)) {
+		boa_map old = boa__map_rehash_view(map);
+		void *new_block_end = boa__map_remove_entry(&old, entry);
+		map->impl.rehash->count = old.count;
+		map->count--;
+		return new_block_end;
+	}
+
 	uint32_t entry_index = boa__map_index_from_entry(map, entry);
 	uint32_t slot_ix = boa__hcs_current_slot(map->impl.hash_cur_slot[entry_index]);
 	uint32_t block_ix = entry_index >> map->impl.entry_block_shift;
@@ -565,8 +1127,28 @@ void *boa__map_remove_non_iter(boa_map *map, void *entry)
 	return new_block_end;
 }
 
+void *boa__map_remove_non_iter(boa_map *map, void *entry)
+{
+	void *new_block_end = boa__map_remove_entry(map, entry);
+
+	// Removed hashes stay in the filter, rebuild it before it gets too crowded
+	boa_filter *filter = map->impl.filter;
+	if (filter && ++filter->num_stale > map->capacity / 4) {
+		boa__map_filter_rebuild(map);
+	}
+
+	return new_block_end;
+}
+
 boa_map_iterator boa_map_iterate_from(const boa_map *map, const void *entry)
 {
+	if (map->impl.rehash && !boa__map_owns_entry(map, entry)) {
+		boa_map old = boa__map_rehash_view(map);
+		uint32_t entry_index = boa__map_index_from_entry(&old, entry);
+		uint32_t block_ix = entry_index >> old.impl.entry_block_shift;
+		return boa__map_find_block_start(&old, block_ix);
+	}
+
 	uint32_t entry_index = boa__map_index_from_entry(map, entry);
 	uint32_t block_ix = entry_index >> map->impl.entry_block_shift;
 	return boa__map_find_block_start(map, block_ix);
@@ -574,51 +1156,393 @@ boa_map_iterator boa_map_iterate_from(const boa_map *map, const void *entry)
 
 boa_map_iterator boa__map_find_next(const boa_map *map, const void *entry)
 {
+	return boa__map_find_next_in(map, entry, ~0u);
+}
+
+boa_map_iterator boa__map_find_next_in(const boa_map *map, const void *entry, uint32_t end_block)
+{
+	if (map->impl.rehash && !boa__map_owns_entry(map, entry)) {
+		boa_map old = boa__map_rehash_view(map);
+		uint32_t entry_index = boa__map_index_from_entry(&old, entry);
+		uint32_t block_ix = entry_index >> old.impl.entry_block_shift;
+		uint32_t count = map->impl.num_used_blocks;
+		boa_assert(end_block > count);
+		return boa__map_find_block_range(&old, block_ix + 1, end_block - count);
+	}
+
 	uint32_t entry_index = boa__map_index_from_entry(map, entry);
 	uint32_t block_ix = entry_index >> map->impl.entry_block_shift;
-	return boa__map_find_block_start(map, block_ix + 1);
+	return boa__map_find_block_range(map, block_ix + 1, end_block);
+}
+
+boa_map_part boa_map_get_part(const boa_map *map, uint32_t index, uint32_t num_parts)
+{
+	boa_assert(index < num_parts);
+	uint64_t num_blocks = map->impl.blocks ? map->impl.num_used_blocks : 0;
+	if (map->impl.rehash) num_blocks += map->impl.rehash->impl.num_used_blocks;
+
+	boa_map_part part;
+	part.begin_block = (uint32_t)(num_blocks * index / num_parts);
+	part.end_block = (uint32_t)(num_blocks * (index + 1) / num_parts);
+	return part;
 }
 
 void boa_map_clear(boa_map *map)
 {
+	boa__map_rehash_free(map);
 	map->count = 0;
+	map->impl.num_used_blocks = map->impl.num_hash_blocks;
 	uint32_t block_num_slots = boa__map_block_num_slots(map);
 	memset(map->impl.entry_slot, 0, sizeof(uint16_t) * block_num_slots * map->impl.num_hash_blocks);
 	memset(map->impl.blocks, 0, sizeof(boa__map_block) * map->impl.num_hash_blocks);
+	if (map->impl.filter) boa_filter_clear(map->impl.filter);
 }
 
 void boa_map_reset(boa_map *map)
 {
+	boa__map_rehash_free(map);
 	map->count = 0;
 	map->capacity = 0;
-	if (map->impl.blocks) {
-		boa_free_ator(map->ator, map->impl.blocks);
-		map->impl.blocks = NULL;
+	boa__map_free_table(map, map->impl.blocks);
+	map->impl.blocks = NULL;
+	if (map->impl.filter) boa_filter_clear(map->impl.filter);
+}
+
+// Accumulate the scan distances of all the entries in `map`
+static void boa__map_gather_scan_stats(const boa_map *map, boa_map_stats *stats, uint64_t *total_scan)
+{
+	uint32_t block_ix, entry_ix;
+	uint32_t block_num_entries = map->impl.block_num_entries;
+	uint32_t block_num_slots = boa__map_block_num_slots(map);
+	uint32_t slot_mask = block_num_slots - 1;
+
+	for (block_ix = 0; block_ix < map->impl.num_used_blocks; block_ix++) {
+		const uint32_t *hash_cur_slot = map->impl.hash_cur_slot + block_ix * block_num_entries;
+		const uint16_t *entry_slot = map->impl.entry_slot + block_ix * block_num_slots;
+		uint32_t count = map->impl.blocks[block_ix].count;
+
+		for (entry_ix = 0; entry_ix < count; entry_ix++) {
+			uint32_t slot_ix = boa__hcs_current_slot(hash_cur_slot[entry_ix]);
+			uint32_t scan = boa__es_scan_distance(entry_slot[slot_ix], slot_ix, slot_mask);
+			if (scan > stats->max_scan) stats->max_scan = scan;
+			*total_scan += scan;
+		}
 	}
 }
 
-static uint32_t boa__blit_map_hash(const void *key, uint32_t size)
+void boa_map_get_stats(const boa_map *map, boa_map_stats *stats)
 {
-	uint32_t x = 1;
-	const char *pa = (const char*)key;
+	uint32_t block_ix;
+	uint64_t total_scan = 0;
+	memset(stats, 0, sizeof(boa_map_stats));
 
-	if ((size & 3) == 0) {
-		while (size >= 4) {
-			x = boa_hash_combine(x, *(uint32_t*)pa);
+	stats->count = map->count;
+	stats->capacity = map->capacity;
+	if (!map->impl.blocks) return;
 
-			size -= 4;
-			pa += 4;
+	uint32_t block_num_entries = map->impl.block_num_entries;
+	stats->block_num_entries = block_num_entries;
+	stats->num_hash_blocks = map->impl.num_hash_blocks;
+	stats->num_aux_used = map->impl.num_used_blocks - map->impl.num_hash_blocks;
+	stats->num_aux_allocated = map->impl.num_total_blocks - map->impl.num_hash_blocks;
+	stats->memory_bytes = boa__map_get_layout(map, map->impl.num_total_blocks).total_size;
+
+	for (block_ix = 0; block_ix < map->impl.num_used_blocks; block_ix++) {
+		uint32_t count = map->impl.blocks[block_ix].count;
+		uint32_t bucket = count * BOA_MAP_STATS_FILL_BUCKETS / block_num_entries;
+		if (bucket >= BOA_MAP_STATS_FILL_BUCKETS) bucket = BOA_MAP_STATS_FILL_BUCKETS - 1;
+		stats->fill_histogram[bucket]++;
+		if (count == block_num_entries) stats->num_full_blocks++;
+	}
+
+	for (block_ix = 0; block_ix < map->impl.num_hash_blocks; block_ix++) {
+		uint32_t chain = 0;
+		uint32_t aux_ix = map->impl.blocks[block_ix].next_aux;
+		for (; aux_ix != 0; aux_ix = map->impl.blocks[aux_ix].next_aux) {
+			chain++;
 		}
+		if (chain > stats->max_aux_chain) stats->max_aux_chain = chain;
+		stats->avg_aux_chain += (double)chain;
 	}
 
-	while (size > 0) {
-		x = boa_hash_combine(x, (uint32_t)*pa);
+	boa__map_gather_scan_stats(map, stats, &total_scan);
 
-		size -= 1;
-		pa += 1;
+	// The block statistics only cover the current table but the entry ones both
+	if (map->impl.rehash) {
+		boa_map old = boa__map_rehash_view(map);
+		stats->rehash_count = old.count;
+		stats->memory_bytes += sizeof(boa__map_rehash);
+		stats->memory_bytes += boa__map_get_layout(&old, old.impl.num_total_blocks).total_size;
+		boa__map_gather_scan_stats(&old, stats, &total_scan);
+	}
+
+	uint32_t table_count = map->count - stats->rehash_count;
+	stats->avg_block_fill = (double)table_count / ((double)map->impl.num_used_blocks * (double)block_num_entries);
+	stats->avg_aux_chain /= (double)map->impl.num_hash_blocks;
+	if (map->count > 0) {
+		stats->avg_scan = (double)total_scan / (double)map->count;
+		stats->bytes_per_entry = (double)stats->memory_bytes / (double)map->count;
+	}
+}
+
+typedef struct boa__map_snapshot_header {
+	uint32_t magic;   // < BOA__MAP_SNAPSHOT_MAGIC, also detects a different endianness
+	uint32_t version; // < BOA__MAP_SNAPSHOT_VERSION
+	uint32_t lowbits; // < BOA__MAP_LOWBITS of the writer
+	uint32_t entry_size;
+	uint32_t count;
+	uint32_t num_hash_blocks;
+	uint32_t num_blocks;
+	uint32_t block_num_entries;
+	boa__map_layout layout; // < Offsets relative to the end of the header
+	uint32_t hash_seed;
+	uint32_t hash_variant;  // < BOA__HASH_VARIANT of the writer
+} boa__map_snapshot_header;
+
+#define BOA__MAP_SNAPSHOT_MAGIC 0x4d414f42 // 'BOAM'
+#define BOA__MAP_SNAPSHOT_VERSION 2
+
+// Variant of `boa_hash_bytes()`, keys longer than 16 bytes hash differently with AES-NI
+#define BOA__HASH_VARIANT (BOA_AESNI ? 2u : 1u)
+
+uint32_t boa_map_snapshot_size(const boa_map *map)
+{
+	boa__map_layout layout = boa__map_get_layout(map, map->impl.num_used_blocks);
+	return sizeof(boa__map_snapshot_header) + layout.total_size;
+}
+
+uint32_t boa_map_snapshot_write(const boa_map *map, void *dst, uint32_t dst_size)
+{
+	if (map->impl.rehash) return 0;
+
+	uint32_t size = boa_map_snapshot_size(map);
+	if (dst_size < size) return 0;
+	memset(dst, 0, size);
+
+	uint32_t num_blocks = map->impl.num_used_blocks;
+	uint32_t block_num_entries = map->impl.block_num_entries;
+	uint32_t block_num_slots = boa__map_block_num_slots(map);
+
+	boa__map_snapshot_header *header = (boa__map_snapshot_header*)dst;
+	header->magic = BOA__MAP_SNAPSHOT_MAGIC;
+	header->version = BOA__MAP_SNAPSHOT_VERSION;
+	header->lowbits = BOA__MAP_LOWBITS;
+	header->entry_size = map->entry_size;
+	header->count = map->count;
+	header->num_hash_blocks = map->impl.num_hash_blocks;
+	header->num_blocks = num_blocks;
+	header->block_num_entries = block_num_entries;
+	header->layout = boa__map_get_layout(map, num_blocks);
+	header->hash_seed = map->impl.hash_seed;
+	header->hash_variant = BOA__HASH_VARIANT;
+
+	char *base = (char*)(header + 1);
+	memcpy(base + header->layout.block_offset, map->impl.blocks, num_blocks * sizeof(boa__map_block));
+	memcpy(base + header->layout.es_offset, map->impl.entry_slot, num_blocks * block_num_slots * sizeof(uint16_t));
+
+	// Copy only the used entries so the image doesn't contain uninitialized memory
+	uint32_t block_ix;
+	for (block_ix = 0; block_ix < num_blocks; block_ix++) {
+		uint32_t count = map->impl.blocks[block_ix].count;
+		uint32_t first = block_ix * block_num_entries;
+		memcpy(base + header->layout.hcs_offset + first * sizeof(uint32_t),
+			map->impl.hash_cur_slot + first, count * sizeof(uint32_t));
+		memcpy(base + header->layout.entry_offset + first * map->entry_size,
+			boa__map_entry_from_index(map, first), count * map->entry_size);
+	}
+
+	return size;
+}
+
+int boa_map_snapshot_open(boa_map *map, const void *data, uint32_t size)
+{
+	const boa__map_snapshot_header *header = (const boa__map_snapshot_header*)data;
+	if (((uintptr_t)data & 7) != 0) return 0;
+	if (size < sizeof(boa__map_snapshot_header)) return 0;
+	if (header->magic != BOA__MAP_SNAPSHOT_MAGIC) return 0;
+	if (header->version != BOA__MAP_SNAPSHOT_VERSION) return 0;
+	if (header->lowbits != BOA__MAP_LOWBITS) return 0;
+	if (header->entry_size != map->entry_size) return 0;
+	if (header->hash_variant != BOA__HASH_VARIANT) return 0;
+
+	// Validate the geometry, the contents of the arrays are trusted
+	uint32_t num_hash_blocks = header->num_hash_blocks;
+	uint32_t block_num_entries = header->block_num_entries;
+	if (header->num_blocks > 0) {
+		if (num_hash_blocks == 0 || (num_hash_blocks & (num_hash_blocks - 1)) != 0) return 0;
+		if (block_num_entries == 0 || (block_num_entries & (block_num_entries - 1)) != 0) return 0;
+		if (block_num_entries < BOA_MAP_MIN_BLOCK_ENTRIES || block_num_entries > BOA__MAP_BLOCK_MAX_ENTRIES) return 0;
+		if (header->num_blocks < num_hash_blocks) return 0;
+	} else if (header->count > 0) {
+		return 0;
+	}
+
+	// Maps with fixed geometry can only open snapshots with the same block size
+	uint32_t fixed_entries = map->impl.fixed_block_entries;
+	if (fixed_entries && header->num_blocks > 0 && block_num_entries != fixed_entries) return 0;
+
+	boa_map view = *map;
+	view.impl.block_num_entries = (uint8_t)block_num_entries;
+	boa__map_layout layout = boa__map_get_layout(&view, header->num_blocks);
+	if (memcmp(&layout, &header->layout, sizeof(layout)) != 0) return 0;
+	if (size - sizeof(boa__map_snapshot_header) < layout.total_size) return 0;
+
+	boa_map_reset(map);
+
+	const char *base = (const char*)(header + 1);
+	map->ator = boa_null_ator();
+	map->count = header->count;
+	map->capacity = header->count;
+	memset(&map->impl, 0, sizeof(map->impl));
+	map->impl.fixed_block_entries = (uint8_t)fixed_entries;
+	map->impl.num_hash_blocks = num_hash_blocks;
+	map->impl.num_total_blocks = header->num_blocks;
+	map->impl.num_used_blocks = header->num_blocks;
+	map->impl.block_num_entries = (uint8_t)block_num_entries;
+	map->impl.entry_block_shift = block_num_entries ? boa_highest_bit(block_num_entries) : 0;
+	map->impl.blocks = (boa__map_block*)(base + layout.block_offset);
+	map->impl.entry_slot = (uint16_t*)(base + layout.es_offset);
+	map->impl.hash_cur_slot = (uint32_t*)(base + layout.hcs_offset);
+	map->impl.entries = (void*)(base + layout.entry_offset);
+	map->impl.hash_seed = header->hash_seed;
+
+	return 1;
+}
+
+// -- boa_hash
+// Based on wyhash (public domain), with an AES-NI variant for the long keys
+
+#define BOA__HASH_P0 UINT64_C(0xa0761d6478bd642f)
+#define BOA__HASH_P1 UINT64_C(0xe7037ed1a0b428db)
+#define BOA__HASH_P2 UINT64_C(0x8ebc6af09c88c6e3)
+#define BOA__HASH_P3 UINT64_C(0x589965cc75374cc3)
+
+boa_forceinline uint64_t boa__hash_read64(const unsigned char *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+boa_forceinline uint64_t boa__hash_read32(const unsigned char *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+// Full 64x64 -> 128-bit multiply, returns the low half in `a` and the high half in `b`
+boa_forceinline void boa__hash_mum(uint64_t *a, uint64_t *b)
+{
+#if BOA_GNUC && BOA_64BIT
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#elif BOA_MSVC && BOA_64BIT
+	*a = _umul128(*a, *b, b);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), carry = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	carry += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+}
+
+boa_forceinline uint64_t boa__hash_mix(uint64_t a, uint64_t b)
+{
+	boa__hash_mum(&a, &b);
+	return a ^ b;
+}
+
+#if BOA_AESNI
+
+// Hash keys longer than 16 bytes using two independent chains of AES rounds
+boa_forceinline uint64_t boa__hash_long_aes(const unsigned char *p, size_t size, uint64_t seed)
+{
+	__m128i key = _mm_set_epi64x((long long)(seed ^ BOA__HASH_P1), (long long)BOA__HASH_P0);
+	__m128i s0 = _mm_set_epi64x((long long)size, (long long)seed);
+	__m128i s1 = _mm_set_epi64x((long long)(seed ^ BOA__HASH_P2), (long long)(size ^ BOA__HASH_P3));
+
+	const unsigned char *end = p + size;
+	const unsigned char *last = p;
+	if (size > 32) {
+		do {
+			s0 = _mm_aesenc_si128(_mm_xor_si128(s0, _mm_loadu_si128((const __m128i*)p)), key);
+			s1 = _mm_aesenc_si128(_mm_xor_si128(s1, _mm_loadu_si128((const __m128i*)(p + 16))), key);
+			p += 32;
+			size -= 32;
+		} while (size > 32);
+		last = end - 32;
+	}
+
+	// Hash the last 32 bytes which may overlap with the previous blocks or each other
+	s0 = _mm_aesenc_si128(_mm_xor_si128(s0, _mm_loadu_si128((const __m128i*)last)), key);
+	s1 = _mm_aesenc_si128(_mm_xor_si128(s1, _mm_loadu_si128((const __m128i*)(end - 16))), key);
+
+	__m128i s = _mm_aesenc_si128(s0, s1);
+	s = _mm_aesenc_si128(s, key);
+	s = _mm_aesenc_si128(s, key);
+	return (uint64_t)_mm_cvtsi128_si64(_mm_xor_si128(s, _mm_unpackhi_epi64(s, s)));
+}
+
+#endif
+
+boa_forceinline uint64_t boa__hash_bytes_inline(const void *data, size_t size, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	uint64_t a, b;
+
+	seed ^= boa__hash_mix(seed ^ BOA__HASH_P0, BOA__HASH_P1);
+
+	if (size <= 16) {
+		if (size >= 4) {
+			size_t mid = (size >> 3) << 2;
+			a = boa__hash_read32(p) << 32 | boa__hash_read32(p + mid);
+			b = boa__hash_read32(p + size - 4) << 32 | boa__hash_read32(p + size - 4 - mid);
+		} else if (size > 0) {
+			a = (uint64_t)p[0] << 16 | (uint64_t)p[size >> 1] << 8 | p[size - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+#if BOA_AESNI
+		return boa__hash_long_aes(p, size, seed);
+#else
+		size_t left = size;
+		if (left > 48) {
+			uint64_t seed1 = seed, seed2 = seed;
+			do {
+				seed = boa__hash_mix(boa__hash_read64(p) ^ BOA__HASH_P1, boa__hash_read64(p + 8) ^ seed);
+				seed1 = boa__hash_mix(boa__hash_read64(p + 16) ^ BOA__HASH_P2, boa__hash_read64(p + 24) ^ seed1);
+				seed2 = boa__hash_mix(boa__hash_read64(p + 32) ^ BOA__HASH_P3, boa__hash_read64(p + 40) ^ seed2);
+				p += 48;
+				left -= 48;
+			} while (left > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (left > 16) {
+			seed = boa__hash_mix(boa__hash_read64(p) ^ BOA__HASH_P1, boa__hash_read64(p + 8) ^ seed);
+			p += 16;
+			left -= 16;
+		}
+		a = boa__hash_read64(p + left - 16);
+		b = boa__hash_read64(p + left - 8);
+#endif
 	}
 
-	return boa_u32_hash(x);
+	a ^= BOA__HASH_P1;
+	b ^= seed;
+	boa__hash_mum(&a, &b);
+	return boa__hash_mix(a ^ BOA__HASH_P0 ^ size, b ^ BOA__HASH_P1);
+}
+
+uint64_t boa_hash_bytes(const void *data, size_t size, uint64_t seed)
+{
+	return boa__hash_bytes_inline(data, size, seed);
+}
+
+boa_forceinline uint32_t boa__blit_hash(const void *key, uint32_t size, uint32_t seed)
+{
+	uint64_t hash = boa__hash_bytes_inline(key, size, seed);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+boa_forceinline uint32_t boa__blit_map_hash(const boa_map *map, const void *key, uint32_t size)
+{
+	return boa__blit_hash(key, size, map->impl.hash_seed);
 }
 
 static int boa__blit_map_cmp(const void *a, const void *b, void *user)
@@ -659,27 +1583,159 @@ static int boa__blit_map_cmp(const void *a, const void *b, void *user)
 	return 1;
 }
 
+// Keys longer than this compare the full hash before the key data
+#define BOA__BLIT_MAP_FULLHASH_SIZE 8
+
+// Comparisons of fixed size keys, compile to a few loads when inlined
+static int boa__blit4_map_cmp(const void *a, const void *b, void *user)
+{
+	uint32_t x, y;
+	memcpy(&x, a, 4);
+	memcpy(&y, b, 4);
+	return x == y;
+}
+
+static int boa__blit8_map_cmp(const void *a, const void *b, void *user)
+{
+	uint64_t x, y;
+	memcpy(&x, a, 8);
+	memcpy(&y, b, 8);
+	return x == y;
+}
+
+static int boa__blit12_map_cmp(const void *a, const void *b, void *user)
+{
+	uint64_t x0, y0;
+	uint32_t x1, y1;
+	memcpy(&x0, a, 8);
+	memcpy(&y0, b, 8);
+	memcpy(&x1, (const char*)a + 8, 4);
+	memcpy(&y1, (const char*)b + 8, 4);
+	return ((x0 ^ y0) | (x1 ^ y1)) == 0;
+}
+
+static int boa__blit16_map_cmp(const void *a, const void *b, void *user)
+{
+	uint64_t x0, y0, x1, y1;
+	memcpy(&x0, a, 8);
+	memcpy(&y0, b, 8);
+	memcpy(&x1, (const char*)a + 8, 8);
+	memcpy(&y1, (const char*)b + 8, 8);
+	return ((x0 ^ y0) | (x1 ^ y1)) == 0;
+}
+
+boa_noinline boa_map_insert_result boa_blit4_map_insert(boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 4);
+	return boa_map_insert_inline(map, key_ptr, hash, &boa__blit4_map_cmp, NULL);
+}
+
+boa_noinline void *boa_blit4_map_find(const boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 4);
+	return boa_map_find_inline(map, key_ptr, hash, &boa__blit4_map_cmp, NULL);
+}
+
+boa_noinline boa_map_insert_result boa_blit8_map_insert(boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 8);
+	return boa_map_insert_inline(map, key_ptr, hash, &boa__blit8_map_cmp, NULL);
+}
+
+boa_noinline void *boa_blit8_map_find(const boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 8);
+	return boa_map_find_inline(map, key_ptr, hash, &boa__blit8_map_cmp, NULL);
+}
+
+boa_noinline boa_map_insert_result boa_blit12_map_insert(boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 12);
+	return boa_map_insert_fullhash_inline(map, key_ptr, hash, &boa__blit12_map_cmp, NULL);
+}
+
+boa_noinline void *boa_blit12_map_find(const boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 12);
+	return boa_map_find_fullhash_inline(map, key_ptr, hash, &boa__blit12_map_cmp, NULL);
+}
+
+boa_noinline boa_map_insert_result boa_blit16_map_insert(boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 16);
+	return boa_map_insert_fullhash_inline(map, key_ptr, hash, &boa__blit16_map_cmp, NULL);
+}
+
+boa_noinline void *boa_blit16_map_find(const boa_map *map, const void *key_ptr)
+{
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, 16);
+	return boa_map_find_fullhash_inline(map, key_ptr, hash, &boa__blit16_map_cmp, NULL);
+}
+
 boa_noinline boa_map_insert_result boa_blit_map_insert(boa_map *map, const void *key_ptr, uint32_t key_size)
 {
-	uint32_t hash = boa__blit_map_hash(key_ptr, key_size);
-	return boa_map_insert_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+	switch (key_size) {
+	case 4: return boa_blit4_map_insert(map, key_ptr);
+	case 8: return boa_blit8_map_insert(map, key_ptr);
+	case 12: return boa_blit12_map_insert(map, key_ptr);
+	case 16: return boa_blit16_map_insert(map, key_ptr);
+	}
+
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, key_size);
+	if (key_size > BOA__BLIT_MAP_FULLHASH_SIZE) {
+		return boa_map_insert_fullhash_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+	} else {
+		return boa_map_insert_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+	}
 }
 
 boa_noinline void *boa_blit_map_find(const boa_map *map, const void *key_ptr, uint32_t key_size)
 {
-	uint32_t hash = boa__blit_map_hash(key_ptr, key_size);
-	return boa_map_find_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+	switch (key_size) {
+	case 4: return boa_blit4_map_find(map, key_ptr);
+	case 8: return boa_blit8_map_find(map, key_ptr);
+	case 12: return boa_blit12_map_find(map, key_ptr);
+	case 16: return boa_blit16_map_find(map, key_ptr);
+	}
+
+	uint32_t hash = boa__blit_map_hash(map, key_ptr, key_size);
+	if (key_size > BOA__BLIT_MAP_FULLHASH_SIZE) {
+		return boa_map_find_fullhash_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+	} else {
+		return boa_map_find_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+	}
+}
+
+boa_noinline void boa_blit_map_find_batch(const boa_map *map, void **entries, const void *keys, uint32_t key_size, uint32_t count)
+{
+	uint32_t hashes[BOA__MAP_BATCH_SIZE];
+	uint32_t base, i;
+	int full_hash = key_size > BOA__BLIT_MAP_FULLHASH_SIZE;
+
+	for (base = 0; base < count; base += BOA__MAP_BATCH_SIZE) {
+		uint32_t num = count - base;
+		if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+		const char *batch_keys = (const char*)keys + base * key_size;
+
+		for (i = 0; i < num; i++) {
+			hashes[i] = boa__blit_map_hash(map, batch_keys + i * key_size, key_size);
+		}
+
+		boa__map_find_batch_impl(map, entries + base, batch_keys, key_size, hashes, num,
+			&boa__blit_map_cmp, &key_size, full_hash);
+	}
 }
 
-static uint32_t boa__ptr_map_hash(const void *key)
+boa_noinline int boa_blit_map_build(boa_map *map, const void *entries, uint32_t key_size, uint32_t count)
 {
-	uintptr_t up = (uintptr_t)key;
-#if BOA_64BIT
-	uint32_t x = boa_hash_combine((uint32_t)up, (uint32_t)(up >> 32));
-#else
-	uint32_t x = (uint32_t)up;
-#endif
-	return boa_u32_hash(x);
+	uint32_t i, *hashes = boa_make_n_ator(uint32_t, count + 1, map->ator);
+	if (!hashes) return 0;
+	for (i = 0; i < count; i++) {
+		hashes[i] = boa__blit_map_hash(map, (const char*)entries + i * map->entry_size, key_size);
+	}
+	int result = boa_map_build(map, entries, hashes, count);
+	boa_free_ator(map->ator, hashes);
+	return result;
 }
 
 static int boa__ptr_map_cmp(const void *a, const void *b, void *user)
@@ -689,16 +1745,46 @@ static int boa__ptr_map_cmp(const void *a, const void *b, void *user)
 
 boa_noinline boa_map_insert_result boa_ptr_map_insert(boa_map *map, const void *key)
 {
-	uint32_t hash = boa__ptr_map_hash(key);
+	uint32_t hash = boa_ptr_hash(key);
 	return boa_map_insert_inline(map, &key, hash, &boa__ptr_map_cmp, NULL);
 }
 
 boa_noinline void *boa_ptr_map_find(const boa_map *map, const void *key)
 {
-	uint32_t hash = boa__ptr_map_hash(key);
+	uint32_t hash = boa_ptr_hash(key);
 	return boa_map_find_inline(map, &key, hash, &boa__ptr_map_cmp, NULL);
 }
 
+boa_noinline void boa_ptr_map_find_batch(const boa_map *map, void **entries, const void *const *keys, uint32_t count)
+{
+	uint32_t hashes[BOA__MAP_BATCH_SIZE];
+	uint32_t base, i;
+
+	for (base = 0; base < count; base += BOA__MAP_BATCH_SIZE) {
+		uint32_t num = count - base;
+		if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+
+		for (i = 0; i < num; i++) {
+			hashes[i] = boa_ptr_hash(keys[base + i]);
+		}
+
+		boa_map_find_batch_inline(map, entries + base, keys + base, sizeof(void*), hashes, num,
+			&boa__ptr_map_cmp, NULL);
+	}
+}
+
+boa_noinline int boa_ptr_map_build(boa_map *map, const void *entries, uint32_t count)
+{
+	uint32_t i, *hashes = boa_make_n_ator(uint32_t, count + 1, map->ator);
+	if (!hashes) return 0;
+	for (i = 0; i < count; i++) {
+		hashes[i] = boa_ptr_hash(*(const void**)((const char*)entries + i * map->entry_size));
+	}
+	int result = boa_map_build(map, entries, hashes, count);
+	boa_free_ator(map->ator, hashes);
+	return result;
+}
+
 static int boa__u32_map_cmp(const void *a, const void *b, void *user)
 {
 	return *(const uint32_t*)a == *(const uint32_t*)b;
@@ -716,57 +1802,2012 @@ boa_noinline void *boa_u32_map_find(const boa_map *map, uint32_t key)
 	return boa_map_find_inline(map, &key, hash, &boa__u32_map_cmp, NULL);
 }
 
-// -- boa_heap
+boa_noinline void boa_u32_map_find_batch(const boa_map *map, void **entries, const uint32_t *keys, uint32_t count)
+{
+	uint32_t hashes[BOA__MAP_BATCH_SIZE];
+	uint32_t base, i;
 
-void boa_upheap(void *values, uint32_t index, uint32_t size, boa_before_fn before, void *user)
+	for (base = 0; base < count; base += BOA__MAP_BATCH_SIZE) {
+		uint32_t num = count - base;
+		if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+
+		for (i = 0; i < num; i++) {
+			hashes[i] = boa_u32_hash(keys[base + i]);
+		}
+
+		boa_map_find_batch_inline(map, entries + base, keys + base, sizeof(uint32_t), hashes, num,
+			&boa__u32_map_cmp, NULL);
+	}
+}
+
+boa_noinline int boa_u32_map_build(boa_map *map, const void *entries, uint32_t count)
 {
-	return boa_upheap_inline(values, index, size, before, user);
+	uint32_t i, *hashes = boa_make_n_ator(uint32_t, count + 1, map->ator);
+	if (!hashes) return 0;
+	for (i = 0; i < count; i++) {
+		hashes[i] = boa_u32_hash(*(const uint32_t*)((const char*)entries + i * map->entry_size));
+	}
+	int result = boa_map_build(map, entries, hashes, count);
+	boa_free_ator(map->ator, hashes);
+	return result;
 }
 
-void boa_downheap(void *values, uint32_t end, uint32_t index, uint32_t size, boa_before_fn before, void *user)
+// -- boa_frozen_map
+
+#define BOA__FROZEN_MAX_ATTEMPTS 8
+#define BOA__FROZEN_MAX_PILOT 0xffffu
+
+typedef struct boa__frozen_key {
+	uint32_t hash;  // < Canonicalized hash of the entry
+	uint32_t index; // < Index of the entry in `src`
+} boa__frozen_key;
+
+typedef struct boa__frozen_build {
+	boa__frozen_key *keys;    // < [count] Hashes of the entries, sorted by hash
+	boa__frozen_key *tmp;     // < [count] Sort scratch space, reused for `hashes`
+	const void **src;         // < [count] Entries of the source map
+	uint32_t *group_begin;    // < [num_distinct + 1] First key of each distinct hash
+	uint32_t num_distinct;    // < Number of distinct hashes
+	uint32_t num_buckets;
+	uint32_t num_slots;
+	const uint32_t *hashes;   // < [num_distinct] Distinct hashes in sorted order
+	uint32_t *bucket_offsets; // < [num_buckets + 1] Start of each bucket in `members`
+	uint32_t *members;        // < [num_distinct] Indices to `hashes` grouped by bucket
+	uint32_t *order;          // < [num_buckets] Non-empty buckets from largest to smallest
+	uint32_t *taken;          // < [num_slots / 32 + 1] Bitmask of the used slots
+	uint32_t *slot_of;        // < [num_distinct] Slot of each distinct hash
+	uint16_t *pilots;         // < [num_buckets] Result pilots
+} boa__frozen_build;
+
+// Collect the hashes of the entries of a single table of `map`
+static uint32_t boa__frozen_gather(const boa_map *map, boa__frozen_key *keys, const void **src, uint32_t num)
 {
-	return boa_downheap_inline(values, end, index, size, before, user);
+	uint32_t block_ix, entry_ix;
+	uint32_t block_num_entries = map->impl.block_num_entries;
+	for (block_ix = 0; block_ix < map->impl.num_used_blocks; block_ix++) {
+		uint32_t entry_index = block_ix * block_num_entries;
+		uint32_t count = map->impl.blocks[block_ix].count;
+		for (entry_ix = 0; entry_ix < count; entry_ix++) {
+			keys[num].hash = boa__map_stored_hash(map, block_ix, entry_index + entry_ix);
+			keys[num].index = num;
+			src[num] = boa__map_entry_from_index(map, entry_index + entry_ix);
+			num++;
+		}
+	}
+	return num;
 }
 
-// -- boa_arena
+// Sort `keys` by hash using `tmp` as scratch space, the result is in `keys`
+static void boa__frozen_sort(boa__frozen_key *keys, boa__frozen_key *tmp, uint32_t count)
+{
+	uint32_t shift, i;
+	for (shift = 0; shift < 32; shift += 8) {
+		uint32_t offsets[256], pos = 0;
+		memset(offsets, 0, sizeof(offsets));
+		for (i = 0; i < count; i++) {
+			offsets[(keys[i].hash >> shift) & 0xff]++;
+		}
+		for (i = 0; i < 256; i++) {
+			uint32_t num = offsets[i];
+			offsets[i] = pos;
+			pos += num;
+		}
+		for (i = 0; i < count; i++) {
+			tmp[offsets[(keys[i].hash >> shift) & 0xff]++] = keys[i];
+		}
 
-typedef struct boa__arena_page {
-	struct boa__arena_page *next;
-	boa_allocator *ator;
-} boa__arena_page;
+		boa__frozen_key *swap = keys;
+		keys = tmp;
+		tmp = swap;
+	}
+}
 
-void *boa__arena_push_page(boa_arena *arena, uint32_t size)
+// Try to place all the distinct hashes using `seed`, returns 0 if some bucket didn't fit
+static int boa__frozen_place(boa__frozen_build *b, uint32_t seed)
 {
-	uint32_t header_size = boa_align_up(sizeof(boa__arena_page), 8);
-	size = header_size + boa_align_up(size, 8);
+	uint32_t i, j, size, num_order = 0, max_size = 0;
+	uint32_t num_buckets = b->num_buckets, num_slots = b->num_slots;
 
-	uint32_t page_size = arena->impl.cap * 2;
-	if (page_size < 1024) page_size = 1024;
-	if (page_size < size * 2) page_size = size * 2;
+	// Group the hashes by bucket: Count, then fill backwards from the end of each bucket
+	memset(b->bucket_offsets, 0, sizeof(uint32_t) * (num_buckets + 1));
+	for (i = 0; i < b->num_distinct; i++) {
+		b->bucket_offsets[boa__frozen_range(boa__frozen_bucket_hash(b->hashes[i], seed), num_buckets)]++;
+	}
+	for (i = 1; i <= num_buckets; i++) {
+		b->bucket_offsets[i] += b->bucket_offsets[i - 1];
+	}
+	for (i = b->num_distinct; i > 0; i--) {
+		uint32_t bucket = boa__frozen_range(boa__frozen_bucket_hash(b->hashes[i - 1], seed), num_buckets);
+		b->members[--b->bucket_offsets[bucket]] = i - 1;
+	}
 
-	boa__arena_page *prev = (boa__arena_page*)arena->impl.data;
-	boa__arena_page *page = (boa__arena_page*)boa_alloc_ator(arena->ator, page_size);
-	if (page == NULL) return NULL;
+	// Place the largest buckets first while most of the slots are still free
+	for (i = 0; i < num_buckets; i++) {
+		size = b->bucket_offsets[i + 1] - b->bucket_offsets[i];
+		if (size > max_size) max_size = size;
+	}
+	for (size = max_size; size > 0; size--) {
+		for (i = 0; i < num_buckets; i++) {
+			if (b->bucket_offsets[i + 1] - b->bucket_offsets[i] == size) b->order[num_order++] = i;
+		}
+	}
 
-	page->next = prev;
-	page->ator = arena->ator;
+	memset(b->taken, 0, sizeof(uint32_t) * (num_slots / 32 + 1));
+	memset(b->pilots, 0, sizeof(uint16_t) * num_buckets);
+
+	for (i = 0; i < num_order; i++) {
+		uint32_t bucket = b->order[i];
+		const uint32_t *members = b->members + b->bucket_offsets[bucket];
+		size = b->bucket_offsets[bucket + 1] - b->bucket_offsets[bucket];
+
+		uint32_t pilot;
+		for (pilot = 0; pilot <= BOA__FROZEN_MAX_PILOT; pilot++) {
+			uint32_t pilot_hash = boa__frozen_pilot_hash(pilot);
+
+			// Claim slots until one is taken, also catches collisions within the bucket
+			for (j = 0; j < size; j++) {
+				uint32_t slot_hash = boa__frozen_slot_hash(b->hashes[members[j]], seed);
+				uint32_t slot = boa__frozen_range(slot_hash ^ pilot_hash, num_slots);
+				if (b->taken[slot >> 5] & (1u << (slot & 31))) break;
+				b->taken[slot >> 5] |= 1u << (slot & 31);
+				b->slot_of[members[j]] = slot;
+			}
+			if (j == size) break;
 
-	void *ptr = (char*)page + header_size;
-	arena->impl.data = page;
-	arena->impl.pos = size;
-	arena->impl.cap = page_size;
-	return ptr;
+			while (j > 0) {
+				uint32_t slot = b->slot_of[members[--j]];
+				b->taken[slot >> 5] &= ~(1u << (slot & 31));
+			}
+		}
+
+		if (pilot > BOA__FROZEN_MAX_PILOT) return 0;
+		b->pilots[bucket] = (uint16_t)pilot;
+	}
+
+	return 1;
 }
 
-void boa_arena_reset(boa_arena *arena)
+static void boa__frozen_build_free(boa__frozen_build *b, boa_allocator *ator)
 {
-	boa__arena_page *page = (boa__arena_page*)arena->impl.data;
-	while (page != NULL) {
-		void *free_ptr = page;
-		boa_allocator *ator = page->ator;
-		page = page->next;
-		boa_free_ator(ator, free_ptr);
+	if (b->slot_of) boa_free_ator(ator, b->slot_of);
+	if (b->taken) boa_free_ator(ator, b->taken);
+	if (b->order) boa_free_ator(ator, b->order);
+	if (b->members) boa_free_ator(ator, b->members);
+	if (b->bucket_offsets) boa_free_ator(ator, b->bucket_offsets);
+	if (b->group_begin) boa_free_ator(ator, b->group_begin);
+	if (b->src) boa_free_ator(ator, (void*)b->src);
+	if (b->tmp) boa_free_ator(ator, b->tmp);
+	if (b->keys) boa_free_ator(ator, b->keys);
+}
+
+static int boa__frozen_build_table(boa_frozen_map *frozen, const boa_map *map, boa__frozen_build *b, boa_allocator *ator)
+{
+	uint32_t i, j, count = map->count;
+	size_t entry_size = map->entry_size;
+
+	b->keys = boa_make_n_ator(boa__frozen_key, count, ator);
+	b->tmp = boa_make_n_ator(boa__frozen_key, count, ator);
+	b->src = boa_make_n_ator(const void*, count, ator);
+	b->group_begin = boa_make_n_ator(uint32_t, count + 1, ator);
+	if (!b->keys || !b->tmp || !b->src || !b->group_begin) return 0;
+
+	uint32_t num = boa__frozen_gather(map, b->keys, b->src, 0);
+	if (map->impl.rehash) {
+		boa_map old = boa__map_rehash_view(map);
+		num = boa__frozen_gather(&old, b->keys, b->src, num);
+	}
+	boa_assert(num == count);
+	boa__frozen_sort(b->keys, b->tmp, count);
+
+	// Collapse equal hashes to groups of consecutive keys, the sort scratch space is free now
+	const boa__frozen_key *keys = b->keys;
+	uint32_t *hashes = (uint32_t*)b->tmp;
+	uint32_t num_distinct = 0;
+	for (i = 0; i < count; i++) {
+		if (i == 0 || keys[i].hash != keys[i - 1].hash) {
+			hashes[num_distinct] = keys[i].hash;
+			b->group_begin[num_distinct] = i;
+			num_distinct++;
+		}
+	}
+	b->group_begin[num_distinct] = count;
+
+	// Around 4 hashes per bucket and a load factor of 0.89
+	b->num_distinct = num_distinct;
+	b->num_buckets = num_distinct / 4 + 1;
+	b->num_slots = num_distinct + num_distinct / 8 + 1;
+	b->hashes = hashes;
+	b->bucket_offsets = boa_make_n_ator(uint32_t, b->num_buckets + 1, ator);
+	b->members = boa_make_n_ator(uint32_t, num_distinct, ator);
+	b->order = boa_make_n_ator(uint32_t, b->num_buckets, ator);
+	b->taken = boa_make_n_ator(uint32_t, b->num_slots / 32 + 1, ator);
+	b->slot_of = boa_make_n_ator(uint32_t, num_distinct, ator);
+	if (!b->bucket_offsets || !b->members || !b->order || !b->taken || !b->slot_of) return 0;
+
+	// Single allocation for the pilots, slots and entries
+	size_t pilot_size = ((size_t)b->num_buckets * sizeof(uint16_t) + 7) & ~(size_t)7;
+	size_t slot_size = ((size_t)b->num_slots + 1) * sizeof(boa__frozen_slot);
+	char *data = (char*)boa_alloc_ator(ator, pilot_size + slot_size + count * entry_size);
+	if (!data) return 0;
+	b->pilots = (uint16_t*)data;
+
+	uint32_t attempt, seed = 0;
+	for (attempt = 0; attempt < BOA__FROZEN_MAX_ATTEMPTS; attempt++) {
+		seed = attempt * 0x9e3779b9u;
+		if (boa__frozen_place(b, seed)) break;
 	}
+	if (attempt == BOA__FROZEN_MAX_ATTEMPTS) {
+		boa_free_ator(ator, data);
+		return 0;
+	}
+
+	frozen->count = count;
+	frozen->num_buckets = b->num_buckets;
+	frozen->num_slots = b->num_slots;
+	frozen->seed = seed;
+	frozen->pilots = b->pilots;
+	frozen->slots = (boa__frozen_slot*)(data + pilot_size);
+	frozen->entries = data + pilot_size + slot_size;
+	frozen->data = data;
+
+	// Count the entries of each slot and convert the counts to offsets in slot order
+	boa__frozen_slot *slots = frozen->slots;
+	memset(slots, 0, slot_size);
+	for (i = 0; i < num_distinct; i++) {
+		boa__frozen_slot *slot = &slots[b->slot_of[i]];
+		slot->hash = hashes[i];
+		slot->begin = b->group_begin[i + 1] - b->group_begin[i];
+	}
+	uint32_t pos = 0;
+	for (i = 0; i <= b->num_slots; i++) {
+		uint32_t slot_count = slots[i].begin;
+		slots[i].begin = pos;
+		pos += slot_count;
+	}
+
+	for (i = 0; i < num_distinct; i++) {
+		char *dst = (char*)frozen->entries + slots[b->slot_of[i]].begin * entry_size;
+		for (j = b->group_begin[i]; j < b->group_begin[i + 1]; j++) {
+			memcpy(dst, b->src[keys[j].index], entry_size);
+			dst += entry_size;
+		}
+	}
+
+	return 1;
+}
+
+int boa_map_freeze(boa_frozen_map *frozen, const boa_map *map, boa_allocator *ator)
+{
+	memset(frozen, 0, sizeof(boa_frozen_map));
+	frozen->ator = ator;
+	frozen->entry_size = map->entry_size;
+	frozen->hash_seed = map->impl.hash_seed;
+	if (map->count == 0) return 1;
+
+	boa__frozen_build b;
+	memset(&b, 0, sizeof(b));
+	int result = boa__frozen_build_table(frozen, map, &b, ator);
+	boa__frozen_build_free(&b, ator);
+	return result;
+}
+
+void boa_frozen_map_reset(boa_frozen_map *map)
+{
+	if (map->data) {
+		boa_free_ator(map->ator, map->data);
+	}
+	map->data = NULL;
+	map->pilots = NULL;
+	map->slots = NULL;
+	map->entries = NULL;
+	map->count = 0;
+}
+
+boa_noinline void *boa_frozen_map_find(const boa_frozen_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa_frozen_map_find_inline(map, key_ptr, hash, cmp, user);
+}
+
+boa_noinline void *boa_blit_frozen_map_find(const boa_frozen_map *map, const void *key_ptr, uint32_t key_size)
+{
+	uint32_t hash = boa__blit_hash(key_ptr, key_size, map->hash_seed);
+	switch (key_size) {
+	case 4: return boa_frozen_map_find_inline(map, key_ptr, hash, &boa__blit4_map_cmp, NULL);
+	case 8: return boa_frozen_map_find_inline(map, key_ptr, hash, &boa__blit8_map_cmp, NULL);
+	case 12: return boa_frozen_map_find_inline(map, key_ptr, hash, &boa__blit12_map_cmp, NULL);
+	case 16: return boa_frozen_map_find_inline(map, key_ptr, hash, &boa__blit16_map_cmp, NULL);
+	}
+	return boa_frozen_map_find_inline(map, key_ptr, hash, &boa__blit_map_cmp, &key_size);
+}
+
+boa_noinline void *boa_ptr_frozen_map_find(const boa_frozen_map *map, const void *key)
+{
+	uint32_t hash = boa_ptr_hash(key);
+	return boa_frozen_map_find_inline(map, &key, hash, &boa__ptr_map_cmp, NULL);
+}
+
+boa_noinline void *boa_u32_frozen_map_find(const boa_frozen_map *map, uint32_t key)
+{
+	uint32_t hash = boa_u32_hash(key);
+	return boa_frozen_map_find_inline(map, &key, hash, &boa__u32_map_cmp, NULL);
+}
+
+// -- boa_sync_map
+
+boa_forceinline boa__sync_map_shard *boa__sync_map_get_shard(const boa_sync_map *map, uint32_t hash)
+{
+	// Use hash bits mixed from the whole hash as the shard maps use the low bits for
+	// the slots and the high bits for the block index
+	uint32_t ix = ((hash * 0x9e3779b1u) >> 16) & (map->num_shards - 1);
+	return &map->shards[ix];
+}
+
+int boa_sync_map_init(boa_sync_map *map, size_t entry_size, uint32_t num_shards, boa_allocator *ator)
+{
+	uint32_t i;
+	if (num_shards == 0) num_shards = BOA_SYNC_MAP_DEFAULT_SHARDS;
+	if (num_shards > 0x10000) num_shards = 0x10000;
+	num_shards = boa_round_pow2_up(num_shards);
+
+	map->ator = ator;
+	map->entry_size = (uint32_t)entry_size;
+	map->num_shards = num_shards;
+	map->shards = boa_make_n_ator(boa__sync_map_shard, num_shards, ator);
+	if (!map->shards) return 0;
+
+	for (i = 0; i < num_shards; i++) {
+		boa__sync_map_shard *shard = &map->shards[i];
+		shard->lock.locked = 0;
+		boa_map_init_ator(&shard->map, entry_size, ator);
+	}
+	return 1;
+}
+
+void boa_sync_map_reset(boa_sync_map *map)
+{
+	uint32_t i;
+	if (!map->shards) return;
+	for (i = 0; i < map->num_shards; i++) {
+		boa_map_reset(&map->shards[i].map);
+	}
+	boa_free_ator(map->ator, map->shards);
+	map->shards = NULL;
+}
+
+int boa_sync_map_reserve(boa_sync_map *map, uint32_t capacity)
+{
+	uint32_t i, per_shard = capacity / map->num_shards + 1;
+	int result = 1;
+	for (i = 0; i < map->num_shards; i++) {
+		boa__sync_map_shard *shard = &map->shards[i];
+		boa_spinlock_lock(&shard->lock);
+		if (!boa_map_reserve(&shard->map, per_shard)) result = 0;
+		boa_spinlock_unlock(&shard->lock);
+	}
+	return result;
+}
+
+int boa_sync_map_insert(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, const void *entry)
+{
+	boa__sync_map_shard *shard = boa__sync_map_get_shard(map, hash);
+	boa_map_insert_result res;
+	boa_spinlock_lock(&shard->lock);
+	res = boa_map_insert(&shard->map, key_ptr, hash, cmp, user);
+	if (res.inserted) memcpy(res.entry, entry, map->entry_size);
+	boa_spinlock_unlock(&shard->lock);
+	return res.entry ? res.inserted : -1;
+}
+
+int boa_sync_map_update(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user,
+	boa_sync_map_update_fn fn, void *fn_user)
+{
+	boa__sync_map_shard *shard = boa__sync_map_get_shard(map, hash);
+	boa_map_insert_result res;
+	boa_spinlock_lock(&shard->lock);
+	res = boa_map_insert(&shard->map, key_ptr, hash, cmp, user);
+	if (res.entry) fn(res.entry, res.inserted, fn_user);
+	boa_spinlock_unlock(&shard->lock);
+	return res.entry != NULL;
+}
+
+int boa_sync_map_find(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, void *entry_out)
+{
+	boa__sync_map_shard *shard = boa__sync_map_get_shard(map, hash);
+	void *entry;
+	boa_spinlock_lock(&shard->lock);
+	entry = boa_map_find(&shard->map, key_ptr, hash, cmp, user);
+	if (entry && entry_out) memcpy(entry_out, entry, map->entry_size);
+	boa_spinlock_unlock(&shard->lock);
+	return entry != NULL;
+}
+
+int boa_sync_map_remove(boa_sync_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, void *entry_out)
+{
+	boa__sync_map_shard *shard = boa__sync_map_get_shard(map, hash);
+	void *entry;
+	boa_spinlock_lock(&shard->lock);
+	entry = boa_map_find(&shard->map, key_ptr, hash, cmp, user);
+	if (entry) {
+		if (entry_out) memcpy(entry_out, entry, map->entry_size);
+		boa_map_remove(&shard->map, entry);
+	}
+	boa_spinlock_unlock(&shard->lock);
+	return entry != NULL;
+}
+
+uint32_t boa_sync_map_count(boa_sync_map *map)
+{
+	uint32_t i, count = 0;
+	for (i = 0; i < map->num_shards; i++) {
+		boa__sync_map_shard *shard = &map->shards[i];
+		boa_spinlock_lock(&shard->lock);
+		count += shard->map.count;
+		boa_spinlock_unlock(&shard->lock);
+	}
+	return count;
+}
+
+// -- boa_cow_map
+
+#define boa__cow_block_header_size() boa_align_up(sizeof(boa__cow_block), 8)
+
+// Allocate a block owned by `version`, a copy of `src` or empty if NULL
+static boa__cow_block *boa__cow_block_alloc(boa_cow_map *map, const boa__cow_block *src, uint32_t version)
+{
+	boa__cow_block *block = (boa__cow_block*)boa_alloc_ator(map->ator, map->block_size);
+	if (!block) return NULL;
+
+	boa_map *bm = &block->map;
+	if (src) {
+		*bm = src->map;
+	} else {
+		// Single block geometry, the block is never grown as the map handles full blocks
+		boa_map_init_ator(bm, map->entry_size, boa_null_ator());
+		bm->capacity = BOA_COW_MAP_BLOCK_ENTRIES;
+		bm->impl.num_hash_blocks = 1;
+		bm->impl.num_total_blocks = 1;
+		bm->impl.num_used_blocks = 1;
+		bm->impl.block_num_entries = BOA_COW_MAP_BLOCK_ENTRIES;
+		bm->impl.entry_block_shift = boa_highest_bit(BOA_COW_MAP_BLOCK_ENTRIES);
+	}
+
+	boa__map_layout layout = boa__map_get_layout(bm, 1);
+	char *ptr = (char*)block + boa__cow_block_header_size();
+	bm->impl.blocks = (boa__map_block*)(ptr + layout.block_offset);
+	bm->impl.entry_slot = (uint16_t*)(ptr + layout.es_offset);
+	bm->impl.hash_cur_slot = (uint32_t*)(ptr + layout.hcs_offset);
+	bm->impl.entries = (void*)(ptr + layout.entry_offset);
+
+	if (src) {
+		// Metadata, slots and hashes are contiguous, copy only the used entries
+		const char *src_ptr = (const char*)src + boa__cow_block_header_size();
+		memcpy(ptr, src_ptr, layout.entry_offset);
+		memcpy(ptr + layout.entry_offset, src_ptr + layout.entry_offset, (size_t)bm->count * map->entry_size);
+	} else {
+		memset(ptr, 0, layout.hcs_offset);
+	}
+
+	block->version = version;
+	return block;
+}
+
+static boa_cow_version *boa__cow_version_alloc(boa_cow_map *map, uint32_t version, uint32_t num_blocks)
+{
+	size_t size = sizeof(boa_cow_version) + num_blocks * sizeof(boa__cow_block*);
+	boa_cow_version *ver = (boa_cow_version*)boa_alloc_ator(map->ator, size);
+	if (!ver) return NULL;
+	ver->version = version;
+	ver->count = 0;
+	ver->num_blocks = num_blocks;
+	ver->blocks = (boa__cow_block**)(ver + 1);
+	return ver;
+}
+
+// Free a version that was never published with the blocks it owns
+static void boa__cow_version_free_owned(boa_cow_map *map, boa_cow_version *ver)
+{
+	uint32_t i;
+	for (i = 0; i < ver->num_blocks; i++) {
+		boa__cow_block *block = ver->blocks[i];
+		if (block && block->version == ver->version) boa_free_ator(map->ator, block);
+	}
+	boa_free_ator(map->ator, ver);
+}
+
+// Retire `ptr` that versions up to `version` may refer to, space must be reserved
+static void boa__cow_map_retire(boa_cow_map *map, void *ptr, uint32_t version)
+{
+	boa__cow_retired *retired = boa_push(boa__cow_retired, &map->retired);
+	boa_assert(retired != NULL);
+	retired->ptr = ptr;
+	retired->version = version;
+}
+
+// Get the unpublished version of the writer, the first one after a publish shares all
+// the blocks of the published version
+static boa_cow_version *boa__cow_map_get_working(boa_cow_map *map)
+{
+	boa_cow_version *pub = map->published, *work = map->working;
+	if (work) return work;
+
+	if (!boa_reserve(boa__cow_retired, &map->retired)) return NULL;
+	work = boa__cow_version_alloc(map, pub->version + 1, pub->num_blocks);
+	if (!work) return NULL;
+	work->count = pub->count;
+	memcpy(work->blocks, pub->blocks, pub->num_blocks * sizeof(boa__cow_block*));
+
+	boa__cow_map_retire(map, pub, pub->version);
+	map->working = work;
+	return work;
+}
+
+// Get block `block_ix` of `work` for writing, copying it if it's shared with older versions
+static boa__cow_block *boa__cow_map_write_block(boa_cow_map *map, boa_cow_version *work, uint32_t block_ix)
+{
+	boa__cow_block *block = work->blocks[block_ix];
+	if (block->version == work->version) return block;
+
+	if (!boa_reserve(boa__cow_retired, &map->retired)) return NULL;
+	boa__cow_block *copy = boa__cow_block_alloc(map, block, work->version);
+	if (!copy) return NULL;
+
+	boa__cow_map_retire(map, block, work->version - 1);
+	work->blocks[block_ix] = copy;
+	return copy;
+}
+
+// Insert the entries of `src` to empty blocks of `dst`. Returns 0 if out of memory
+// or if a block overflows in which case `*overflow` is set.
+static int boa__cow_map_rehash(boa_cow_map *map, boa_cow_version *dst, const boa_cow_version *src, int *overflow)
+{
+	uint32_t i, entry_ix;
+	uint32_t block_mask = dst->num_blocks - 1;
+
+	for (i = 0; i < dst->num_blocks; i++) {
+		dst->blocks[i] = boa__cow_block_alloc(map, NULL, dst->version);
+		if (!dst->blocks[i]) return 0;
+	}
+
+	for (i = 0; i < src->num_blocks; i++) {
+		const boa_map *sm = &src->blocks[i]->map;
+		for (entry_ix = 0; entry_ix < sm->count; entry_ix++) {
+			uint32_t hash = boa__map_stored_hash(sm, 0, entry_ix);
+			boa_map *dm = &dst->blocks[(hash >> BOA__MAP_BLOCK_SHIFT) & block_mask]->map;
+			if (dm->count >= BOA_COW_MAP_BLOCK_ENTRIES) {
+				*overflow = 1;
+				return 0;
+			}
+			boa__map_insert_no_find(dm, hash, boa__map_entry_from_index(sm, entry_ix));
+			dm->count++;
+		}
+	}
+
+	return 1;
+}
+
+// Replace the working version with one that has more blocks, at least `min_blocks`
+static boa_cow_version *boa__cow_map_grow(boa_cow_map *map, boa_cow_version *work, uint32_t min_blocks)
+{
+	uint32_t i, old_blocks = work->num_blocks;
+	uint32_t num_blocks = old_blocks ? old_blocks * 2 : 1;
+	boa_cow_version *grown;
+	if (num_blocks < min_blocks) num_blocks = min_blocks;
+
+	if (!boa_reserve_n(boa__cow_retired, &map->retired, old_blocks)) return NULL;
+
+	for (;;) {
+		// Out of hash bits to split the blocks with, too many keys with colliding hashes
+		if (num_blocks > 1u << (32 - BOA__MAP_BLOCK_SHIFT)) return NULL;
+
+		grown = boa__cow_version_alloc(map, work->version, num_blocks);
+		if (!grown) return NULL;
+		grown->count = work->count;
+		memset(grown->blocks, 0, num_blocks * sizeof(boa__cow_block*));
+
+		int overflow = 0;
+		if (boa__cow_map_rehash(map, grown, work, &overflow)) break;
+		boa__cow_version_free_owned(map, grown);
+		if (!overflow) return NULL;
+		num_blocks *= 2;
+	}
+
+	for (i = 0; i < old_blocks; i++) {
+		boa__cow_block *block = work->blocks[i];
+		if (block->version == work->version) {
+			boa_free_ator(map->ator, block);
+		} else {
+			boa__cow_map_retire(map, block, work->version - 1);
+		}
+	}
+	boa_free_ator(map->ator, work);
+
+	map->working = grown;
+	return grown;
+}
+
+// Translate `entry` of `src` to the same entry in its copy `dst`
+#define boa__cow_block_translate(dst, src, entry) \
+	(void*)((char*)(dst)->map.impl.entries + ((char*)(entry) - (char*)(src)->map.impl.entries))
+
+int boa_cow_map_init(boa_cow_map *map, size_t entry_size, uint32_t num_readers, boa_allocator *ator)
+{
+	boa_map view;
+	boa_assert(num_readers > 0);
+
+	boa_map_init_ator(&view, entry_size, ator);
+	view.impl.block_num_entries = BOA_COW_MAP_BLOCK_ENTRIES;
+
+	map->ator = ator;
+	map->entry_size = (uint32_t)entry_size;
+	map->num_readers = num_readers;
+	map->block_size = boa__cow_block_header_size() + boa__map_get_layout(&view, 1).total_size;
+	map->working = NULL;
+	map->retired = boa_empty_buf_ator(ator);
+
+	map->readers = boa_make_n_ator(boa_cow_reader, num_readers, ator);
+	if (!map->readers) return 0;
+	memset(map->readers, 0, num_readers * sizeof(boa_cow_reader));
+
+	map->published = boa__cow_version_alloc(map, 1, 0);
+	if (!map->published) {
+		boa_free_ator(ator, map->readers);
+		map->readers = NULL;
+		return 0;
+	}
+	map->published_version = 1;
+	return 1;
+}
+
+void boa_cow_map_reset(boa_cow_map *map)
+{
+	boa_cow_version *live = map->working ? map->working : map->published;
+	boa__cow_retired *retired;
+	uint32_t i;
+	if (!live) return;
+
+	// The blocks of the published version are either shared with the working
+	// version or retired so everything is freed exactly once
+	for (retired = boa_begin(boa__cow_retired, &map->retired); retired != boa_end(boa__cow_retired, &map->retired); retired++) {
+		boa_free_ator(map->ator, retired->ptr);
+	}
+	for (i = 0; i < live->num_blocks; i++) {
+		boa_free_ator(map->ator, live->blocks[i]);
+	}
+	boa_free_ator(map->ator, live);
+	boa_free_ator(map->ator, map->readers);
+	boa_reset(&map->retired);
+
+	map->readers = NULL;
+	map->published = NULL;
+	map->working = NULL;
+}
+
+boa_map_insert_result boa_cow_map_insert(boa_cow_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	boa_map_insert_result result;
+	boa_cow_version *work = boa__cow_map_get_working(map);
+	boa__cow_block *block, *copy;
+	uint32_t block_ix;
+
+	result.entry = NULL;
+	result.inserted = 0;
+	if (!work) return result;
+
+	if (work->num_blocks == 0) {
+		work = boa__cow_map_grow(map, work, 1);
+		if (!work) return result;
+	}
+
+	for (;;) {
+		block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & (work->num_blocks - 1);
+		block = work->blocks[block_ix];
+		if (block->map.count < BOA_COW_MAP_BLOCK_ENTRIES) break;
+
+		// Full block: Existing keys are returned as-is, new ones need a larger table
+		void *entry = boa__map_find_impl(&block->map, key_ptr, hash, cmp, user, 0);
+		if (entry) {
+			copy = boa__cow_map_write_block(map, work, block_ix);
+			if (copy) result.entry = boa__cow_block_translate(copy, block, entry);
+			return result;
+		}
+
+		// Grow just enough to split some entry of the block away from the new key.
+		// If every hash agrees with `hash` on all the block bits no table size helps.
+		uint32_t i, split_bits = 0;
+		for (i = 0; i < block->map.count; i++) {
+			split_bits |= boa__map_stored_hash(&block->map, 0, i) ^ hash;
+		}
+		split_bits >>= BOA__MAP_BLOCK_SHIFT;
+		if (split_bits == 0) return result;
+
+		work = boa__cow_map_grow(map, work, 2u << boa_lowest_bit(split_bits));
+		if (!work) return result;
+	}
+
+	block = boa__cow_map_write_block(map, work, block_ix);
+	if (!block) return result;
+
+	result = boa__map_insert_impl(&block->map, key_ptr, hash, cmp, user, 0);
+	if (result.inserted) work->count++;
+	return result;
+}
+
+int boa_cow_map_remove(boa_cow_map *map, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	const boa_cow_version *cur = boa_cow_map_current(map);
+	boa_cow_version *work;
+	boa__cow_block *block, *copy;
+	uint32_t block_ix;
+	void *entry;
+
+	// Look up the entry first to avoid copying blocks that don't contain the key
+	entry = boa_cow_version_find(cur, key_ptr, hash, cmp, user);
+	if (!entry) return 0;
+
+	work = boa__cow_map_get_working(map);
+	if (!work) return -1;
+
+	block_ix = (hash >> BOA__MAP_BLOCK_SHIFT) & (work->num_blocks - 1);
+	block = work->blocks[block_ix];
+	copy = boa__cow_map_write_block(map, work, block_ix);
+	if (!copy) return -1;
+
+	boa_map_remove(&copy->map, boa__cow_block_translate(copy, block, entry));
+	work->count--;
+	return 1;
+}
+
+void boa_cow_map_publish(boa_cow_map *map)
+{
+	boa_cow_version *work = map->working;
+	if (work) {
+		// Readers load the epoch before the pointer so the pointer has to be stored first
+		boa_atomic_store_ptr((void *volatile*)&map->published, work);
+		boa_atomic_store_u32(&map->published_version, work->version);
+		map->working = NULL;
+	}
+	boa_cow_map_collect(map);
+}
+
+void boa_cow_map_collect(boa_cow_map *map)
+{
+	boa__cow_retired *src, *dst, *end;
+	uint32_t i, oldest = map->published_version;
+
+	// Readers pinned after this point see at least the current version
+	for (i = 0; i < map->num_readers; i++) {
+		uint32_t pinned = boa_atomic_load_u32(&map->readers[i].pinned);
+		if (pinned != 0 && pinned < oldest) oldest = pinned;
+	}
+
+	// Free everything only versions older than the oldest pinned one can refer to
+	dst = boa_begin(boa__cow_retired, &map->retired);
+	end = boa_end(boa__cow_retired, &map->retired);
+	for (src = dst; src != end; src++) {
+		if (src->version < oldest) {
+			boa_free_ator(map->ator, src->ptr);
+		} else {
+			*dst++ = *src;
+		}
+	}
+	map->retired.end_pos = (uint32_t)((char*)dst - (char*)map->retired.data);
+}
+
+// -- boa_agg
+
+void boa_agg_init(boa_agg *agg, const boa_agg_opts *opts, boa_allocator *ator)
+{
+	agg->opts = *opts;
+	agg->stats_offset = boa_align_up(opts->key_size, 8);
+	agg->state_offset = agg->stats_offset + sizeof(boa_agg_stats);
+	uint32_t entry_size = boa_align_up(agg->state_offset + opts->state_size, 8);
+	boa_map_init_ator(&agg->map, entry_size, ator);
+}
+
+void boa_agg_reset(boa_agg *agg)
+{
+	boa_map_reset(&agg->map);
+}
+
+boa_forceinline void boa__agg_update(boa_agg *agg, void *group, int inserted, const void *row)
+{
+	boa_agg_stats *stats = boa_agg_group_stats(agg, group);
+	uint32_t value_offset = agg->opts.value_offset;
+
+	if (inserted) {
+		memcpy(group, row, agg->opts.key_size);
+		memset(stats, 0, sizeof(boa_agg_stats) + agg->opts.state_size);
+		if (value_offset != BOA_AGG_NO_VALUE) {
+			memcpy(&stats->min, (const char*)row + value_offset, sizeof(double));
+			stats->max = stats->min;
+		}
+	}
+
+	stats->count++;
+	if (value_offset != BOA_AGG_NO_VALUE) {
+		double value;
+		memcpy(&value, (const char*)row + value_offset, sizeof(double));
+		stats->sum += value;
+		if (value < stats->min) stats->min = value;
+		if (value > stats->max) stats->max = value;
+	}
+
+	if (agg->opts.update_fn) {
+		agg->opts.update_fn(boa_agg_group_state(agg, group), row, agg->opts.user);
+	}
+}
+
+boa_forceinline void boa__agg_merge_group(boa_agg *agg, void *group, int inserted, const void *src)
+{
+	if (inserted) {
+		memcpy(group, src, agg->map.entry_size);
+		return;
+	}
+
+	boa_agg_stats *dst_stats = boa_agg_group_stats(agg, group);
+	const boa_agg_stats *src_stats = boa_agg_group_stats(agg, (void*)src);
+	dst_stats->count += src_stats->count;
+	dst_stats->sum += src_stats->sum;
+	if (src_stats->min < dst_stats->min) dst_stats->min = src_stats->min;
+	if (src_stats->max > dst_stats->max) dst_stats->max = src_stats->max;
+
+	if (agg->opts.merge_fn) {
+		agg->opts.merge_fn(boa_agg_group_state(agg, group), boa_agg_group_state(agg, (void*)src), agg->opts.user);
+	}
+}
+
+// Upsert `count` keys `stride` bytes apart with `cmp` specialized for the key size. The
+// blocks of a batch of keys are prefetched before inserting any of them. If `merge` is
+// set the keys are groups of a partial aggregate, otherwise rows.
+boa_forceinline int boa__agg_upsert_batch(boa_agg *agg, const void *keys, uint32_t stride, uint32_t count,
+	int merge, boa_map_cmp_fn cmp, void *cmp_user, int full_hash)
+{
+	boa_map *map = &agg->map;
+	uint32_t hashes[BOA__MAP_BATCH_SIZE];
+	uint32_t key_size = agg->opts.key_size;
+	uint32_t base, i;
+
+	for (base = 0; base < count; base += BOA__MAP_BATCH_SIZE) {
+		uint32_t num = count - base;
+		if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+		const char *batch_keys = (const char*)keys + (size_t)base * stride;
+
+		for (i = 0; i < num; i++) {
+			hashes[i] = boa__blit_map_hash(map, batch_keys + i * stride, key_size);
+		}
+
+		boa__map_prefetch_slots(map, hashes, num);
+
+		for (i = 0; i < num; i++) {
+			const char *key = batch_keys + i * stride;
+			boa_map_insert_result res = boa__map_insert_impl(map, key, hashes[i], cmp, cmp_user, full_hash);
+			if (!res.entry) return 0;
+			if (merge) {
+				boa__agg_merge_group(agg, res.entry, res.inserted, key);
+			} else {
+				boa__agg_update(agg, res.entry, res.inserted, key);
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int boa__agg_upsert(boa_agg *agg, const void *keys, uint32_t stride, uint32_t count, int merge)
+{
+	uint32_t key_size = agg->opts.key_size;
+	int full_hash = key_size > BOA__BLIT_MAP_FULLHASH_SIZE;
+	switch (key_size) {
+	case 4: return boa__agg_upsert_batch(agg, keys, stride, count, merge, &boa__blit4_map_cmp, NULL, 0);
+	case 8: return boa__agg_upsert_batch(agg, keys, stride, count, merge, &boa__blit8_map_cmp, NULL, 0);
+	case 12: return boa__agg_upsert_batch(agg, keys, stride, count, merge, &boa__blit12_map_cmp, NULL, 1);
+	case 16: return boa__agg_upsert_batch(agg, keys, stride, count, merge, &boa__blit16_map_cmp, NULL, 1);
+	default: return boa__agg_upsert_batch(agg, keys, stride, count, merge, &boa__blit_map_cmp, &key_size, full_hash);
+	}
+}
+
+boa_noinline void *boa_agg_add(boa_agg *agg, const void *row)
+{
+	boa_map_insert_result res = boa_blit_map_insert(&agg->map, row, agg->opts.key_size);
+	if (res.entry) boa__agg_update(agg, res.entry, res.inserted, row);
+	return res.entry;
+}
+
+int boa_agg_add_batch(boa_agg *agg, const void *rows, uint32_t count)
+{
+	return boa__agg_upsert(agg, rows, agg->opts.row_size, count, 0);
+}
+
+int boa_agg_merge(boa_agg *agg, const boa_agg *src)
+{
+	boa_assert(agg->map.entry_size == src->map.entry_size);
+	boa_assert(agg->opts.key_size == src->opts.key_size);
+	if (src->map.count == 0) return 1;
+
+	// The groups of a block are contiguous so merge them a block at a time
+	if (src->map.count > agg->map.capacity) {
+		if (!boa_map_reserve(&agg->map, src->map.count)) return 0;
+	}
+
+	boa_map_iterator it = boa_map_begin(&src->map);
+	while (it.entry) {
+		uint32_t num = (uint32_t)(((char*)it.impl_block_end - (char*)it.entry) / src->map.entry_size);
+		if (!boa__agg_upsert(agg, it.entry, src->map.entry_size, num, 1)) return 0;
+		it = boa__map_find_next(&src->map, (char*)it.impl_block_end - src->map.entry_size);
+	}
+
+	return 1;
+}
+
+boa_noinline void *boa_agg_find(const boa_agg *agg, const void *key)
+{
+	return boa_blit_map_find(&agg->map, key, agg->opts.key_size);
+}
+
+// -- boa_join
+
+// Target number of build rows per partition, keeps the partition map in L2
+#define BOA__JOIN_PARTITION_ROWS 4096
+#define BOA__JOIN_MAX_RADIX_BITS 14
+
+typedef struct boa__join_item {
+	uint32_t hash;
+	uint32_t index;
+} boa__join_item;
+
+typedef struct boa__join_side {
+	const char *rows;
+	uint32_t count;
+	uint32_t stride;
+	boa__join_item *items;  // < Hashes and indices of the rows sorted by partition
+	uint32_t *offsets;      // < Start of each partition in `items`, `num_parts + 1` entries
+} boa__join_side;
+
+boa_forceinline uint32_t boa__join_hash(const void *key, uint32_t key_size)
+{
+	uint64_t hash = boa__hash_bytes_inline(key, key_size, 0);
+	return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// Hash the rows of `side` and scatter them to `1 << bits` partitions by the top hash bits
+static int boa__join_partition(boa__join_side *side, uint32_t key_size, uint32_t bits, boa_allocator *ator)
+{
+	uint32_t num_parts = 1u << bits, i;
+	side->items = boa_make_n_ator(boa__join_item, side->count + 1, ator);
+	side->offsets = boa_make_n_ator(uint32_t, num_parts + 1, ator);
+	if (!side->items || !side->offsets) return 0;
+
+	if (bits == 0) {
+		for (i = 0; i < side->count; i++) {
+			side->items[i].hash = boa__join_hash(side->rows + (size_t)i * side->stride, key_size);
+			side->items[i].index = i;
+		}
+		side->offsets[0] = 0;
+		side->offsets[1] = side->count;
+		return 1;
+	}
+
+	uint32_t *hashes = boa_make_n_ator(uint32_t, side->count + 1, ator);
+	if (!hashes) return 0;
+
+	uint32_t shift = 32 - bits;
+	memset(side->offsets, 0, sizeof(uint32_t) * (num_parts + 1));
+	for (i = 0; i < side->count; i++) {
+		uint32_t hash = boa__join_hash(side->rows + (size_t)i * side->stride, key_size);
+		hashes[i] = hash;
+		side->offsets[(hash >> shift) + 1]++;
+	}
+	for (i = 0; i < num_parts; i++) {
+		side->offsets[i + 1] += side->offsets[i];
+	}
+
+	// Use the end of the previous partition as the write cursor and restore it afterwards
+	for (i = 0; i < side->count; i++) {
+		uint32_t hash = hashes[i];
+		boa__join_item *item = &side->items[side->offsets[hash >> shift]++];
+		item->hash = hash;
+		item->index = i;
+	}
+	for (i = num_parts; i > 0; i--) {
+		side->offsets[i] = side->offsets[i - 1];
+	}
+	side->offsets[0] = 0;
+
+	boa_free_ator(ator, hashes);
+	return 1;
+}
+
+boa_forceinline int boa__hash_join_impl(boa_buf *out, boa__join_side *build, boa__join_side *probe,
+	uint32_t num_parts, uint32_t key_size, boa_allocator *ator,
+	boa_map_cmp_fn cmp, void *cmp_user, int full_hash)
+{
+	// Map entries are the key followed by the index of the first build row with the key,
+	// the rest of the rows with the same key are linked through `next`
+	uint32_t first_offset = boa_align_up(key_size, 4);
+	uint32_t *next = boa_make_n_ator(uint32_t, build->count + 1, ator);
+	if (!next) return 0;
+
+	boa_map map;
+	boa_map_init_ator(&map, first_offset + sizeof(uint32_t), ator);
+	int result = 1;
+	uint32_t part, i, base;
+
+	for (part = 0; part < num_parts && result; part++) {
+		const boa__join_item *build_items = build->items + build->offsets[part];
+		uint32_t build_num = build->offsets[part + 1] - build->offsets[part];
+		const boa__join_item *probe_items = probe->items + probe->offsets[part];
+		uint32_t probe_num = probe->offsets[part + 1] - probe->offsets[part];
+		if (build_num == 0 || probe_num == 0) continue;
+
+		if (map.count > 0) boa_map_clear(&map);
+		if (build_num > map.capacity && !boa_map_reserve(&map, build_num)) {
+			result = 0;
+			break;
+		}
+
+		for (i = 0; i < build_num; i++) {
+			uint32_t index = build_items[i].index;
+			const char *row = build->rows + (size_t)index * build->stride;
+			boa_map_insert_result res = boa__map_insert_impl(&map, row, build_items[i].hash, cmp, cmp_user, full_hash);
+			if (!res.entry) {
+				result = 0;
+				break;
+			}
+			uint32_t *first = (uint32_t*)((char*)res.entry + first_offset);
+			if (res.inserted) {
+				memcpy(res.entry, row, key_size);
+				next[index] = ~0u;
+			} else {
+				next[index] = *first;
+			}
+			*first = index;
+		}
+		if (!result) break;
+
+		for (base = 0; base < probe_num && result; base += BOA__MAP_BATCH_SIZE) {
+			uint32_t num = probe_num - base;
+			if (num > BOA__MAP_BATCH_SIZE) num = BOA__MAP_BATCH_SIZE;
+			const boa__join_item *batch = probe_items + base;
+
+			// Start loading the probe rows, block headers and initial slots of the batch
+			uint32_t batch_hashes[BOA__MAP_BATCH_SIZE];
+			for (i = 0; i < num; i++) {
+				boa_prefetch(probe->rows + (size_t)batch[i].index * probe->stride);
+				batch_hashes[i] = batch[i].hash;
+			}
+			boa__map_prefetch_slots(&map, batch_hashes, num);
+
+			for (i = 0; i < num; i++) {
+				uint32_t probe_index = batch[i].index;
+				const char *row = probe->rows + (size_t)probe_index * probe->stride;
+				void *entry = boa__map_find_impl(&map, row, batch[i].hash, cmp, cmp_user, full_hash);
+				if (!entry) continue;
+
+				uint32_t build_index = *(uint32_t*)((char*)entry + first_offset);
+				do {
+					boa_join_pair *pair = boa_push(boa_join_pair, out);
+					if (!pair) {
+						result = 0;
+						break;
+					}
+					pair->build_index = build_index;
+					pair->probe_index = probe_index;
+					build_index = next[build_index];
+				} while (build_index != ~0u);
+				if (!result) break;
+			}
+		}
+	}
+
+	boa_map_reset(&map);
+	boa_free_ator(ator, next);
+	return result;
+}
+
+int boa_hash_join(boa_buf *out, const void *build_rows, uint32_t build_count,
+	const void *probe_rows, uint32_t probe_count, const boa_join_opts *opts)
+{
+	if (build_count == 0 || probe_count == 0) return 1;
+
+	uint32_t key_size = opts->key_size;
+	uint32_t bits = opts->radix_bits;
+	if (bits == BOA_JOIN_AUTO_RADIX) {
+		while (bits < BOA__JOIN_MAX_RADIX_BITS && (build_count >> bits) > BOA__JOIN_PARTITION_ROWS * 2) {
+			bits++;
+		}
+	} else if (bits == BOA_JOIN_NO_PARTITIONS) {
+		bits = 0;
+	} else if (bits > BOA__JOIN_MAX_RADIX_BITS) {
+		bits = BOA__JOIN_MAX_RADIX_BITS;
+	}
+
+	boa__join_side build = { (const char*)build_rows, build_count, opts->build_stride };
+	boa__join_side probe = { (const char*)probe_rows, probe_count, opts->probe_stride };
+	uint32_t num_parts = 1u << bits;
+	int result = boa__join_partition(&build, key_size, bits, opts->ator)
+		&& boa__join_partition(&probe, key_size, bits, opts->ator);
+
+	if (result) {
+		int full_hash = key_size > BOA__BLIT_MAP_FULLHASH_SIZE;
+		switch (key_size) {
+		case 4: result = boa__hash_join_impl(out, &build, &probe, num_parts, key_size, opts->ator, &boa__blit4_map_cmp, NULL, 0); break;
+		case 8: result = boa__hash_join_impl(out, &build, &probe, num_parts, key_size, opts->ator, &boa__blit8_map_cmp, NULL, 0); break;
+		case 12: result = boa__hash_join_impl(out, &build, &probe, num_parts, key_size, opts->ator, &boa__blit12_map_cmp, NULL, 1); break;
+		case 16: result = boa__hash_join_impl(out, &build, &probe, num_parts, key_size, opts->ator, &boa__blit16_map_cmp, NULL, 1); break;
+		default: result = boa__hash_join_impl(out, &build, &probe, num_parts, key_size, opts->ator, &boa__blit_map_cmp, &key_size, full_hash); break;
+		}
+	}
+
+	if (build.items) boa_free_ator(opts->ator, build.items);
+	if (build.offsets) boa_free_ator(opts->ator, build.offsets);
+	if (probe.items) boa_free_ator(opts->ator, probe.items);
+	if (probe.offsets) boa_free_ator(opts->ator, probe.offsets);
+	return result;
+}
+
+// -- boa_heap
+
+void boa_upheap(void *values, uint32_t index, uint32_t size, boa_before_fn before, void *user)
+{
+	return boa_upheap_inline(values, index, size, before, user);
+}
+
+void boa_downheap(void *values, uint32_t end, uint32_t index, uint32_t size, boa_before_fn before, void *user)
+{
+	return boa_downheap_inline(values, end, index, size, before, user);
+}
+
+// -- boa_arena
+
+typedef struct boa__arena_page {
+	struct boa__arena_page *next;
+	boa_allocator *ator;
+} boa__arena_page;
+
+void *boa__arena_push_page(boa_arena *arena, uint32_t size)
+{
+	uint32_t header_size = boa_align_up(sizeof(boa__arena_page), 8);
+	size = header_size + boa_align_up(size, 8);
+
+	uint32_t page_size = arena->impl.cap * 2;
+	if (page_size < 1024) page_size = 1024;
+	if (page_size < size * 2) page_size = size * 2;
+
+	boa__arena_page *prev = (boa__arena_page*)arena->impl.data;
+	boa__arena_page *page = (boa__arena_page*)boa_alloc_ator(arena->ator, page_size);
+	if (page == NULL) return NULL;
+
+	page->next = prev;
+	page->ator = arena->ator;
+
+	void *ptr = (char*)page + header_size;
+	arena->impl.data = page;
+	arena->impl.pos = size;
+	arena->impl.cap = page_size;
+	return ptr;
+}
+
+void boa_arena_reset(boa_arena *arena)
+{
+	boa__arena_page *page = (boa__arena_page*)arena->impl.data;
+	while (page != NULL) {
+		void *free_ptr = page;
+		boa_allocator *ator = page->ator;
+		page = page->next;
+		boa_free_ator(ator, free_ptr);
+	}
+}
+
+// -- boa_str_map
+
+void boa_str_map_reset(boa_str_map *map)
+{
+	boa_map_reset(&map->map);
+	boa_arena_reset(&map->arena);
+	boa_arena_init_ator(&map->arena, map->map.ator);
+}
+
+void boa_str_map_clear(boa_str_map *map)
+{
+	boa_map_clear(&map->map);
+	boa_arena_reset(&map->arena);
+	boa_arena_init_ator(&map->arena, map->map.ator);
+}
+
+boa_noinline boa_map_insert_result boa_str_map_insert(boa_str_map *map, const char *data, uint32_t length)
+{
+	boa_str_key key;
+	key.data = data;
+	key.length = length;
+	key.hash = boa_str_map_hash(map, data, length);
+	boa_map_insert_result res = boa_map_insert_fullhash_inline(&map->map, &key, key.hash, &boa__str_map_cmp, NULL);
+	if (!res.inserted) return res;
+
+	char *copy = (char*)boa_arena_push_size(&map->arena, length + 1, 1);
+	if (!copy) {
+		boa_map_remove(&map->map, res.entry);
+		res.entry = NULL;
+		res.inserted = 0;
+		return res;
+	}
+	memcpy(copy, data, length);
+	copy[length] = '\0';
+
+	key.data = copy;
+	memcpy(res.entry, &key, sizeof(boa_str_key));
+	return res;
+}
+
+boa_noinline void *boa_str_map_find(const boa_str_map *map, const char *data, uint32_t length)
+{
+	return boa_str_map_find_inline(map, data, length);
+}
+
+// -- boa_intern
+
+void boa_intern_init(boa_intern *intern, int thread_safe, boa_allocator *ator)
+{
+	boa_str_map_init(&intern->map, sizeof(boa__intern_entry), ator);
+	intern->strings = boa_empty_buf_ator(ator);
+	intern->lock.locked = 0;
+	intern->thread_safe = thread_safe;
+}
+
+void boa_intern_reset(boa_intern *intern)
+{
+	boa_str_map_reset(&intern->map);
+	boa_reset(&intern->strings);
+}
+
+// Find or insert the string with the lock held if thread-safe
+static uint32_t boa__intern_insert(boa_intern *intern, const char *data, uint32_t length)
+{
+	boa_map_insert_result res = boa_str_map_insert(&intern->map, data, length);
+	boa__intern_entry *entry = (boa__intern_entry*)res.entry;
+	if (!entry) return BOA_INTERN_INVALID_ID;
+	if (!res.inserted) return entry->id;
+
+	uint32_t id = (uint32_t)boa_count(boa_str_key, &intern->strings);
+	if (!boa_buf_push_data(&intern->strings, &entry->key, sizeof(boa_str_key))) {
+		boa_str_map_remove(&intern->map, entry);
+		return BOA_INTERN_INVALID_ID;
+	}
+	entry->id = id;
+	return id;
+}
+
+uint32_t boa_intern_str(boa_intern *intern, const char *data, uint32_t length)
+{
+	if (intern->thread_safe) boa_spinlock_lock(&intern->lock);
+	uint32_t id = boa__intern_insert(intern, data, length);
+	if (intern->thread_safe) boa_spinlock_unlock(&intern->lock);
+	return id;
+}
+
+uint32_t boa_intern_find(boa_intern *intern, const char *data, uint32_t length)
+{
+	if (intern->thread_safe) boa_spinlock_lock(&intern->lock);
+	boa__intern_entry *entry = (boa__intern_entry*)boa_str_map_find_inline(&intern->map, data, length);
+	uint32_t id = entry ? entry->id : BOA_INTERN_INVALID_ID;
+	if (intern->thread_safe) boa_spinlock_unlock(&intern->lock);
+	return id;
+}
+
+int boa_intern_bulk(boa_intern *intern, uint32_t *ids, const char *const *strings, const uint32_t *lengths, uint32_t count)
+{
+	uint32_t i;
+	int result = 1;
+	if (intern->thread_safe) boa_spinlock_lock(&intern->lock);
+
+	for (i = 0; i < count; i++) {
+		uint32_t length = lengths ? lengths[i] : (uint32_t)strlen(strings[i]);
+		ids[i] = boa__intern_insert(intern, strings[i], length);
+		if (ids[i] == BOA_INTERN_INVALID_ID) result = 0;
+	}
+
+	if (intern->thread_safe) boa_spinlock_unlock(&intern->lock);
+	return result;
+}
+
+// -- boa_btree
+
+static uint32_t boa__btree_column_size(uint32_t key_type, uint32_t cap)
+{
+	return key_type ? boa_align_up((cap + BOA__BTREE_KEY_PAD) * key_type, 8) : 0;
+}
+
+static uint32_t boa__btree_leaf_size(uint32_t entry_size, uint32_t key_type, uint32_t cap)
+{
+	return boa_align_up(sizeof(boa__btree_node), 8) + boa__btree_column_size(key_type, cap) + cap * entry_size;
+}
+
+static uint32_t boa__btree_inner_size(uint32_t entry_size, uint32_t key_type, uint32_t cap)
+{
+	return boa_align_up(sizeof(boa__btree_node), 8) + boa__btree_column_size(key_type, cap)
+		+ boa_align_up(cap * entry_size, 8) + (cap + 1) * (uint32_t)sizeof(boa__btree_node*);
+}
+
+void boa_btree_init(boa_btree *tree, size_t entry_size, uint32_t key_type, uint32_t node_size, boa_allocator *ator)
+{
+	boa_assert(key_type == BOA_BTREE_KEY_ANY || key_type == BOA_BTREE_KEY_U32 || key_type == BOA_BTREE_KEY_U64);
+	boa_assert(entry_size >= key_type);
+	uint32_t es = (uint32_t)entry_size;
+	uint32_t header = boa_align_up(sizeof(boa__btree_node), 8);
+	if (node_size == 0) node_size = BOA_BTREE_DEFAULT_NODE_SIZE;
+
+	// Start from an estimate of the largest capacity that fits and adjust for padding
+	uint32_t overhead = header + boa__btree_column_size(key_type, 0) + 8;
+	uint32_t leaf_cap = node_size > overhead ? (node_size - overhead) / (es + key_type) : 0;
+	uint32_t inner_cap = node_size > overhead + 8 ? (node_size - overhead - 8) / (es + key_type + 8) : 0;
+	leaf_cap = boa_max(leaf_cap + 1, 4);
+	inner_cap = boa_max(inner_cap + 1, 4);
+	while (leaf_cap > 4 && boa__btree_leaf_size(es, key_type, leaf_cap) > node_size) leaf_cap--;
+	while (inner_cap > 4 && boa__btree_inner_size(es, key_type, inner_cap) > node_size) inner_cap--;
+
+	tree->ator = ator;
+	tree->entry_size = es;
+	tree->count = 0;
+	tree->impl.root = NULL;
+	tree->impl.height = 0;
+	tree->impl.key_type = key_type;
+	tree->impl.leaf_cap = leaf_cap;
+	tree->impl.inner_cap = inner_cap;
+	tree->impl.leaf_size = boa__btree_leaf_size(es, key_type, leaf_cap);
+	tree->impl.inner_size = boa__btree_inner_size(es, key_type, inner_cap);
+	tree->impl.key_offset = header;
+	tree->impl.leaf_entry_offset = header + boa__btree_column_size(key_type, leaf_cap);
+	tree->impl.inner_entry_offset = header + boa__btree_column_size(key_type, inner_cap);
+	tree->impl.child_offset = tree->impl.inner_entry_offset + boa_align_up(inner_cap * es, 8);
+}
+
+static boa__btree_node *boa__btree_alloc_node(boa_btree *tree, int leaf)
+{
+	uint32_t size = leaf ? tree->impl.leaf_size : tree->impl.inner_size;
+	boa__btree_node *node = (boa__btree_node*)boa_alloc_ator(tree->ator, size);
+	if (!node) return NULL;
+	node->count = 0;
+	node->leaf = (uint32_t)leaf;
+	node->prev = NULL;
+	node->next = NULL;
+	return node;
+}
+
+static void boa__btree_free_node(boa_btree *tree, boa__btree_node *node, uint32_t height)
+{
+	if (height > 0) {
+		boa__btree_node **children = boa__btree_children(tree, node);
+		uint32_t i;
+		for (i = 0; i <= node->count; i++) {
+			boa__btree_free_node(tree, children[i], height - 1);
+		}
+	}
+	boa_free_ator(tree->ator, node);
+}
+
+void boa_btree_reset(boa_btree *tree)
+{
+	if (tree->impl.root) boa__btree_free_node(tree, tree->impl.root, tree->impl.height);
+	tree->impl.root = NULL;
+	tree->impl.height = 0;
+	tree->count = 0;
+}
+
+// Insert separator `sep` with key column value `sep_key` and right child `child` at `pos`
+// of a non-full inner `node`
+static void boa__btree_inner_insert_at(boa_btree *tree, boa__btree_node *node, uint32_t pos,
+	const char *sep, const char *sep_key, boa__btree_node *child)
+{
+	uint32_t num_move = node->count - pos, es = tree->entry_size, key_size = tree->impl.key_type;
+	boa__btree_node **children = boa__btree_children(tree, node);
+	char *dst = boa__btree_sep(tree, node, pos);
+	memmove(dst + es, dst, (size_t)num_move * es);
+	memcpy(dst, sep, es);
+	if (key_size) {
+		char *key = boa__btree_keys(tree, node) + (size_t)pos * key_size;
+		memmove(key + key_size, key, (size_t)num_move * key_size);
+		memcpy(key, sep_key, key_size);
+	}
+	memmove(children + pos + 2, children + pos + 1, num_move * sizeof(boa__btree_node*));
+	children[pos + 1] = child;
+	node->count++;
+}
+
+boa_noinline boa_map_insert_result boa__btree_insert_split(boa_btree *tree, boa__btree_path *path,
+	boa__btree_node *leaf, uint32_t pos, const void *key_ptr)
+{
+	boa_map_insert_result result;
+	result.entry = NULL;
+	result.inserted = 0;
+
+	if (!leaf) {
+		leaf = boa__btree_alloc_node(tree, 1);
+		if (!leaf) return result;
+		tree->impl.root = leaf;
+		tree->impl.height = 0;
+		result.entry = boa__btree_leaf_insert_at(tree, leaf, 0, key_ptr);
+		result.inserted = 1;
+		return result;
+	}
+
+	// Allocate all the nodes up front so running out of memory leaves the tree intact
+	boa__btree_node *spare[BOA__BTREE_MAX_HEIGHT + 1];
+	uint32_t height = tree->impl.height, inner_cap = tree->impl.inner_cap;
+	uint32_t level = height, num_spare = 0, spare_ix = 0, i;
+	while (level > 0 && path->nodes[level - 1]->count == inner_cap) {
+		level--;
+		num_spare++;
+	}
+	if (level == 0) {
+		if (height == BOA__BTREE_MAX_HEIGHT) return result;
+		num_spare++;
+	}
+
+	boa__btree_node *right = boa__btree_alloc_node(tree, 1);
+	if (!right) return result;
+	for (i = 0; i < num_spare; i++) {
+		spare[i] = boa__btree_alloc_node(tree, 0);
+		if (!spare[i]) {
+			boa_free_ator(tree->ator, right);
+			while (i > 0) boa_free_ator(tree->ator, spare[--i]);
+			return result;
+		}
+	}
+
+	// Split the leaf, appending to the last leaf leaves it full for sequential inserts.
+	// The new entry never becomes the first one of `right` as it's used as the separator.
+	uint32_t cap = tree->impl.leaf_cap, es = tree->entry_size, key_size = tree->impl.key_type;
+	uint32_t mid = pos == cap && !leaf->next ? cap - 1 : cap / 2;
+	memcpy(boa__btree_entry(tree, right, 0), boa__btree_entry(tree, leaf, mid), (size_t)(cap - mid) * es);
+	if (key_size) {
+		memcpy(boa__btree_keys(tree, right), boa__btree_keys(tree, leaf) + (size_t)mid * key_size, (size_t)(cap - mid) * key_size);
+	}
+	right->count = cap - mid;
+	leaf->count = mid;
+	right->prev = leaf;
+	right->next = leaf->next;
+	if (leaf->next) leaf->next->prev = right;
+	leaf->next = right;
+
+	if (pos <= mid) {
+		result.entry = boa__btree_leaf_insert_at(tree, leaf, pos, key_ptr);
+	} else {
+		result.entry = boa__btree_leaf_insert_at(tree, right, pos - mid, key_ptr);
+	}
+	result.inserted = 1;
+
+	// Insert separators to the parents until one has room for them
+	const char *sep = boa__btree_entry(tree, right, 0);
+	const char *sep_key = boa__btree_keys(tree, right);
+	boa__btree_node *child = right;
+	for (level = height; level > 0; level--) {
+		boa__btree_node *node = path->nodes[level - 1];
+		uint32_t ix = path->indices[level - 1];
+		if (node->count < inner_cap) {
+			boa__btree_inner_insert_at(tree, node, ix, sep, sep_key, child);
+			return result;
+		}
+
+		// Move the separators after `half` to a new node and push up separator `half`,
+		// which is stashed in the last slot of the new node that stays unused
+		boa__btree_node *split = spare[spare_ix++];
+		uint32_t half = inner_cap / 2, last = inner_cap - 1;
+		memcpy(boa__btree_sep(tree, split, 0), boa__btree_sep(tree, node, half + 1), (size_t)(last - half) * es);
+		memcpy(boa__btree_sep(tree, split, last), boa__btree_sep(tree, node, half), es);
+		if (key_size) {
+			char *keys = boa__btree_keys(tree, node), *split_keys = boa__btree_keys(tree, split);
+			memcpy(split_keys, keys + (size_t)(half + 1) * key_size, (size_t)(last - half) * key_size);
+			memcpy(split_keys + (size_t)last * key_size, keys + (size_t)half * key_size, key_size);
+		}
+		memcpy(boa__btree_children(tree, split), boa__btree_children(tree, node) + half + 1,
+			(inner_cap - half) * sizeof(boa__btree_node*));
+		split->count = last - half;
+		node->count = half;
+
+		if (ix <= half) {
+			boa__btree_inner_insert_at(tree, node, ix, sep, sep_key, child);
+		} else {
+			boa__btree_inner_insert_at(tree, split, ix - half - 1, sep, sep_key, child);
+		}
+
+		sep = boa__btree_sep(tree, split, last);
+		sep_key = boa__btree_keys(tree, split) + (size_t)last * key_size;
+		child = split;
+	}
+
+	// Every level was split so grow a new root
+	boa__btree_node *root = spare[spare_ix++];
+	memcpy(boa__btree_sep(tree, root, 0), sep, es);
+	if (key_size) memcpy(boa__btree_keys(tree, root), sep_key, key_size);
+	boa__btree_children(tree, root)[0] = tree->impl.root;
+	boa__btree_children(tree, root)[1] = child;
+	root->count = 1;
+	tree->impl.root = root;
+	tree->impl.height = height + 1;
+	return result;
+}
+
+boa_noinline boa_btree_iterator boa_btree_lower_bound(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user)
+{
+	if (cmp) return boa_btree_lower_bound_inline(tree, key_ptr, cmp, user, BOA_BTREE_KEY_ANY);
+	if (tree->impl.key_type == BOA_BTREE_KEY_U32) return boa_btree_lower_bound_inline(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U32);
+	boa_assert(tree->impl.key_type == BOA_BTREE_KEY_U64);
+	return boa_btree_lower_bound_inline(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U64);
+}
+
+boa_noinline void *boa_btree_find(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user)
+{
+	if (cmp) return boa_btree_find_inline(tree, key_ptr, cmp, user, BOA_BTREE_KEY_ANY);
+	if (tree->impl.key_type == BOA_BTREE_KEY_U32) return boa_btree_find_inline(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U32);
+	boa_assert(tree->impl.key_type == BOA_BTREE_KEY_U64);
+	return boa_btree_find_inline(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U64);
+}
+
+boa_noinline boa_map_insert_result boa_btree_insert(boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user)
+{
+	if (cmp) return boa_btree_insert_inline(tree, key_ptr, cmp, user, BOA_BTREE_KEY_ANY);
+	if (tree->impl.key_type == BOA_BTREE_KEY_U32) return boa_btree_insert_inline(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U32);
+	boa_assert(tree->impl.key_type == BOA_BTREE_KEY_U64);
+	return boa_btree_insert_inline(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U64);
+}
+
+// Find the leaf containing `key_ptr` recording the path to it, NULL if not found
+boa_forceinline boa__btree_node *
+boa__btree_find_leaf(const boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user,
+	uint32_t key_type, boa__btree_path *path, uint32_t *p_ix)
+{
+	boa__btree_node *leaf = boa__btree_descend(tree, key_ptr, cmp, user, key_type, path);
+	uint32_t ix = boa__btree_rank(tree, leaf, boa__btree_entry(tree, leaf, 0), key_ptr, cmp, user, key_type, 0);
+	if (ix == leaf->count || !boa__btree_leaf_equal(tree, leaf, ix, key_ptr, cmp, user, key_type)) return NULL;
+	*p_ix = ix;
+	return leaf;
+}
+
+boa_noinline int boa_btree_remove(boa_btree *tree, const void *key_ptr, boa_btree_cmp_fn cmp, void *user)
+{
+	boa__btree_path path;
+	boa__btree_node *leaf;
+	uint32_t ix = 0;
+	if (!tree->impl.root) return 0;
+
+	if (cmp) {
+		leaf = boa__btree_find_leaf(tree, key_ptr, cmp, user, BOA_BTREE_KEY_ANY, &path, &ix);
+	} else if (tree->impl.key_type == BOA_BTREE_KEY_U32) {
+		leaf = boa__btree_find_leaf(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U32, &path, &ix);
+	} else {
+		boa_assert(tree->impl.key_type == BOA_BTREE_KEY_U64);
+		leaf = boa__btree_find_leaf(tree, key_ptr, NULL, NULL, BOA_BTREE_KEY_U64, &path, &ix);
+	}
+	if (!leaf) return 0;
+
+	uint32_t es = tree->entry_size, key_size = tree->impl.key_type;
+	uint32_t num_move = leaf->count - ix - 1;
+	char *entry = boa__btree_entry(tree, leaf, ix);
+	memmove(entry, entry + es, (size_t)num_move * es);
+	if (key_size) {
+		char *key = boa__btree_keys(tree, leaf) + (size_t)ix * key_size;
+		memmove(key, key + key_size, (size_t)num_move * key_size);
+	}
+	leaf->count--;
+	tree->count--;
+
+	// The root leaf may stay empty, other leaves are freed once they run out of entries
+	if (leaf->count > 0 || tree->impl.height == 0) return 1;
+
+	if (leaf->prev) leaf->prev->next = leaf->next;
+	if (leaf->next) leaf->next->prev = leaf->prev;
+	boa_free_ator(tree->ator, leaf);
+
+	// Remove the child from the parent, freeing inner nodes that are left without children
+	uint32_t level = tree->impl.height;
+	for (; level > 0; level--) {
+		boa__btree_node *node = path.nodes[level - 1];
+		uint32_t child_ix = path.indices[level - 1];
+		if (node->count == 0) {
+			boa_free_ator(tree->ator, node);
+			continue;
+		}
+
+		uint32_t sep_ix = child_ix > 0 ? child_ix - 1 : 0;
+		uint32_t num_sep = node->count - sep_ix - 1;
+		boa__btree_node **children = boa__btree_children(tree, node);
+		char *sep = boa__btree_sep(tree, node, sep_ix);
+		memmove(sep, sep + es, (size_t)num_sep * es);
+		if (key_size) {
+			char *key = boa__btree_keys(tree, node) + (size_t)sep_ix * key_size;
+			memmove(key, key + key_size, (size_t)num_sep * key_size);
+		}
+		memmove(children + child_ix, children + child_ix + 1, (node->count - child_ix) * sizeof(boa__btree_node*));
+		node->count--;
+		break;
+	}
+
+	if (level == 0) {
+		boa_assert(tree->count == 0);
+		tree->impl.root = NULL;
+		tree->impl.height = 0;
+		return 1;
+	}
+
+	// Collapse roots with a single child
+	while (tree->impl.height > 0 && tree->impl.root->count == 0) {
+		boa__btree_node *root = tree->impl.root;
+		tree->impl.root = boa__btree_children(tree, root)[0];
+		tree->impl.height--;
+		boa_free_ator(tree->ator, root);
+	}
+	return 1;
+}
+
+int boa_btree_build(boa_btree *tree, const void *entries, uint32_t count)
+{
+	if (count == 0) {
+		boa_btree_reset(tree);
+		return 1;
+	}
+
+	uint32_t es = tree->entry_size, key_size = tree->impl.key_type;
+	uint32_t leaf_cap = tree->impl.leaf_cap, inner_cap = tree->impl.inner_cap;
+	uint32_t num_leaves = (count + leaf_cap - 1) / leaf_cap;
+	const char *src = (const char*)entries;
+
+	// Nodes of the level being built with the first entry of their subtree, and every
+	// allocated node for cleanup. Each parent has at least two children so there are
+	// less inner nodes than leaves.
+	size_t temp_size = (size_t)num_leaves * (3 * sizeof(boa__btree_node*) + sizeof(const char*));
+	char *temp = (char*)boa_alloc_ator(tree->ator, temp_size);
+	if (!temp) return 0;
+	boa__btree_node **nodes = (boa__btree_node**)temp;
+	boa__btree_node **all = nodes + num_leaves;
+	const char **mins = (const char**)(all + 2 * (size_t)num_leaves);
+	uint32_t num_all = 0, num_nodes = num_leaves, height = 0, i, j;
+	boa__btree_node *prev = NULL;
+	int ok = 1;
+
+	for (i = 0; i < num_leaves; i++) {
+		uint32_t begin = (uint32_t)((uint64_t)count * i / num_leaves);
+		uint32_t end = (uint32_t)((uint64_t)count * (i + 1) / num_leaves);
+		boa__btree_node *leaf = boa__btree_alloc_node(tree, 1);
+		if (!leaf) {
+			ok = 0;
+			break;
+		}
+		all[num_all++] = leaf;
+
+		memcpy(boa__btree_entry(tree, leaf, 0), src + (size_t)begin * es, (size_t)(end - begin) * es);
+		if (key_size) {
+			char *keys = boa__btree_keys(tree, leaf);
+			for (j = begin; j < end; j++) {
+				memcpy(keys + (size_t)(j - begin) * key_size, src + (size_t)j * es, key_size);
+			}
+		}
+		leaf->count = end - begin;
+		leaf->prev = prev;
+		if (prev) prev->next = leaf;
+		prev = leaf;
+		nodes[i] = leaf;
+		mins[i] = src + (size_t)begin * es;
+	}
+
+	while (ok && num_nodes > 1) {
+		uint32_t num_parents = (num_nodes + inner_cap) / (inner_cap + 1);
+		for (i = 0; i < num_parents; i++) {
+			uint32_t begin = (uint32_t)((uint64_t)num_nodes * i / num_parents);
+			uint32_t end = (uint32_t)((uint64_t)num_nodes * (i + 1) / num_parents);
+			boa__btree_node *node = boa__btree_alloc_node(tree, 0);
+			if (!node) {
+				ok = 0;
+				break;
+			}
+			all[num_all++] = node;
+
+			boa__btree_node **children = boa__btree_children(tree, node);
+			char *keys = boa__btree_keys(tree, node);
+			for (j = begin; j < end; j++) {
+				children[j - begin] = nodes[j];
+				if (j == begin) continue;
+				memcpy(boa__btree_sep(tree, node, j - begin - 1), mins[j], es);
+				if (key_size) memcpy(keys + (size_t)(j - begin - 1) * key_size, mins[j], key_size);
+			}
+			node->count = end - begin - 1;
+
+			// Later parents only read children from `begin` onwards which is at least `i`
+			nodes[i] = node;
+			mins[i] = mins[begin];
+		}
+		num_nodes = num_parents;
+		height++;
+	}
+
+	if (!ok) {
+		for (i = 0; i < num_all; i++) {
+			boa_free_ator(tree->ator, all[i]);
+		}
+		boa_free_ator(tree->ator, temp);
+		return 0;
+	}
+
+	boa_btree_reset(tree);
+	tree->impl.root = nodes[0];
+	tree->impl.height = height;
+	tree->count = count;
+	boa_free_ator(tree->ator, temp);
+	return 1;
+}
+
+// -- boa_slotmap
+
+void boa_slotmap_reset(boa_slotmap *map)
+{
+	boa_reset(&map->data);
+	boa_reset(&map->slots);
+	boa_reset(&map->dense_slots);
+	map->count = 0;
+	map->free_slot = BOA_SLOTMAP_INDEX_MASK;
+}
+
+void boa_slotmap_clear(boa_slotmap *map)
+{
+	// Bump the live slots to even free generations so that old handles don't resolve
+	// to objects inserted later and chain all the slots to the free list
+	boa__slot *slots = boa_begin(boa__slot, &map->slots);
+	uint32_t i, num_slots = (uint32_t)boa_count(boa__slot, &map->slots);
+	for (i = 0; i < map->count; i++) {
+		boa__slot *slot = &slots[boa_begin(uint32_t, &map->dense_slots)[i]];
+		slot->generation = (slot->generation + 1) & BOA_SLOTMAP_GENERATION_MASK;
+	}
+	for (i = 0; i < num_slots; i++) {
+		slots[i].index = i + 1 < num_slots ? i + 1 : BOA_SLOTMAP_INDEX_MASK;
+	}
+	map->free_slot = num_slots > 0 ? 0 : BOA_SLOTMAP_INDEX_MASK;
+	boa_clear(&map->data);
+	boa_clear(&map->dense_slots);
+	map->count = 0;
+}
+
+int boa_slotmap_reserve(boa_slotmap *map, uint32_t count)
+{
+	if (count <= map->count) return 1;
+	uint32_t num_new = count - map->count;
+	if (!boa_buf_reserve(&map->data, num_new * map->elem_size)) return 0;
+	if (!boa_reserve_n(uint32_t, &map->dense_slots, num_new)) return 0;
+
+	// Free slots can be reused so only the rest need to be reserved
+	uint32_t num_slots = (uint32_t)boa_count(boa__slot, &map->slots);
+	uint32_t num_free = num_slots - map->count;
+	if (num_new > num_free && !boa_reserve_n(boa__slot, &map->slots, num_new - num_free)) return 0;
+	return 1;
+}
+
+boa_noinline void *boa_slotmap_insert(boa_slotmap *map, uint32_t *p_handle)
+{
+	// Reserve everything before modifying so that failing leaves the map unchanged
+	void *data = boa_buf_reserve(&map->data, map->elem_size);
+	uint32_t *dense_slot = boa_reserve(uint32_t, &map->dense_slots);
+	if (!data || !dense_slot) return NULL;
+
+	uint32_t ix = map->free_slot;
+	boa__slot *slot;
+	if (ix != BOA_SLOTMAP_INDEX_MASK) {
+		// Free generations are even and below the odd mask so this can't wrap
+		slot = boa_begin(boa__slot, &map->slots) + ix;
+		slot->generation++;
+		map->free_slot = slot->index;
+	} else {
+		ix = (uint32_t)boa_count(boa__slot, &map->slots);
+		if (ix == BOA_SLOTMAP_INDEX_MASK) return NULL;
+		slot = boa_push(boa__slot, &map->slots);
+		if (!slot) return NULL;
+		slot->generation = 1;
+	}
+
+	slot->index = map->count++;
+	*dense_slot = ix;
+	boa_buf_bump(&map->data, map->elem_size);
+	boa_bump(uint32_t, &map->dense_slots);
+	*p_handle = slot->generation << BOA_SLOTMAP_INDEX_BITS | ix;
+	return data;
+}
+
+// -- boa_cache
+
+void boa_cache_init(boa_cache *cache, const boa_cache_opts *opts)
+{
+	boa_assert(opts->policy == BOA_CACHE_LRU || opts->policy == BOA_CACHE_CLOCK);
+	cache->opts = *opts;
+
+	// Keep 8-byte alignment for entries that have it
+	uint32_t entry_size = (uint32_t)opts->entry_size;
+	cache->slot_offset = boa_align_up(entry_size, 4);
+	uint32_t map_entry_size = boa_align_up(cache->slot_offset + sizeof(uint32_t), entry_size % 8 == 0 ? 8 : 4);
+	boa_map_init_ator(&cache->map, map_entry_size, opts->ator);
+
+	cache->slots = boa_empty_buf_ator(opts->ator);
+	cache->referenced = boa_empty_buf_ator(opts->ator);
+	cache->used = 0;
+	cache->newest = BOA__CACHE_NONE;
+	cache->oldest = BOA__CACHE_NONE;
+	cache->clock_hand = 0;
+	cache->free_slot = BOA__CACHE_NONE;
+	cache->hits = 0;
+	cache->misses = 0;
+	cache->evictions = 0;
+}
+
+void boa_cache_clear(boa_cache *cache)
+{
+	if (cache->opts.evict_fn) {
+		boa_map_iterator it;
+		for (it = boa_map_begin(&cache->map); it.entry; boa_map_advance(&cache->map, &it)) {
+			cache->opts.evict_fn(it.entry, cache->opts.evict_user);
+		}
+	}
+	boa_map_clear(&cache->map);
+	boa_clear(&cache->slots);
+	boa_clear(&cache->referenced);
+	cache->used = 0;
+	cache->newest = BOA__CACHE_NONE;
+	cache->oldest = BOA__CACHE_NONE;
+	cache->clock_hand = 0;
+	cache->free_slot = BOA__CACHE_NONE;
+}
+
+void boa_cache_reset(boa_cache *cache)
+{
+	boa_cache_clear(cache);
+	boa_map_reset(&cache->map);
+	boa_reset(&cache->slots);
+	boa_reset(&cache->referenced);
+}
+
+static int boa__cache_slot_cmp(const void *key, const void *entry, void *user)
+{
+	const boa_cache *cache = (const boa_cache*)user;
+	return *(const uint32_t*)((const char*)entry + cache->slot_offset) == *(const uint32_t*)key;
+}
+
+// Map entry owning slot `slot_ix`
+static void *boa__cache_slot_entry(boa_cache *cache, uint32_t slot_ix)
+{
+	uint32_t hash = boa_begin(boa__cache_slot, &cache->slots)[slot_ix].hash;
+	void *entry = boa_map_find(&cache->map, &slot_ix, hash, &boa__cache_slot_cmp, cache);
+	boa_assert(entry != NULL);
+	return entry;
+}
+
+static void boa__cache_remove_entry(boa_cache *cache, void *entry)
+{
+	boa__cache_slot *slots = boa_begin(boa__cache_slot, &cache->slots);
+	uint32_t slot_ix = *(uint32_t*)((char*)entry + cache->slot_offset);
+	boa__cache_slot *slot = &slots[slot_ix];
+
+	if (cache->opts.evict_fn) cache->opts.evict_fn(entry, cache->opts.evict_user);
+	cache->used -= slot->charge;
+	boa_map_remove(&cache->map, entry);
+
+	if (cache->opts.policy == BOA_CACHE_LRU) {
+		if (slot->older != BOA__CACHE_NONE) slots[slot->older].newer = slot->newer;
+		else cache->oldest = slot->newer;
+		if (slot->newer != BOA__CACHE_NONE) slots[slot->newer].older = slot->older;
+		else cache->newest = slot->older;
+	} else {
+		boa_begin(uint8_t, &cache->referenced)[slot_ix] = BOA__CACHE_FREE_SLOT;
+	}
+
+	slot->older = cache->free_slot;
+	cache->free_slot = slot_ix;
+}
+
+// Slot to evict next, never `protect`
+static uint32_t boa__cache_pick_victim(boa_cache *cache, uint32_t protect)
+{
+	if (cache->opts.policy == BOA_CACHE_LRU) {
+		uint32_t victim = cache->oldest;
+		if (victim == protect) victim = boa_begin(boa__cache_slot, &cache->slots)[victim].newer;
+		return victim;
+	}
+
+	// Sweep the hand clearing reference bits until finding an unreferenced slot
+	uint8_t *referenced = boa_begin(uint8_t, &cache->referenced);
+	uint32_t count = (uint32_t)boa_count(uint8_t, &cache->referenced);
+	for (;;) {
+		uint32_t ix = cache->clock_hand;
+		cache->clock_hand = ix + 1 < count ? ix + 1 : 0;
+		if (ix == protect || referenced[ix] == BOA__CACHE_FREE_SLOT) continue;
+		if (!referenced[ix]) return ix;
+		referenced[ix] = 0;
+	}
+}
+
+// Evict entries other than `protect` until the cache fits in the budget
+static void boa__cache_evict(boa_cache *cache, uint32_t protect)
+{
+	while (cache->used > cache->opts.budget && cache->map.count > 1) {
+		uint32_t victim = boa__cache_pick_victim(cache, protect);
+		boa__cache_remove_entry(cache, boa__cache_slot_entry(cache, victim));
+		cache->evictions++;
+	}
+}
+
+boa_noinline void *boa_cache_find(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	return boa_cache_find_inline(cache, key_ptr, hash, cmp, user);
+}
+
+boa_noinline boa_map_insert_result boa_cache_insert(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user, uint32_t charge)
+{
+	boa_map_insert_result result;
+	result.entry = NULL;
+	result.inserted = 0;
+	if (charge > cache->opts.budget) return result;
+
+	void *entry = boa_map_find_inline(&cache->map, key_ptr, hash, cmp, user);
+	if (entry) {
+		uint32_t slot_ix = *(uint32_t*)((char*)entry + cache->slot_offset);
+		boa__cache_slot *slot = boa_begin(boa__cache_slot, &cache->slots) + slot_ix;
+		cache->used = cache->used - slot->charge + charge;
+		slot->charge = charge;
+		boa__cache_touch(cache, slot_ix);
+
+		// Evicting moves entries in the map so find the entry again
+		if (cache->used > cache->opts.budget) {
+			boa__cache_evict(cache, slot_ix);
+			entry = boa__cache_slot_entry(cache, slot_ix);
+		}
+		result.entry = entry;
+		return result;
+	}
+
+	// Allocate everything before evicting so that failing leaves the cache unchanged,
+	// the map may need an auxilary block even if entries would be evicted first
+	if (cache->free_slot == BOA__CACHE_NONE) {
+		if (!boa_reserve(boa__cache_slot, &cache->slots)) return result;
+		if (cache->opts.policy == BOA_CACHE_CLOCK && !boa_reserve(uint8_t, &cache->referenced)) return result;
+	}
+	result = boa_map_insert(&cache->map, key_ptr, hash, cmp, user);
+	if (!result.entry) return result;
+
+	uint32_t slot_ix = cache->free_slot;
+	boa__cache_slot *slot;
+	if (slot_ix != BOA__CACHE_NONE) {
+		slot = boa_begin(boa__cache_slot, &cache->slots) + slot_ix;
+		cache->free_slot = slot->older;
+	} else {
+		slot_ix = (uint32_t)boa_count(boa__cache_slot, &cache->slots);
+		slot = boa_push(boa__cache_slot, &cache->slots);
+		if (cache->opts.policy == BOA_CACHE_CLOCK) boa_push(uint8_t, &cache->referenced);
+	}
+	*(uint32_t*)((char*)result.entry + cache->slot_offset) = slot_ix;
+	slot->hash = hash;
+	slot->charge = charge;
+	cache->used += charge;
+
+	if (cache->opts.policy == BOA_CACHE_LRU) {
+		slot->older = cache->newest;
+		slot->newer = BOA__CACHE_NONE;
+		if (cache->newest != BOA__CACHE_NONE) boa_begin(boa__cache_slot, &cache->slots)[cache->newest].newer = slot_ix;
+		else cache->oldest = slot_ix;
+		cache->newest = slot_ix;
+	} else {
+		// New entries start unreferenced so that entries used only once are evicted first
+		boa_begin(uint8_t, &cache->referenced)[slot_ix] = 0;
+		slot->older = BOA__CACHE_NONE;
+		slot->newer = BOA__CACHE_NONE;
+	}
+
+	// Evicting moves entries in the map so find the new entry again
+	if (cache->used > cache->opts.budget) {
+		boa__cache_evict(cache, slot_ix);
+		result.entry = boa__cache_slot_entry(cache, slot_ix);
+	}
+	return result;
+}
+
+boa_noinline int boa_cache_remove(boa_cache *cache, const void *key_ptr, uint32_t hash, boa_map_cmp_fn cmp, void *user)
+{
+	void *entry = boa_map_find_inline(&cache->map, key_ptr, hash, cmp, user);
+	if (!entry) return 0;
+	boa__cache_remove_entry(cache, entry);
+	return 1;
 }
 
 #endif
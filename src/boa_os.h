@@ -57,5 +57,19 @@ typedef struct boa_thread_opts {
 boa_thread *boa_create_thread(const boa_thread_opts *opts);
 void boa_join_thread(boa_thread *thread);
 
+// -- Job runner
+
+#define BOA_THREAD_JOB_RUNNER_MAX_THREADS 64
+
+// `boa_job_runner` that creates threads for each run using `boa_create_thread()`,
+// the calling thread participates in running the jobs as well.
+typedef struct boa_thread_job_runner {
+	boa_job_runner runner;
+	boa_allocator *ator;
+} boa_thread_job_runner;
+
+// Initialize `runner` to use up to `num_threads` threads including the calling one
+boa_job_runner *boa_thread_job_runner_init(boa_thread_job_runner *runner, uint32_t num_threads, boa_allocator *ator);
+
 #endif
 
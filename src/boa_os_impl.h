@@ -343,5 +343,66 @@ void boa_join_thread(boa_thread *thread)
 	#error "No thread implementation for OS"
 #endif
 
-#endif
+// -- Job runner
+
+typedef struct boa__thread_jobs {
+	boa_job_fn fn;
+	void *user;
+	uint32_t count;
+	uint32_t next; // < Next job index to claim, accessed atomically
+} boa__thread_jobs;
+
+static void boa__thread_jobs_entry(void *user)
+{
+	boa__thread_jobs *jobs = (boa__thread_jobs*)user;
+	for (;;) {
+		uint32_t index = boa_atomic_fetch_add_u32(&jobs->next, 1);
+		if (index >= jobs->count) break;
+		jobs->fn(jobs->user, index);
+	}
+}
+
+static void boa__thread_job_runner_run(boa_job_runner *runner, boa_job_fn fn, void *user, uint32_t count)
+{
+	boa_thread_job_runner *self = (boa_thread_job_runner*)runner;
+	boa_thread *threads[BOA_THREAD_JOB_RUNNER_MAX_THREADS];
+	uint32_t i, num_threads = 0;
+	if (count == 0) return;
+	uint32_t num_extra = boa_min(runner->num_workers, count) - 1;
+
+	boa__thread_jobs jobs;
+	jobs.fn = fn;
+	jobs.user = user;
+	jobs.count = count;
+	jobs.next = 0;
+
+	// If creating a thread fails the remaining threads just have more work
+	for (i = 0; i < num_extra; i++) {
+		boa_thread_opts opts = { 0 };
+		opts.ator = self->ator;
+		opts.entry = &boa__thread_jobs_entry;
+		opts.user = &jobs;
+		opts.debug_name = "boa job runner";
+		boa_thread *thread = boa_create_thread(&opts);
+		if (!thread) break;
+		threads[num_threads++] = thread;
+	}
+
+	boa__thread_jobs_entry(&jobs);
+
+	for (i = 0; i < num_threads; i++) {
+		boa_join_thread(threads[i]);
+	}
+}
 
+boa_job_runner *boa_thread_job_runner_init(boa_thread_job_runner *runner, uint32_t num_threads, boa_allocator *ator)
+{
+	if (num_threads == 0) num_threads = 1;
+	if (num_threads > BOA_THREAD_JOB_RUNNER_MAX_THREADS) num_threads = BOA_THREAD_JOB_RUNNER_MAX_THREADS;
+	runner->runner.run_fn = &boa__thread_job_runner_run;
+	runner->runner.num_workers = num_threads;
+	runner->ator = ator;
+	return &runner->runner;
+}
+
+#endif
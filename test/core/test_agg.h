@@ -0,0 +1,167 @@
+
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct {
+	uint32_t key;
+	uint32_t weight;
+	double value;
+} agg_row;
+
+typedef struct {
+	uint64_t weight_sum;
+} agg_state;
+
+void agg_row_update(void *state, const void *row, void *user)
+{
+	((agg_state*)state)->weight_sum += ((const agg_row*)row)->weight;
+	(*(uint32_t*)user)++;
+}
+
+void agg_state_merge(void *dst, const void *src, void *user)
+{
+	((agg_state*)dst)->weight_sum += ((const agg_state*)src)->weight_sum;
+}
+
+void agg_test_init(boa_agg *agg, uint32_t *num_updates)
+{
+	boa_agg_opts opts = { 0 };
+	opts.key_size = sizeof(uint32_t);
+	opts.row_size = sizeof(agg_row);
+	opts.value_offset = offsetof(agg_row, value);
+	opts.state_size = sizeof(agg_state);
+	opts.update_fn = &agg_row_update;
+	opts.merge_fn = &agg_state_merge;
+	opts.user = num_updates;
+	boa_agg_init(agg, &opts, NULL);
+}
+
+agg_row agg_test_row(uint32_t i)
+{
+	agg_row row;
+	row.key = i % 100;
+	row.weight = i;
+	row.value = (double)(i % 7) - 3.0;
+	return row;
+}
+
+void agg_test_check(boa_agg *agg, uint32_t count)
+{
+	boa_assert(agg->map.count == 100);
+	for (uint32_t key = 0; key < 100; key++) {
+		boa_test_hint_u32(key);
+		void *group = boa_agg_find(agg, &key);
+		boa_assert(group != NULL);
+		boa_assert(*(uint32_t*)group == key);
+
+		uint64_t num = 0, weight = 0;
+		double sum = 0.0, min = 100.0, max = -100.0;
+		for (uint32_t i = key; i < count; i += 100) {
+			agg_row row = agg_test_row(i);
+			num++;
+			weight += row.weight;
+			sum += row.value;
+			if (row.value < min) min = row.value;
+			if (row.value > max) max = row.value;
+		}
+
+		boa_agg_stats *stats = boa_agg_group_stats(agg, group);
+		boa_assert(stats->count == num);
+		boa_assert(stats->sum == sum);
+		boa_assert(stats->min == min);
+		boa_assert(stats->max == max);
+		boa_assert(((agg_state*)boa_agg_group_state(agg, group))->weight_sum == weight);
+	}
+}
+
+#endif
+
+BOA_TEST(agg_add, "Aggregate rows one at a time and in batches")
+{
+	uint32_t count = 10000, num_updates = 0;
+	agg_row *rows = boa_make_n(agg_row, count);
+	for (uint32_t i = 0; i < count; i++) {
+		rows[i] = agg_test_row(i);
+	}
+
+	boa_agg single, batch;
+	agg_test_init(&single, &num_updates);
+	agg_test_init(&batch, &num_updates);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_assert(boa_agg_add(&single, &rows[i]) != NULL);
+	}
+	boa_assert(boa_agg_add_batch(&batch, rows, count));
+	boa_assert(num_updates == count * 2);
+
+	agg_test_check(&single, count);
+	agg_test_check(&batch, count);
+
+	uint32_t missing = 1000;
+	boa_assert(boa_agg_find(&batch, &missing) == NULL);
+
+	boa_agg_reset(&single);
+	boa_agg_reset(&batch);
+	boa_free(rows);
+}
+
+BOA_TEST(agg_merge, "Merge partial aggregates")
+{
+	uint32_t count = 10000, num_updates = 0;
+	uint32_t num_parts = 4;
+	agg_row *rows = boa_make_n(agg_row, count);
+	for (uint32_t i = 0; i < count; i++) {
+		rows[i] = agg_test_row(i);
+	}
+
+	boa_agg total;
+	agg_test_init(&total, &num_updates);
+
+	// Partials see overlapping subsets of the keys
+	for (uint32_t part = 0; part < num_parts; part++) {
+		boa_agg partial;
+		agg_test_init(&partial, &num_updates);
+		uint32_t begin = count * part / num_parts, end = count * (part + 1) / num_parts;
+		boa_assert(boa_agg_add_batch(&partial, rows + begin, end - begin));
+		boa_assert(boa_agg_merge(&total, &partial));
+		boa_agg_reset(&partial);
+	}
+
+	agg_test_check(&total, count);
+
+	boa_agg_reset(&total);
+	boa_free(rows);
+}
+
+BOA_TEST(agg_wide_key, "Aggregate rows with a key that is not a fixed blit size")
+{
+	typedef struct { uint8_t key[6]; uint16_t pad; } wide_row;
+	boa_agg_opts opts = { 0 };
+	opts.key_size = 6;
+	opts.row_size = sizeof(wide_row);
+	opts.value_offset = BOA_AGG_NO_VALUE;
+
+	boa_agg agg;
+	boa_agg_init(&agg, &opts, NULL);
+
+	wide_row rows[300];
+	for (uint32_t i = 0; i < 300; i++) {
+		memset(&rows[i], 0, sizeof(wide_row));
+		rows[i].key[0] = (uint8_t)(i % 30);
+		rows[i].key[5] = 0xff;
+	}
+	boa_assert(boa_agg_add_batch(&agg, rows, 300));
+	boa_assert(agg.map.count == 30);
+
+	for (uint32_t i = 0; i < 30; i++) {
+		void *group = boa_agg_find(&agg, rows[i].key);
+		boa_assert(group != NULL);
+		boa_agg_stats *stats = boa_agg_group_stats(&agg, group);
+		boa_assert(stats->count == 10);
+		boa_assert(stats->sum == 0.0);
+	}
+
+	boa_agg_reset(&agg);
+}
@@ -0,0 +1,365 @@
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+uint32_t g_btree_node_size;
+
+typedef struct { uint32_t key, val; } btree_kv;
+typedef struct { uint64_t key; uint32_t val; } btree_kv64;
+typedef struct { int x, y; uint32_t val; } btree_pair;
+
+int btree_pair_cmp(const void *key, const void *entry, void *user)
+{
+	const btree_pair *a = (const btree_pair*)key, *b = (const btree_pair*)entry;
+	if (a->x != b->x) return a->x < b->x ? -1 : 1;
+	if (a->y != b->y) return a->y < b->y ? -1 : 1;
+	return 0;
+}
+
+// Check that `tree` contains keys `i * 3` with values `vals[i]` where zero values are missing keys
+void btree_check(const boa_btree *tree, const uint32_t *vals, uint32_t num_keys)
+{
+	uint32_t count = 0, next = 0;
+	boa_btree_for(btree_kv, kv, tree) {
+		while (next < num_keys && !vals[next]) next++;
+		boa_assert(next < num_keys);
+		boa_assert(kv->key == next * 3);
+		boa_assert(kv->val == vals[next]);
+		next++;
+		count++;
+	}
+	while (next < num_keys && !vals[next]) next++;
+	boa_assert(next == num_keys);
+	boa_assert(tree->count == count);
+
+	for (uint32_t i = 0; i < num_keys; i++) {
+		btree_kv *kv = (btree_kv*)boa_u32_btree_find(tree, i * 3);
+		if (vals[i]) {
+			boa_assert(kv && kv->key == i * 3 && kv->val == vals[i]);
+		} else {
+			boa_assert(kv == NULL);
+		}
+
+		// Lower bound of a key between the stored ones is the next present key
+		uint32_t lb = i;
+		while (lb < num_keys && !vals[lb]) lb++;
+		boa_btree_iterator it = boa_u32_btree_lower_bound(tree, i * 3 - (i > 0 ? 1 : 0));
+		if (lb < num_keys) {
+			boa_assert(it.entry && ((btree_kv*)it.entry)->key == lb * 3);
+		} else {
+			boa_assert(it.entry == NULL);
+		}
+	}
+}
+
+#else
+
+extern uint32_t g_btree_node_size;
+
+static uint32_t btree_node_size_values[] = {
+	64, 512, 4096,
+};
+
+#endif
+
+BOA_TEST_BEGIN_PERMUTATION_U32(g_btree_node_size, btree_node_size_values)
+
+BOA_TEST(btree_u32_random, "Random modifications to a B-tree with 32-bit keys")
+{
+	enum { num_keys = 3000 };
+	static uint32_t vals[num_keys];
+	uint32_t seed = 1;
+	boa_btree tree;
+	boa_btree_init(&tree, sizeof(btree_kv), BOA_BTREE_KEY_U32, g_btree_node_size, NULL);
+	memset(vals, 0, sizeof(vals));
+
+	for (uint32_t round = 0; round < 40; round++) {
+		boa_test_hint_u32(round);
+
+		// Alternate between growing and shrinking the tree
+		uint32_t remove_bits = round % 8 < 4 ? 30 : 31;
+		for (uint32_t op = 0; op < 500; op++) {
+			seed = seed * 1664525u + 1013904223u;
+			uint32_t key = (seed >> 8) % num_keys;
+			if (seed >> remove_bits == 1) {
+				boa_assert(boa_u32_btree_remove(&tree, key * 3) == (vals[key] != 0));
+				vals[key] = 0;
+			} else {
+				boa_map_insert_result res = boa_u32_btree_insert(&tree, key * 3);
+				boa_assert(res.entry != NULL);
+				boa_assert(res.inserted == (vals[key] == 0));
+				((btree_kv*)res.entry)->val = round + 1;
+				vals[key] = round + 1;
+			}
+		}
+
+		btree_check(&tree, vals, num_keys);
+	}
+
+	for (uint32_t i = 0; i < num_keys; i++) {
+		boa_assert(boa_u32_btree_remove(&tree, i * 3) == (vals[i] != 0));
+		vals[i] = 0;
+	}
+	btree_check(&tree, vals, num_keys);
+	boa_assert(boa_btree_begin(&tree).entry == NULL);
+
+	boa_btree_reset(&tree);
+}
+
+BOA_TEST(btree_build, "Bulk load a B-tree from sorted entries")
+{
+	enum { num_keys = 5000 };
+	static btree_kv entries[num_keys];
+	static uint32_t vals[num_keys];
+	boa_btree tree;
+	boa_btree_init(&tree, sizeof(btree_kv), BOA_BTREE_KEY_U32, g_btree_node_size, NULL);
+
+	uint32_t counts[] = { 0, 1, 2, 10, 100, 1000, num_keys };
+	for (uint32_t c = 0; c < boa_arraycount(counts); c++) {
+		uint32_t count = counts[c];
+		boa_test_hint_u32(count);
+		memset(vals, 0, sizeof(vals));
+		for (uint32_t i = 0; i < count; i++) {
+			entries[i].key = i * 3;
+			entries[i].val = i + 1;
+			vals[i] = i + 1;
+		}
+		boa_assert(boa_btree_build(&tree, entries, count));
+		btree_check(&tree, vals, num_keys);
+
+		// Built trees can be modified further
+		for (uint32_t i = 0; i < count; i += 3) {
+			boa_assert(boa_u32_btree_remove(&tree, i * 3));
+			vals[i] = 0;
+		}
+		for (uint32_t i = 1; i < num_keys; i += 7) {
+			btree_kv *kv = (btree_kv*)boa_u32_btree_insert(&tree, i * 3).entry;
+			boa_assert(kv != NULL);
+			kv->val = 1000000 + i;
+			vals[i] = 1000000 + i;
+		}
+		btree_check(&tree, vals, num_keys);
+	}
+
+	boa_btree_reset(&tree);
+}
+
+BOA_TEST(btree_u64, "B-tree with 64-bit keys including extreme values")
+{
+	enum { num_keys = 2000 };
+	boa_btree tree;
+	boa_btree_init(&tree, sizeof(btree_kv64), BOA_BTREE_KEY_U64, g_btree_node_size, NULL);
+
+	// Keys spread over the whole range with the sign bit set in half of them
+	uint64_t step = UINT64_MAX / num_keys;
+	for (uint32_t i = 0; i < num_keys; i++) {
+		btree_kv64 *kv = (btree_kv64*)boa_u64_btree_insert(&tree, (uint64_t)(num_keys - i) * step).entry;
+		boa_assert(kv != NULL);
+		kv->val = num_keys - i;
+	}
+	btree_kv64 *zero = (btree_kv64*)boa_u64_btree_insert(&tree, 0).entry;
+	boa_assert(zero != NULL);
+	zero->val = 0;
+	boa_assert(tree.count == num_keys + 1);
+	boa_assert(boa_u64_btree_find(&tree, 0) != NULL);
+	boa_assert(boa_u64_btree_find(&tree, 1) == NULL);
+	boa_assert(boa_u64_btree_find(&tree, UINT64_MAX) == NULL);
+	boa_assert(boa_u64_btree_lower_bound(&tree, UINT64_MAX).entry == NULL);
+
+	btree_kv64 *max = (btree_kv64*)boa_u64_btree_insert(&tree, UINT64_MAX).entry;
+	boa_assert(max != NULL);
+	max->val = num_keys + 1;
+	boa_assert(boa_u64_btree_find(&tree, UINT64_MAX) == max);
+	boa_assert(boa_u64_btree_lower_bound(&tree, UINT64_MAX).entry == max);
+
+	uint32_t index = 0;
+	boa_btree_for(btree_kv64, kv, &tree) {
+		boa_assert(kv->val == index);
+		index++;
+	}
+	boa_assert(index == num_keys + 2);
+
+	// Range from the middle to the end
+	uint32_t num_range = 0;
+	boa_btree_iterator it = boa_u64_btree_lower_bound(&tree, (uint64_t)(num_keys / 2) * step);
+	for (; it.entry; boa_btree_advance(&tree, &it)) {
+		boa_assert(((btree_kv64*)it.entry)->val == num_keys / 2 + num_range);
+		num_range++;
+	}
+	boa_assert(num_range == num_keys / 2 + 2);
+
+	// Remove the lower half as a contiguous range to free whole leaves and their
+	// separators in the inner nodes, and every other key of the upper half
+	boa_assert(tree.impl.height > 0);
+	for (uint32_t k = 0; k <= num_keys; k++) {
+		if (k < num_keys / 2 || k % 2 == 1) {
+			boa_assert(boa_u64_btree_remove(&tree, (uint64_t)k * step));
+		}
+	}
+	boa_assert(boa_u64_btree_remove(&tree, 0) == 0);
+	boa_assert(boa_u64_btree_remove(&tree, step + 1) == 0);
+	boa_assert(tree.count == (num_keys / 2) / 2 + 2);
+
+	index = num_keys / 2;
+	boa_btree_for(btree_kv64, kv, &tree) {
+		boa_assert(kv->val == index);
+		index = index < num_keys ? index + 2 : num_keys + 1;
+	}
+	boa_assert(index == num_keys + 1);
+
+	for (uint32_t k = 0; k <= num_keys; k++) {
+		boa_test_hint_u32(k);
+		btree_kv64 *kv = (btree_kv64*)boa_u64_btree_find(&tree, (uint64_t)k * step);
+		if (k >= num_keys / 2 && k % 2 == 0) {
+			boa_assert(kv && kv->val == k);
+		} else {
+			boa_assert(kv == NULL);
+			it = boa_u64_btree_lower_bound(&tree, (uint64_t)k * step);
+			uint32_t next = k < num_keys / 2 ? num_keys / 2 : k + 1;
+			boa_assert(it.entry && ((btree_kv64*)it.entry)->val == next);
+		}
+	}
+
+	// Removing everything leaves an empty tree that can be reused
+	for (uint32_t k = num_keys / 2; k <= num_keys; k += 2) {
+		boa_assert(boa_u64_btree_remove(&tree, (uint64_t)k * step));
+	}
+	boa_assert(boa_u64_btree_remove(&tree, UINT64_MAX));
+	boa_assert(tree.count == 0);
+	boa_assert(boa_btree_begin(&tree).entry == NULL);
+	boa_assert(boa_u64_btree_lower_bound(&tree, 0).entry == NULL);
+	boa_assert(boa_u64_btree_insert(&tree, step).inserted);
+	boa_assert(boa_u64_btree_find(&tree, step) != NULL);
+
+	boa_btree_reset(&tree);
+}
+
+BOA_TEST(btree_cmp, "B-tree with keys compared using a callback")
+{
+	enum { side = 60 };
+	boa_btree tree;
+	boa_btree_init(&tree, sizeof(btree_pair), BOA_BTREE_KEY_ANY, g_btree_node_size, NULL);
+
+	for (int x = side - 1; x >= 0; x--) {
+		for (int y = 0; y < side; y++) {
+			btree_pair key = { x, y, 0 };
+			boa_map_insert_result res = boa_btree_insert(&tree, &key, &btree_pair_cmp, NULL);
+			boa_assert(res.entry && res.inserted);
+			key.val = (uint32_t)(x * side + y);
+			*(btree_pair*)res.entry = key;
+		}
+	}
+	boa_assert(tree.count == side * side);
+
+	uint32_t index = 0;
+	boa_btree_for(btree_pair, p, &tree) {
+		boa_assert(p->val == index);
+		index++;
+	}
+	boa_assert(index == side * side);
+
+	// Iterate the row `x = 10` starting from the first key with the given `x`
+	btree_pair lo = { 10, -1000, 0 };
+	uint32_t num_row = 0;
+	boa_btree_iterator it = boa_btree_lower_bound(&tree, &lo, &btree_pair_cmp, NULL);
+	for (; it.entry && ((btree_pair*)it.entry)->x == 10; boa_btree_advance(&tree, &it)) {
+		boa_assert(((btree_pair*)it.entry)->y == (int)num_row);
+		num_row++;
+	}
+	boa_assert(num_row == side);
+
+	for (int x = 0; x < side; x++) {
+		for (int y = 0; y < side; y++) {
+			btree_pair key = { x, y, 0 };
+			btree_pair *p = (btree_pair*)boa_btree_find_inline(&tree, &key, &btree_pair_cmp, NULL, BOA_BTREE_KEY_ANY);
+			boa_assert(p && p->val == (uint32_t)(x * side + y));
+			if ((x + y) % 2 == 0) {
+				boa_assert(boa_btree_remove(&tree, &key, &btree_pair_cmp, NULL));
+				boa_assert(!boa_btree_remove(&tree, &key, &btree_pair_cmp, NULL));
+			}
+		}
+	}
+	boa_assert(tree.count == side * side / 2);
+	boa_btree_for(btree_pair, p, &tree) {
+		boa_assert((p->x + p->y) % 2 == 1);
+	}
+
+	boa_btree_reset(&tree);
+}
+
+BOA_TEST(btree_fail_alloc, "B-tree should survive allocation failures")
+{
+	enum { num_keys = 2000 };
+	static uint32_t vals[num_keys];
+	static btree_kv entries[num_keys];
+	boa_btree tree;
+	boa_btree_init(&tree, sizeof(btree_kv), BOA_BTREE_KEY_U32, g_btree_node_size, NULL);
+	memset(vals, 0, sizeof(vals));
+
+	for (uint32_t i = 0; i < num_keys; i++) {
+		uint32_t key = (i * 7919) % num_keys;
+		boa_test_fail_allocations(i % 3, 1);
+		btree_kv *kv = (btree_kv*)boa_u32_btree_insert(&tree, key * 3).entry;
+		boa_test_fail_allocations(0, 0);
+		if (kv) {
+			kv->val = i + 1;
+			vals[key] = i + 1;
+		}
+	}
+	btree_check(&tree, vals, num_keys);
+
+	// A failed build keeps the old contents
+	for (uint32_t i = 0; i < num_keys; i++) {
+		entries[i].key = i * 3;
+		entries[i].val = 1;
+	}
+	for (uint32_t delay = 0; delay < 4; delay++) {
+		boa_test_fail_allocations(delay, 1);
+		boa_assert(!boa_btree_build(&tree, entries, num_keys));
+		boa_test_fail_allocations(0, 0);
+		btree_check(&tree, vals, num_keys);
+	}
+
+	boa_btree_reset(&tree);
+}
+
+BOA_TEST_END_PERMUTATION(g_btree_node_size)
+
+BOA_TEST(btree_typed_init, "Specialized B-trees with the default node size")
+{
+	enum { num_keys = 5000 };
+	static uint32_t vals[num_keys];
+	boa_btree tree;
+
+	boa_u32_btree_init(&tree, sizeof(btree_kv), NULL);
+	for (uint32_t i = 0; i < num_keys; i++) {
+		btree_kv *kv = (btree_kv*)boa_u32_btree_insert(&tree, i * 3).entry;
+		boa_assert(kv && kv->key == i * 3);
+		kv->val = vals[i] = i + 1;
+	}
+	for (uint32_t i = 0; i < num_keys; i += 3) {
+		boa_assert(boa_u32_btree_remove(&tree, i * 3));
+		vals[i] = 0;
+	}
+	btree_check(&tree, vals, num_keys);
+	boa_btree_reset(&tree);
+
+	boa_u64_btree_init(&tree, sizeof(btree_kv64), NULL);
+	for (uint32_t i = 0; i < num_keys; i++) {
+		btree_kv64 *kv = (btree_kv64*)boa_u64_btree_insert(&tree, (uint64_t)i << 32 | i).entry;
+		boa_assert(kv && kv->key == ((uint64_t)i << 32 | i));
+		kv->val = i;
+	}
+	for (uint32_t i = 1; i < num_keys; i += 2) {
+		boa_assert(boa_u64_btree_remove(&tree, (uint64_t)i << 32 | i));
+	}
+	boa_assert(tree.count == num_keys / 2);
+	uint32_t index = 0;
+	boa_btree_for(btree_kv64, kv, &tree) {
+		boa_assert(kv->val == index);
+		index += 2;
+	}
+	boa_assert(index == num_keys);
+	boa_btree_reset(&tree);
+}
@@ -0,0 +1,318 @@
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+uint32_t g_cache_policy;
+
+typedef struct { uint32_t key, val; } cache_kv;
+
+int cache_kv_cmp(const void *a, const void *b, void *user) { return *(const uint32_t*)a == *(const uint32_t*)b; }
+
+// Present keys tracked through the eviction callback
+typedef struct {
+	uint8_t present[4096];
+	uint32_t num_evicted;
+} cache_tracker;
+
+void cache_tracker_evict(void *entry, void *user)
+{
+	cache_tracker *t = (cache_tracker*)user;
+	cache_kv *kv = (cache_kv*)entry;
+	boa_assert(t->present[kv->key]);
+	boa_assert(kv->val == kv->key * 10);
+	t->present[kv->key] = 0;
+	t->num_evicted++;
+}
+
+void cache_test_init(boa_cache *cache, cache_tracker *t, uint64_t budget, uint32_t policy)
+{
+	boa_cache_opts opts = { 0 };
+	opts.entry_size = sizeof(cache_kv);
+	opts.budget = budget;
+	opts.policy = policy;
+	opts.evict_fn = &cache_tracker_evict;
+	opts.evict_user = t;
+	memset(t, 0, sizeof(cache_tracker));
+	boa_cache_init(cache, &opts);
+}
+
+cache_kv *cache_test_find(boa_cache *cache, uint32_t key)
+{
+	return (cache_kv*)boa_cache_find(cache, &key, boa_u32_hash(key), &cache_kv_cmp, NULL);
+}
+
+cache_kv *cache_test_insert(boa_cache *cache, cache_tracker *t, uint32_t key, uint32_t charge)
+{
+	boa_map_insert_result res = boa_cache_insert(cache, &key, boa_u32_hash(key), &cache_kv_cmp, NULL, charge);
+	cache_kv *kv = (cache_kv*)res.entry;
+	if (res.inserted) {
+		kv->key = key;
+		kv->val = key * 10;
+		t->present[key] = 1;
+	}
+	return kv;
+}
+
+// Check that the cache contains exactly the keys present in `t` within the budget
+void cache_check(boa_cache *cache, cache_tracker *t, uint32_t num_keys)
+{
+	uint32_t count = 0;
+	uint64_t used = 0;
+	for (uint32_t i = 0; i < num_keys; i++) {
+		cache_kv *kv = (cache_kv*)boa_map_find(&cache->map, &i, boa_u32_hash(i), &cache_kv_cmp, NULL);
+		if (t->present[i]) {
+			boa_assert(kv && kv->key == i && kv->val == i * 10);
+			uint32_t slot_ix = *(uint32_t*)((char*)kv + cache->slot_offset);
+			boa_assert(boa_begin(boa__cache_slot, &cache->slots)[slot_ix].hash == boa_u32_hash(i));
+			used += boa_begin(boa__cache_slot, &cache->slots)[slot_ix].charge;
+			count++;
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+	boa_assert(cache->map.count == count);
+	boa_assert(cache->used == used);
+	boa_assert(cache->used <= cache->opts.budget);
+}
+
+// Hash that puts keys other than zero to the first block of the map
+uint32_t cache_block0_hash(uint32_t key) { return key ? key % 512 : 1u << BOA__MAP_BLOCK_SHIFT; }
+
+void cache_block0_check(boa_cache *cache, cache_tracker *t, uint32_t num_keys)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < num_keys; i++) {
+		cache_kv *kv = (cache_kv*)boa_map_find(&cache->map, &i, cache_block0_hash(i), &cache_kv_cmp, NULL);
+		boa_assert(t->present[i] ? kv && kv->val == i * 10 : kv == NULL);
+		if (kv) count++;
+	}
+	boa_assert(cache->map.count == count);
+	boa_assert(cache->used <= cache->opts.budget);
+}
+
+#else
+
+extern uint32_t g_cache_policy;
+
+static uint32_t cache_policy_values[] = {
+	BOA_CACHE_LRU, BOA_CACHE_CLOCK,
+};
+
+#endif
+
+BOA_TEST(cache_lru_order, "LRU cache evicts the least recently used entry")
+{
+	boa_cache cache;
+	cache_tracker t;
+	cache_test_init(&cache, &t, 4, BOA_CACHE_LRU);
+
+	for (uint32_t i = 1; i <= 4; i++) {
+		boa_assert(cache_test_insert(&cache, &t, i, 1) != NULL);
+	}
+	boa_assert(cache_test_find(&cache, 1) != NULL);
+	boa_assert(cache_test_find(&cache, 3) != NULL);
+	boa_assert(cache_test_find(&cache, 7) == NULL);
+	boa_assert(cache.hits == 2);
+	boa_assert(cache.misses == 1);
+
+	// Order from oldest: 2, 4, 1, 3
+	boa_assert(cache_test_insert(&cache, &t, 5, 1) != NULL);
+	boa_assert(!t.present[2] && t.num_evicted == 1);
+	boa_assert(cache_test_insert(&cache, &t, 6, 2) != NULL);
+	boa_assert(!t.present[4] && !t.present[1] && t.num_evicted == 3);
+	boa_assert(cache.evictions == 3);
+	cache_check(&cache, &t, 10);
+
+	// Growing the charge of an entry evicts others but never the entry itself
+	cache_kv *kv = cache_test_insert(&cache, &t, 3, 4);
+	boa_assert(kv && kv->key == 3);
+	boa_assert(t.present[3] && !t.present[5] && !t.present[6]);
+	boa_assert(cache.map.count == 1);
+	cache_check(&cache, &t, 10);
+
+	// Entries larger than the whole budget are rejected
+	boa_assert(cache_test_insert(&cache, &t, 8, 5) == NULL);
+	boa_assert(t.present[3]);
+
+	boa_assert(boa_cache_remove(&cache, &kv->key, boa_u32_hash(3), &cache_kv_cmp, NULL) == 1);
+	boa_assert(!t.present[3]);
+	cache_check(&cache, &t, 10);
+
+	boa_cache_reset(&cache);
+}
+
+BOA_TEST(cache_clock_second_chance, "CLOCK cache keeps referenced entries over unreferenced ones")
+{
+	boa_cache cache;
+	cache_tracker t;
+	cache_test_init(&cache, &t, 8, BOA_CACHE_CLOCK);
+
+	for (uint32_t i = 0; i < 8; i++) {
+		boa_assert(cache_test_insert(&cache, &t, i, 1) != NULL);
+	}
+	for (uint32_t i = 0; i < 8; i += 2) {
+		boa_assert(cache_test_find(&cache, i) != NULL);
+	}
+
+	// Unreferenced entries are evicted before the hand comes back to the cleared ones
+	for (uint32_t i = 8; i < 12; i++) {
+		boa_assert(cache_test_insert(&cache, &t, i, 1) != NULL);
+	}
+	for (uint32_t i = 0; i < 8; i += 2) {
+		boa_assert(t.present[i]);
+	}
+	boa_assert(t.num_evicted == 4);
+	cache_check(&cache, &t, 16);
+
+	boa_cache_clear(&cache);
+	boa_assert(t.num_evicted == 12);
+	boa_assert(cache.evictions == 4);
+	cache_check(&cache, &t, 16);
+
+	boa_cache_reset(&cache);
+}
+
+BOA_TEST_BEGIN_PERMUTATION_U32(g_cache_policy, cache_policy_values)
+
+BOA_TEST(cache_random, "Random operations on a cache with a byte budget")
+{
+	enum { num_keys = 4096 };
+	static uint32_t last_use[num_keys];
+	boa_cache cache;
+	cache_tracker t;
+	uint32_t seed = 1, tick = 0;
+	cache_test_init(&cache, &t, 2000, g_cache_policy);
+	memset(last_use, 0, sizeof(last_use));
+
+	for (uint32_t round = 0; round < 100; round++) {
+		boa_test_hint_u32(round);
+		for (uint32_t op = 0; op < 200; op++) {
+			seed = seed * 1664525u + 1013904223u;
+			uint32_t key = (seed >> 8) % (round % 2 ? 300 : num_keys);
+			uint32_t kind = seed >> 29;
+			tick++;
+
+			if (kind < 4) {
+				cache_kv *kv = cache_test_find(&cache, key);
+				boa_assert((kv != NULL) == (t.present[key] != 0));
+				if (kv) last_use[key] = tick;
+			} else if (kind < 7) {
+				uint32_t charge = 1 + (seed >> 4) % 40;
+
+				// With LRU the entry evicted next is the one with the oldest use
+				uint32_t oldest = num_keys;
+				for (uint32_t i = 0; i < num_keys; i++) {
+					if (t.present[i] && i != key && (oldest == num_keys || last_use[i] < last_use[oldest])) oldest = i;
+				}
+
+				uint32_t num_evicted = t.num_evicted;
+				cache_kv *kv = cache_test_insert(&cache, &t, key, charge);
+				boa_assert(kv && kv->key == key);
+				last_use[key] = tick;
+				if (g_cache_policy == BOA_CACHE_LRU && t.num_evicted > num_evicted) {
+					boa_assert(!t.present[oldest]);
+				}
+			} else {
+				int was_present = t.present[key];
+				boa_assert(boa_cache_remove(&cache, &key, boa_u32_hash(key), &cache_kv_cmp, NULL) == was_present);
+				boa_assert(!t.present[key]);
+			}
+		}
+		cache_check(&cache, &t, num_keys);
+	}
+
+	boa_assert(cache.hits + cache.misses > 0);
+	boa_cache_reset(&cache);
+	for (uint32_t i = 0; i < num_keys; i++) {
+		boa_assert(!t.present[i]);
+	}
+}
+
+BOA_TEST(cache_fail_alloc, "Cache should survive allocation failures")
+{
+	enum { num_keys = 1000 };
+	boa_cache cache;
+	cache_tracker t;
+	cache_test_init(&cache, &t, 300, g_cache_policy);
+
+	uint32_t num_failed = 0;
+	for (uint32_t i = 0; i < num_keys; i++) {
+		uint32_t count = cache.map.count, num_evicted = t.num_evicted;
+		uint64_t evictions = cache.evictions;
+		boa_test_fail_allocations(i % 5, 1);
+		cache_kv *kv = cache_test_insert(&cache, &t, i, 1 + i % 3);
+		boa_test_fail_allocations(0, 0);
+
+		// Failed inserts must not evict anything
+		if (!kv) {
+			boa_assert(cache.map.count == count);
+			boa_assert(t.num_evicted == num_evicted);
+			boa_assert(cache.evictions == evictions);
+			num_failed++;
+		}
+	}
+	boa_assert(num_failed > 0);
+	cache_check(&cache, &t, num_keys);
+
+	boa_cache_reset(&cache);
+}
+
+BOA_TEST(cache_fail_alloc_no_evict, "Cache insert failing to allocate should not evict anything")
+{
+	boa_cache cache;
+	cache_tracker t;
+	cache_test_init(&cache, &t, 1000000, g_cache_policy);
+
+	// Reserve everything except the auxilary blocks of the map
+	boa_assert(boa_map_reserve(&cache.map, 2048));
+	boa_assert(boa_reserve_n(boa__cache_slot, &cache.slots, 4096));
+	boa_assert(boa_reserve_n(uint8_t, &cache.referenced, 4096));
+
+	// The oldest entry is alone in its block and the rest overflow from block 0 to
+	// auxilary blocks until the map runs out of them
+	uint32_t victim = 0;
+	boa_map_insert_result res = boa_cache_insert(&cache, &victim, cache_block0_hash(victim), &cache_kv_cmp, NULL, 1);
+	boa_assert(res.inserted);
+	((cache_kv*)res.entry)->key = victim;
+	((cache_kv*)res.entry)->val = 0;
+	t.present[victim] = 1;
+
+	uint32_t key;
+	for (key = 1; key < 4096; key++) {
+		boa_test_fail_allocations(0, 1000);
+		res = boa_cache_insert(&cache, &key, cache_block0_hash(key), &cache_kv_cmp, NULL, 1);
+		boa_test_fail_allocations(0, 0);
+		if (!res.entry) break;
+		((cache_kv*)res.entry)->key = key;
+		((cache_kv*)res.entry)->val = key * 10;
+		t.present[key] = 1;
+	}
+	boa_assert(key < 4096);
+
+	// Inserting to a full cache would evict the victim but the map can't allocate
+	cache.opts.budget = cache.used;
+	uint32_t count = cache.map.count;
+	boa_test_fail_allocations(0, 1000);
+	res = boa_cache_insert(&cache, &key, cache_block0_hash(key), &cache_kv_cmp, NULL, 1);
+	boa_test_fail_allocations(0, 0);
+	boa_assert(res.entry == NULL);
+	boa_assert(cache.map.count == count);
+	boa_assert(cache.evictions == 0);
+	boa_assert(t.num_evicted == 0);
+	cache_block0_check(&cache, &t, 4096);
+
+	// Once the allocation succeeds the victim is evicted as usual
+	res = boa_cache_insert(&cache, &key, cache_block0_hash(key), &cache_kv_cmp, NULL, 1);
+	boa_assert(res.inserted);
+	((cache_kv*)res.entry)->key = key;
+	((cache_kv*)res.entry)->val = key * 10;
+	t.present[key] = 1;
+	boa_assert(!t.present[victim]);
+	boa_assert(cache.evictions == 1);
+	cache_block0_check(&cache, &t, 4096);
+
+	boa_cache_reset(&cache);
+}
+
+BOA_TEST_END_PERMUTATION(g_cache_policy)
@@ -16,6 +16,38 @@ namespace {
 	struct IntGreater {
 		bool operator()(int a, int b) { return a > b; }
 	};
+
+	struct Point3 {
+		int x, y, z;
+	};
+
+	// Insert and find through the fixed geometry, check against the runtime geometry `Ref`
+	template <typename Map, typename Ref, typename KeyFn>
+	void check_block_geometry(uint32_t block_entries, KeyFn key_fn)
+	{
+		Map map;
+		Ref ref;
+		for (uint32_t i = 0; i < 1000; i++) {
+			map.insert(key_fn(i), i * 10);
+			ref.insert(key_fn(i), i * 10);
+			boa_assert(map.impl.block_num_entries == block_entries);
+		}
+		boa_assert(!map.insert(key_fn(10), 0).inserted);
+		boa_assert(map.count == 1000);
+
+		for (uint32_t i = 0; i < 1500; i++) {
+			auto kv = map.find(key_fn(i));
+			if (i < 1000) {
+				boa_assert(kv && kv->val == i * 10);
+				boa_assert(map.hasher_find(&kv->key) == kv);
+				boa_assert(ref.find(key_fn(i))->val == kv->val);
+			} else {
+				boa_assert(kv == nullptr);
+			}
+		}
+
+		for (auto &kv : map) boa_assert(ref.find(kv.key)->val == kv.val);
+	}
 }
 
 #endif
@@ -141,6 +173,192 @@ BOA_TEST(cpp_map_u32, "C++ U32 map")
 	boa_assert(ref.find(4) == nullptr);
 }
 
+BOA_TEST(cpp_map_find_batch, "C++ map batched find")
+{
+	boa::u32_map<uint32_t, uint32_t> u32_map;
+	boa::blit_map<Point, uint32_t> blit_map;
+	for (uint32_t i = 0; i < 100; i++) {
+		u32_map.insert(i, i * 10);
+		blit_map.insert(Point(i, -(int)i), i * 10);
+	}
+
+	uint32_t u32_keys[200];
+	boa::buf<Point> blit_keys;
+	boa::u32_map<uint32_t, uint32_t>::key_val *u32_entries[200];
+	boa::blit_map<Point, uint32_t>::key_val *blit_entries[200];
+	for (uint32_t i = 0; i < 200; i++) {
+		u32_keys[i] = 199 - i;
+		blit_keys.push(Point(199 - i, -(int)(199 - i)));
+	}
+
+	u32_map.find_batch(u32_entries, u32_keys, 200);
+	blit_map.find_batch(blit_entries, blit_keys.begin(), 200);
+
+	for (uint32_t i = 0; i < 200; i++) {
+		uint32_t key = 199 - i;
+		if (key < 100) {
+			boa_assert(u32_entries[i] && u32_entries[i]->val == key * 10);
+			boa_assert(blit_entries[i] && blit_entries[i]->val == key * 10);
+		} else {
+			boa_assert(u32_entries[i] == nullptr);
+			boa_assert(blit_entries[i] == nullptr);
+		}
+	}
+}
+
+BOA_TEST(cpp_map_assign_bulk, "C++ map bulk assign")
+{
+	boa::u32_map<uint32_t, uint32_t> u32_map;
+	boa::blit_map<Point, uint32_t> blit_map;
+	u32_map.insert(1000, 1);
+	blit_map.insert(Point(1000, 0), 1);
+
+	boa::buf<boa::u32_map<uint32_t, uint32_t>::key_val> u32_entries;
+	boa::buf<boa::blit_map<Point, uint32_t>::key_val> blit_entries;
+	for (uint32_t i = 0; i < 500; i++) {
+		u32_entries.push({ i, i * 10 });
+		blit_entries.push({ Point(i, -(int)i), i * 10 });
+	}
+
+	boa_assert(u32_map.assign_bulk(u32_entries.begin(), 500));
+	boa_assert(blit_map.assign_bulk(blit_entries.begin(), 500));
+	boa_assert(u32_map.count == 500);
+	boa_assert(blit_map.count == 500);
+	boa_assert(u32_map.find(1000) == nullptr);
+	boa_assert(blit_map.find(Point(1000, 0)) == nullptr);
+
+	for (uint32_t i = 0; i < 500; i++) {
+		auto u32_kv = u32_map.find(i);
+		auto blit_kv = blit_map.find(Point(i, -(int)i));
+		boa_assert(u32_kv && u32_kv->val == i * 10);
+		boa_assert(blit_kv && blit_kv->val == i * 10);
+	}
+}
+
+BOA_TEST(cpp_map_snapshot, "C++ map snapshot")
+{
+	boa::blit_map<Point, uint32_t> map;
+	for (uint32_t i = 0; i < 100; i++) {
+		map.insert(Point(i, -(int)i), i * 10);
+	}
+
+	uint32_t size = boa_map_snapshot_size(&map);
+	void *data = boa_alloc(size);
+	boa_assert(boa_map_snapshot_write(&map, data, size) == size);
+
+	boa::blit_map<Point, uint32_t> snap;
+	boa_assert(snap.open_snapshot(data, size));
+	boa_assert(snap.count == 100);
+	for (uint32_t i = 0; i < 100; i++) {
+		auto kv = snap.find(Point(i, -(int)i));
+		boa_assert(kv && kv->val == i * 10);
+	}
+	boa_assert(snap.find(Point(100, -100)) == nullptr);
+
+	boa_free(data);
+}
+
+BOA_TEST(cpp_map_block_geometry, "C++ maps with the block size fixed at compile time")
+{
+	static_assert(boa::u32_set<uint32_t, 16>::geometry::slot_bits == 5, "Unexpected slot bits");
+	static_assert(boa::u32_set<uint32_t, 64>::geometry::block_slots == 128, "Unexpected block slots");
+	static_assert(boa::blit_map<Point3, uint32_t, 32>::geometry::entry_size == 16, "Unexpected entry size");
+
+	auto u32_key = [](uint32_t i) { return i * 7; };
+	auto point_key = [](uint32_t i) { return Point((int)i, -(int)i); };
+	auto point3_key = [](uint32_t i) { return Point3{ (int)i, 1, (int)(i * i) }; };
+	auto ptr_key = [](uint32_t i) { return (const void*)(uintptr_t)(i * 16 + 16); };
+
+	check_block_geometry<boa::u32_map<uint32_t, uint32_t, 16>, boa::u32_map<uint32_t, uint32_t>>(16, u32_key);
+	check_block_geometry<boa::u32_map<uint32_t, uint32_t, 32>, boa::u32_map<uint32_t, uint32_t>>(32, u32_key);
+	check_block_geometry<boa::u32_map<uint32_t, uint32_t, 64>, boa::u32_map<uint32_t, uint32_t>>(64, u32_key);
+	check_block_geometry<boa::blit_map<Point, uint32_t, 16>, boa::blit_map<Point, uint32_t>>(16, point_key);
+	check_block_geometry<boa::blit_map<Point3, uint32_t, 32>, boa::blit_map<Point3, uint32_t>>(32, point3_key);
+	check_block_geometry<boa::ptr_map<const void*, uint32_t, 16>, boa::ptr_map<const void*, uint32_t>>(16, ptr_key);
+
+	// Set with a fixed geometry interoperates with the C runtime functions
+	boa::u32_set<uint32_t, 32> set;
+	for (uint32_t i = 0; i < 200; i++) set.insert(i);
+	for (uint32_t i = 0; i < 200; i++) {
+		boa_assert(set.find(i) && *set.find(i) == i);
+		boa_assert(boa_u32_map_find(&set, i) == set.find(i));
+	}
+	boa_assert(set.find(200) == nullptr);
+	boa_assert(set.impl.block_num_entries == 32);
+}
+
+BOA_TEST(cpp_map_fixed_storage, "C++ map using caller storage")
+{
+	typedef boa::u32_map<uint32_t, uint32_t> map_type;
+	alignas(8) char storage[map_type::fixed_storage_size(16)];
+	map_type map{ storage, sizeof(storage), boa::boa_null_ator() };
+
+	for (uint32_t i = 0; i < 16; i++) {
+		boa_assert(map.try_insert(i, i * 10).entry);
+	}
+	boa_assert(!map.try_insert(16, 160).entry);
+	for (uint32_t i = 0; i < 16; i++) {
+		boa_assert(map.find(i) && map.find(i)->val == i * 10);
+	}
+	boa_assert(map.find(16) == nullptr);
+
+	alignas(8) char set_storage[boa::u32_set<uint32_t>::fixed_storage_size(32)];
+	boa::u32_set<uint32_t> set{ set_storage, sizeof(set_storage) };
+	for (uint32_t i = 0; i < 100; i++) set.insert(i);
+	for (uint32_t i = 0; i < 100; i++) boa_assert(set.find(i) && *set.find(i) == i);
+}
+
+BOA_TEST(cpp_str_map, "C++ string map")
+{
+	boa::str_map<uint32_t> map;
+	map.insert("Hello", 10);
+	map.insert("World", 20);
+	boa_assert(!map.insert("Hello", 30).inserted);
+	boa_assert(map.insert_or_assign("World", 5, 40).entry->val == 40);
+
+	boa_assert(map.find("Hello") && map.find("Hello")->val == 10);
+	boa_assert(map.find("World!", 5) && map.find("World!", 5)->val == 40);
+	boa_assert(map.find("World!") == nullptr);
+	boa_assert(map.count() == 2);
+
+	uint32_t total = 0;
+	for (auto &kv : map) total += kv.val;
+	boa_assert(total == 50);
+
+	const boa::str_map<uint32_t> &ref = map;
+	boa_assert(ref.find("Hello") && !strcmp(ref.find("Hello")->key.data, "Hello"));
+
+	map.remove(map.find("Hello"));
+	boa_assert(map.find("Hello") == nullptr);
+	map.clear();
+	boa_assert(map.count() == 0);
+}
+
+BOA_TEST(cpp_blit_cache, "C++ cache with a byte budget")
+{
+	struct Key { uint32_t file, block; };
+	boa::blit_cache<Key, uint32_t> cache{ 1000, BOA_CACHE_LRU };
+	uint32_t num_evicted = 0;
+	cache.set_evict_fn([](void *entry, void *user) { (*(uint32_t*)user)++; }, &num_evicted);
+
+	for (uint32_t i = 0; i < 20; i++) {
+		Key key = { i / 4, i % 4 };
+		boa_assert(cache.insert_or_assign(key, i, 100));
+	}
+	boa_assert(cache.count() == 10);
+	boa_assert(num_evicted == 10);
+	boa_assert(cache.find(Key{ 0, 0 }) == nullptr);
+	boa_assert(cache.find(Key{ 4, 3 }) && cache.find(Key{ 4, 3 })->val == 19);
+	boa_assert(cache.hits == 2 && cache.misses == 1);
+
+	boa_assert(cache.insert_or_assign(Key{ 0, 0 }, 5, 2000) == nullptr);
+	boa_assert(cache.remove(Key{ 4, 3 }));
+	boa_assert(!cache.remove(Key{ 4, 3 }));
+	cache.clear();
+	boa_assert(cache.count() == 0);
+	boa_assert(num_evicted == 20);
+}
+
 BOA_TEST(cpp_pqueue, "C++ priority queue")
 {
 	boa::pqueue<int> pq;
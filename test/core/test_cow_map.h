@@ -0,0 +1,321 @@
+#include <boa_test.h>
+#include <boa_core.h>
+#include <boa_os.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct { uint32_t key, val; } cow_kv;
+
+int cow_kv_cmp(const void *a, const void *b, void *user) { return *(const uint32_t*)a == *(const uint32_t*)b; }
+
+cow_kv *cow_find(const boa_cow_version *ver, uint32_t key)
+{
+	return (cow_kv*)boa_cow_version_find(ver, &key, boa_u32_hash(key), &cow_kv_cmp, NULL);
+}
+
+int cow_set(boa_cow_map *map, uint32_t key, uint32_t val)
+{
+	boa_map_insert_result res = boa_cow_map_insert(map, &key, boa_u32_hash(key), &cow_kv_cmp, NULL);
+	if (!res.entry) return 0;
+	cow_kv *kv = (cow_kv*)res.entry;
+	kv->key = key;
+	kv->val = val;
+	return 1;
+}
+
+int cow_remove(boa_cow_map *map, uint32_t key)
+{
+	return boa_cow_map_remove(map, &key, boa_u32_hash(key), &cow_kv_cmp, NULL);
+}
+
+// Check that `ver` matches `vals` where zero values are missing keys
+void cow_check_version(const boa_cow_version *ver, const uint32_t *vals, uint32_t num_keys)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < num_keys; i++) {
+		cow_kv *kv = cow_find(ver, i);
+		if (vals[i]) {
+			boa_assert(kv != NULL);
+			boa_assert(kv->key == i);
+			boa_assert(kv->val == vals[i]);
+			count++;
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+	boa_assert(ver->count == count);
+}
+
+#define cow_meta_key 0xffffffffu
+
+typedef struct {
+	boa_cow_map *map;
+	volatile uint32_t done;
+} cow_map_thread_ctx;
+
+typedef struct {
+	cow_map_thread_ctx *ctx;
+	uint32_t reader;
+	uint32_t num_checked;
+} cow_map_reader;
+
+// Every published version contains keys [0, n) and key `cow_meta_key` with value `n`
+void cow_map_reader_entry(void *user)
+{
+	cow_map_reader *r = (cow_map_reader*)user;
+	cow_map_thread_ctx *ctx = r->ctx;
+	while (!boa_atomic_load_u32(&ctx->done)) {
+		const boa_cow_version *ver = boa_cow_map_pin(ctx->map, r->reader);
+		cow_kv *meta = cow_find(ver, cow_meta_key);
+		if (meta) {
+			uint32_t n = meta->val;
+			boa_assert(ver->count == n + 1);
+			boa_assert(cow_find(ver, n) == NULL);
+			if (n > 0) {
+				boa_assert(cow_find(ver, n - 1) != NULL);
+				boa_assert(cow_find(ver, r->num_checked % n) != NULL);
+			}
+		} else {
+			boa_assert(ver->count == 0);
+		}
+		boa_cow_map_unpin(ctx->map, r->reader);
+		r->num_checked++;
+	}
+}
+
+#endif
+
+BOA_TEST(cow_map_versions, "Pinned versions of a copy-on-write map are not affected by writes")
+{
+	enum { num_keys = 2000 };
+	static uint32_t old_vals[num_keys], new_vals[num_keys];
+	boa_cow_map map;
+	boa_assert(boa_cow_map_init(&map, sizeof(cow_kv), 2, NULL));
+
+	for (uint32_t i = 0; i < num_keys / 2; i++) {
+		boa_assert(cow_set(&map, i, i + 1));
+		old_vals[i] = i + 1;
+	}
+
+	// Nothing is visible before publishing
+	{
+		const boa_cow_version *ver = boa_cow_map_pin(&map, 0);
+		boa_assert(ver->count == 0);
+		boa_assert(cow_find(ver, 10) == NULL);
+		boa_cow_map_unpin(&map, 0);
+	}
+
+	boa_cow_map_publish(&map);
+	const boa_cow_version *old_ver = boa_cow_map_pin(&map, 0);
+	cow_check_version(old_ver, old_vals, num_keys);
+
+	memcpy(new_vals, old_vals, sizeof(new_vals));
+	for (uint32_t i = 0; i < num_keys; i++) {
+		if (i < num_keys / 2 && i % 3 == 0) {
+			boa_assert(cow_remove(&map, i) == 1);
+			new_vals[i] = 0;
+		} else {
+			boa_assert(cow_set(&map, i, i * 7 + 3));
+			new_vals[i] = i * 7 + 3;
+		}
+	}
+	boa_assert(cow_remove(&map, 0) == 0);
+	cow_check_version(boa_cow_map_current(&map), new_vals, num_keys);
+
+	// Readers still get the old version until the changes are published
+	{
+		const boa_cow_version *ver = boa_cow_map_pin(&map, 1);
+		boa_assert(ver == old_ver);
+		boa_cow_map_unpin(&map, 1);
+	}
+	cow_check_version(old_ver, old_vals, num_keys);
+
+	boa_cow_map_publish(&map);
+	const boa_cow_version *new_ver = boa_cow_map_pin(&map, 1);
+	cow_check_version(new_ver, new_vals, num_keys);
+	cow_check_version(old_ver, old_vals, num_keys);
+	boa_assert(boa_non_empty(&map.retired));
+
+	// Old blocks are reclaimed once nobody is reading them
+	boa_cow_map_unpin(&map, 0);
+	boa_cow_map_collect(&map);
+	boa_assert(boa_is_empty(&map.retired));
+	cow_check_version(new_ver, new_vals, num_keys);
+	boa_cow_map_unpin(&map, 1);
+
+	boa_cow_map_reset(&map);
+}
+
+BOA_TEST(cow_map_random, "Random modifications to a copy-on-write map")
+{
+	enum { num_keys = 4096, num_snapshots = 4 };
+	static uint32_t vals[num_keys], snapshot_vals[num_snapshots][num_keys];
+	const boa_cow_version *snapshots[num_snapshots] = { 0 };
+	uint32_t seed = 1;
+
+	boa_cow_map map;
+	boa_assert(boa_cow_map_init(&map, sizeof(cow_kv), num_snapshots, NULL));
+	memset(vals, 0, sizeof(vals));
+
+	for (uint32_t round = 0; round < 200; round++) {
+		boa_test_hint_u32(round);
+
+		uint32_t num_ops = round % 7 == 0 ? 1000 : 20;
+		for (uint32_t op = 0; op < num_ops; op++) {
+			seed = seed * 1664525u + 1013904223u;
+			uint32_t key = (seed >> 8) % num_keys;
+			if (seed >> 30 == 0) {
+				boa_assert(cow_remove(&map, key) == (vals[key] != 0));
+				vals[key] = 0;
+			} else {
+				boa_assert(cow_set(&map, key, round + 1));
+				vals[key] = round + 1;
+			}
+		}
+
+		boa_cow_map_publish(&map);
+
+		// Keep some versions pinned for a while
+		uint32_t slot = round % num_snapshots;
+		if (snapshots[slot]) {
+			cow_check_version(snapshots[slot], snapshot_vals[slot], num_keys);
+			boa_cow_map_unpin(&map, slot);
+		}
+		snapshots[slot] = boa_cow_map_pin(&map, slot);
+		memcpy(snapshot_vals[slot], vals, sizeof(vals));
+		cow_check_version(snapshots[slot], vals, num_keys);
+	}
+
+	for (uint32_t i = 0; i < num_snapshots; i++) {
+		cow_check_version(snapshots[i], snapshot_vals[i], num_keys);
+		boa_cow_map_unpin(&map, i);
+	}
+	boa_cow_map_collect(&map);
+	boa_assert(boa_is_empty(&map.retired));
+
+	boa_cow_map_reset(&map);
+}
+
+BOA_TEST(cow_map_fail_alloc, "Copy-on-write map should survive allocation failures")
+{
+	enum { num_keys = 500 };
+	static uint32_t vals[num_keys];
+	boa_cow_map map;
+	memset(vals, 0, sizeof(vals));
+
+	boa_test_fail_next_allocation();
+	boa_assert(!boa_cow_map_init(&map, sizeof(cow_kv), 1, NULL));
+
+	boa_assert(boa_cow_map_init(&map, sizeof(cow_kv), 1, NULL));
+	for (uint32_t i = 0; i < num_keys; i++) {
+		boa_test_fail_allocations(i % 3, 1);
+		if (cow_set(&map, i, i + 1)) vals[i] = i + 1;
+		boa_test_fail_allocations(0, 0);
+
+		if (i % 10 == 0) {
+			boa_cow_map_publish(&map);
+			uint32_t key = i / 2;
+			boa_test_fail_next_allocation();
+			int res = cow_remove(&map, key);
+			boa_test_fail_allocations(0, 0);
+			if (res == 1) vals[key] = 0;
+			else boa_assert(res == (vals[key] ? -1 : 0));
+		}
+	}
+
+	cow_check_version(boa_cow_map_current(&map), vals, num_keys);
+	boa_cow_map_publish(&map);
+	cow_check_version(boa_cow_map_current(&map), vals, num_keys);
+
+	boa_cow_map_reset(&map);
+}
+
+BOA_TEST(cow_map_colliding_hashes, "Copy-on-write map should not grow without bound on colliding hashes")
+{
+	// Two groups of keys that only differ in a single block bit and a group that
+	// shares all the block bits so it can never be split
+	enum { num_keys = BOA_COW_MAP_BLOCK_ENTRIES + 10 };
+	uint32_t split_bit = 1u << (BOA__MAP_BLOCK_SHIFT + 4);
+	uint32_t hashes[2] = { 0x12345678u & ~split_bit, 0x12345678u | split_bit };
+	boa_cow_map map;
+	boa_assert(boa_cow_map_init(&map, sizeof(cow_kv), 1, NULL));
+
+	for (uint32_t i = 0; i < 2 * BOA_COW_MAP_BLOCK_ENTRIES; i++) {
+		uint32_t key = i;
+		boa_map_insert_result res = boa_cow_map_insert(&map, &key, hashes[i % 2], &cow_kv_cmp, NULL);
+		boa_assert(res.entry && res.inserted);
+		((cow_kv*)res.entry)->key = key;
+		((cow_kv*)res.entry)->val = i + 1;
+	}
+	const boa_cow_version *ver = boa_cow_map_current(&map);
+	boa_assert(ver->num_blocks <= 2u << 4);
+
+	uint32_t num_inserted = 0;
+	for (uint32_t i = 0; i < num_keys; i++) {
+		uint32_t key = 1000 + i;
+		boa_map_insert_result res = boa_cow_map_insert(&map, &key, hashes[0] ^ (1u << BOA__MAP_BLOCK_SHIFT), &cow_kv_cmp, NULL);
+		if (!res.entry) continue;
+		((cow_kv*)res.entry)->key = key;
+		((cow_kv*)res.entry)->val = key + 1;
+		num_inserted++;
+	}
+	ver = boa_cow_map_current(&map);
+	boa_assert(num_inserted == BOA_COW_MAP_BLOCK_ENTRIES);
+	boa_assert(ver->num_blocks <= 2u << 4);
+	boa_assert(ver->count == 3 * BOA_COW_MAP_BLOCK_ENTRIES);
+
+	for (uint32_t i = 0; i < 2 * BOA_COW_MAP_BLOCK_ENTRIES; i++) {
+		uint32_t key = i;
+		cow_kv *kv = (cow_kv*)boa_cow_version_find(ver, &key, hashes[i % 2], &cow_kv_cmp, NULL);
+		boa_assert(kv && kv->val == i + 1);
+	}
+	for (uint32_t i = 0; i < num_keys; i++) {
+		uint32_t key = 1000 + i;
+		cow_kv *kv = (cow_kv*)boa_cow_version_find(ver, &key, hashes[0] ^ (1u << BOA__MAP_BLOCK_SHIFT), &cow_kv_cmp, NULL);
+		boa_assert(kv ? kv->val == key + 1 : i >= BOA_COW_MAP_BLOCK_ENTRIES);
+	}
+
+	boa_cow_map_reset(&map);
+}
+
+BOA_TEST(cow_map_threads, "Read a copy-on-write map while it's being modified")
+{
+	enum { num_readers = 3, num_keys = 20000 };
+	boa_cow_map map;
+	cow_map_thread_ctx ctx;
+	cow_map_reader readers[num_readers];
+	boa_thread *threads[num_readers];
+
+	boa_assert(boa_cow_map_init(&map, sizeof(cow_kv), num_readers, NULL));
+	ctx.map = &map;
+	ctx.done = 0;
+
+	for (uint32_t i = 0; i < num_readers; i++) {
+		boa_thread_opts opts = { 0 };
+		readers[i].ctx = &ctx;
+		readers[i].reader = i;
+		readers[i].num_checked = 0;
+		opts.entry = &cow_map_reader_entry;
+		opts.user = &readers[i];
+		threads[i] = boa_create_thread(&opts);
+		boa_assert(threads[i] != NULL);
+	}
+
+	for (uint32_t i = 0; i < num_keys; i++) {
+		boa_assert(cow_set(&map, i, i));
+		boa_assert(cow_set(&map, cow_meta_key, i + 1));
+		boa_cow_map_publish(&map);
+	}
+
+	boa_atomic_store_u32(&ctx.done, 1);
+	for (uint32_t i = 0; i < num_readers; i++) {
+		boa_join_thread(threads[i]);
+	}
+
+	boa_cow_map_collect(&map);
+	boa_assert(boa_is_empty(&map.retired));
+	boa_assert(boa_cow_map_current(&map)->count == num_keys + 1);
+
+	boa_cow_map_reset(&map);
+}
+
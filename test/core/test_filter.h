@@ -0,0 +1,196 @@
+
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct { uint32_t key, val; } filter_kv;
+
+void insert_filter_kv(boa_map *map, uint32_t key)
+{
+	boa_map_insert_result ires = boa_u32_map_insert(map, key);
+	boa_assert(ires.inserted);
+	filter_kv *kv = (filter_kv*)ires.entry;
+	kv->key = key;
+	kv->val = key * 3;
+}
+
+// Check that exactly the keys in `[0, count)` for which `present(key)` is set are found
+void check_filter_map(boa_map *map, uint32_t count, int (*present)(uint32_t key))
+{
+	for (uint32_t i = 0; i < count * 2; i++) {
+		filter_kv *kv = (filter_kv*)boa_u32_map_find(map, i);
+		if (i < count && present(i)) {
+			boa_assert(kv != NULL);
+			boa_assert(kv->key == i);
+			boa_assert(kv->val == i * 3);
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+}
+
+int filter_key_all(uint32_t key) { return 1; }
+int filter_key_odd(uint32_t key) { return key % 2 == 1; }
+int filter_key_none(uint32_t key) { return 0; }
+
+#endif
+
+BOA_TEST(filter_simple, "Filter should have no false negatives and few false positives")
+{
+	boa_filter filter;
+	boa_assert(boa_filter_init(&filter, 10000, NULL));
+
+	for (uint32_t i = 0; i < 10000; i++) {
+		boa_filter_add(&filter, boa_u32_hash(i));
+	}
+	boa_assert(filter.count == 10000);
+
+	for (uint32_t i = 0; i < 10000; i++) {
+		boa_assert(boa_filter_test(&filter, boa_u32_hash(i)));
+	}
+
+	uint32_t num_false = 0;
+	for (uint32_t i = 10000; i < 110000; i++) {
+		num_false += boa_filter_test(&filter, boa_u32_hash(i));
+	}
+	boa_assert(num_false < 1000);
+
+	boa_filter_clear(&filter);
+	boa_assert(filter.count == 0);
+	for (uint32_t i = 0; i < 10000; i++) {
+		boa_assert(!boa_filter_test(&filter, boa_u32_hash(i)));
+	}
+
+	boa_filter_reset(&filter);
+}
+
+BOA_TEST(map_filter, "Filter attached to a map should be kept in sync")
+{
+	boa_map map, *m = &map;
+	boa_filter filter = { 0 };
+	boa_map_init(m, sizeof(filter_kv));
+
+	// Attach to an empty map and let the filter grow with it
+	boa_assert(boa_map_set_filter(m, &filter));
+	for (uint32_t i = 0; i < 20000; i++) {
+		insert_filter_kv(m, i);
+	}
+	boa_assert(filter.capacity >= m->capacity);
+	check_filter_map(m, 20000, &filter_key_all);
+
+	for (uint32_t i = 0; i < 20000; i += 2) {
+		filter_kv *kv = (filter_kv*)boa_u32_map_find(m, i);
+		boa_assert(kv != NULL);
+		boa_map_remove(m, kv);
+	}
+	check_filter_map(m, 20000, &filter_key_odd);
+
+	// The filter has been rebuilt at least once, so most removed keys should be rejected
+	uint32_t num_rejected = 0;
+	for (uint32_t i = 0; i < 20000; i += 2) {
+		if (!boa_filter_test(&filter, boa_u32_hash(i))) num_rejected++;
+	}
+	boa_assert(num_rejected > 5000);
+
+	boa_map_clear(m);
+	boa_assert(filter.count == 0);
+	check_filter_map(m, 20000, &filter_key_none);
+
+	boa_map_reset(m);
+	boa_filter_reset(&filter);
+}
+
+BOA_TEST(map_filter_attach, "Attach a filter to a map that already has entries")
+{
+	boa_map map, *m = &map;
+	boa_filter filter;
+	boa_map_init(m, sizeof(filter_kv));
+
+	for (uint32_t i = 0; i < 5000; i++) {
+		insert_filter_kv(m, i);
+	}
+
+	// Pre-sized filter that is smaller than the map gets re-allocated
+	boa_assert(boa_filter_init(&filter, 100, NULL));
+	boa_assert(boa_map_set_filter(m, &filter));
+	boa_assert(filter.capacity >= m->capacity);
+	boa_assert(filter.count == 5000);
+	check_filter_map(m, 5000, &filter_key_all);
+
+	// Detaching leaves the map working without the filter
+	boa_assert(boa_map_set_filter(m, NULL));
+	insert_filter_kv(m, 5000);
+	check_filter_map(m, 5001, &filter_key_all);
+	boa_assert(filter.count == 5000);
+
+	boa_map_reset(m);
+	boa_filter_reset(&filter);
+}
+
+BOA_TEST(map_filter_incremental, "Filter should cover both tables during an incremental rehash")
+{
+	boa_map map, *m = &map;
+	boa_filter filter = { 0 };
+	boa_map_init(m, sizeof(filter_kv));
+	boa_map_set_incremental(m, 1);
+	boa_assert(boa_map_set_filter(m, &filter));
+
+	int saw_rehash = 0;
+	for (uint32_t i = 0; i < 10000; i++) {
+		insert_filter_kv(m, i);
+		if (m->impl.rehash) saw_rehash = 1;
+		if (i % 1000 == 0) check_filter_map(m, i + 1, &filter_key_all);
+	}
+	boa_assert(saw_rehash);
+
+	// Remove keys from both tables while the rehash is in progress
+	uint32_t count = 10000;
+	for (; m->impl.rehash == NULL; count++) {
+		insert_filter_kv(m, count);
+	}
+	for (uint32_t i = 0; i < count; i += 2) {
+		filter_kv *kv = (filter_kv*)boa_u32_map_find(m, i);
+		boa_assert(kv != NULL);
+		boa_map_remove(m, kv);
+	}
+	boa_assert(m->impl.rehash != NULL);
+	check_filter_map(m, count, &filter_key_odd);
+
+	boa_map_reset(m);
+	boa_filter_reset(&filter);
+}
+
+BOA_TEST(map_filter_batch_build, "Batched finds and bulk builds should use the filter")
+{
+	boa_map map, *m = &map;
+	boa_filter filter = { 0 };
+	boa_map_init(m, sizeof(filter_kv));
+	boa_assert(boa_map_set_filter(m, &filter));
+
+	filter_kv *kvs = boa_make_n(filter_kv, 3000);
+	for (uint32_t i = 0; i < 3000; i++) {
+		kvs[i].key = i * 2 + 1;
+		kvs[i].val = kvs[i].key * 3;
+	}
+	boa_assert(boa_u32_map_build(m, kvs, 3000));
+	boa_assert(filter.count == 3000);
+	check_filter_map(m, 6000, &filter_key_odd);
+
+	uint32_t keys[100];
+	void *entries[100];
+	for (uint32_t i = 0; i < 100; i++) keys[i] = i * 37 % 6000;
+	boa_u32_map_find_batch(m, entries, keys, 100);
+	for (uint32_t i = 0; i < 100; i++) {
+		filter_kv *kv = (filter_kv*)entries[i];
+		if (keys[i] % 2 == 1) {
+			boa_assert(kv != NULL && kv->key == keys[i]);
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+
+	boa_free(kvs);
+	boa_map_reset(m);
+	boa_filter_reset(&filter);
+}
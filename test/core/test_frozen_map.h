@@ -0,0 +1,147 @@
+
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct { uint32_t key, val; } frozen_kv;
+
+// Collides the 32-bit hashes of many keys to exercise the shared slots
+uint32_t frozen_weak_hash(uint32_t key) { return boa_u32_hash(key % 97); }
+int frozen_kv_cmp(const void *a, const void *b, void *user) { return *(const uint32_t*)a == *(const uint32_t*)b; }
+
+#endif
+
+BOA_TEST(frozen_map_u32, "Freeze maps of various sizes")
+{
+	static const uint32_t sizes[] = { 0, 1, 2, 10, 1000, 50000 };
+
+	for (uint32_t n = 0; n < boa_arraycount(sizes); n++) {
+		uint32_t count = sizes[n];
+		boa_test_hint_u32(count);
+
+		boa_map map;
+		boa_frozen_map frozen;
+		boa_map_init(&map, sizeof(frozen_kv));
+		for (uint32_t i = 0; i < count; i++) {
+			frozen_kv *kv = (frozen_kv*)boa_u32_map_insert(&map, i * 3).entry;
+			kv->key = i * 3;
+			kv->val = i;
+		}
+
+		boa_assert(boa_map_freeze(&frozen, &map, NULL));
+		boa_assert(frozen.count == count);
+		boa_map_reset(&map);
+
+		for (uint32_t i = 0; i < count * 3 + 10; i++) {
+			frozen_kv *kv = (frozen_kv*)boa_u32_frozen_map_find(&frozen, i);
+			if (i % 3 == 0 && i / 3 < count) {
+				boa_assert(kv != NULL);
+				boa_assert(kv->key == i);
+				boa_assert(kv->val == i / 3);
+			} else {
+				boa_assert(kv == NULL);
+			}
+		}
+
+		// Entries are densely packed
+		uint64_t sum = 0;
+		for (uint32_t i = 0; i < frozen.count; i++) {
+			sum += ((frozen_kv*)frozen.entries)[i].val;
+		}
+		boa_assert(sum == (uint64_t)count * (count - (count > 0)) / 2);
+
+		boa_frozen_map_reset(&frozen);
+	}
+}
+
+BOA_TEST(frozen_map_hash_collisions, "Frozen map should handle keys with equal hashes")
+{
+	boa_map map;
+	boa_frozen_map frozen;
+	boa_map_init(&map, sizeof(frozen_kv));
+	for (uint32_t i = 0; i < 2000; i++) {
+		boa_map_insert_result ires = boa_map_insert(&map, &i, frozen_weak_hash(i), &frozen_kv_cmp, NULL);
+		frozen_kv *kv = (frozen_kv*)ires.entry;
+		kv->key = i;
+		kv->val = i + 1;
+	}
+
+	boa_assert(boa_map_freeze(&frozen, &map, NULL));
+	boa_map_reset(&map);
+
+	for (uint32_t i = 0; i < 4000; i++) {
+		frozen_kv *kv = (frozen_kv*)boa_frozen_map_find(&frozen, &i, frozen_weak_hash(i), &frozen_kv_cmp, NULL);
+		if (i < 2000) {
+			boa_assert(kv != NULL && kv->val == i + 1);
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+
+	boa_frozen_map_reset(&frozen);
+}
+
+BOA_TEST(frozen_map_blit, "Freeze blit maps with seeds and during an incremental rehash")
+{
+	static const uint32_t key_sizes[] = { 4, 6, 8, 16, 24 };
+
+	for (uint32_t n = 0; n < boa_arraycount(key_sizes); n++) {
+		uint32_t key_size = key_sizes[n];
+		boa_test_hint_u32(key_size);
+
+		char key[32] = { 0 };
+		boa_map map;
+		boa_frozen_map frozen;
+		boa_map_init(&map, 32);
+		boa_map_set_hash_seed(&map, 0x1234u + key_size);
+		boa_map_set_incremental(&map, 1);
+
+		uint32_t count = 0;
+		for (; count < 1000 || map.impl.rehash == NULL; count++) {
+			memcpy(key, &count, sizeof(uint32_t));
+			char *entry = (char*)boa_blit_map_insert(&map, key, key_size).entry;
+			memcpy(entry, key, 32);
+		}
+
+		boa_assert(boa_map_freeze(&frozen, &map, NULL));
+		boa_assert(frozen.count == count);
+
+		for (uint32_t i = 0; i < count + 100; i++) {
+			memcpy(key, &i, sizeof(uint32_t));
+			char *entry = (char*)boa_blit_frozen_map_find(&frozen, key, key_size);
+			boa_assert((entry != NULL) == (i < count));
+			if (entry) boa_assert(!memcmp(entry, key, key_size));
+			boa_assert(entry == NULL || boa_blit_map_find(&map, key, key_size) != NULL);
+		}
+
+		boa_map_reset(&map);
+		boa_frozen_map_reset(&frozen);
+	}
+}
+
+BOA_TEST(frozen_map_alloc_fail, "Freeze should fail gracefully when out of memory")
+{
+	boa_map map;
+	boa_frozen_map frozen;
+	boa_map_init(&map, sizeof(frozen_kv));
+	for (uint32_t i = 0; i < 100; i++) {
+		frozen_kv *kv = (frozen_kv*)boa_u32_map_insert(&map, i).entry;
+		kv->key = i;
+		kv->val = i;
+	}
+
+	for (uint32_t fail = 0; fail <= 10; fail++) {
+		boa_test_hint_u32(fail);
+		boa_test_fail_allocations(fail, 1);
+		int ok = boa_map_freeze(&frozen, &map, NULL);
+		boa_test_fail_allocations(0, 0);
+		boa_assert(ok == (fail >= 10));
+		if (ok) {
+			boa_assert(boa_u32_frozen_map_find(&frozen, 42) != NULL);
+			boa_frozen_map_reset(&frozen);
+		}
+	}
+
+	boa_map_reset(&map);
+}
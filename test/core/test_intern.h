@@ -0,0 +1,155 @@
+#include <boa_test.h>
+#include <boa_core.h>
+#include <boa_os.h>
+
+#if BOA_TEST_IMPL
+
+#define intern_num_threads 4
+#define intern_num_strings 2000
+
+typedef struct {
+	boa_intern *intern;
+	uint32_t index;
+	uint32_t ids[intern_num_strings];
+} intern_thread_ctx;
+
+// Intern the same strings from every thread in a different order
+void intern_thread_entry(void *user)
+{
+	intern_thread_ctx *ctx = (intern_thread_ctx*)user;
+	char buf[64];
+	for (uint32_t n = 0; n < intern_num_strings; n++) {
+		uint32_t i = (n * 7 + ctx->index * 501) % intern_num_strings;
+		uint32_t length = (uint32_t)snprintf(buf, sizeof(buf), "tag:%u", i);
+		ctx->ids[i] = boa_intern_str(ctx->intern, buf, length);
+		boa_assert(ctx->ids[i] != BOA_INTERN_INVALID_ID);
+	}
+}
+
+#endif
+
+BOA_TEST(intern_simple, "Intern strings to dense IDs and back")
+{
+	boa_intern intern;
+	boa_intern_init(&intern, 0, NULL);
+
+	boa_assert(boa_intern_cstr(&intern, "apple") == 0);
+	boa_assert(boa_intern_cstr(&intern, "banana") == 1);
+	boa_assert(boa_intern_cstr(&intern, "apple") == 0);
+	boa_assert(boa_intern_str(&intern, "cherry pie", 6) == 2);
+	boa_assert(boa_intern_str(&intern, "", 0) == 3);
+	boa_assert(boa_intern_count(&intern) == 4);
+
+	boa_assert(boa_intern_find_cstr(&intern, "banana") == 1);
+	boa_assert(boa_intern_find_cstr(&intern, "cherry") == 2);
+	boa_assert(boa_intern_find_cstr(&intern, "durian") == BOA_INTERN_INVALID_ID);
+	boa_assert(boa_intern_count(&intern) == 4);
+
+	uint32_t length;
+	boa_assert(!strcmp(boa_intern_get(&intern, 0, &length), "apple") && length == 5);
+	boa_assert(!strcmp(boa_intern_get(&intern, 2, &length), "cherry") && length == 6);
+	boa_assert(!strcmp(boa_intern_get(&intern, 3, NULL), ""));
+
+	boa_intern_reset(&intern);
+}
+
+BOA_TEST(intern_bulk, "Intern a batch of strings")
+{
+	enum { count = 1000 };
+	static char storage[count][32];
+	static const char *strings[count];
+	static uint32_t lengths[count], ids[count], ids2[count];
+
+	boa_intern intern;
+	boa_intern_init(&intern, 0, NULL);
+	boa_assert(boa_intern_cstr(&intern, "tag:7") == 0);
+
+	// Every string appears twice in the batch
+	for (uint32_t i = 0; i < count; i++) {
+		lengths[i] = (uint32_t)snprintf(storage[i], sizeof(storage[i]), "tag:%u", i % (count / 2));
+		strings[i] = storage[i];
+	}
+
+	boa_assert(boa_intern_bulk(&intern, ids, strings, lengths, count));
+	boa_assert(boa_intern_count(&intern) == count / 2);
+	boa_assert(ids[7] == 0);
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(ids[i] < count / 2);
+		boa_assert(ids[i] == ids[i % (count / 2)]);
+		uint32_t length;
+		const char *str = boa_intern_get(&intern, ids[i], &length);
+		boa_assert(length == lengths[i] && !memcmp(str, strings[i], length));
+	}
+
+	// Zero-terminated strings without lengths
+	boa_assert(boa_intern_bulk(&intern, ids2, strings, NULL, count));
+	boa_assert(!memcmp(ids, ids2, sizeof(ids)));
+
+	boa_intern_reset(&intern);
+}
+
+BOA_TEST(intern_fail_alloc, "Interning should fail gracefully")
+{
+	boa_intern intern;
+	boa_intern_init(&intern, 0, NULL);
+	char buf[32];
+
+	for (uint32_t i = 0; i < 300; i++) {
+		uint32_t length = (uint32_t)snprintf(buf, sizeof(buf), "s%u", i);
+		boa_test_fail_allocations(i % 4, 1);
+		uint32_t id = boa_intern_str(&intern, buf, length);
+		boa_test_fail_allocations(0, 0);
+
+		boa_assert(boa_intern_find(&intern, buf, length) == id);
+		if (id != BOA_INTERN_INVALID_ID) {
+			boa_assert(!strcmp(boa_intern_get(&intern, id, NULL), buf));
+		}
+	}
+
+	// IDs stay dense even if some inserts failed
+	uint32_t count = boa_intern_count(&intern);
+	boa_assert(count == intern.map.map.count);
+	for (uint32_t id = 0; id < count; id++) {
+		const char *str = boa_intern_get(&intern, id, NULL);
+		boa_assert(boa_intern_find_cstr(&intern, str) == id);
+	}
+
+	boa_intern_reset(&intern);
+}
+
+BOA_TEST(intern_threads, "Intern the same strings from multiple threads")
+{
+	static intern_thread_ctx ctxs[intern_num_threads];
+	boa_thread *threads[intern_num_threads];
+	boa_intern intern;
+
+	// The test allocator isn't thread-safe so allocate directly from the original one
+	boa_intern_init(&intern, 1, boa_test_original_ator());
+
+	for (uint32_t i = 0; i < intern_num_threads; i++) {
+		boa_thread_opts opts = { 0 };
+		ctxs[i].intern = &intern;
+		ctxs[i].index = i;
+		opts.entry = &intern_thread_entry;
+		opts.user = &ctxs[i];
+		threads[i] = boa_create_thread(&opts);
+		boa_assert(threads[i] != NULL);
+	}
+	for (uint32_t i = 0; i < intern_num_threads; i++) {
+		boa_join_thread(threads[i]);
+	}
+
+	boa_assert(boa_intern_count(&intern) == intern_num_strings);
+	for (uint32_t i = 0; i < intern_num_strings; i++) {
+		char buf[64];
+		snprintf(buf, sizeof(buf), "tag:%u", i);
+		uint32_t id = ctxs[0].ids[i];
+		for (uint32_t t = 1; t < intern_num_threads; t++) {
+			boa_assert(ctxs[t].ids[i] == id);
+		}
+		boa_assert(!strcmp(boa_intern_get(&intern, id, NULL), buf));
+	}
+
+	boa_intern_reset(&intern);
+}
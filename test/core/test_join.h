@@ -0,0 +1,146 @@
+
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+uint32_t g_join_radix_bits;
+
+// Max-heap order so that popping to the back sorts ascending
+int join_pair_before(const void *a, const void *b, void *user)
+{
+	const boa_join_pair *pa = (const boa_join_pair*)a, *pb = (const boa_join_pair*)b;
+	if (pa->probe_index != pb->probe_index) return pa->probe_index > pb->probe_index;
+	return pa->build_index > pb->build_index;
+}
+
+// Heap sort using the priority queue helpers
+void sort_join_pairs(boa_join_pair *pairs, uint32_t count)
+{
+	for (uint32_t i = 1; i < count; i++) {
+		boa_upheap(pairs, i, sizeof(boa_join_pair), &join_pair_before, NULL);
+	}
+	for (uint32_t end = count; end > 1; end--) {
+		boa_join_pair tmp = pairs[0];
+		pairs[0] = pairs[end - 1];
+		pairs[end - 1] = tmp;
+		boa_downheap(pairs, (end - 1) * sizeof(boa_join_pair), 0, sizeof(boa_join_pair), &join_pair_before, NULL);
+	}
+}
+
+// Check `boa_hash_join()` against a nested loop join of rows with `key_size` byte keys
+void check_join(const char *build, uint32_t build_count, const char *probe, uint32_t probe_count,
+	uint32_t key_size, uint32_t stride)
+{
+	boa_join_opts opts = { 0 };
+	opts.key_size = key_size;
+	opts.build_stride = stride;
+	opts.probe_stride = stride;
+	opts.radix_bits = g_join_radix_bits;
+
+	boa_buf out = boa_empty_buf();
+	boa_assert(boa_hash_join(&out, build, build_count, probe, probe_count, &opts));
+
+	boa_buf ref = boa_empty_buf();
+	for (uint32_t p = 0; p < probe_count; p++) {
+		for (uint32_t b = 0; b < build_count; b++) {
+			if (!memcmp(build + b * stride, probe + p * stride, key_size)) {
+				boa_join_pair pair = { b, p };
+				boa_assert(boa_push_data(&ref, &pair));
+			}
+		}
+	}
+
+	uint32_t count = (uint32_t)boa_count(boa_join_pair, &out);
+	boa_assert(count == boa_count(boa_join_pair, &ref));
+
+	// Reference pairs are already in the sorted order
+	sort_join_pairs(boa_begin(boa_join_pair, &out), count);
+	boa_assert(!memcmp(out.data, ref.data, count * sizeof(boa_join_pair)));
+
+	boa_reset(&out);
+	boa_reset(&ref);
+}
+
+#else
+
+extern uint32_t g_join_radix_bits;
+
+static uint32_t join_radix_bits_values[] = {
+	BOA_JOIN_AUTO_RADIX, BOA_JOIN_NO_PARTITIONS, 3,
+};
+
+#endif
+
+BOA_TEST_BEGIN_PERMUTATION_U32(g_join_radix_bits, join_radix_bits_values)
+
+BOA_TEST(hash_join_u32, "Join rows with 4-byte keys and duplicates on both sides")
+{
+	typedef struct { uint32_t key, val; } row;
+	row build[500], probe[700];
+	for (uint32_t i = 0; i < 500; i++) {
+		build[i].key = i % 200;
+		build[i].val = i;
+	}
+	for (uint32_t i = 0; i < 700; i++) {
+		probe[i].key = (i * 7) % 350;
+		probe[i].val = i;
+	}
+	check_join((const char*)build, 500, (const char*)probe, 700, 4, sizeof(row));
+}
+
+BOA_TEST(hash_join_key_sizes, "Join rows with keys of various sizes")
+{
+	static const uint32_t key_sizes[] = { 1, 6, 8, 12, 16, 20 };
+	char build[300 * 24], probe[400 * 24];
+	uint32_t stride = 24;
+
+	for (uint32_t n = 0; n < boa_arraycount(key_sizes); n++) {
+		uint32_t key_size = key_sizes[n];
+		boa_test_hint_u32(key_size);
+
+		memset(build, 0xcc, sizeof(build));
+		memset(probe, 0xcc, sizeof(probe));
+		for (uint32_t i = 0; i < 300; i++) {
+			memset(build + i * stride, 0, key_size);
+			build[i * stride + key_size - 1] = (char)(i % 50);
+		}
+		for (uint32_t i = 0; i < 400; i++) {
+			memset(probe + i * stride, 0, key_size);
+			probe[i * stride + key_size - 1] = (char)(i % 80);
+		}
+		check_join(build, 300, probe, 400, key_size, stride);
+	}
+}
+
+BOA_TEST_END_PERMUTATION(g_join_radix_bits)
+
+BOA_TEST(hash_join_large, "Join inputs large enough to be partitioned automatically")
+{
+	uint32_t build_count = 20000, probe_count = 50000;
+	uint32_t *build = boa_make_n(uint32_t, build_count);
+	uint32_t *probe = boa_make_n(uint32_t, probe_count);
+	for (uint32_t i = 0; i < build_count; i++) build[i] = i * 2;
+	for (uint32_t i = 0; i < probe_count; i++) probe[i] = i;
+
+	boa_join_opts opts = { 0 };
+	opts.key_size = 4;
+	opts.build_stride = 4;
+	opts.probe_stride = 4;
+
+	boa_buf out = boa_empty_buf();
+	boa_assert(boa_hash_join(&out, build, build_count, probe, probe_count, &opts));
+	boa_assert(boa_count(boa_join_pair, &out) == build_count);
+
+	char *seen = (char*)boa_alloc(probe_count);
+	memset(seen, 0, probe_count);
+	boa_for (boa_join_pair, pair, &out) {
+		boa_assert(build[pair->build_index] == probe[pair->probe_index]);
+		boa_assert(!seen[pair->probe_index]);
+		seen[pair->probe_index] = 1;
+	}
+
+	boa_free(seen);
+	boa_reset(&out);
+	boa_free(build);
+	boa_free(probe);
+}
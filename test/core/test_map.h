@@ -9,6 +9,7 @@ int g_insert_reversed;
 
 uint32_t int_hash(int i) { return i % 10000 * g_hash_factor; }
 int int_cmp(const void *a, const void *b, void *user) { return *(int*)a == *(int*)b; }
+int u32_key_cmp(const void *a, const void *b, void *user) { return *(const uint32_t*)a == *(const uint32_t*)b; }
 
 typedef struct { int key, val; } kv_int_int;
 
@@ -68,6 +69,12 @@ void init_square_map(boa_map *map, uint32_t count)
 	init_square_map_ator(map, count, NULL);
 }
 
+int counting_int_cmp(const void *a, const void *b, void *user)
+{
+	++*(uint32_t*)user;
+	return *(int*)a == *(int*)b;
+}
+
 typedef struct string_entry {
 	uint32_t length;
 	char *string;
@@ -136,6 +143,70 @@ void string_map_reset(boa_map *map)
 	boa_map_reset(map);
 }
 
+// Runs the jobs in reverse order on the calling thread to make sure they don't depend on each other
+void reverse_run_jobs(boa_job_runner *runner, boa_job_fn fn, void *user, uint32_t count)
+{
+	for (uint32_t i = count; i > 0; i--) {
+		fn(user, i - 1);
+	}
+}
+
+typedef struct {
+	const boa_map *map;
+	uint32_t num_parts;
+	uint64_t *part_sums;
+} map_part_sum_job;
+
+// Sum the values of a single part of the map, streaming a block at a time
+void map_part_sum(void *user, uint32_t index)
+{
+	map_part_sum_job *job = (map_part_sum_job*)user;
+	boa_map_part part = boa_map_get_part(job->map, index, job->num_parts);
+	uint64_t sum = 0;
+	boa_map_iterator it = boa_map_part_begin(job->map, &part);
+	while (it.entry) {
+		kv_int_int *begin = (kv_int_int*)it.entry, *end = (kv_int_int*)it.impl_block_end;
+		for (kv_int_int *kv = begin; kv != end; kv++) {
+			sum += (uint32_t)kv->val;
+		}
+		boa_map_part_next_block(job->map, &part, &it);
+	}
+	job->part_sums[index] = sum;
+}
+
+// Check that the parts of `map` cover every entry exactly once
+void check_map_parts(const boa_map *map, uint32_t count, uint32_t num_parts)
+{
+	char *seen = (char*)boa_alloc(count);
+	memset(seen, 0, count);
+
+	uint32_t prev_end = 0;
+	for (uint32_t i = 0; i < num_parts; i++) {
+		boa_map_part part = boa_map_get_part(map, i, num_parts);
+		boa_assert(part.begin_block == prev_end);
+		prev_end = part.end_block;
+
+		boa_map_part_for (kv_int_int, kv, map, &part) {
+			boa_assert(kv->key >= 0 && (uint32_t)kv->key < count);
+			boa_assert(!seen[kv->key]);
+			seen[kv->key] = 1;
+		}
+
+		// The iterator variant visits the same entries
+		uint32_t num_for = 0, num_iter = 0;
+		boa_map_part_for (kv_int_int, kv, map, &part) num_for++;
+		for (boa_map_iterator it = boa_map_part_begin(map, &part); it.entry; boa_map_part_advance(map, &part, &it)) {
+			num_iter++;
+		}
+		boa_assert(num_for == num_iter);
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_assert(seen[i]);
+	}
+	boa_free(seen);
+}
+
 #else
 
 extern uint32_t g_hash_factor;
@@ -232,6 +303,306 @@ BOA_TEST(map_medium, "Insert a medium amount of keys")
 	boa_map_reset(map);
 }
 
+BOA_TEST(map_find_batch, "Find a medium amount of keys in batches")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	uint32_t count = 1000;
+	init_square_map(map, count);
+
+	int keys[2000];
+	uint32_t hashes[2000];
+	void *entries[2000];
+	for (uint32_t i = 0; i < 2000; i++) {
+		keys[i] = (int)(i * 7 % 2000);
+		hashes[i] = int_hash(keys[i]);
+	}
+
+	boa_map_find_batch(map, entries, keys, sizeof(int), hashes, 2000, &int_cmp, NULL);
+
+	for (uint32_t i = 0; i < 2000; i++) {
+		boa_test_hint_u32(i);
+		kv_int_int *kv = (kv_int_int*)entries[i];
+		if (keys[i] < (int)count) {
+			boa_assert(kv != NULL);
+			boa_assert(kv->key == keys[i]);
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_build, "Build a map from an array of entries")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+	uint32_t count = 1000;
+
+	// Previous contents should be replaced
+	insert_int(map, 5000, 1);
+
+	kv_int_int *entries = boa_make_n(kv_int_int, count);
+	uint32_t *hashes = boa_make_n(uint32_t, count);
+	for (uint32_t i = 0; i < count; i++) {
+		int key = g_insert_reversed ? (int)(count - i - 1) : (int)i;
+		entries[i].key = key;
+		entries[i].val = key * key;
+		hashes[i] = int_hash(key);
+	}
+
+	boa_assert(boa_map_build(map, entries, hashes, count));
+	boa_assert(map->count == count);
+	boa_assert(map->capacity >= count);
+	boa_free(entries);
+	boa_free(hashes);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(map, i) == i * i);
+	}
+	boa_assert(find_int(map, 5000) == -1);
+
+	// Map should work normally after building
+	insert_int(map, 5000, 2);
+	erase_int(map, 0);
+	boa_assert(find_int(map, 5000) == 2);
+	boa_assert(find_int(map, 0) == -1);
+	boa_assert(map->count == count);
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_snapshot, "Write a map snapshot and open it read-only")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	uint32_t count = 1000;
+	init_square_map(map, count);
+
+	// Remove some to have holes in the blocks
+	for (uint32_t i = 0; i < count; i += 3) {
+		erase_int(map, i);
+	}
+
+	uint32_t size = boa_map_snapshot_size(map);
+	void *data = boa_alloc(size);
+	boa_assert(boa_map_snapshot_write(map, data, size - 1) == 0);
+	boa_assert(boa_map_snapshot_write(map, data, size) == size);
+	boa_map_reset(map);
+
+	boa_map snapv = { 0 }, *snap = &snapv;
+	boa_map_init(snap, sizeof(kv_int_int));
+	boa_assert(boa_map_snapshot_open(snap, data, size));
+	boa_assert(snap->count == count - (count + 2) / 3);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(snap, i) == (i % 3 == 0 ? -1 : i * i));
+	}
+
+	uint32_t num_visited = 0;
+	boa_map_for (kv_int_int, kv, snap) {
+		boa_assert(kv->key % 3 != 0);
+		num_visited++;
+	}
+	boa_assert(num_visited == snap->count);
+
+	// Inserting should fail without touching the snapshot
+	int key = (int)count;
+	boa_map_insert_result ires = boa_map_insert(snap, &key, int_hash(key), &int_cmp, NULL);
+	boa_assert(ires.entry == NULL);
+	boa_assert(find_int(snap, 1) == 1);
+
+	boa_map_reset(snap);
+
+	// Incompatible snapshots should be rejected
+	boa_map_init(snap, sizeof(int));
+	boa_assert(!boa_map_snapshot_open(snap, data, size));
+	boa_map_init(snap, sizeof(kv_int_int));
+	boa_assert(!boa_map_snapshot_open(snap, data, size - 1));
+	((uint32_t*)data)[1] += 1;
+	boa_assert(!boa_map_snapshot_open(snap, data, size));
+	((uint32_t*)data)[1] -= 1;
+	boa_assert(boa_map_snapshot_open(snap, data, size));
+	boa_map_reset(snap);
+
+	// Snapshots written with a different `boa_hash_bytes()` variant would miss long keys
+	boa_map_init(snap, sizeof(kv_int_int));
+	boa__map_snapshot_header *header = (boa__map_snapshot_header*)data;
+	header->hash_variant = BOA__HASH_VARIANT == 1 ? 2 : 1;
+	boa_assert(!boa_map_snapshot_open(snap, data, size));
+	header->hash_variant = BOA__HASH_VARIANT;
+
+	// Blocks smaller than a slot group would be scanned out of bounds even if the rest
+	// of the header is consistent with them
+	for (uint32_t entries = 1; entries < BOA_MAP_MIN_BLOCK_ENTRIES; entries *= 2) {
+		boa__map_snapshot_header bad = *header;
+		boa_map view = *snap;
+		view.impl.block_num_entries = (uint8_t)entries;
+		header->block_num_entries = entries;
+		header->layout = boa__map_get_layout(&view, header->num_blocks);
+		boa_assert(!boa_map_snapshot_open(snap, data, size));
+		*header = bad;
+	}
+	boa_assert(boa_map_snapshot_open(snap, data, size));
+	boa_map_reset(snap);
+
+	boa_free(data);
+}
+
+BOA_TEST(map_stats, "Map statistics should be consistent with the contents")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+	boa_map_stats stats;
+
+	boa_map_get_stats(map, &stats);
+	boa_assert(stats.count == 0);
+	boa_assert(stats.memory_bytes == 0);
+
+	uint32_t count = 1000;
+	init_square_map(map, count);
+	boa_map_get_stats(map, &stats);
+
+	boa_assert(stats.count == count);
+	boa_assert(stats.capacity == map->capacity);
+	boa_assert(stats.num_aux_used <= stats.num_aux_allocated);
+	boa_assert(stats.avg_scan <= (double)stats.max_scan);
+	boa_assert(stats.avg_aux_chain <= (double)stats.max_aux_chain);
+	boa_assert(stats.bytes_per_entry >= (double)sizeof(kv_int_int));
+
+	uint32_t num_blocks = 0;
+	for (uint32_t i = 0; i < BOA_MAP_STATS_FILL_BUCKETS; i++) {
+		num_blocks += stats.fill_histogram[i];
+	}
+	boa_assert(num_blocks == stats.num_hash_blocks + stats.num_aux_used);
+	boa_assert(stats.num_full_blocks <= stats.fill_histogram[BOA_MAP_STATS_FILL_BUCKETS - 1]);
+
+	// Every hash in the same block should result in full blocks and long aux chains
+	if (g_hash_factor == 0 && stats.num_hash_blocks > 1) {
+		boa_assert(stats.max_aux_chain >= count / stats.block_num_entries - 1);
+		boa_assert(stats.max_scan > 0);
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_shrink, "Shrink a map after removing most of the keys")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	uint32_t count = 1000;
+	init_square_map(map, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (i % 10 != 0) erase_int(map, i);
+	}
+
+	boa_map_stats before, after;
+	boa_map_get_stats(map, &before);
+	boa_assert(boa_map_shrink(map));
+	boa_map_get_stats(map, &after);
+
+	boa_assert(map->count == count / 10);
+	boa_assert(map->capacity >= map->count);
+	boa_assert(map->capacity < before.capacity);
+	boa_assert(after.memory_bytes < before.memory_bytes);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(map, i) == (i % 10 == 0 ? i * i : -1));
+	}
+
+	// Shrinking an empty map frees everything
+	for (uint32_t i = 0; i < count; i += 10) {
+		erase_int(map, i);
+	}
+	boa_assert(boa_map_shrink(map));
+	boa_assert(map->capacity == 0);
+	boa_assert(map->impl.blocks == NULL);
+	insert_int(map, 1, 1);
+	boa_assert(find_int(map, 1) == 1);
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_compact, "Compacting should release auxilary blocks")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	uint32_t count = 1000;
+	init_square_map(map, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (i % 4 != 0) erase_int(map, i);
+	}
+
+	boa_map_stats before, after;
+	boa_map_get_stats(map, &before);
+	boa_assert(boa_map_compact(map));
+	boa_map_get_stats(map, &after);
+
+	boa_assert(after.capacity == before.capacity);
+	boa_assert(after.num_aux_allocated <= before.num_aux_allocated);
+
+	// Every primary block should only chain the auxilary blocks its own entries need
+	uint32_t *block_counts = boa_make_n(uint32_t, after.num_hash_blocks);
+	memset(block_counts, 0, after.num_hash_blocks * sizeof(uint32_t));
+	for (uint32_t i = 0; i < count; i += 4) {
+		uint32_t hash = boa__map_hash_canonicalize(int_hash((int)i));
+		block_counts[(hash >> BOA__MAP_BLOCK_SHIFT) & (after.num_hash_blocks - 1)]++;
+	}
+	uint32_t min_aux = 0, min_chain = 0;
+	for (uint32_t i = 0; i < after.num_hash_blocks; i++) {
+		if (block_counts[i] == 0) continue;
+		uint32_t chain = (block_counts[i] - 1) / after.block_num_entries;
+		min_aux += chain;
+		min_chain = boa_max(min_chain, chain);
+	}
+	boa_free(block_counts);
+	boa_assert(after.num_aux_used == min_aux);
+	boa_assert(after.max_aux_chain == min_chain);
+	if (g_hash_factor == 1051) {
+		// A quarter of the capacity fits in the primary blocks with a good hash
+		boa_assert(after.num_aux_used == 0);
+		boa_assert(after.max_aux_chain == 0);
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(map, i) == (i % 4 == 0 ? i * i : -1));
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_clear_aux, "Cleared maps should not contain entries of auxilary blocks")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	uint32_t count = 1000;
+	init_square_map(map, count);
+
+	boa_map_clear(map);
+	boa_assert(map->count == 0);
+
+	uint32_t num_visited = 0;
+	boa_map_for (kv_int_int, kv, map) {
+		num_visited++;
+	}
+	boa_assert(num_visited == 0);
+
+	for (uint32_t i = 0; i < 100; i++) {
+		insert_int(map, i, i);
+	}
+
+	num_visited = 0;
+	boa_map_for (kv_int_int, kv, map) {
+		boa_assert(find_int(map, kv->key) == kv->key);
+		num_visited++;
+	}
+	boa_assert(num_visited == 100);
+
+	boa_map_reset(map);
+}
+
 BOA_TEST(map_medium_remove_half, "Remove half of the keys of a map and find the remaining ones")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
@@ -412,6 +783,88 @@ BOA_TEST(map_remove_medium_iterate, "Remove a medium amount of keys by iteration
 	boa_map_reset(map);
 }
 
+BOA_TEST(map_incremental_rehash, "Find, insert, iterate and remove during an incremental rehash")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+	boa_map_set_incremental(map, 1);
+
+	uint32_t count;
+	for (count = 0; count < 1000 || !map->impl.rehash; count++) {
+		insert_int(map, count, count * count);
+	}
+
+	boa_assert(map->impl.rehash != NULL);
+	boa_assert(map->count == count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(map, i) == i * i);
+	}
+
+	char *visited = (char*)boa_alloc(count);
+	memset(visited, 0, count);
+	uint32_t num_visited = 0;
+	boa_map_for (kv_int_int, kv, map) {
+		boa_assert(kv->key >= 0 && kv->key < (int)count);
+		boa_assert(!visited[kv->key]);
+		visited[kv->key] = 1;
+		num_visited++;
+	}
+	boa_assert(num_visited == count);
+	boa_free(visited);
+
+	// Remove odd keys from both the old and the new table
+	for (uint32_t i = 1; i < count; i += 2) {
+		erase_int(map, i);
+	}
+	boa_assert(map->count == count - count / 2);
+
+	// Inserting existing keys continues the migration
+	for (uint32_t i = 0; i < count; i += 2) {
+		boa_test_hint_u32(i);
+		int key = (int)i;
+		boa_map_insert_result ires = boa_map_insert(map, &key, int_hash(key), &int_cmp, NULL);
+		boa_assert(!ires.inserted);
+		boa_assert(((kv_int_int*)ires.entry)->val == i * i);
+	}
+
+	boa_assert(boa_map_rehash_step(map, ~0u) == 0);
+	boa_assert(map->impl.rehash == NULL);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(map, i) == (i % 2 == 0 ? i * i : -1));
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_incremental_remove_iterate, "Remove all keys by iteration during an incremental rehash")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+	boa_map_set_incremental(map, 1);
+
+	uint32_t count;
+	for (count = 0; count < 1000 || !map->impl.rehash; count++) {
+		insert_int(map, count, count * count);
+	}
+
+	boa_map_iterator it = boa_map_begin(map);
+	uint32_t iter = 0;
+	while (it.entry) {
+		iter++;
+		boa_test_hint_u32(iter);
+		it = boa_map_remove_iter(map, it.entry);
+		boa_assert(map->count == count - iter);
+	}
+
+	boa_assert(iter == count);
+
+	boa_map_reset(map);
+}
+
 BOA_TEST(map_erase_erase_odd, "Erase odd keys from a map")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
@@ -492,6 +945,73 @@ BOA_TEST(map_erase_insert_loop, "Insert + erase loop should not reallocate")
 	boa_map_reset(map);
 }
 
+BOA_TEST(map_init_fixed, "Maps should use caller storage while the table fits in it")
+{
+	uint64_t storage[BOA_MAP_FIXED_STORAGE_SIZE(sizeof(uint32_t) * 2, 64) / 8];
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_test_allocator ator = boa_test_allocator_make();
+	boa_map_init_fixed(map, sizeof(uint32_t) * 2, storage, sizeof(storage), &ator.ator);
+
+	// The table is sized to fill the storage
+	for (uint32_t i = 0; i < 64; i++) {
+		uint32_t *kv = (uint32_t*)boa_u32_map_insert(map, i).entry;
+		kv[0] = i;
+		kv[1] = i * 3;
+	}
+	boa_assert(map->capacity == 64);
+	boa_assert((void*)map->impl.blocks == (void*)storage);
+	boa_assert(ator.allocs == 0);
+
+	// Growing moves the table to the allocator
+	for (uint32_t i = 64; i < 500; i++) {
+		uint32_t *kv = (uint32_t*)boa_u32_map_insert(map, i).entry;
+		kv[0] = i;
+		kv[1] = i * 3;
+	}
+	boa_assert((void*)map->impl.blocks != (void*)storage);
+	boa_assert(ator.allocs >= 1);
+	for (uint32_t i = 0; i < 500; i++) {
+		uint32_t *kv = (uint32_t*)boa_u32_map_find(map, i);
+		boa_assert(kv && kv[1] == i * 3);
+	}
+
+	// Shrinking moves it back
+	for (uint32_t i = 40; i < 500; i++) {
+		boa_map_remove(map, boa_u32_map_find(map, i));
+	}
+	boa_assert(boa_map_shrink(map));
+	boa_assert((void*)map->impl.blocks == (void*)storage);
+	boa_assert(ator.frees == ator.allocs);
+	for (uint32_t i = 0; i < 500; i++) {
+		uint32_t *kv = (uint32_t*)boa_u32_map_find(map, i);
+		if (i < 40) boa_assert(kv && kv[1] == i * 3);
+		else boa_assert(kv == NULL);
+	}
+
+	// Incremental growth out of the storage
+	boa_map_set_incremental(map, 1);
+	for (uint32_t i = 40; i < 2000; i++) {
+		uint32_t *kv = (uint32_t*)boa_u32_map_insert(map, i).entry;
+		kv[0] = i;
+		kv[1] = i * 3;
+	}
+	for (uint32_t i = 0; i < 2000; i++) {
+		uint32_t *kv = (uint32_t*)boa_u32_map_find(map, i);
+		boa_assert(kv && kv[1] == i * 3);
+	}
+
+	boa_map_reset(map);
+	boa_assert(ator.frees == ator.allocs);
+
+	// Storage too small for any table
+	uint64_t tiny[4];
+	boa_map_init_fixed(map, sizeof(uint32_t) * 2, tiny, sizeof(tiny), &ator.ator);
+	boa_u32_map_insert(map, 1);
+	boa_assert((void*)map->impl.blocks != (void*)tiny);
+	boa_map_reset(map);
+	boa_assert(ator.frees == ator.allocs);
+}
+
 BOA_TEST(map_insert_alloc_fail, "Insert should fail gracefully")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
@@ -546,6 +1066,91 @@ BOA_TEST(map_large, "Insert a large amount of keys")
 	boa_map_reset(map);
 }
 
+BOA_TEST(map_parallel_reserve, "Re-hash a large map using a job runner")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_job_runner runner = { &reverse_run_jobs, 4 };
+	boa_map_init(map, sizeof(kv_int_int));
+	boa_map_set_job_runner(map, &runner);
+
+	// Grow through parallel re-hashes without reserving
+	uint32_t count = 40000;
+	for (uint32_t i = 0; i < count; i++) {
+		insert_int(map, i, i * i);
+	}
+	boa_assert(map->count == count);
+
+	boa_assert(boa_map_reserve(map, count * 4));
+	boa_assert(map->count == count);
+	boa_assert(map->capacity >= count * 4);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(find_int(map, i) == i * i);
+	}
+
+	uint32_t num_visited = 0;
+	boa_map_for (kv_int_int, kv, map) {
+		boa_assert(kv->val == kv->key * kv->key);
+		num_visited++;
+	}
+	boa_assert(num_visited == count);
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_parts, "Iterate a map in disjoint parts")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+
+	// Empty map has only empty parts
+	boa_map_part part = boa_map_get_part(map, 0, 4);
+	boa_assert(boa_map_part_begin(map, &part).entry == NULL);
+
+	uint32_t count = 10000;
+	for (uint32_t i = 0; i < count; i++) {
+		insert_int(map, i, i);
+	}
+
+	static const uint32_t part_counts[] = { 1, 2, 3, 7, 64, 1000 };
+	for (uint32_t i = 0; i < boa_arraycount(part_counts); i++) {
+		uint32_t num_parts = part_counts[i];
+		boa_test_hint_u32(num_parts);
+		check_map_parts(map, count, num_parts);
+	}
+
+	// Sum the parts using a job runner
+	boa_job_runner runner = { &reverse_run_jobs, 4 };
+	uint64_t part_sums[16];
+	map_part_sum_job job = { map, 16, part_sums };
+	boa_run_jobs(&runner, &map_part_sum, &job, 16);
+
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < 16; i++) sum += part_sums[i];
+	boa_assert(sum == (uint64_t)count * (count - 1) / 2);
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_parts_incremental, "Iterate a map in parts during an incremental rehash")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+	boa_map_set_incremental(map, 1);
+
+	uint32_t count = 0;
+	for (; count < 1000 || map->impl.rehash == NULL; count++) {
+		insert_int(map, count, count);
+	}
+
+	check_map_parts(map, count, 1);
+	check_map_parts(map, count, 5);
+	check_map_parts(map, count, 100);
+
+	boa_map_reset(map);
+}
+
 BOA_TEST_END_PERMUTATION(g_hash_factor)
 BOA_TEST_END_PERMUTATION(g_do_reserve)
 BOA_TEST_END_PERMUTATION(g_insert_reversed)
@@ -588,6 +1193,90 @@ BOA_TEST(map_insert_alloc_fail_fallback, "Insert should fail gracefully on aux b
 	boa_map_reset(map);
 }
 
+BOA_TEST(map_probe_wrap, "Probe sequences should wrap around the end of a block")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+
+	boa_map_reserve(map, 16);
+	uint32_t slot_mask = boa__map_block_num_slots(map) - 1;
+
+	// Start all probes from the last few slots of the block
+	for (uint32_t i = 0; i < 12; i++) {
+		int key = (int)i;
+		uint32_t hash = slot_mask - (i % 3);
+		boa_map_insert_result ires = boa_map_insert(map, &key, hash, &int_cmp, NULL);
+		kv_int_int *kv = (kv_int_int*)ires.entry;
+		boa_assert(ires.inserted);
+		kv->key = key;
+		kv->val = key * key;
+	}
+
+	for (uint32_t i = 0; i < 12; i += 2) {
+		int key = (int)i;
+		uint32_t hash = slot_mask - (i % 3);
+		void *entry = boa_map_find(map, &key, hash, &int_cmp, NULL);
+		boa_assert(entry != NULL);
+		boa_map_remove(map, entry);
+	}
+
+	for (uint32_t i = 0; i < 16; i++) {
+		boa_test_hint_u32(i);
+		int key = (int)i;
+		uint32_t hash = slot_mask - (i % 3);
+		kv_int_int *kv = (kv_int_int*)boa_map_find(map, &key, hash, &int_cmp, NULL);
+		if (i % 2 == 1 && i < 12) {
+			boa_assert(kv != NULL);
+			boa_assert(kv->val == i * i);
+		} else {
+			boa_assert(kv == NULL);
+		}
+	}
+
+	boa_map_reset(map);
+}
+
+BOA_TEST(map_fullhash_cmp, "Full hash variants should not compare entries with different high hash bits")
+{
+	boa_map mapv = { 0 }, *map = &mapv;
+	boa_map_init(map, sizeof(kv_int_int));
+
+	uint32_t num_cmp = 0;
+
+	// Every key has the same `LOWMASK` bits but different high bits
+	for (uint32_t i = 0; i < 32; i++) {
+		int key = (int)i;
+		uint32_t hash = (i << BOA__MAP_LOWBITS) | 1;
+		boa_map_insert_result ires = boa_map_insert_fullhash(map, &key, hash, &counting_int_cmp, &num_cmp);
+		kv_int_int *kv = (kv_int_int*)ires.entry;
+		boa_assert(ires.inserted);
+		kv->key = key;
+		kv->val = key * key;
+	}
+	boa_assert(num_cmp == 0);
+
+	for (uint32_t i = 0; i < 64; i++) {
+		boa_test_hint_u32(i);
+		int key = (int)i;
+		uint32_t hash = (i << BOA__MAP_LOWBITS) | 1;
+		num_cmp = 0;
+		kv_int_int *kv = (kv_int_int*)boa_map_find_fullhash(map, &key, hash, &counting_int_cmp, &num_cmp);
+		if (i < 32) {
+			boa_assert(kv != NULL);
+			boa_assert(kv->val == i * i);
+			boa_assert(num_cmp == 1);
+		} else {
+			boa_assert(kv == NULL);
+			boa_assert(num_cmp == 0);
+		}
+
+		// Non-full hash find should return the same results
+		boa_assert(boa_map_find(map, &key, hash, &int_cmp, NULL) == kv);
+	}
+
+	boa_map_reset(map);
+}
+
 BOA_TEST(string_map_simple, "Simple manual string map test")
 {
 	boa_map mapv = { 0 }, *map = &mapv;
@@ -643,3 +1332,183 @@ BOA_TEST(string_map_medium, "String map test with medium amount of keys")
 
 	string_map_reset(map);
 }
+
+BOA_TEST(hash_bytes, "Hash byte keys of all sizes")
+{
+	unsigned char data[100];
+	for (uint32_t i = 0; i < sizeof(data); i++) {
+		data[i] = (unsigned char)(i * 7 + 1);
+	}
+
+	for (uint32_t size = 0; size <= sizeof(data); size++) {
+		boa_test_hint_u32(size);
+
+		// Copy to an exact size allocation to catch reads past the end
+		unsigned char *key = (unsigned char*)boa_alloc(size + 1);
+		memcpy(key, data, size);
+
+		uint64_t hash = boa_hash_bytes(key, size, 0);
+		boa_assert(boa_hash_bytes(key, size, 0) == hash);
+		boa_assert(boa_hash_bytes(data, size, 0) == hash);
+		boa_assert(boa_hash_bytes(key, size, 1) != hash);
+
+		// Every bit of the key should affect the hash
+		for (uint32_t bit = 0; bit < size * 8; bit++) {
+			boa_test_hint_u32(bit);
+			key[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+			boa_assert(boa_hash_bytes(key, size, 0) != hash);
+			key[bit / 8] ^= (unsigned char)(1u << (bit % 8));
+		}
+
+		boa_free(key);
+	}
+}
+
+BOA_TEST(blit_map_seed, "Blit maps with different hash seeds")
+{
+	typedef struct { uint32_t key[5]; uint32_t val; } blit_entry;
+	uint32_t count = 1000;
+
+	for (uint32_t seed = 0; seed < 3; seed++) {
+		boa_test_hint_u32(seed);
+		boa_map mapv = { 0 }, *map = &mapv;
+		boa_map_init(map, sizeof(blit_entry));
+		boa_map_set_hash_seed(map, seed * 0x12345);
+
+		for (uint32_t i = 0; i < count; i++) {
+			blit_entry entry = { { i, 1, 2, 3, i * 3 }, i * i };
+			boa_map_insert_result ires = boa_blit_map_insert(map, &entry, sizeof(entry.key));
+			boa_assert(ires.inserted);
+			memcpy(ires.entry, &entry, sizeof(entry));
+		}
+
+		// Snapshots should keep the seed
+		uint32_t size = boa_map_snapshot_size(map);
+		void *data = boa_alloc(size);
+		boa_assert(boa_map_snapshot_write(map, data, size) == size);
+
+		boa_map snapv = { 0 }, *snap = &snapv;
+		boa_map_init(snap, sizeof(blit_entry));
+		boa_assert(boa_map_snapshot_open(snap, data, size));
+
+		for (uint32_t i = 0; i < count; i++) {
+			boa_test_hint_u32(i);
+			uint32_t key[5] = { i, 1, 2, 3, i * 3 };
+			blit_entry *entry = (blit_entry*)boa_blit_map_find(map, key, sizeof(key));
+			boa_assert(entry && entry->val == i * i);
+			entry = (blit_entry*)boa_blit_map_find(snap, key, sizeof(key));
+			boa_assert(entry && entry->val == i * i);
+		}
+
+		boa_map_reset(snap);
+		boa_free(data);
+		boa_map_reset(map);
+	}
+}
+
+BOA_TEST(blit_map_fixed_sizes, "Fixed size blit maps are compatible with generic blit maps")
+{
+	typedef boa_map_insert_result (*insert_fn)(boa_map *map, const void *key_ptr);
+	typedef void *(*find_fn)(const boa_map *map, const void *key_ptr);
+	static const uint32_t sizes[] = { 4, 8, 12, 16 };
+	static const insert_fn inserts[] = { &boa_blit4_map_insert, &boa_blit8_map_insert, &boa_blit12_map_insert, &boa_blit16_map_insert };
+	static const find_fn finds[] = { &boa_blit4_map_find, &boa_blit8_map_find, &boa_blit12_map_find, &boa_blit16_map_find };
+	uint32_t count = 1000;
+
+	for (uint32_t n = 0; n < boa_arraycount(sizes); n++) {
+		uint32_t size = sizes[n];
+		boa_test_hint_u32(size);
+		boa_map mapv = { 0 }, *map = &mapv;
+		boa_map_init(map, 16);
+
+		// Insert even keys with the fixed function and odd keys with the generic one
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t key[4] = { i, i * 3, 7, i ^ 5 };
+			boa_map_insert_result ires = i % 2 ? boa_blit_map_insert(map, key, size) : inserts[n](map, key);
+			boa_assert(ires.inserted);
+			memcpy(ires.entry, key, sizeof(key));
+			boa_assert(!inserts[n](map, key).inserted);
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			boa_test_hint_u32(i);
+			uint32_t key[4] = { i, i * 3, 7, i ^ 5 };
+			void *entry = finds[n](map, key);
+			boa_assert(entry != NULL);
+			boa_assert(boa_blit_map_find(map, key, size) == entry);
+			boa_assert(!memcmp(entry, key, size));
+
+			// Only the first `size` bytes are part of the key
+			key[size / 4 - 1] = ~0u;
+			boa_assert(finds[n](map, key) == NULL);
+		}
+
+		boa_map_reset(map);
+	}
+}
+
+BOA_TEST(map_block_entries, "Maps with a fixed block size keep it through growth, shrinking and snapshots")
+{
+	static const uint32_t block_sizes[] = { 16, 32, 64 };
+	uint32_t count = 2000;
+
+	for (uint32_t n = 0; n < boa_arraycount(block_sizes); n++) {
+		uint32_t block_entries = block_sizes[n];
+		boa_test_hint_u32(block_entries);
+		boa_map mapv = { 0 }, *map = &mapv;
+		boa_map_init(map, sizeof(uint32_t) * 2);
+		boa_map_set_block_entries(map, block_entries);
+
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t *kv = (uint32_t*)boa_map_insert_geometry_inline(map, &i, boa_u32_hash(i),
+				&u32_key_cmp, NULL, 0, block_entries, sizeof(uint32_t) * 2).entry;
+			boa_assert(kv != NULL);
+			kv[0] = i;
+			kv[1] = i * 3;
+			boa_assert(map->impl.block_num_entries == block_entries);
+		}
+		boa_assert(map->impl.num_hash_blocks > 1);
+
+		// Fixed geometry and runtime finds see the same entries
+		for (uint32_t i = 0; i < count * 2; i++) {
+			boa_test_hint_u32(i);
+			uint32_t *kv = (uint32_t*)boa_map_find_geometry_inline(map, &i, boa_u32_hash(i),
+				&u32_key_cmp, NULL, 0, block_entries, sizeof(uint32_t) * 2);
+			boa_assert(kv == boa_u32_map_find(map, i));
+			if (i < count) boa_assert(kv && kv[1] == i * 3);
+			else boa_assert(kv == NULL);
+		}
+
+		for (uint32_t i = 0; i < count; i += 2) {
+			boa_map_remove(map, boa_u32_map_find(map, i));
+		}
+		boa_map_shrink(map);
+		boa_assert(map->impl.block_num_entries == block_entries);
+
+		uint32_t size = boa_map_snapshot_size(map);
+		void *data = boa_alloc(size);
+		boa_assert(boa_map_snapshot_write(map, data, size) == size);
+
+		// Snapshots can only be opened with a matching block size
+		for (uint32_t m = 0; m < boa_arraycount(block_sizes); m++) {
+			boa_map snapv = { 0 }, *snap = &snapv;
+			boa_map_init(snap, sizeof(uint32_t) * 2);
+			boa_map_set_block_entries(snap, block_sizes[m]);
+			int ok = boa_map_snapshot_open(snap, data, size);
+			boa_assert(ok == (m == n));
+			if (ok) {
+				boa_assert(snap->impl.block_num_entries == block_entries);
+				for (uint32_t i = 0; i < count; i++) {
+					uint32_t *kv = (uint32_t*)boa_map_find_geometry_inline(snap, &i, boa_u32_hash(i),
+						&u32_key_cmp, NULL, 0, block_entries, sizeof(uint32_t) * 2);
+					if (i % 2) boa_assert(kv && kv[1] == i * 3);
+					else boa_assert(kv == NULL);
+				}
+			}
+			boa_map_reset(snap);
+		}
+
+		boa_free(data);
+		boa_map_reset(map);
+	}
+}
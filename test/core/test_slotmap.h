@@ -0,0 +1,239 @@
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct {
+	uint32_t id;
+	uint32_t val;
+} slot_obj;
+
+#endif
+
+BOA_TEST(slotmap_simple, "Insert, get and remove slot map objects")
+{
+	boa_slotmap map;
+	uint32_t a, b, c;
+	boa_slotmap_init(&map, sizeof(slot_obj), NULL);
+	boa_assert(boa_slotmap_get(&map, BOA_SLOTMAP_INVALID_HANDLE) == NULL);
+
+	slot_obj *obj = (slot_obj*)boa_slotmap_insert(&map, &a);
+	boa_assert(obj != NULL);
+	obj->id = 1;
+	obj = (slot_obj*)boa_slotmap_insert(&map, &b);
+	boa_assert(obj != NULL);
+	obj->id = 2;
+	obj = (slot_obj*)boa_slotmap_insert(&map, &c);
+	boa_assert(obj != NULL);
+	obj->id = 3;
+
+	boa_assert(a != BOA_SLOTMAP_INVALID_HANDLE);
+	boa_assert(map.count == 3);
+	boa_assert(((slot_obj*)boa_slotmap_get(&map, a))->id == 1);
+	boa_assert(((slot_obj*)boa_slotmap_get(&map, b))->id == 2);
+	boa_assert(((slot_obj*)boa_slotmap_get(&map, c))->id == 3);
+
+	// Removing moves the last object in place of the removed one
+	boa_assert(boa_slotmap_remove(&map, a) == 1);
+	boa_assert(boa_slotmap_remove(&map, a) == 0);
+	boa_assert(boa_slotmap_get(&map, a) == NULL);
+	boa_assert(map.count == 2);
+	boa_assert(boa_begin(slot_obj, &map.data)[0].id == 3);
+	boa_assert(boa_slotmap_handle_at(&map, 0) == c);
+	boa_assert(((slot_obj*)boa_slotmap_get(&map, c))->id == 3);
+
+	// The slot is reused with a new generation
+	uint32_t d;
+	obj = (slot_obj*)boa_slotmap_insert(&map, &d);
+	boa_assert(obj != NULL);
+	obj->id = 4;
+	boa_assert((d & BOA_SLOTMAP_INDEX_MASK) == (a & BOA_SLOTMAP_INDEX_MASK));
+	boa_assert(d != a);
+	boa_assert(boa_slotmap_get(&map, a) == NULL);
+	boa_assert(((slot_obj*)boa_slotmap_get(&map, d))->id == 4);
+
+	boa_slotmap_clear(&map);
+	boa_assert(map.count == 0);
+	boa_assert(boa_slotmap_get(&map, b) == NULL);
+	boa_assert(boa_slotmap_get(&map, d) == NULL);
+	obj = (slot_obj*)boa_slotmap_insert(&map, &a);
+	boa_assert(obj != NULL);
+	boa_assert(boa_slotmap_get(&map, a) == obj);
+	boa_assert(boa_slotmap_get(&map, b) == NULL);
+
+	boa_slotmap_reset(&map);
+}
+
+BOA_TEST(slotmap_random, "Random inserts and removes from a slot map")
+{
+	enum { max_live = 1000 };
+	static uint32_t handles[max_live];
+	static uint32_t dead[max_live];
+	uint32_t num_live = 0, num_dead = 0, seed = 1, next_id = 1;
+	boa_slotmap map;
+	boa_slotmap_init(&map, sizeof(slot_obj), NULL);
+
+	for (uint32_t round = 0; round < 50; round++) {
+		boa_test_hint_u32(round);
+		for (uint32_t op = 0; op < 400; op++) {
+			seed = seed * 1664525u + 1013904223u;
+			if (num_live < max_live && (num_live == 0 || (seed >> 8) % 3 != 0)) {
+				uint32_t handle;
+				slot_obj *obj = (slot_obj*)boa_slotmap_insert(&map, &handle);
+				boa_assert(obj != NULL);
+				obj->id = next_id++;
+				obj->val = handle;
+				handles[num_live++] = handle;
+			} else {
+				uint32_t ix = (seed >> 8) % num_live;
+				boa_assert(boa_slotmap_remove(&map, handles[ix]) == 1);
+				dead[num_dead++ % max_live] = handles[ix];
+				handles[ix] = handles[--num_live];
+			}
+		}
+
+		boa_assert(map.count == num_live);
+		for (uint32_t i = 0; i < num_live; i++) {
+			slot_obj *obj = (slot_obj*)boa_slotmap_get(&map, handles[i]);
+			boa_assert(obj && obj->val == handles[i]);
+		}
+		for (uint32_t i = 0; i < boa_min(num_dead, (uint32_t)max_live); i++) {
+			boa_assert(boa_slotmap_get(&map, dead[i]) == NULL);
+		}
+
+		// Dense iteration visits every live object once
+		uint32_t index = 0;
+		boa_slotmap_for(slot_obj, obj, &map) {
+			boa_assert(boa_slotmap_handle_at(&map, index) == obj->val);
+			boa_assert(boa_slotmap_get(&map, obj->val) == obj);
+			index++;
+		}
+		boa_assert(index == num_live);
+	}
+
+	// Remove objects while iterating by index, the last object moves to the removed index
+	for (uint32_t i = 0; i < map.count; ) {
+		slot_obj *obj = boa_begin(slot_obj, &map.data) + i;
+		if (obj->id % 2 == 0) {
+			boa_assert(boa_slotmap_remove(&map, obj->val));
+		} else {
+			i++;
+		}
+	}
+	boa_slotmap_for(slot_obj, obj, &map) {
+		boa_assert(obj->id % 2 == 1);
+	}
+
+	boa_slotmap_reset(&map);
+}
+
+BOA_TEST(slotmap_generations, "Slot map handles stay unique through generation wrap-around")
+{
+	boa_slotmap map;
+	boa_slotmap_init(&map, sizeof(slot_obj), NULL);
+
+	uint32_t first, prev = BOA_SLOTMAP_INVALID_HANDLE;
+	boa_assert(boa_slotmap_insert(&map, &first) != NULL);
+	boa_assert(boa_slotmap_remove(&map, first));
+	for (uint32_t i = 0; i < BOA_SLOTMAP_GENERATION_MASK + 10; i++) {
+		uint32_t handle;
+		boa_assert(boa_slotmap_insert(&map, &handle) != NULL);
+		boa_assert(handle != BOA_SLOTMAP_INVALID_HANDLE);
+		boa_assert(handle != prev);
+		boa_assert(boa_slotmap_get(&map, prev) == NULL);
+		boa_assert(boa_slotmap_remove(&map, handle));
+		prev = handle;
+	}
+	boa_assert(boa_count(boa__slot, &map.slots) == 1);
+
+	boa_slotmap_reset(&map);
+}
+
+BOA_TEST(slotmap_stale_wrap, "Stale slot map handles never resolve to a free slot")
+{
+	boa_slotmap map;
+	boa_slotmap_init(&map, sizeof(slot_obj), NULL);
+
+	// Cycle the slot through every generation multiple times checking the stale
+	// handle against both the free and the reused slot
+	uint32_t stale, aliased = 0;
+	boa_assert(boa_slotmap_insert(&map, &stale) != NULL);
+	boa_assert(boa_slotmap_remove(&map, stale));
+	for (uint32_t i = 0; i < BOA_SLOTMAP_GENERATION_MASK + 10; i++) {
+		boa_assert(boa_slotmap_get(&map, stale) == NULL);
+		boa_assert(boa_slotmap_remove(&map, stale) == 0);
+		boa_assert(boa_slotmap_get(&map, BOA_SLOTMAP_INVALID_HANDLE) == NULL);
+		boa_assert(boa_slotmap_remove(&map, BOA_SLOTMAP_INVALID_HANDLE) == 0);
+		boa_assert(map.count == 0);
+
+		uint32_t handle;
+		slot_obj *obj = (slot_obj*)boa_slotmap_insert(&map, &handle);
+		boa_assert(obj != NULL);
+		boa_assert((handle >> BOA_SLOTMAP_INDEX_BITS) % 2 == 1);
+		if (handle == stale) {
+			// Wrapped around, allowed to alias the live object but nothing else
+			boa_assert(boa_slotmap_get(&map, stale) == obj);
+			aliased++;
+		} else {
+			boa_assert(boa_slotmap_get(&map, stale) == NULL);
+		}
+		boa_assert(boa_slotmap_remove(&map, handle));
+	}
+	boa_assert(aliased == 2);
+
+	// The free generation has wrapped to zero at some point, the invalid handle
+	// must still never resolve
+	boa_assert(boa_begin(boa__slot, &map.slots)[0].generation % 2 == 0);
+	boa_assert(boa_slotmap_get(&map, BOA_SLOTMAP_INVALID_HANDLE) == NULL);
+	boa_assert(boa_slotmap_remove(&map, BOA_SLOTMAP_INVALID_HANDLE) == 0);
+	boa_assert(map.count == 0);
+
+	// Clearing frees the slots the same way
+	uint32_t live;
+	boa_assert(boa_slotmap_insert(&map, &live) != NULL);
+	boa_slotmap_clear(&map);
+	boa_assert(boa_slotmap_get(&map, live) == NULL);
+	boa_assert(boa_slotmap_remove(&map, live) == 0);
+	boa_assert(map.count == 0);
+
+	boa_slotmap_reset(&map);
+}
+
+BOA_TEST(slotmap_fail_alloc, "Slot map should survive allocation failures")
+{
+	enum { num_objs = 500 };
+	static uint32_t handles[num_objs];
+	uint32_t num_live = 0;
+	boa_slotmap map;
+	boa_slotmap_init(&map, sizeof(slot_obj), NULL);
+
+	for (uint32_t i = 0; i < num_objs; i++) {
+		uint32_t handle;
+		boa_test_fail_allocations(i % 4, 1);
+		slot_obj *obj = (slot_obj*)boa_slotmap_insert(&map, &handle);
+		boa_test_fail_allocations(0, 0);
+		if (obj) {
+			obj->val = handle;
+			handles[num_live++] = handle;
+		}
+	}
+
+	boa_assert(map.count == num_live);
+	for (uint32_t i = 0; i < num_live; i++) {
+		slot_obj *obj = (slot_obj*)boa_slotmap_get(&map, handles[i]);
+		boa_assert(obj && obj->val == handles[i]);
+	}
+
+	boa_test_fail_next_allocation();
+	boa_assert(!boa_slotmap_reserve(&map, 100000));
+	boa_assert(boa_slotmap_reserve(&map, 2000));
+	boa_test_fail_allocations(0, 100);
+	for (uint32_t i = num_live; i < 2000; i++) {
+		uint32_t handle;
+		boa_assert(boa_slotmap_insert(&map, &handle) != NULL);
+	}
+	boa_test_fail_allocations(0, 0);
+	boa_assert(map.count == 2000);
+
+	boa_slotmap_reset(&map);
+}
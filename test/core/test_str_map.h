@@ -0,0 +1,128 @@
+#include <boa_test.h>
+#include <boa_core.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct { boa_str_key key; uint32_t val; } str_kv;
+
+void str_map_check_key(const str_kv *kv, const char *data, uint32_t length)
+{
+	boa_assert(kv->key.length == length);
+	boa_assert(!memcmp(kv->key.data, data, length));
+	boa_assert(kv->key.data[length] == '\0');
+}
+
+#endif
+
+BOA_TEST(str_map_simple, "Insert, find and remove string keys")
+{
+	boa_str_map map;
+	boa_str_map_init(&map, sizeof(str_kv), NULL);
+
+	str_kv *hello = (str_kv*)boa_str_map_insert_cstr(&map, "Hello").entry;
+	hello->val = 10;
+	str_kv *world = (str_kv*)boa_str_map_insert_cstr(&map, "World").entry;
+	world->val = 20;
+
+	boa_assert(map.map.count == 2);
+	boa_assert(!boa_str_map_insert_cstr(&map, "Hello").inserted);
+
+	// Lookups by a slice of a larger buffer
+	const char *text = "Hello World!";
+	str_kv *kv = (str_kv*)boa_str_map_find(&map, text, 5);
+	boa_assert(kv == hello && kv->val == 10);
+	str_map_check_key(kv, "Hello", 5);
+	boa_assert(kv->key.data != text);
+	boa_assert(kv->key.hash == boa_str_map_hash(&map, "Hello", 5));
+
+	kv = (str_kv*)boa_str_map_find(&map, text + 6, 5);
+	boa_assert(kv == world && kv->val == 20);
+	boa_assert(boa_str_map_find(&map, text, 4) == NULL);
+	boa_assert(boa_str_map_find(&map, text + 6, 6) == NULL);
+	boa_assert(boa_str_map_find_cstr(&map, "What") == NULL);
+
+	// Empty keys and keys with zero bytes are valid
+	boa_assert(boa_str_map_insert(&map, "", 0).inserted);
+	boa_assert(boa_str_map_insert(&map, "a\0b", 3).inserted);
+	boa_assert(boa_str_map_insert(&map, "a\0c", 3).inserted);
+	boa_assert(boa_str_map_find(&map, "", 0) != NULL);
+	str_map_check_key((str_kv*)boa_str_map_find(&map, "a\0b", 3), "a\0b", 3);
+	boa_assert(boa_str_map_find_cstr(&map, "a") == NULL);
+
+	boa_str_map_remove(&map, hello);
+	boa_assert(boa_str_map_find_cstr(&map, "Hello") == NULL);
+	boa_assert(((str_kv*)boa_str_map_find_cstr(&map, "World"))->val == 20);
+	boa_assert(map.map.count == 4);
+
+	boa_str_map_reset(&map);
+}
+
+BOA_TEST(str_map_medium, "String map with a medium amount of keys")
+{
+	boa_str_map map;
+	boa_str_map_init(&map, sizeof(str_kv), NULL);
+	uint32_t count = 2000;
+	char buf[64];
+
+	for (uint32_t round = 0; round < 2; round++) {
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t length = (uint32_t)snprintf(buf, sizeof(buf), "some/common/prefix/%u", i);
+			boa_map_insert_result res = boa_str_map_insert(&map, buf, length);
+			boa_assert(res.inserted);
+			((str_kv*)res.entry)->val = i;
+		}
+
+		for (uint32_t i = 0; i < count * 2; i++) {
+			boa_test_hint_u32(i);
+			uint32_t length = (uint32_t)snprintf(buf, sizeof(buf), "some/common/prefix/%u", i);
+			str_kv *kv = (str_kv*)boa_str_map_find(&map, buf, length);
+			if (i < count) {
+				boa_assert(kv && kv->val == i);
+				str_map_check_key(kv, buf, length);
+			} else {
+				boa_assert(kv == NULL);
+			}
+		}
+
+		uint32_t num_visited = 0;
+		boa_map_for (str_kv, kv, &map.map) {
+			boa_assert(kv->key.hash == boa_str_map_hash(&map, kv->key.data, kv->key.length));
+			num_visited++;
+		}
+		boa_assert(num_visited == count);
+
+		boa_str_map_clear(&map);
+		boa_assert(map.map.count == 0);
+		boa_assert(boa_str_map_find_cstr(&map, "some/common/prefix/1") == NULL);
+	}
+
+	boa_str_map_reset(&map);
+}
+
+BOA_TEST(str_map_fail_alloc, "String map inserts should fail gracefully")
+{
+	boa_str_map map;
+	boa_str_map_init(&map, sizeof(str_kv), NULL);
+	char buf[64];
+
+	for (uint32_t i = 0; i < 500; i++) {
+		uint32_t length = (uint32_t)snprintf(buf, sizeof(buf), "key-%u", i);
+		boa_test_fail_allocations(i % 3, 1);
+		boa_map_insert_result res = boa_str_map_insert(&map, buf, length);
+		boa_test_fail_allocations(0, 0);
+		if (res.entry) {
+			((str_kv*)res.entry)->val = i;
+		}
+
+		str_kv *kv = (str_kv*)boa_str_map_find(&map, buf, length);
+		boa_assert(kv == res.entry);
+		if (kv) str_map_check_key(kv, buf, length);
+	}
+
+	boa_map_for (str_kv, kv, &map.map) {
+		uint32_t length = (uint32_t)snprintf(buf, sizeof(buf), "key-%u", kv->val);
+		str_map_check_key(kv, buf, length);
+	}
+
+	boa_str_map_reset(&map);
+}
@@ -0,0 +1,125 @@
+
+#include <boa_test.h>
+#include <boa_core.h>
+#include <boa_os.h>
+
+#if BOA_TEST_IMPL
+
+typedef struct { uint32_t key, val; } sync_kv;
+
+int sync_kv_cmp(const void *a, const void *b, void *user) { return *(const uint32_t*)a == *(const uint32_t*)b; }
+
+void sync_kv_add(void *entry, int inserted, void *user)
+{
+	sync_kv *kv = (sync_kv*)entry;
+	if (inserted) {
+		kv->key = *(uint32_t*)user;
+		kv->val = 0;
+	}
+	kv->val++;
+}
+
+typedef struct {
+	boa_sync_map *map;
+	uint32_t begin, end;
+} sync_map_worker;
+
+void sync_map_worker_entry(void *user)
+{
+	sync_map_worker *w = (sync_map_worker*)user;
+	uint32_t i, shared_key = 0xffffffffu;
+	for (i = w->begin; i < w->end; i++) {
+		sync_kv kv = { i, i * 2 };
+		boa_sync_map_insert(w->map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, &kv);
+		boa_sync_map_update(w->map, &shared_key, boa_u32_hash(shared_key), &sync_kv_cmp, NULL, &sync_kv_add, &shared_key);
+	}
+	for (i = w->begin; i < w->end; i += 2) {
+		boa_sync_map_remove(w->map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, NULL);
+	}
+}
+
+#endif
+
+BOA_TEST(sync_map_simple, "Insert, find and remove from a sync map")
+{
+	boa_sync_map map;
+	boa_assert(boa_sync_map_init(&map, sizeof(sync_kv), 0, NULL));
+	boa_assert(map.num_shards == BOA_SYNC_MAP_DEFAULT_SHARDS);
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		sync_kv kv = { i, i * 3 };
+		boa_assert(boa_sync_map_insert(&map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, &kv) == 1);
+	}
+	boa_assert(boa_sync_map_count(&map) == 1000);
+
+	{
+		uint32_t key = 10;
+		sync_kv kv = { 10, 0 };
+		boa_assert(boa_sync_map_insert(&map, &key, boa_u32_hash(key), &sync_kv_cmp, NULL, &kv) == 0);
+	}
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		sync_kv kv;
+		boa_assert(boa_sync_map_find(&map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, &kv));
+		boa_assert(kv.key == i);
+		boa_assert(kv.val == i * 3);
+	}
+
+	for (uint32_t i = 0; i < 1000; i += 2) {
+		sync_kv kv;
+		boa_assert(boa_sync_map_remove(&map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, &kv));
+		boa_assert(kv.key == i);
+	}
+	boa_assert(boa_sync_map_count(&map) == 500);
+
+	for (uint32_t i = 0; i < 1000; i++) {
+		int found = boa_sync_map_find(&map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, NULL);
+		boa_assert(found == (int)(i % 2));
+	}
+
+	boa_sync_map_reset(&map);
+}
+
+BOA_TEST(sync_map_threads, "Modify a sync map from multiple threads")
+{
+	enum { num_threads = 4, per_thread = 10000 };
+	uint32_t num_shards = 16;
+	boa_sync_map map;
+	sync_map_worker workers[num_threads];
+	boa_thread *threads[num_threads];
+
+	// The test allocator isn't thread-safe so allocate directly from the original one
+	boa_assert(boa_sync_map_init(&map, sizeof(sync_kv), num_shards, boa_test_original_ator()));
+
+	for (uint32_t i = 0; i < num_threads; i++) {
+		boa_thread_opts opts = { 0 };
+		workers[i].map = &map;
+		workers[i].begin = i * per_thread;
+		workers[i].end = (i + 1) * per_thread;
+		opts.entry = &sync_map_worker_entry;
+		opts.user = &workers[i];
+		threads[i] = boa_create_thread(&opts);
+		boa_assert(threads[i] != NULL);
+	}
+	for (uint32_t i = 0; i < num_threads; i++) {
+		boa_join_thread(threads[i]);
+	}
+
+	boa_assert(boa_sync_map_count(&map) == num_threads * per_thread / 2 + 1);
+
+	for (uint32_t i = 0; i < num_threads * per_thread; i++) {
+		sync_kv kv;
+		int found = boa_sync_map_find(&map, &i, boa_u32_hash(i), &sync_kv_cmp, NULL, &kv);
+		boa_assert(found == (int)(i % 2));
+		if (found) boa_assert(kv.val == i * 2);
+	}
+
+	{
+		uint32_t shared_key = 0xffffffffu;
+		sync_kv kv;
+		boa_assert(boa_sync_map_find(&map, &shared_key, boa_u32_hash(shared_key), &sync_kv_cmp, NULL, &kv));
+		boa_assert(kv.val == num_threads * per_thread);
+	}
+
+	boa_sync_map_reset(&map);
+}
@@ -59,6 +59,19 @@ BOA_TEST(astar_impossible, "Astar should fail on impossible map")
 	boa_assert(path.is_empty());
 }
 
+BOA_TEST(astar_no_alloc, "Astar should not allocate for small searches")
+{
+	astar::map map(4, 4);
+	map.set(2, 0, INFINITY);
+	map.set(2, 1, INFINITY);
+	map.set(2, 2, INFINITY);
+
+	boa::buf<astar::point> path;
+	bool result = astar::pathfind(path, map, { 0, 1 }, { 3, 1 }, boa::boa_null_ator());
+	boa_assert(result);
+	boa_assert(path.count() == 8);
+}
+
 BOA_TEST(astar_big, "Astar should handle larger maps")
 {
 	astar::map map(1024, 1024);
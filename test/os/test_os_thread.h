@@ -9,6 +9,18 @@ void simple_thread_entry(void *user)
 	*(int*)user = 10;
 }
 
+typedef struct {
+	uint32_t runs[1000];
+	uint32_t total;
+} job_counter;
+
+void count_job(void *user, uint32_t index)
+{
+	job_counter *counter = (job_counter*)user;
+	counter->runs[index]++;
+	boa_atomic_fetch_add_u32(&counter->total, index);
+}
+
 #endif
 
 BOA_TEST(thread_simple, "Create a thread to set a value")
@@ -36,3 +48,21 @@ BOA_TEST(thread_simple_named, "Create a thread with a debug name")
 	boa_assert(value == 10);
 }
 
+BOA_TEST(thread_job_runner, "Run jobs using threads")
+{
+	static job_counter counter;
+	memset(&counter, 0, sizeof(counter));
+
+	boa_thread_job_runner runnerv;
+	boa_job_runner *runner = boa_thread_job_runner_init(&runnerv, 4, NULL);
+	boa_assert(runner->num_workers == 4);
+
+	uint32_t count = boa_arraycount(counter.runs);
+	boa_run_jobs(runner, &count_job, &counter, count);
+
+	for (uint32_t i = 0; i < count; i++) {
+		boa_test_hint_u32(i);
+		boa_assert(counter.runs[i] == 1);
+	}
+	boa_assert(counter.total == count * (count - 1) / 2);
+}
@@ -8,8 +8,19 @@
 #include "core/test_buf.h"
 #include "core/test_format.h"
 #include "core/test_map.h"
+#include "core/test_filter.h"
+#include "core/test_frozen_map.h"
+#include "core/test_sync_map.h"
+#include "core/test_cow_map.h"
+#include "core/test_agg.h"
+#include "core/test_join.h"
 #include "core/test_pqueue.h"
 #include "core/test_arena.h"
+#include "core/test_str_map.h"
+#include "core/test_intern.h"
+#include "core/test_btree.h"
+#include "core/test_slotmap.h"
+#include "core/test_cache.h"
 
 #include "core/test_map_impl.h"
 